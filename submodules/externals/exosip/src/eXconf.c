@@ -274,6 +274,7 @@ void eXosip_quit(void)
 #endif
 	eXtl_tls.tl_free();
 #endif
+	_eXosip_poll_free();
 
 	memset(&eXosip, 0, sizeof(eXosip));
 	eXosip.j_stop_ua = -1;
@@ -614,6 +615,15 @@ eXosip_listen_addr(int transport, const char *addr, int port, int family,
 	return OSIP_SUCCESS;
 }
 
+#ifdef OSIP_MT
+static void _eXosip_wakeup_cb(int sock, void *data)
+{
+	char buf2[500];
+
+	jpipe_read(eXosip.j_socketctl, buf2, 499);
+}
+#endif
+
 int eXosip_init(void)
 {
 	osip_t *osip;
@@ -706,6 +716,13 @@ int eXosip_init(void)
 		return OSIP_UNDEFINED_ERROR;
 #endif
 
+	if (_eXosip_poll_init() == OSIP_SUCCESS) {
+#ifdef OSIP_MT
+		_eXosip_poll_add(jpipe_get_read_descr(eXosip.j_socketctl),
+						 &_eXosip_wakeup_cb, NULL);
+#endif
+	}
+
 	/* To be changed in osip! */
 	eXosip.j_events = (osip_fifo_t *) osip_malloc(sizeof(osip_fifo_t));
 	if (eXosip.j_events == NULL)
@@ -74,6 +74,8 @@ static struct sockaddr_storage ai_addr;
 static char dtls_firewall_ip[64];
 static char dtls_firewall_port[10];
 
+static void _dtls_tl_poll_cb(int sock, void *data);
+
 static SSL_CTX *server_ctx;
 static SSL_CTX *client_ctx;
 
@@ -274,8 +276,10 @@ static int dtls_tl_free(void)
 	memset(dtls_firewall_ip, 0, sizeof(dtls_firewall_ip));
 	memset(dtls_firewall_port, 0, sizeof(dtls_firewall_port));
 	memset(&ai_addr, 0, sizeof(struct sockaddr_storage));
-	if (dtls_socket > 0)
+	if (dtls_socket > 0) {
+		_eXosip_poll_remove(dtls_socket);
 		close(dtls_socket);
+	}
 	dtls_socket = 0;
 	return OSIP_SUCCESS;
 }
@@ -380,6 +384,7 @@ static int dtls_tl_open(void)
 	}
 
 	dtls_socket = sock;
+	_eXosip_poll_add(dtls_socket, &_dtls_tl_poll_cb, NULL);
 
 	if (eXtl_dtls.proto_port == 0) {
 		/* get port number from socket */
@@ -415,236 +420,246 @@ static int dtls_tl_set_fdset(fd_set * osip_fdset, fd_set * osip_wrset, int *fd_m
 	return OSIP_SUCCESS;
 }
 
-static int dtls_tl_read_message(fd_set * osip_fdset, fd_set * osip_wrset)
+/* read one datagram from dtls_socket */
+static int _dtls_tl_recv(void)
 {
+	struct sockaddr_storage sa;
 	char *enc_buf;
 	char *dec_buf;
 	int i;
 	int enc_buf_len;
-
-	if (dtls_socket <= 0)
-		return -1;
-
-	if (FD_ISSET(dtls_socket, osip_fdset)) {
-		struct sockaddr_storage sa;
-
 #ifdef __linux
-		socklen_t slen;
+	socklen_t slen;
 #else
-		int slen;
+	int slen;
 #endif
-		if (eXtl_dtls.proto_family == AF_INET)
-			slen = sizeof(struct sockaddr_in);
-		else
-			slen = sizeof(struct sockaddr_in6);
 
-		enc_buf = (char *) osip_malloc(SIP_MESSAGE_MAX_LENGTH * sizeof(char) + 1);
-		if (enc_buf == NULL)
-			return OSIP_NOMEM;
+	if (eXtl_dtls.proto_family == AF_INET)
+		slen = sizeof(struct sockaddr_in);
+	else
+		slen = sizeof(struct sockaddr_in6);
 
-		enc_buf_len = recvfrom(dtls_socket, enc_buf,
-							   SIP_MESSAGE_MAX_LENGTH, 0,
-							   (struct sockaddr *) &sa, &slen);
+	enc_buf = (char *) osip_malloc(SIP_MESSAGE_MAX_LENGTH * sizeof(char) + 1);
+	if (enc_buf == NULL)
+		return OSIP_NOMEM;
 
-		if (enc_buf_len > 5) {
-			char src6host[NI_MAXHOST];
-			int recvport = 0;
-			int err;
+	enc_buf_len = recvfrom(dtls_socket, enc_buf,
+						   SIP_MESSAGE_MAX_LENGTH, 0,
+						   (struct sockaddr *) &sa, &slen);
 
-			BIO *rbio;
-			struct socket_tab *socket_tab_used = NULL;
-			int pos;
+	if (enc_buf_len > 5) {
+		char src6host[NI_MAXHOST];
+		int recvport = 0;
+		int err;
 
-			enc_buf[enc_buf_len] = '\0';
-			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
-								  "Received message: \n%s\n", enc_buf));
+		BIO *rbio;
+		struct socket_tab *socket_tab_used = NULL;
+		int pos;
 
-			memset(src6host, 0, sizeof(src6host));
+		enc_buf[enc_buf_len] = '\0';
+		OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
+							  "Received message: \n%s\n", enc_buf));
 
-			if (eXtl_dtls.proto_family == AF_INET)
-				recvport = ntohs(((struct sockaddr_in *) &sa)->sin_port);
-			else
-				recvport = ntohs(((struct sockaddr_in6 *) &sa)->sin6_port);
+		memset(src6host, 0, sizeof(src6host));
 
-#if defined(__arc__)
-			{
-				struct sockaddr_in *fromsa = (struct sockaddr_in *) &sa;
-				char *tmp;
-				tmp = inet_ntoa(fromsa->sin_addr);
-				if (tmp == NULL) {
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_ERROR, NULL,
-								"Message received from: NULL:%i inet_ntoa failure\n",
-								recvport));
-				} else {
-					snprintf(src6host, sizeof(src6host), "%s", tmp);
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-								"Message received from: %s:%i\n", src6host,
-								recvport));
-				}
-			}
-#else
-			err = getnameinfo((struct sockaddr *) &sa, slen,
-							  src6host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
+		if (eXtl_dtls.proto_family == AF_INET)
+			recvport = ntohs(((struct sockaddr_in *) &sa)->sin_port);
+		else
+			recvport = ntohs(((struct sockaddr_in6 *) &sa)->sin6_port);
 
-			if (err != 0) {
+#if defined(__arc__)
+		{
+			struct sockaddr_in *fromsa = (struct sockaddr_in *) &sa;
+			char *tmp;
+			tmp = inet_ntoa(fromsa->sin_addr);
+			if (tmp == NULL) {
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_ERROR, NULL,
-							"Message received from: NULL:%i getnameinfo failure\n",
+							"Message received from: NULL:%i inet_ntoa failure\n",
 							recvport));
-				snprintf(src6host, sizeof(src6host), "127.0.0.1");
 			} else {
+				snprintf(src6host, sizeof(src6host), "%s", tmp);
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-							"Message received from: %s:%i\n", src6host, recvport));
+							"Message received from: %s:%i\n", src6host,
+							recvport));
 			}
-#endif
+		}
+#else
+		err = getnameinfo((struct sockaddr *) &sa, slen,
+						  src6host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
 
+		if (err != 0) {
+			OSIP_TRACE(osip_trace
+					   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+						"Message received from: NULL:%i getnameinfo failure\n",
+						recvport));
+			snprintf(src6host, sizeof(src6host), "127.0.0.1");
+		} else {
 			OSIP_TRACE(osip_trace
 					   (__FILE__, __LINE__, OSIP_INFO1, NULL,
 						"Message received from: %s:%i\n", src6host, recvport));
+		}
+#endif
+
+		OSIP_TRACE(osip_trace
+				   (__FILE__, __LINE__, OSIP_INFO1, NULL,
+					"Message received from: %s:%i\n", src6host, recvport));
+
+		for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
+			if (dtls_socket_tab[pos].ssl_conn != NULL) {
+				if (dtls_socket_tab[pos].remote_port == recvport &&
+					(strcmp(dtls_socket_tab[pos].remote_ip, src6host) == 0)) {
+					socket_tab_used = &dtls_socket_tab[pos];
+					break;
+				}
+			}
+		}
 
+		if (socket_tab_used == NULL) {
 			for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-				if (dtls_socket_tab[pos].ssl_conn != NULL) {
-					if (dtls_socket_tab[pos].remote_port == recvport &&
-						(strcmp(dtls_socket_tab[pos].remote_ip, src6host) == 0)) {
-						socket_tab_used = &dtls_socket_tab[pos];
-						break;
-					}
+				if (dtls_socket_tab[pos].ssl_conn == NULL) {
+					/* should accept this connection? */
+					break;
 				}
 			}
 
-			if (socket_tab_used == NULL) {
-				for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-					if (dtls_socket_tab[pos].ssl_conn == NULL) {
-						/* should accept this connection? */
-						break;
-					}
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO3, NULL,
+								  "creating DTLS-UDP socket at index: %i\n", pos));
+			if (pos < 0) {
+				/* delete an old one! */
+				pos = 0;
+				if (dtls_socket_tab[pos].ssl_conn != NULL) {
+					shutdown_free_client_dtls(pos);
+					shutdown_free_server_dtls(pos);
 				}
 
-				OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO3, NULL,
-									  "creating DTLS-UDP socket at index: %i\n", pos));
-				if (pos < 0) {
-					/* delete an old one! */
-					pos = 0;
-					if (dtls_socket_tab[pos].ssl_conn != NULL) {
-						shutdown_free_client_dtls(pos);
-						shutdown_free_server_dtls(pos);
-					}
+				memset(&dtls_socket_tab[pos], 0, sizeof(struct socket_tab));
+			}
+		}
 
-					memset(&dtls_socket_tab[pos], 0, sizeof(struct socket_tab));
-				}
+		if (dtls_socket_tab[pos].ssl_conn == NULL) {
+			BIO *wbio;
+			if (!SSL_CTX_check_private_key(server_ctx)) {
+				OSIP_TRACE(osip_trace
+						   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+							"SSL CTX private key check error\n"));
+				osip_free(enc_buf);
+				return -1;
 			}
 
+			/* behave as a server: */
+			dtls_socket_tab[pos].ssl_conn = SSL_new(server_ctx);
 			if (dtls_socket_tab[pos].ssl_conn == NULL) {
-				BIO *wbio;
-				if (!SSL_CTX_check_private_key(server_ctx)) {
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_ERROR, NULL,
-								"SSL CTX private key check error\n"));
-					osip_free(enc_buf);
-					return -1;
-				}
-
-				/* behave as a server: */
-				dtls_socket_tab[pos].ssl_conn = SSL_new(server_ctx);
-				if (dtls_socket_tab[pos].ssl_conn == NULL) {
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_ERROR, NULL,
-								"SSL_new error\n"));
-					osip_free(enc_buf);
-					return -1;
-				}
+				OSIP_TRACE(osip_trace
+						   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+							"SSL_new error\n"));
+				osip_free(enc_buf);
+				return -1;
+			}
 
-				/* No MTU query */
+			/* No MTU query */
 #ifdef	SSL_OP_NO_QUERY_MTU
-				SSL_set_options(dtls_socket_tab[pos].ssl_conn,
-								SSL_OP_NO_QUERY_MTU);
-				SSL_set_mtu(dtls_socket_tab[pos].ssl_conn, 2000);
+			SSL_set_options(dtls_socket_tab[pos].ssl_conn,
+							SSL_OP_NO_QUERY_MTU);
+			SSL_set_mtu(dtls_socket_tab[pos].ssl_conn, 2000);
 #endif
-				/* MTU query */
-				/* BIO_ctrl(sbio, BIO_CTRL_DGRAM_MTU_DISCOVER, 0, NULL); */
+			/* MTU query */
+			/* BIO_ctrl(sbio, BIO_CTRL_DGRAM_MTU_DISCOVER, 0, NULL); */
 #ifdef	SSL_OP_COOKIE_EXCHANGE
-				SSL_set_options(dtls_socket_tab[pos].ssl_conn,
-								SSL_OP_COOKIE_EXCHANGE);
+			SSL_set_options(dtls_socket_tab[pos].ssl_conn,
+							SSL_OP_COOKIE_EXCHANGE);
 #endif
-				wbio = BIO_new_dgram(dtls_socket, BIO_NOCLOSE);
-				BIO_dgram_set_peer(wbio, &sa);
-				SSL_set_bio(dtls_socket_tab[pos].ssl_conn, NULL, wbio);
+			wbio = BIO_new_dgram(dtls_socket, BIO_NOCLOSE);
+			BIO_dgram_set_peer(wbio, &sa);
+			SSL_set_bio(dtls_socket_tab[pos].ssl_conn, NULL, wbio);
 
-				SSL_set_accept_state(dtls_socket_tab[pos].ssl_conn);
+			SSL_set_accept_state(dtls_socket_tab[pos].ssl_conn);
 
-				dtls_socket_tab[pos].ssl_state = 0;
-				dtls_socket_tab[pos].ssl_type = EXOSIP_AS_A_SERVER;
+			dtls_socket_tab[pos].ssl_state = 0;
+			dtls_socket_tab[pos].ssl_type = EXOSIP_AS_A_SERVER;
 
-				osip_strncpy(dtls_socket_tab[pos].remote_ip, src6host,
-							 sizeof(dtls_socket_tab[pos].remote_ip) - 1);
-				dtls_socket_tab[pos].remote_port = recvport;
+			osip_strncpy(dtls_socket_tab[pos].remote_ip, src6host,
+						 sizeof(dtls_socket_tab[pos].remote_ip) - 1);
+			dtls_socket_tab[pos].remote_port = recvport;
 
-				OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
-									  "New DTLS-UDP connection accepted\n"));
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
+								  "New DTLS-UDP connection accepted\n"));
 
-			}
+		}
 
-			dec_buf =
-				(char *) osip_malloc(SIP_MESSAGE_MAX_LENGTH * sizeof(char) + 1);
-			if (dec_buf == NULL) {
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_ERROR, NULL,
-							"Allocation error\n"));
-				osip_free(enc_buf);
-				return OSIP_NOMEM;
-			}
-			rbio = BIO_new_mem_buf(enc_buf, enc_buf_len);
-			BIO_set_mem_eof_return(rbio, -1);
+		dec_buf =
+			(char *) osip_malloc(SIP_MESSAGE_MAX_LENGTH * sizeof(char) + 1);
+		if (dec_buf == NULL) {
+			OSIP_TRACE(osip_trace
+					   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+						"Allocation error\n"));
+			osip_free(enc_buf);
+			return OSIP_NOMEM;
+		}
+		rbio = BIO_new_mem_buf(enc_buf, enc_buf_len);
+		BIO_set_mem_eof_return(rbio, -1);
 
-			dtls_socket_tab[pos].ssl_conn->rbio = rbio;
+		dtls_socket_tab[pos].ssl_conn->rbio = rbio;
 
-			i = SSL_read(dtls_socket_tab[pos].ssl_conn, dec_buf,
-						 SIP_MESSAGE_MAX_LENGTH);
-			/* done with the rbio */
-			BIO_free(dtls_socket_tab[pos].ssl_conn->rbio);
-			dtls_socket_tab[pos].ssl_conn->rbio = BIO_new(BIO_s_mem());
+		i = SSL_read(dtls_socket_tab[pos].ssl_conn, dec_buf,
+					 SIP_MESSAGE_MAX_LENGTH);
+		/* done with the rbio */
+		BIO_free(dtls_socket_tab[pos].ssl_conn->rbio);
+		dtls_socket_tab[pos].ssl_conn->rbio = BIO_new(BIO_s_mem());
 
-			if (i > 5) {
-				dec_buf[i] = '\0';
+		if (i > 5) {
+			dec_buf[i] = '\0';
 
-				_eXosip_handle_incoming_message(dec_buf, i, dtls_socket, src6host,
-												recvport);
+			_eXosip_handle_incoming_message(dec_buf, i, dtls_socket, src6host,
+											recvport);
 
-			}
+		}
 #ifndef MINISIZE
-			else if (i <= 0) {
-				err = SSL_get_error(dtls_socket_tab[pos].ssl_conn, i);
-				print_ssl_error(err);
-				if (err == SSL_ERROR_SYSCALL) {
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_WARNING,
-								NULL, "DTLS-UDP SYSCALL on SSL_read\n"));
-				} else if (err == SSL_ERROR_SSL || err == SSL_ERROR_ZERO_RETURN) {
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_WARNING,
-								NULL, "DTLS-UDP closed\n"));
+		else if (i <= 0) {
+			err = SSL_get_error(dtls_socket_tab[pos].ssl_conn, i);
+			print_ssl_error(err);
+			if (err == SSL_ERROR_SYSCALL) {
+				OSIP_TRACE(osip_trace
+						   (__FILE__, __LINE__, OSIP_WARNING,
+							NULL, "DTLS-UDP SYSCALL on SSL_read\n"));
+			} else if (err == SSL_ERROR_SSL || err == SSL_ERROR_ZERO_RETURN) {
+				OSIP_TRACE(osip_trace
+						   (__FILE__, __LINE__, OSIP_WARNING,
+							NULL, "DTLS-UDP closed\n"));
 
-					shutdown_free_client_dtls(pos);
-					shutdown_free_server_dtls(pos);
+				shutdown_free_client_dtls(pos);
+				shutdown_free_server_dtls(pos);
 
-					memset(&(dtls_socket_tab[pos]), 0,
-						   sizeof(dtls_socket_tab[pos]));
-				}
-			} else {
-				OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
-									  "Dummy SIP message received\n"));
+				memset(&(dtls_socket_tab[pos]), 0,
+					   sizeof(dtls_socket_tab[pos]));
 			}
+		} else {
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
+								  "Dummy SIP message received\n"));
+		}
 #endif
 
-			osip_free(dec_buf);
-			osip_free(enc_buf);
+		osip_free(dec_buf);
+		osip_free(enc_buf);
 
-		}
 	}
+	return OSIP_SUCCESS;
+}
+
+static void _dtls_tl_poll_cb(int sock, void *data)
+{
+	if (sock == dtls_socket)
+		_dtls_tl_recv();
+}
+
+static int dtls_tl_read_message(fd_set * osip_fdset, fd_set * osip_wrset)
+{
+	if (dtls_socket <= 0)
+		return -1;
 
+	if (FD_ISSET(dtls_socket, osip_fdset))
+		return _dtls_tl_recv();
 	return OSIP_SUCCESS;
 }
 
@@ -689,7 +704,7 @@ dtls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 	size_t length = 0;
 	struct addrinfo *addrinfo;
 	struct __eXosip_sockaddr addr;
-	char *message;
+	const char *message;
 
 	char ipbuf[INET6_ADDRSTRLEN];
 	int i;
@@ -891,7 +906,7 @@ dtls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 		if (tag == NULL && route != NULL && route->url != NULL) {
 			osip_list_remove(&sip->routes, 0);
 		}
-		i = osip_message_to_str(sip, &message, &length);
+		i = osip_message_get_buffer(sip, &message, &length);
 		if (tag == NULL && route != NULL && route->url != NULL) {
 			osip_list_add(&sip->routes, route, 0);
 		}
@@ -990,7 +1005,6 @@ dtls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 
 			memset(&dtls_socket_tab[pos], 0, sizeof(struct socket_tab));
 
-			osip_free(message);
 			return -1;
 		}
 
@@ -1004,7 +1018,6 @@ dtls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 
 			memset(&dtls_socket_tab[pos], 0, sizeof(struct socket_tab));
 
-			osip_free(message);
 			return -1;
 		}
 
@@ -1045,13 +1058,11 @@ dtls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 			/* rotate on failure! */
 			if (eXosip_dnsutils_rotate_srv(&naptr_record->sipdtls_record)>0)
 			{
-				osip_free(message);
 				return OSIP_SUCCESS;	/* retry for next retransmission! */
 			}
 		}
 #endif
 		/* SIP_NETWORK_ERROR; */
-		osip_free(message);
 		return -1;
 	}
 
@@ -1066,7 +1077,6 @@ dtls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 		}
 	}
 
-	osip_free(message);
 	return OSIP_SUCCESS;
 }
 
@@ -1098,6 +1108,7 @@ static int dtls_tl_keepalive(void)
 static int dtls_tl_set_socket(int socket)
 {
 	dtls_socket = socket;
+	_eXosip_poll_add(dtls_socket, &_dtls_tl_poll_cb, NULL);
 
 	return OSIP_SUCCESS;
 }
@@ -33,6 +33,9 @@
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
 #endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 #endif
 
 #if defined(_WIN32_WCE) || defined(WIN32)
@@ -97,21 +100,119 @@ struct _tcp_sockets {
 #endif
 
 static int _tcp_tl_send_sockinfo (struct _tcp_sockets *sockinfo, const char *msg, int msglen);
+static int _tcp_tl_recv(struct _tcp_sockets *sockinfo);
+static void _tcp_tl_accept(void);
+
+/* The table starts with EXOSIP_MAX_SOCKETS slots. When sockets are
+   polled with epoll, it grows instead of evicting connections; with
+   select() it stays bounded by the fd_set. Slots are allocated one by
+   one so that a struct _tcp_sockets never moves once handed out. */
+static struct _tcp_sockets **tcp_socket_tab;
+static int tcp_socket_tab_size;
 
-static struct _tcp_sockets tcp_socket_tab[EXOSIP_MAX_SOCKETS];
+/* socket -> slot, for O(1) lookup of a connection by socket */
+static struct _tcp_sockets **tcp_socket_index;
+static int tcp_socket_index_size;
 
 static int tcp_tl_init(void)
 {
 	tcp_socket = 0;
 	memset(&ai_addr, 0, sizeof(struct sockaddr_storage));
-	memset(&tcp_socket_tab, 0, sizeof(struct _tcp_sockets) * EXOSIP_MAX_SOCKETS);
+	tcp_socket_tab = NULL;
+	tcp_socket_tab_size = 0;
+	tcp_socket_index = NULL;
+	tcp_socket_index_size = 0;
 	memset(tcp_firewall_ip, 0, sizeof(tcp_firewall_ip));
 	memset(tcp_firewall_port, 0, sizeof(tcp_firewall_port));
 	return OSIP_SUCCESS;
 }
 
+static int _tcp_tl_grow_socket_tab(void)
+{
+	struct _tcp_sockets **tab;
+	int size;
+	int pos;
+
+	size = tcp_socket_tab_size > 0 ? tcp_socket_tab_size * 2 : EXOSIP_MAX_SOCKETS;
+	tab = (struct _tcp_sockets **) osip_realloc(tcp_socket_tab,
+											   size * sizeof(struct _tcp_sockets *));
+	if (tab == NULL)
+		return OSIP_NOMEM;
+	tcp_socket_tab = tab;
+
+	for (pos = tcp_socket_tab_size; pos < size; pos++) {
+		tab[pos] = (struct _tcp_sockets *) osip_malloc(sizeof(struct _tcp_sockets));
+		if (tab[pos] == NULL)
+			break;
+		memset(tab[pos], 0, sizeof(struct _tcp_sockets));
+	}
+	if (pos == tcp_socket_tab_size)
+		return OSIP_NOMEM;
+	tcp_socket_tab_size = pos;
+	return OSIP_SUCCESS;
+}
+
+/* return a free slot, or -1 when the table is full and cannot grow */
+static int _tcp_tl_get_free_slot(void)
+{
+	int pos;
+
+	for (pos = 0; pos < tcp_socket_tab_size; pos++) {
+		if (tcp_socket_tab[pos]->socket == 0)
+			return pos;
+	}
+	if (tcp_socket_tab_size > 0 && !_eXosip_poll_enabled())
+		return -1;
+	if (_tcp_tl_grow_socket_tab() != OSIP_SUCCESS)
+		return -1;
+	return pos;
+}
+
+static void _tcp_tl_poll_cb(int sock, void *data)
+{
+	struct _tcp_sockets *sockinfo = (struct _tcp_sockets *) data;
+
+	if (sockinfo->socket == sock)
+		_tcp_tl_recv(sockinfo);
+}
+
+static void _tcp_tl_poll_accept_cb(int sock, void *data)
+{
+	_tcp_tl_accept();
+}
+
+/* start using a slot for sock */
+static void _tcp_tl_attach_sockinfo(struct _tcp_sockets *sockinfo, int sock)
+{
+	sockinfo->socket = sock;
+
+	if (sock >= tcp_socket_index_size) {
+		struct _tcp_sockets **index;
+		int size = tcp_socket_index_size > 0 ? tcp_socket_index_size : EXOSIP_MAX_SOCKETS;
+
+		while (size <= sock)
+			size *= 2;
+		index = (struct _tcp_sockets **) osip_realloc(tcp_socket_index,
+													 size * sizeof(struct _tcp_sockets *));
+		if (index != NULL) {
+			memset(index + tcp_socket_index_size, 0,
+				   (size - tcp_socket_index_size) * sizeof(struct _tcp_sockets *));
+			tcp_socket_index = index;
+			tcp_socket_index_size = size;
+		}
+	}
+	if (sock < tcp_socket_index_size)
+		tcp_socket_index[sock] = sockinfo;
+
+	_eXosip_poll_add(sock, &_tcp_tl_poll_cb, sockinfo);
+}
+
 static void _tcp_tl_close_sockinfo(struct _tcp_sockets *sockinfo)
 {
+	if (sockinfo->socket > 0 && sockinfo->socket < tcp_socket_index_size
+		&& tcp_socket_index[sockinfo->socket] == sockinfo)
+		tcp_socket_index[sockinfo->socket] = NULL;
+	_eXosip_poll_remove(sockinfo->socket);
 	closesocket(sockinfo->socket);
 	if (sockinfo->buf!=NULL)
 		osip_free(sockinfo->buf);
@@ -138,14 +239,25 @@ static int tcp_tl_free(void)
 	memset(tcp_firewall_ip, 0, sizeof(tcp_firewall_ip));
 	memset(tcp_firewall_port, 0, sizeof(tcp_firewall_port));
 	memset(&ai_addr, 0, sizeof(struct sockaddr_storage));
-	if (tcp_socket > 0)
+	if (tcp_socket > 0) {
+		_eXosip_poll_remove(tcp_socket);
 		closesocket(tcp_socket);
+	}
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tcp_socket_tab[pos].socket > 0) {
-			_tcp_tl_close_sockinfo(&tcp_socket_tab[pos]);
+	for (pos = 0; pos < tcp_socket_tab_size; pos++) {
+		if (tcp_socket_tab[pos]->socket > 0) {
+			_tcp_tl_close_sockinfo(tcp_socket_tab[pos]);
 		}
+		osip_free(tcp_socket_tab[pos]);
 	}
+	if (tcp_socket_tab != NULL)
+		osip_free(tcp_socket_tab);
+	tcp_socket_tab = NULL;
+	tcp_socket_tab_size = 0;
+	if (tcp_socket_index != NULL)
+		osip_free(tcp_socket_index);
+	tcp_socket_index = NULL;
+	tcp_socket_index_size = 0;
 
 	return OSIP_SUCCESS;
 }
@@ -246,6 +358,7 @@ static int tcp_tl_open(void)
 	}
 
 	tcp_socket = sock;
+	_eXosip_poll_add(tcp_socket, &_tcp_tl_poll_accept_cb, NULL);
 
 	if (eXtl_tcp.proto_port == 0) {
 		/* get port number from socket */
@@ -276,13 +389,13 @@ static int tcp_tl_set_fdset(fd_set * osip_fdset, fd_set * osip_wrset, int *fd_ma
 	if (tcp_socket > *fd_max)
 		*fd_max = tcp_socket;
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tcp_socket_tab[pos].socket > 0) {
-			eXFD_SET(tcp_socket_tab[pos].socket, osip_fdset);
-			if (tcp_socket_tab[pos].socket > *fd_max)
-				*fd_max = tcp_socket_tab[pos].socket;
-			if (tcp_socket_tab[pos].sendbuflen > 0)
-				eXFD_SET (tcp_socket_tab[pos].socket, osip_wrset);
+	for (pos = 0; pos < tcp_socket_tab_size; pos++) {
+		if (tcp_socket_tab[pos]->socket > 0) {
+			eXFD_SET(tcp_socket_tab[pos]->socket, osip_fdset);
+			if (tcp_socket_tab[pos]->socket > *fd_max)
+				*fd_max = tcp_socket_tab[pos]->socket;
+			if (tcp_socket_tab[pos]->sendbuflen > 0)
+				eXFD_SET (tcp_socket_tab[pos]->socket, osip_wrset);
 		}
 	}
 
@@ -456,122 +569,127 @@ static int _tcp_tl_recv(struct _tcp_sockets *sockinfo)
 	}
 }
 
-static int tcp_tl_read_message(fd_set * osip_fdset, fd_set * osip_wrset)
+/* accept an incoming connection on tcp_socket */
+static void _tcp_tl_accept(void)
 {
-	int pos = 0;
-
-	if (FD_ISSET(tcp_socket, osip_fdset)) {
-		/* accept incoming connection */
-		char src6host[NI_MAXHOST];
-		int recvport = 0;
-		struct sockaddr_storage sa;
-		int sock;
-		int i;
+	int pos;
+	char src6host[NI_MAXHOST];
+	int recvport = 0;
+	struct sockaddr_storage sa;
+	int sock;
+	int i;
 
 #ifdef __linux
-		socklen_t slen;
+	socklen_t slen;
 #else
-		int slen;
+	int slen;
 #endif
-		if (eXtl_tcp.proto_family == AF_INET)
-			slen = sizeof(struct sockaddr_in);
-		else
-			slen = sizeof(struct sockaddr_in6);
-
-		for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-			if (tcp_socket_tab[pos].socket == 0)
-				break;
-		}
-		if (pos == EXOSIP_MAX_SOCKETS) {
-			/* delete an old one! */
-			pos = 0;
-			if (tcp_socket_tab[pos].socket > 0) {
-				_tcp_tl_close_sockinfo(&tcp_socket_tab[pos]);
-			}
-			memset(&tcp_socket_tab[pos], 0, sizeof(tcp_socket_tab[pos]));
+	if (eXtl_tcp.proto_family == AF_INET)
+		slen = sizeof(struct sockaddr_in);
+	else
+		slen = sizeof(struct sockaddr_in6);
+
+	pos = _tcp_tl_get_free_slot();
+	if (pos < 0) {
+		if (tcp_socket_tab_size == 0)
+			return;
+		/* delete an old one! */
+		pos = 0;
+		if (tcp_socket_tab[pos]->socket > 0) {
+			_tcp_tl_close_sockinfo(tcp_socket_tab[pos]);
 		}
-		
-		OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO3, NULL,
-							  "creating TCP socket at index: %i\n", pos));
-		sock = accept(tcp_socket, (struct sockaddr *) &sa, &slen);
-		if (sock < 0) {
+	}
+	
+	OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO3, NULL,
+						  "creating TCP socket at index: %i\n", pos));
+	sock = accept(tcp_socket, (struct sockaddr *) &sa, &slen);
+	if (sock < 0) {
 #if defined(EBADF)
-			int status = ex_errno;
+		int status = ex_errno;
 #endif
-			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
-								  "Error accepting TCP socket\n"));
+		OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
+							  "Error accepting TCP socket\n"));
 #if defined(EBADF)
-			if (status==EBADF)
-			{
-				OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
-									  "Error accepting TCP socket: EBADF\n"));
-				memset(&ai_addr, 0, sizeof(struct sockaddr_storage));
-				if (tcp_socket > 0)
-					closesocket(tcp_socket);
-				tcp_tl_open();
+		if (status==EBADF)
+		{
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
+								  "Error accepting TCP socket: EBADF\n"));
+			memset(&ai_addr, 0, sizeof(struct sockaddr_storage));
+			if (tcp_socket > 0) {
+				_eXosip_poll_remove(tcp_socket);
+				closesocket(tcp_socket);
 			}
+			tcp_tl_open();
+		}
 #endif
-		} else {
-			tcp_socket_tab[pos].socket = sock;
-			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
-								  "New TCP connection accepted\n"));
+	} else {
+		_tcp_tl_attach_sockinfo(tcp_socket_tab[pos], sock);
+		OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
+							  "New TCP connection accepted\n"));
 
-			memset(src6host, 0, sizeof(src6host));
+		memset(src6host, 0, sizeof(src6host));
 
-			if (eXtl_tcp.proto_family == AF_INET)
-				recvport = ntohs(((struct sockaddr_in *) &sa)->sin_port);
-			else
-				recvport = ntohs(((struct sockaddr_in6 *) &sa)->sin6_port);
+		if (eXtl_tcp.proto_family == AF_INET)
+			recvport = ntohs(((struct sockaddr_in *) &sa)->sin_port);
+		else
+			recvport = ntohs(((struct sockaddr_in6 *) &sa)->sin6_port);
 
 #if defined(__arc__)
-			{
-				struct sockaddr_in *fromsa = (struct sockaddr_in *) &sa;
-				char *tmp;
-				tmp = inet_ntoa(fromsa->sin_addr);
-				if (tmp == NULL) {
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_ERROR, NULL,
-								"Message received from: NULL:%i inet_ntoa failure\n",
-								recvport));
-				} else {
-					snprintf(src6host, sizeof(src6host), "%s", tmp);
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-								"Message received from: %s:%i\n", src6host,
-								recvport));
-					osip_strncpy(tcp_socket_tab[pos].remote_ip, src6host,
-								 sizeof(tcp_socket_tab[pos].remote_ip) - 1);
-					tcp_socket_tab[pos].remote_port = recvport;
-				}
-			}
-#else
-			i = getnameinfo((struct sockaddr *) &sa, slen,
-							src6host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
-
-			if (i != 0) {
+		{
+			struct sockaddr_in *fromsa = (struct sockaddr_in *) &sa;
+			char *tmp;
+			tmp = inet_ntoa(fromsa->sin_addr);
+			if (tmp == NULL) {
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_ERROR, NULL,
-							"Message received from: NULL:%i getnameinfo failure\n",
+							"Message received from: NULL:%i inet_ntoa failure\n",
 							recvport));
-				snprintf(src6host, sizeof(src6host), "127.0.0.1");
 			} else {
+				snprintf(src6host, sizeof(src6host), "%s", tmp);
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-							"Message received from: %s:%i\n", src6host, recvport));
-				osip_strncpy(tcp_socket_tab[pos].remote_ip, src6host,
-							 sizeof(tcp_socket_tab[pos].remote_ip) - 1);
-				tcp_socket_tab[pos].remote_port = recvport;
+							"Message received from: %s:%i\n", src6host,
+							recvport));
+				osip_strncpy(tcp_socket_tab[pos]->remote_ip, src6host,
+							 sizeof(tcp_socket_tab[pos]->remote_ip) - 1);
+				tcp_socket_tab[pos]->remote_port = recvport;
 			}
-#endif
 		}
+#else
+		i = getnameinfo((struct sockaddr *) &sa, slen,
+						src6host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
+
+		if (i != 0) {
+			OSIP_TRACE(osip_trace
+					   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+						"Message received from: NULL:%i getnameinfo failure\n",
+						recvport));
+			snprintf(src6host, sizeof(src6host), "127.0.0.1");
+		} else {
+			OSIP_TRACE(osip_trace
+					   (__FILE__, __LINE__, OSIP_INFO1, NULL,
+						"Message received from: %s:%i\n", src6host, recvport));
+			osip_strncpy(tcp_socket_tab[pos]->remote_ip, src6host,
+						 sizeof(tcp_socket_tab[pos]->remote_ip) - 1);
+			tcp_socket_tab[pos]->remote_port = recvport;
+		}
+#endif
 	}
+}
+
+static int tcp_tl_read_message(fd_set * osip_fdset, fd_set * osip_wrset)
+{
+	int pos = 0;
+
+	if (FD_ISSET(tcp_socket, osip_fdset))
+		_tcp_tl_accept();
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tcp_socket_tab[pos].socket > 0) {
-			if (FD_ISSET(tcp_socket_tab[pos].socket, osip_wrset))
-				_tcp_tl_send_sockinfo(&tcp_socket_tab[pos], NULL, 0);
-			if (FD_ISSET(tcp_socket_tab[pos].socket, osip_fdset))
-				_tcp_tl_recv(&tcp_socket_tab[pos]);
+	for (pos = 0; pos < tcp_socket_tab_size; pos++) {
+		if (tcp_socket_tab[pos]->socket > 0) {
+			if (FD_ISSET(tcp_socket_tab[pos]->socket, osip_wrset))
+				_tcp_tl_send_sockinfo(tcp_socket_tab[pos], NULL, 0);
+			if (FD_ISSET(tcp_socket_tab[pos]->socket, osip_fdset))
+				_tcp_tl_recv(tcp_socket_tab[pos]);
 		}
 	}
 
@@ -582,9 +700,19 @@ static struct _tcp_sockets *_tcp_tl_find_sockinfo(int sock)
 {
 	int pos;
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tcp_socket_tab[pos].socket == sock) {
-			return &tcp_socket_tab[pos];
+	if (sock <= 0)
+		return NULL;
+	if (sock < tcp_socket_index_size) {
+		if (tcp_socket_index[sock] != NULL
+			&& tcp_socket_index[sock]->socket == sock)
+			return tcp_socket_index[sock];
+		return NULL;
+	}
+
+	/* the index could not grow that far */
+	for (pos = 0; pos < tcp_socket_tab_size; pos++) {
+		if (tcp_socket_tab[pos]->socket == sock) {
+			return tcp_socket_tab[pos];
 		}
 	}
 	return NULL;
@@ -594,30 +722,48 @@ static int _tcp_tl_find_socket(char *host, int port)
 {
 	int pos;
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tcp_socket_tab[pos].socket != 0) {
-			if (0 == osip_strcasecmp(tcp_socket_tab[pos].remote_ip, host)
-				&& port == tcp_socket_tab[pos].remote_port)
+	for (pos = 0; pos < tcp_socket_tab_size; pos++) {
+		if (tcp_socket_tab[pos]->socket != 0) {
+			if (0 == osip_strcasecmp(tcp_socket_tab[pos]->remote_ip, host)
+				&& port == tcp_socket_tab[pos]->remote_port)
 				return pos;
 		}
 	}
 	return -1;
 }
 
-static int _tcp_tl_is_connected(int sock)
+/* wait at most timeout ms for sock to become writable: return >0 when it
+   is, 0 on timeout and <0 on error. With epoll the socket table grows
+   and sockets can be above FD_SETSIZE, so poll() is used when available. */
+static int _tcp_tl_wait_writable(int sock, int timeout)
 {
-	int res;
+#ifdef HAVE_POLL_H
+	struct pollfd pfd;
+
+	pfd.fd = sock;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+	return poll(&pfd, 1, timeout);
+#else
 	struct timeval tv;
 	fd_set wrset;
-	int valopt;
-	socklen_t sock_len;
-	tv.tv_sec = SOCKET_TIMEOUT / 1000;
-	tv.tv_usec = (SOCKET_TIMEOUT % 1000) * 1000;
+	tv.tv_sec = timeout / 1000;
+	tv.tv_usec = (timeout % 1000) * 1000;
 
 	FD_ZERO(&wrset);
 	FD_SET(sock, &wrset);
 
-	res = select(sock + 1, NULL, &wrset, NULL, &tv);
+	return select(sock + 1, NULL, &wrset, NULL, &tv);
+#endif
+}
+
+static int _tcp_tl_is_connected(int sock)
+{
+	int res;
+	int valopt;
+	socklen_t sock_len;
+
+	res = _tcp_tl_wait_writable(sock, SOCKET_TIMEOUT);
 	if (res > 0) {
 		sock_len = sizeof(int);
 		if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (void *) (&valopt), &sock_len)
@@ -658,20 +804,20 @@ static int _tcp_tl_check_connected()
 	int pos;
 	int res;
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tcp_socket_tab[pos].socket > 0
-			&& tcp_socket_tab[pos].ai_addrlen > 0) {
-				res = connect(tcp_socket_tab[pos].socket, &tcp_socket_tab[pos].ai_addr, tcp_socket_tab[pos].ai_addrlen);
+	for (pos = 0; pos < tcp_socket_tab_size; pos++) {
+		if (tcp_socket_tab[pos]->socket > 0
+			&& tcp_socket_tab[pos]->ai_addrlen > 0) {
+				res = connect(tcp_socket_tab[pos]->socket, &tcp_socket_tab[pos]->ai_addr, tcp_socket_tab[pos]->ai_addrlen);
 				if (res < 0) {
 					int status = ex_errno;
 #if defined(_WIN32_WCE) || defined(WIN32)
 					if (status == WSAEISCONN) {
-						tcp_socket_tab[pos].ai_addrlen=0; /* already connected */
+						tcp_socket_tab[pos]->ai_addrlen=0; /* already connected */
 						continue;
 					}
 #else
 					if (status == EISCONN) {
-						tcp_socket_tab[pos].ai_addrlen=0; /* already connected */
+						tcp_socket_tab[pos]->ai_addrlen=0; /* already connected */
 						continue;
 					}
 #endif
@@ -683,49 +829,49 @@ static int _tcp_tl_check_connected()
 						OSIP_TRACE(osip_trace
 							(__FILE__, __LINE__, OSIP_INFO2, NULL,
 							"_tcp_tl_check_connected: Cannot connect socket node:%s:%i, socket %d [pos=%d], family:%d, %s[%d]\n",
-							tcp_socket_tab[pos].remote_ip,
-							tcp_socket_tab[pos].remote_port,
-							tcp_socket_tab[pos].socket,
+							tcp_socket_tab[pos]->remote_ip,
+							tcp_socket_tab[pos]->remote_port,
+							tcp_socket_tab[pos]->socket,
 							pos,
-							tcp_socket_tab[pos].ai_addr.sa_family,
+							tcp_socket_tab[pos]->ai_addr.sa_family,
 							strerror(status),
 							status));
-						_tcp_tl_close_sockinfo(&tcp_socket_tab[pos]);
+						_tcp_tl_close_sockinfo(tcp_socket_tab[pos]);
 						continue;
 					} else {
-						res = _tcp_tl_is_connected(tcp_socket_tab[pos].socket);
+						res = _tcp_tl_is_connected(tcp_socket_tab[pos]->socket);
 						if (res > 0) {
 							OSIP_TRACE(osip_trace
 								(__FILE__, __LINE__, OSIP_INFO2, NULL,
 								"_tcp_tl_check_connected: socket node:%s:%i, socket %d [pos=%d], family:%d, in progress\n",
-								tcp_socket_tab[pos].remote_ip,
-								tcp_socket_tab[pos].remote_port,
-								tcp_socket_tab[pos].socket,
+								tcp_socket_tab[pos]->remote_ip,
+								tcp_socket_tab[pos]->remote_port,
+								tcp_socket_tab[pos]->socket,
 								pos,
-								tcp_socket_tab[pos].ai_addr.sa_family));
+								tcp_socket_tab[pos]->ai_addr.sa_family));
 							continue;
 						} else if (res == 0) {
 							OSIP_TRACE(osip_trace
 								(__FILE__, __LINE__, OSIP_INFO1, NULL,
 								"_tcp_tl_check_connected: socket node:%s:%i , socket %d [pos=%d], family:%d, connected\n",
-								tcp_socket_tab[pos].remote_ip,
-								tcp_socket_tab[pos].remote_port,
-								tcp_socket_tab[pos].socket,
+								tcp_socket_tab[pos]->remote_ip,
+								tcp_socket_tab[pos]->remote_port,
+								tcp_socket_tab[pos]->socket,
 								pos,
-								tcp_socket_tab[pos].ai_addr.sa_family));
+								tcp_socket_tab[pos]->ai_addr.sa_family));
 							/* stop calling "connect()" */
-							tcp_socket_tab[pos].ai_addrlen=0;
+							tcp_socket_tab[pos]->ai_addrlen=0;
 							continue;
 						} else {
 							OSIP_TRACE(osip_trace
 								(__FILE__, __LINE__, OSIP_INFO2, NULL,
 								"_tcp_tl_check_connected: socket node:%s:%i, socket %d [pos=%d], family:%d, error\n",
-								tcp_socket_tab[pos].remote_ip,
-								tcp_socket_tab[pos].remote_port,
-								tcp_socket_tab[pos].socket,
+								tcp_socket_tab[pos]->remote_ip,
+								tcp_socket_tab[pos]->remote_port,
+								tcp_socket_tab[pos]->socket,
 								pos,
-								tcp_socket_tab[pos].ai_addr.sa_family));
-							_tcp_tl_close_sockinfo(&tcp_socket_tab[pos]);
+								tcp_socket_tab[pos]->ai_addr.sa_family));
+							_tcp_tl_close_sockinfo(tcp_socket_tab[pos]);
 							continue;
 						}
 					}
@@ -735,13 +881,13 @@ static int _tcp_tl_check_connected()
 					OSIP_TRACE(osip_trace
 						(__FILE__, __LINE__, OSIP_INFO1, NULL,
 						"_tcp_tl_check_connected: socket node:%s:%i , socket %d [pos=%d], family:%d, connected (with connect)\n",
-						tcp_socket_tab[pos].remote_ip,
-						tcp_socket_tab[pos].remote_port,
-						tcp_socket_tab[pos].socket,
+						tcp_socket_tab[pos]->remote_ip,
+						tcp_socket_tab[pos]->remote_port,
+						tcp_socket_tab[pos]->socket,
 						pos,
-						tcp_socket_tab[pos].ai_addr.sa_family));
+						tcp_socket_tab[pos]->ai_addr.sa_family));
 					/* stop calling "connect()" */
-					tcp_socket_tab[pos].ai_addrlen=0;
+					tcp_socket_tab[pos]->ai_addrlen=0;
 				}
 		}
 	}
@@ -764,23 +910,20 @@ static int _tcp_tl_connect_socket(char *host, int port)
 	selected_ai_addrlen=0;
 	memset(&selected_ai_addr, 0, sizeof(struct sockaddr));
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tcp_socket_tab[pos].socket == 0) {
-			break;
-		}
-	}
+	pos = _tcp_tl_get_free_slot();
 
-	if (pos == EXOSIP_MAX_SOCKETS) {
+	if (pos < 0) {
 	  OSIP_TRACE(osip_trace
 		     (__FILE__, __LINE__, OSIP_ERROR, NULL,
 		      "tcp_socket_tab is full - cannot create new socket!\n"));
 #ifdef DELETE_OLD_SOCKETS
+	  if (tcp_socket_tab_size == 0)
+		  return -1;
 	  /* delete an old one! */
 	  pos = 0;
-	  if (tcp_socket_tab[pos].socket > 0) {
-		  _tcp_tl_close_sockinfo(&tcp_socket_tab[pos]);
+	  if (tcp_socket_tab[pos]->socket > 0) {
+		  _tcp_tl_close_sockinfo(tcp_socket_tab[pos]);
 	  }
-	  memset(&tcp_socket_tab[pos], 0, sizeof(tcp_socket_tab[pos]));
 #else
 	  return -1;
 #endif
@@ -948,22 +1091,22 @@ static int _tcp_tl_connect_socket(char *host, int port)
 #ifdef MULTITASKING_ENABLED
 					if (kCFCoreFoundationVersionNumber > kCFCoreFoundationVersionNumber10_6) { /*I.E is >=OS4*/
 							
-						tcp_socket_tab[pos].readStream = NULL;
-						tcp_socket_tab[pos].writeStream = NULL;
+						tcp_socket_tab[pos]->readStream = NULL;
+						tcp_socket_tab[pos]->writeStream = NULL;
 						CFStreamCreatePairWithSocket(kCFAllocatorDefault, sock,
-													 &tcp_socket_tab[pos].readStream, &tcp_socket_tab[pos].writeStream);
-						if (tcp_socket_tab[pos].readStream!=NULL)
-							CFReadStreamSetProperty(tcp_socket_tab[pos].readStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
-						if (tcp_socket_tab[pos].writeStream!=NULL)
-							CFWriteStreamSetProperty(tcp_socket_tab[pos].writeStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
-						if (CFReadStreamOpen (tcp_socket_tab[pos].readStream))
+													 &tcp_socket_tab[pos]->readStream, &tcp_socket_tab[pos]->writeStream);
+						if (tcp_socket_tab[pos]->readStream!=NULL)
+							CFReadStreamSetProperty(tcp_socket_tab[pos]->readStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
+						if (tcp_socket_tab[pos]->writeStream!=NULL)
+							CFWriteStreamSetProperty(tcp_socket_tab[pos]->writeStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
+						if (CFReadStreamOpen (tcp_socket_tab[pos]->readStream))
 						{ 
 							OSIP_TRACE(osip_trace
 									   (__FILE__, __LINE__, OSIP_INFO1, NULL,
 										"CFReadStreamOpen Succeeded!\n"));
 						}
 						
-						CFWriteStreamOpen (tcp_socket_tab[pos].writeStream);
+						CFWriteStreamOpen (tcp_socket_tab[pos]->writeStream);
 					}
 #endif		
 					OSIP_TRACE(osip_trace
@@ -985,21 +1128,21 @@ static int _tcp_tl_connect_socket(char *host, int port)
 	eXosip_freeaddrinfo(addrinfo);
 
 	if (sock > 0) {
-		tcp_socket_tab[pos].socket = sock;
+		_tcp_tl_attach_sockinfo(tcp_socket_tab[pos], sock);
 
-		tcp_socket_tab[pos].ai_addrlen = selected_ai_addrlen;
-		memset(&tcp_socket_tab[pos].ai_addr, 0, sizeof(struct sockaddr));
+		tcp_socket_tab[pos]->ai_addrlen = selected_ai_addrlen;
+		memset(&tcp_socket_tab[pos]->ai_addr, 0, sizeof(struct sockaddr));
 		if (selected_ai_addrlen>0)
-			memcpy(&tcp_socket_tab[pos].ai_addr, &selected_ai_addr, selected_ai_addrlen);
+			memcpy(&tcp_socket_tab[pos]->ai_addr, &selected_ai_addr, selected_ai_addrlen);
 
 		if (src6host[0] == '\0')
-			osip_strncpy(tcp_socket_tab[pos].remote_ip, host,
-						 sizeof(tcp_socket_tab[pos].remote_ip) - 1);
+			osip_strncpy(tcp_socket_tab[pos]->remote_ip, host,
+						 sizeof(tcp_socket_tab[pos]->remote_ip) - 1);
 		else
-			osip_strncpy(tcp_socket_tab[pos].remote_ip, src6host,
-						 sizeof(tcp_socket_tab[pos].remote_ip) - 1);
+			osip_strncpy(tcp_socket_tab[pos]->remote_ip, src6host,
+						 sizeof(tcp_socket_tab[pos]->remote_ip) - 1);
 
-		tcp_socket_tab[pos].remote_port = port;
+		tcp_socket_tab[pos]->remote_port = port;
 
 
 		return pos;
@@ -1017,17 +1160,11 @@ _tcp_tl_send_sockinfo (struct _tcp_sockets *sockinfo, const char *msg, int msgle
 		if (i < 0) {
 			int status = ex_errno;
 			if (is_wouldblock_error(status)) {
-				struct timeval tv;
-				fd_set wrset;
-				tv.tv_sec = SOCKET_TIMEOUT / 1000;
-				tv.tv_usec = (SOCKET_TIMEOUT % 1000) * 1000;
-				if (tv.tv_usec==0)
-					tv.tv_usec += 10000;
-
-				FD_ZERO(&wrset);
-				FD_SET(sockinfo->socket, &wrset);
+				int timeout = SOCKET_TIMEOUT;
+				if (timeout % 1000 == 0)
+					timeout += 10;
 
-				i = select(sockinfo->socket + 1, NULL, &wrset, NULL, &tv);
+				i = _tcp_tl_wait_writable(sockinfo->socket, timeout);
 				if (i > 0) {
 					continue;
 				} else if (i < 0) {
@@ -1077,7 +1214,7 @@ tcp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 					int port, int out_socket)
 {
 	size_t length = 0;
-	char *message = NULL;
+	const char *message = NULL;
 	int i;
 	int pos=-1;
 	osip_naptr_t *naptr_record=NULL;
@@ -1213,14 +1350,13 @@ tcp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 		if (tag == NULL && route != NULL && route->url != NULL) {
 			osip_list_remove(&sip->routes, 0);
 		}
-		i = osip_message_to_str(sip, &message, &length);
+		i = osip_message_get_buffer(sip, &message, &length);
 		if (tag == NULL && route != NULL && route->url != NULL) {
 			osip_list_add(&sip->routes, route, 0);
 		}
 	}
 
 	if (i != 0 || length <= 0) {
-		osip_free(message);
 		return -1;
 	}
 
@@ -1228,19 +1364,14 @@ tcp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 	_tcp_tl_check_connected();
 
 	if (out_socket > 0) {
-		for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-			if (tcp_socket_tab[pos].socket != 0) {
-				if (tcp_socket_tab[pos].socket == out_socket) {
-					out_socket = tcp_socket_tab[pos].socket;
-					OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
-										  "reusing REQUEST connection (to dest=%s:%i)\n",
-										  tcp_socket_tab[pos].remote_ip,
-										  tcp_socket_tab[pos].remote_port));
-					break;
-				}
-			}
-		}
-		if (pos == EXOSIP_MAX_SOCKETS)
+		struct _tcp_sockets *sockinfo = _tcp_tl_find_sockinfo(out_socket);
+
+		if (sockinfo != NULL) {
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
+								  "reusing REQUEST connection (to dest=%s:%i)\n",
+								  sockinfo->remote_ip,
+								  sockinfo->remote_port));
+		} else
 			out_socket = 0;
 	}
 	
@@ -1251,8 +1382,8 @@ tcp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 		{
 			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
 									"reusing connection (to dest=%s:%i)\n",
-									tcp_socket_tab[pos].remote_ip,
-									tcp_socket_tab[pos].remote_port));
+									tcp_socket_tab[pos]->remote_ip,
+									tcp_socket_tab[pos]->remote_port));
 		}
 		
 		/* Step 2: create new socket with host:port */
@@ -1260,12 +1391,11 @@ tcp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 			pos = _tcp_tl_connect_socket(host, port);
 		}
 		if (pos>=0)
-			out_socket = tcp_socket_tab[pos].socket;
+			out_socket = tcp_socket_tab[pos]->socket;
 	}
 	
 
 	if (out_socket <= 0) {
-		osip_free(message);
 		return -1;
 	}
 
@@ -1277,7 +1407,6 @@ tcp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 				   (__FILE__, __LINE__, OSIP_INFO2, NULL,
 					"socket node:%s, socket %d [pos=%d], in progress\n",
 					host, out_socket, pos));
-		osip_free(message);
 		if (tr != NULL && now - tr->birth_time > 10 && now - tr->birth_time < 13)
 		{
 			/* avoid doing this twice... */
@@ -1307,37 +1436,37 @@ tcp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 				   (__FILE__, __LINE__, OSIP_ERROR, NULL,
 					"socket node:%s, socket %d [pos=%d], socket error\n",
 					host, out_socket, pos));
-		osip_free(message);
 		return -1;
 	}
 
 	
 #ifdef MULTITASKING_ENABLED
 	if (kCFCoreFoundationVersionNumber > kCFCoreFoundationVersionNumber10_6) { /*I.E is >=OS4*/					
-		if (pos>=0 && tcp_socket_tab[pos].readStream==NULL)
+		struct _tcp_sockets *sockinfo = _tcp_tl_find_sockinfo(out_socket);
+		if (sockinfo!=NULL && sockinfo->readStream==NULL)
 		{
-			tcp_socket_tab[pos].readStream = NULL;
-			tcp_socket_tab[pos].writeStream = NULL;
+			sockinfo->readStream = NULL;
+			sockinfo->writeStream = NULL;
 			CFStreamCreatePairWithSocket(kCFAllocatorDefault, out_socket,
-										 &tcp_socket_tab[pos].readStream, &tcp_socket_tab[pos].writeStream);
-			if (tcp_socket_tab[pos].readStream!=NULL)
-				CFReadStreamSetProperty(tcp_socket_tab[pos].readStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
-			if (tcp_socket_tab[pos].writeStream!=NULL)
-				CFWriteStreamSetProperty(tcp_socket_tab[pos].writeStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
-			if (CFReadStreamOpen (tcp_socket_tab[pos].readStream))
+										 &sockinfo->readStream, &sockinfo->writeStream);
+			if (sockinfo->readStream!=NULL)
+				CFReadStreamSetProperty(sockinfo->readStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
+			if (sockinfo->writeStream!=NULL)
+				CFWriteStreamSetProperty(sockinfo->writeStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
+			if (CFReadStreamOpen (sockinfo->readStream))
 			{ 
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_INFO1, NULL,
 							"CFReadStreamOpen Succeeded!\n"));
 			}
 			
-			CFWriteStreamOpen (tcp_socket_tab[pos].writeStream) ;
+			CFWriteStreamOpen (sockinfo->writeStream) ;
 			OSIP_TRACE(osip_trace
 					   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-						"socket node:%s:%i , socket %d [pos=%d], family:?, connected\n",
-						tcp_socket_tab[pos].remote_ip,
-						tcp_socket_tab[pos].remote_port,
-						tcp_socket_tab[pos].socket, pos));
+						"socket node:%s:%i , socket %d, family:?, connected\n",
+						sockinfo->remote_ip,
+						sockinfo->remote_port,
+						sockinfo->socket));
 		}
 	}
 #endif
@@ -1346,7 +1475,6 @@ tcp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 						  "Message sent: (to dest=%s:%i) \n%s\n",
 						  host, port, message));
 	i = _tcp_tl_send(out_socket, (const void *)message, length);
-	osip_free(message);
 	return i;
 }
 
@@ -1389,32 +1517,32 @@ static int tcp_tl_keepalive(void)
 	if (tcp_socket <= 0)
 		return OSIP_UNDEFINED_ERROR;
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tcp_socket_tab[pos].socket > 0) {
-			i = _tcp_tl_is_connected(tcp_socket_tab[pos].socket);
+	for (pos = 0; pos < tcp_socket_tab_size; pos++) {
+		if (tcp_socket_tab[pos]->socket > 0) {
+			i = _tcp_tl_is_connected(tcp_socket_tab[pos]->socket);
 			if (i > 0) {
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_INFO2, NULL,
 							"tcp_tl_keepalive socket node:%s:%i, socket %d [pos=%d], in progress\n",
-							tcp_socket_tab[pos].remote_ip,
-							tcp_socket_tab[pos].remote_port,
-							tcp_socket_tab[pos].socket, pos));
+							tcp_socket_tab[pos]->remote_ip,
+							tcp_socket_tab[pos]->remote_port,
+							tcp_socket_tab[pos]->socket, pos));
 				continue;
 			} else if (i == 0) {
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_INFO2, NULL,
 							"tcp_tl_keepalive socket node:%s:%i , socket %d [pos=%d], connected\n",
-							tcp_socket_tab[pos].remote_ip,
-							tcp_socket_tab[pos].remote_port,
-							tcp_socket_tab[pos].socket, pos));
+							tcp_socket_tab[pos]->remote_ip,
+							tcp_socket_tab[pos]->remote_port,
+							tcp_socket_tab[pos]->socket, pos));
 			} else {
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_ERROR, NULL,
 							"tcp_tl_keepalive socket node:%s:%i, socket %d [pos=%d], socket error\n",
-							tcp_socket_tab[pos].remote_ip,
-							tcp_socket_tab[pos].remote_port,
-							tcp_socket_tab[pos].socket, pos));
-				_tcp_tl_close_sockinfo(&tcp_socket_tab[pos]);
+							tcp_socket_tab[pos]->remote_ip,
+							tcp_socket_tab[pos]->remote_port,
+							tcp_socket_tab[pos]->socket, pos));
+				_tcp_tl_close_sockinfo(tcp_socket_tab[pos]);
 				continue;
 			}
 			if (eXosip.keep_alive > 0) {
@@ -1435,14 +1563,14 @@ static int tcp_tl_keepalive(void)
 					memset(locip, '\0', sizeof(locip));
 					locport = 0;
 
-					snprintf(to, sizeof(to), "<sip:%s:%d>", tcp_socket_tab[pos].remote_ip, tcp_socket_tab[pos].remote_port);
-					_tcp_tl_get_socket_info(tcp_socket_tab[pos].socket, locip, sizeof(locip), &locport);
+					snprintf(to, sizeof(to), "<sip:%s:%d>", tcp_socket_tab[pos]->remote_ip, tcp_socket_tab[pos]->remote_port);
+					_tcp_tl_get_socket_info(tcp_socket_tab[pos]->socket, locip, sizeof(locip), &locport);
 					if (locip[0] == '\0')
 					{
 						OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL,
 							"tcp_tl_keepalive socket node:%s , socket %d [pos=%d], failed to create sip options message\n",
-							tcp_socket_tab[pos].remote_ip,
-							tcp_socket_tab[pos].socket, 
+							tcp_socket_tab[pos]->remote_ip,
+							tcp_socket_tab[pos]->socket, 
 							pos));
 						continue;
 					}
@@ -1460,11 +1588,11 @@ static int tcp_tl_keepalive(void)
 						{
 							OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO2, NULL,
 								"tcp_tl_keepalive socket node:%s , socket %d [pos=%d], sending sip options\n\r%s",
-								tcp_socket_tab[pos].remote_ip,
-								tcp_socket_tab[pos].socket, 
+								tcp_socket_tab[pos]->remote_ip,
+								tcp_socket_tab[pos]->socket, 
 								pos,
 								message));
-							i = send(tcp_socket_tab[pos].socket, (const void *) message, length, 0);
+							i = send(tcp_socket_tab[pos]->socket, (const void *) message, length, 0);
 							osip_free(message);
 							if(i > 0) {
 								OSIP_TRACE(osip_trace
@@ -1476,8 +1604,8 @@ static int tcp_tl_keepalive(void)
 						{
 							OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL,
 								"tcp_tl_keepalive socket node:%s , socket %d [pos=%d], failed to convert sip options message\n",
-								tcp_socket_tab[pos].remote_ip,
-								tcp_socket_tab[pos].socket, 
+								tcp_socket_tab[pos]->remote_ip,
+								tcp_socket_tab[pos]->socket, 
 								pos));
 						}
 					}
@@ -1485,15 +1613,15 @@ static int tcp_tl_keepalive(void)
 					{
 						OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_WARNING, NULL,
 							"tcp_tl_keepalive socket node:%s , socket %d [pos=%d], failed to create sip options message\n",
-							tcp_socket_tab[pos].remote_ip,
-							tcp_socket_tab[pos].socket, 
+							tcp_socket_tab[pos]->remote_ip,
+							tcp_socket_tab[pos]->socket, 
 							pos));
 					}
 					eXosip_unlock();
 					continue;
 				}
 #endif
-				i = send(tcp_socket_tab[pos].socket, (const void *) buf, 4, 0);
+				i = send(tcp_socket_tab[pos]->socket, (const void *) buf, 4, 0);
 			}
 		}
 	}
@@ -1503,6 +1631,7 @@ static int tcp_tl_keepalive(void)
 static int tcp_tl_set_socket(int socket)
 {
 	tcp_socket = socket;
+	_eXosip_poll_add(tcp_socket, &_tcp_tl_poll_accept_cb, NULL);
 
 	return OSIP_SUCCESS;
 }
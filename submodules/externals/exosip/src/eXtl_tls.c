@@ -41,6 +41,9 @@
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
 #endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 #endif
 
 #if defined(_WIN32_WCE) || defined(WIN32)
@@ -146,7 +149,15 @@ struct socket_tab {
 #define EXOSIP_MAX_SOCKETS 100
 #endif
 
-static struct socket_tab tls_socket_tab[EXOSIP_MAX_SOCKETS];
+static int _tls_tl_recv(struct socket_tab *sockinfo);
+static void _tls_tl_accept(void);
+
+/* The table starts with EXOSIP_MAX_SOCKETS slots. When sockets are
+   polled with epoll, it grows instead of evicting connections; with
+   select() it stays bounded by the fd_set. Slots are allocated one by
+   one so that a struct socket_tab never moves once handed out. */
+static struct socket_tab **tls_socket_tab;
+static int tls_socket_tab_size;
 
 static int tls_tl_init(void)
 {
@@ -154,7 +165,8 @@ static int tls_tl_init(void)
 	server_ctx = NULL;
 	client_ctx = NULL;
 	memset(&ai_addr, 0, sizeof(struct sockaddr_storage));
-	memset(&tls_socket_tab, 0, sizeof(struct socket_tab) * EXOSIP_MAX_SOCKETS);
+	tls_socket_tab = NULL;
+	tls_socket_tab_size = 0;
 	memset(tls_firewall_ip, 0, sizeof(tls_firewall_ip));
 	memset(tls_firewall_port, 0, sizeof(tls_firewall_port));
 	memset(&eXosip_tls_ctx_params, 0, sizeof(eXosip_tls_ctx_t));
@@ -164,6 +176,60 @@ static int tls_tl_init(void)
 	return OSIP_SUCCESS;
 }
 
+static int _tls_tl_grow_socket_tab(void)
+{
+	struct socket_tab **tab;
+	int size;
+	int pos;
+
+	size = tls_socket_tab_size > 0 ? tls_socket_tab_size * 2 : EXOSIP_MAX_SOCKETS;
+	tab = (struct socket_tab **) osip_realloc(tls_socket_tab,
+											 size * sizeof(struct socket_tab *));
+	if (tab == NULL)
+		return OSIP_NOMEM;
+	tls_socket_tab = tab;
+
+	for (pos = tls_socket_tab_size; pos < size; pos++) {
+		tab[pos] = (struct socket_tab *) osip_malloc(sizeof(struct socket_tab));
+		if (tab[pos] == NULL)
+			break;
+		memset(tab[pos], 0, sizeof(struct socket_tab));
+	}
+	if (pos == tls_socket_tab_size)
+		return OSIP_NOMEM;
+	tls_socket_tab_size = pos;
+	return OSIP_SUCCESS;
+}
+
+/* return a free slot, or -1 when the table is full and cannot grow */
+static int _tls_tl_get_free_slot(void)
+{
+	int pos;
+
+	for (pos = 0; pos < tls_socket_tab_size; pos++) {
+		if (tls_socket_tab[pos]->socket == 0)
+			return pos;
+	}
+	if (tls_socket_tab_size > 0 && !_eXosip_poll_enabled())
+		return -1;
+	if (_tls_tl_grow_socket_tab() != OSIP_SUCCESS)
+		return -1;
+	return pos;
+}
+
+static void _tls_tl_poll_cb(int sock, void *data)
+{
+	struct socket_tab *sockinfo = (struct socket_tab *) data;
+
+	if (sockinfo->socket == sock)
+		_tls_tl_recv(sockinfo);
+}
+
+static void _tls_tl_poll_accept_cb(int sock, void *data)
+{
+	_tls_tl_accept();
+}
+
 static void _tls_tl_close_sockinfo (struct socket_tab *sockinfo)
 {
 	if (sockinfo->socket>0)
@@ -175,6 +241,7 @@ static void _tls_tl_close_sockinfo (struct socket_tab *sockinfo)
 		}
 		if (sockinfo->ssl_ctx != NULL)
 			SSL_CTX_free(sockinfo->ssl_ctx);
+		_eXosip_poll_remove(sockinfo->socket);
 		closesocket(sockinfo->socket);
 	}
 	if (sockinfo->buf!=NULL)
@@ -207,9 +274,14 @@ static int tls_tl_free(void)
 		SSL_CTX_free(client_ctx);
 	client_ctx = NULL;
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		_tls_tl_close_sockinfo(&tls_socket_tab[pos]);
+	for (pos = 0; pos < tls_socket_tab_size; pos++) {
+		_tls_tl_close_sockinfo(tls_socket_tab[pos]);
+		osip_free(tls_socket_tab[pos]);
 	}
+	if (tls_socket_tab != NULL)
+		osip_free(tls_socket_tab);
+	tls_socket_tab = NULL;
+	tls_socket_tab_size = 0;
 
 #if 0
 	/* this would break other ssl usage */
@@ -220,13 +292,13 @@ static int tls_tl_free(void)
 	CRYPTO_cleanup_all_ex_data();
 #endif
 
-	memset(&tls_socket_tab, 0, sizeof(struct socket_tab) * EXOSIP_MAX_SOCKETS);
-
 	memset(tls_firewall_ip, 0, sizeof(tls_firewall_ip));
 	memset(tls_firewall_port, 0, sizeof(tls_firewall_port));
 	memset(&ai_addr, 0, sizeof(struct sockaddr_storage));
-	if (tls_socket > 0)
+	if (tls_socket > 0) {
+		_eXosip_poll_remove(tls_socket);
 		close(tls_socket);
+	}
 	tls_socket = 0;
 
 	memset(&eXosip_tls_ctx_params, 0, sizeof(eXosip_tls_ctx_t));
@@ -1488,6 +1560,7 @@ static int tls_tl_open(void)
 	}
 
 	tls_socket = sock;
+	_eXosip_poll_add(tls_socket, &_tls_tl_poll_accept_cb, NULL);
 
 	if (eXtl_tls.proto_port == 0) {
 		/* get port number from socket */
@@ -1518,13 +1591,13 @@ static int tls_tl_set_fdset(fd_set * osip_fdset, fd_set * osip_wrset, int *fd_ma
 	if (tls_socket > *fd_max)
 		*fd_max = tls_socket;
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tls_socket_tab[pos].socket > 0) {
-			eXFD_SET(tls_socket_tab[pos].socket, osip_fdset);
-			if (tls_socket_tab[pos].socket > *fd_max)
-				*fd_max = tls_socket_tab[pos].socket;
-			if (tls_socket_tab[pos].sendbuflen > 0)
-				eXFD_SET (tls_socket_tab[pos].socket, osip_wrset);
+	for (pos = 0; pos < tls_socket_tab_size; pos++) {
+		if (tls_socket_tab[pos]->socket > 0) {
+			eXFD_SET(tls_socket_tab[pos]->socket, osip_fdset);
+			if (tls_socket_tab[pos]->socket > *fd_max)
+				*fd_max = tls_socket_tab[pos]->socket;
+			if (tls_socket_tab[pos]->sendbuflen > 0)
+				eXFD_SET (tls_socket_tab[pos]->socket, osip_wrset);
 		}
 	}
 
@@ -1680,20 +1753,41 @@ static void tls_dump_verification_failure(long verification_result)
 				"verification failure: %s\n", tmp));
 }
 
+/* wait at most timeout ms for sock to become readable, or writable when
+   for_write is set: return >0 when it is, 0 on timeout and <0 on error.
+   With epoll the socket table grows and sockets can be above FD_SETSIZE,
+   so poll() is used when available. */
+static int _tls_tl_wait_socket(int sock, int for_write, int timeout)
+{
+#ifdef HAVE_POLL_H
+	struct pollfd pfd;
+
+	pfd.fd = sock;
+	pfd.events = for_write ? POLLOUT : POLLIN;
+	pfd.revents = 0;
+	return poll(&pfd, 1, timeout);
+#else
+	struct timeval tv;
+	fd_set fdset;
+	tv.tv_sec = timeout / 1000;
+	tv.tv_usec = (timeout % 1000) * 1000;
+
+	FD_ZERO(&fdset);
+	FD_SET(sock, &fdset);
+
+	if (for_write)
+		return select(sock + 1, NULL, &fdset, NULL, &tv);
+	return select(sock + 1, &fdset, NULL, NULL, &tv);
+#endif
+}
+
 static int _tls_tl_is_connected(int sock)
 {
 	int res;
-	struct timeval tv;
-	fd_set wrset;
 	int valopt;
 	socklen_t sock_len;
-	tv.tv_sec = SOCKET_TIMEOUT / 1000;
-	tv.tv_usec = (SOCKET_TIMEOUT % 1000) * 1000;
-
-	FD_ZERO(&wrset);
-	FD_SET(sock, &wrset);
 
-	res = select(sock + 1, NULL, &wrset, NULL, &tv);
+	res = _tls_tl_wait_socket(sock, 1, SOCKET_TIMEOUT);
 	if (res > 0) {
 		sock_len = sizeof(int);
 		if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (void *) (&valopt), &sock_len)
@@ -1734,27 +1828,27 @@ static int _tls_tl_check_connected()
 	int pos;
 	int res;
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tls_socket_tab[pos].socket > 0
-			&& tls_socket_tab[pos].ai_addrlen > 0) {
-				if (tls_socket_tab[pos].ssl_state>0)
+	for (pos = 0; pos < tls_socket_tab_size; pos++) {
+		if (tls_socket_tab[pos]->socket > 0
+			&& tls_socket_tab[pos]->ai_addrlen > 0) {
+				if (tls_socket_tab[pos]->ssl_state>0)
 				{
 					/* already connected */
-					tls_socket_tab[pos].ai_addrlen = 0;
+					tls_socket_tab[pos]->ai_addrlen = 0;
 					continue;
 				}
 
-				res = connect(tls_socket_tab[pos].socket, &tls_socket_tab[pos].ai_addr, tls_socket_tab[pos].ai_addrlen);
+				res = connect(tls_socket_tab[pos]->socket, &tls_socket_tab[pos]->ai_addr, tls_socket_tab[pos]->ai_addrlen);
 				if (res < 0) {
 					int status = ex_errno;
 #if defined(_WIN32_WCE) || defined(WIN32)
 					if (status == WSAEISCONN) {
-						tls_socket_tab[pos].ai_addrlen=0; /* already connected */
+						tls_socket_tab[pos]->ai_addrlen=0; /* already connected */
 						continue;
 					}
 #else
 					if (status == EISCONN) {
-						tls_socket_tab[pos].ai_addrlen=0; /* already connected */
+						tls_socket_tab[pos]->ai_addrlen=0; /* already connected */
 						continue;
 					}
 #endif
@@ -1766,50 +1860,50 @@ static int _tls_tl_check_connected()
 						OSIP_TRACE(osip_trace
 							(__FILE__, __LINE__, OSIP_INFO2, NULL,
 							"_tls_tl_check_connected: Cannot connect socket node:%s:%i, socket %d [pos=%d], family:%d, %s[%d]\n",
-							tls_socket_tab[pos].remote_ip,
-							tls_socket_tab[pos].remote_port,
-							tls_socket_tab[pos].socket,
+							tls_socket_tab[pos]->remote_ip,
+							tls_socket_tab[pos]->remote_port,
+							tls_socket_tab[pos]->socket,
 							pos,
-							tls_socket_tab[pos].ai_addr.sa_family,
+							tls_socket_tab[pos]->ai_addr.sa_family,
 							strerror(status),
 							status));
-							_tls_tl_close_sockinfo(&tls_socket_tab[pos]);
+							_tls_tl_close_sockinfo(tls_socket_tab[pos]);
 							continue;
 					} else {
-						res = _tls_tl_is_connected(tls_socket_tab[pos].socket);
+						res = _tls_tl_is_connected(tls_socket_tab[pos]->socket);
 						if (res > 0) {
 							OSIP_TRACE(osip_trace
 								(__FILE__, __LINE__, OSIP_INFO2, NULL,
 								"_tls_tl_check_connected: socket node:%s:%i, socket %d [pos=%d], family:%d, in progress\n",
-								tls_socket_tab[pos].remote_ip,
-								tls_socket_tab[pos].remote_port,
-								tls_socket_tab[pos].socket,
+								tls_socket_tab[pos]->remote_ip,
+								tls_socket_tab[pos]->remote_port,
+								tls_socket_tab[pos]->socket,
 								pos,
-								tls_socket_tab[pos].ai_addr.sa_family));
+								tls_socket_tab[pos]->ai_addr.sa_family));
 							continue;
 						} else if (res == 0) {
 							OSIP_TRACE(osip_trace
 								(__FILE__, __LINE__, OSIP_INFO1, NULL,
 								"_tls_tl_check_connected: socket node:%s:%i , socket %d [pos=%d], family:%d, connected\n",
-								tls_socket_tab[pos].remote_ip,
-								tls_socket_tab[pos].remote_port,
-								tls_socket_tab[pos].socket,
+								tls_socket_tab[pos]->remote_ip,
+								tls_socket_tab[pos]->remote_port,
+								tls_socket_tab[pos]->socket,
 								pos,
-								tls_socket_tab[pos].ai_addr.sa_family));
+								tls_socket_tab[pos]->ai_addr.sa_family));
 							/* stop calling "connect()" */
-							tls_socket_tab[pos].ai_addrlen=0;
-							tls_socket_tab[pos].ssl_state=1;
+							tls_socket_tab[pos]->ai_addrlen=0;
+							tls_socket_tab[pos]->ssl_state=1;
 							continue;
 						} else {
 							OSIP_TRACE(osip_trace
 								(__FILE__, __LINE__, OSIP_INFO2, NULL,
 								"_tls_tl_check_connected: socket node:%s:%i, socket %d [pos=%d], family:%d, error\n",
-								tls_socket_tab[pos].remote_ip,
-								tls_socket_tab[pos].remote_port,
-								tls_socket_tab[pos].socket,
+								tls_socket_tab[pos]->remote_ip,
+								tls_socket_tab[pos]->remote_port,
+								tls_socket_tab[pos]->socket,
 								pos,
-								tls_socket_tab[pos].ai_addr.sa_family));
-							_tls_tl_close_sockinfo(&tls_socket_tab[pos]);
+								tls_socket_tab[pos]->ai_addr.sa_family));
+							_tls_tl_close_sockinfo(tls_socket_tab[pos]);
 							continue;
 						}
 					}
@@ -1819,13 +1913,13 @@ static int _tls_tl_check_connected()
 					OSIP_TRACE(osip_trace
 						(__FILE__, __LINE__, OSIP_INFO1, NULL,
 						"_tls_tl_check_connected: socket node:%s:%i , socket %d [pos=%d], family:%d, connected (with connect)\n",
-						tls_socket_tab[pos].remote_ip,
-						tls_socket_tab[pos].remote_port,
-						tls_socket_tab[pos].socket,
+						tls_socket_tab[pos]->remote_ip,
+						tls_socket_tab[pos]->remote_port,
+						tls_socket_tab[pos]->socket,
 						pos,
-						tls_socket_tab[pos].ai_addr.sa_family));
+						tls_socket_tab[pos]->ai_addr.sa_family));
 					/* stop calling "connect()" */
-					tls_socket_tab[pos].ai_addrlen=0;
+					tls_socket_tab[pos]->ai_addrlen=0;
 				}
 		}
 	}
@@ -1872,9 +1966,7 @@ static int _tls_tl_ssl_connect_socket(struct socket_tab *sockinfo)
 	}
 
 	do {
-		struct timeval tv;
 		int fd;
-		fd_set readfds;
 
 		res = SSL_connect(sockinfo->ssl_conn);
 		res = SSL_get_error(sockinfo->ssl_conn, res);
@@ -1891,15 +1983,11 @@ static int _tls_tl_ssl_connect_socket(struct socket_tab *sockinfo)
 			return -1;
 		}
 
-		tv.tv_sec = SOCKET_TIMEOUT / 1000;
-		tv.tv_usec = (SOCKET_TIMEOUT % 1000) * 1000;
 		OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO2, NULL,
 							  "SSL_connect retry\n"));
 
 		fd = SSL_get_fd(sockinfo->ssl_conn);
-		FD_ZERO(&readfds);
-		FD_SET(fd, &readfds);
-		res = select(fd + 1, &readfds, NULL, NULL, &tv);
+		res = _tls_tl_wait_socket(fd, 0, SOCKET_TIMEOUT);
 		if (res < 0) {
 			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO2, NULL,
 								  "SSL_connect select(read) error (%s)\n",
@@ -2236,176 +2324,182 @@ static int _tls_tl_recv(struct socket_tab *sockinfo)
 	}
 }
 
-static int tls_tl_read_message(fd_set * osip_fdset, fd_set * osip_wrset)
+/* accept an incoming connection on tls_socket */
+static void _tls_tl_accept(void)
 {
-	int pos = 0;
-
-	if (FD_ISSET(tls_socket, osip_fdset)) {
-		/* accept incoming connection */
-		char src6host[NI_MAXHOST];
-		int recvport = 0;
-		struct sockaddr_storage sa;
-		int sock;
-		int i;
+	int pos;
+	char src6host[NI_MAXHOST];
+	int recvport = 0;
+	struct sockaddr_storage sa;
+	int sock;
+	int i;
 
 #ifdef __linux
-		socklen_t slen;
+	socklen_t slen;
 #else
-		int slen;
+	int slen;
 #endif
 
-		SSL *ssl = NULL;
-		BIO *sbio;
+	SSL *ssl = NULL;
+	BIO *sbio;
 
 
-		if (eXtl_tls.proto_family == AF_INET)
-			slen = sizeof(struct sockaddr_in);
-		else
-			slen = sizeof(struct sockaddr_in6);
+	if (eXtl_tls.proto_family == AF_INET)
+		slen = sizeof(struct sockaddr_in);
+	else
+		slen = sizeof(struct sockaddr_in6);
 
-		for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-			if (tls_socket_tab[pos].socket <= 0)
-				break;
-		}
-		if (pos == EXOSIP_MAX_SOCKETS) {
-			/* delete an old one! */
-			pos = 0;
-			if (tls_socket_tab[pos].socket > 0) {
-				_tls_tl_close_sockinfo(&tls_socket_tab[pos]);
-			}
-			memset(&tls_socket_tab[pos], 0, sizeof(struct socket_tab));
+	pos = _tls_tl_get_free_slot();
+	if (pos < 0) {
+		if (tls_socket_tab_size == 0)
+			return;
+		/* delete an old one! */
+		pos = 0;
+		if (tls_socket_tab[pos]->socket > 0) {
+			_tls_tl_close_sockinfo(tls_socket_tab[pos]);
 		}
+	}
 
-		OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO3, NULL,
-							  "creating TLS socket at index: %i\n", pos));
-		sock = accept(tls_socket, (struct sockaddr *) &sa, &slen);
-		if (sock < 0) {
+	OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO3, NULL,
+						  "creating TLS socket at index: %i\n", pos));
+	sock = accept(tls_socket, (struct sockaddr *) &sa, &slen);
+	if (sock < 0) {
 #if defined(EBADF)
-			int status = ex_errno;
+		int status = ex_errno;
 #endif
-			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
-								  "Error accepting TLS socket\n"));
+		OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
+							  "Error accepting TLS socket\n"));
 #if defined(EBADF)
-			if (status==EBADF)
-			{
-				OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
-									  "Error accepting TLS socket: EBADF\n"));
-				memset(&ai_addr, 0, sizeof(struct sockaddr_storage));
-				if (tls_socket > 0)
-					closesocket(tls_socket);
-				tls_tl_open();
+		if (status==EBADF)
+		{
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
+								  "Error accepting TLS socket: EBADF\n"));
+			memset(&ai_addr, 0, sizeof(struct sockaddr_storage));
+			if (tls_socket > 0) {
+				_eXosip_poll_remove(tls_socket);
+				closesocket(tls_socket);
 			}
+			tls_tl_open();
+		}
 #endif
-		} else {
-			if (server_ctx == NULL) {
-				OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
-									  "TLS connection rejected\n"));
-				close(sock);
-				return -1;
-			}
+	} else {
+		if (server_ctx == NULL) {
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
+								  "TLS connection rejected\n"));
+			close(sock);
+			return;
+		}
 
-			if (!SSL_CTX_check_private_key(server_ctx)) {
-				OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
-									  "SSL CTX private key check error\n"));
-			}
+		if (!SSL_CTX_check_private_key(server_ctx)) {
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
+								  "SSL CTX private key check error\n"));
+		}
 
-			ssl = SSL_new(server_ctx);
-			if (ssl == NULL) {
-				OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
-									  "Cannot create ssl connection context\n"));
-				return -1;
-			}
+		ssl = SSL_new(server_ctx);
+		if (ssl == NULL) {
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
+								  "Cannot create ssl connection context\n"));
+			return;
+		}
 
-			if (!SSL_check_private_key(ssl)) {
-				OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
-									  "SSL private key check error\n"));
-			}
+		if (!SSL_check_private_key(ssl)) {
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
+								  "SSL private key check error\n"));
+		}
 
-			sbio = BIO_new_socket(sock, BIO_NOCLOSE);
-			if (sbio == NULL) {
-				OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
-									  "BIO_new_socket error\n"));
-			}
+		sbio = BIO_new_socket(sock, BIO_NOCLOSE);
+		if (sbio == NULL) {
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
+								  "BIO_new_socket error\n"));
+		}
 
-			SSL_set_bio(ssl, sbio, sbio);	/* cannot fail */
+		SSL_set_bio(ssl, sbio, sbio);	/* cannot fail */
 
-			i = SSL_accept(ssl);
-			if (i <= 0) {
-				OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
-									  "SSL_accept error: %s\n",
-									  ERR_error_string(ERR_get_error(),NULL)));
-				i = SSL_get_error(ssl, i);
-				print_ssl_error(i);
+		i = SSL_accept(ssl);
+		if (i <= 0) {
+			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
+								  "SSL_accept error: %s\n",
+								  ERR_error_string(ERR_get_error(),NULL)));
+			i = SSL_get_error(ssl, i);
+			print_ssl_error(i);
 
 
-				SSL_shutdown(ssl);
-				close(sock);
-				SSL_free(ssl);
-				return -1;
-			}
+			SSL_shutdown(ssl);
+			close(sock);
+			SSL_free(ssl);
+			return;
+		}
 
-			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
-								  "New TLS connection accepted\n"));
+		OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
+							  "New TLS connection accepted\n"));
 
-			tls_socket_tab[pos].socket = sock;
-			tls_socket_tab[pos].ssl_conn = ssl;
-			tls_socket_tab[pos].ssl_state = 2;
+		tls_socket_tab[pos]->socket = sock;
+		_eXosip_poll_add(sock, &_tls_tl_poll_cb, tls_socket_tab[pos]);
+		tls_socket_tab[pos]->ssl_conn = ssl;
+		tls_socket_tab[pos]->ssl_state = 2;
 
 
-			memset(src6host, 0, sizeof(src6host));
+		memset(src6host, 0, sizeof(src6host));
 
-			if (eXtl_tls.proto_family == AF_INET)
-				recvport = ntohs(((struct sockaddr_in *) &sa)->sin_port);
-			else
-				recvport = ntohs(((struct sockaddr_in6 *) &sa)->sin6_port);
+		if (eXtl_tls.proto_family == AF_INET)
+			recvport = ntohs(((struct sockaddr_in *) &sa)->sin_port);
+		else
+			recvport = ntohs(((struct sockaddr_in6 *) &sa)->sin6_port);
 
 #if defined(__arc__)
-			{
-				struct sockaddr_in *fromsa = (struct sockaddr_in *) &sa;
-				char *tmp;
-				tmp = inet_ntoa(fromsa->sin_addr);
-				if (tmp == NULL) {
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_ERROR, NULL,
-								"Message received from: NULL:%i inet_ntoa failure\n",
-								recvport));
-				} else {
-					snprintf(src6host, sizeof(src6host), "%s", tmp);
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-								"Message received from: %s:%i\n", src6host,
-								recvport));
-					osip_strncpy(tls_socket_tab[pos].remote_ip, src6host,
-								 sizeof(tls_socket_tab[pos].remote_ip) - 1);
-					tls_socket_tab[pos].remote_port = recvport;
-				}
-			}
-#else
-			i = getnameinfo((struct sockaddr *) &sa, slen,
-							src6host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
-
-			if (i != 0) {
+		{
+			struct sockaddr_in *fromsa = (struct sockaddr_in *) &sa;
+			char *tmp;
+			tmp = inet_ntoa(fromsa->sin_addr);
+			if (tmp == NULL) {
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_ERROR, NULL,
-							"Message received from: NULL:%i getnameinfo failure\n",
+							"Message received from: NULL:%i inet_ntoa failure\n",
 							recvport));
-				snprintf(src6host, sizeof(src6host), "127.0.0.1");
 			} else {
+				snprintf(src6host, sizeof(src6host), "%s", tmp);
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-							"Message received from: %s:%i\n", src6host, recvport));
-				osip_strncpy(tls_socket_tab[pos].remote_ip, src6host,
-							 sizeof(tls_socket_tab[pos].remote_ip) - 1);
-				tls_socket_tab[pos].remote_port = recvport;
+							"Message received from: %s:%i\n", src6host,
+							recvport));
+				osip_strncpy(tls_socket_tab[pos]->remote_ip, src6host,
+							 sizeof(tls_socket_tab[pos]->remote_ip) - 1);
+				tls_socket_tab[pos]->remote_port = recvport;
 			}
-#endif
 		}
+#else
+		i = getnameinfo((struct sockaddr *) &sa, slen,
+						src6host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
+
+		if (i != 0) {
+			OSIP_TRACE(osip_trace
+					   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+						"Message received from: NULL:%i getnameinfo failure\n",
+						recvport));
+			snprintf(src6host, sizeof(src6host), "127.0.0.1");
+		} else {
+			OSIP_TRACE(osip_trace
+					   (__FILE__, __LINE__, OSIP_INFO1, NULL,
+						"Message received from: %s:%i\n", src6host, recvport));
+			osip_strncpy(tls_socket_tab[pos]->remote_ip, src6host,
+						 sizeof(tls_socket_tab[pos]->remote_ip) - 1);
+			tls_socket_tab[pos]->remote_port = recvport;
+		}
+#endif
 	}
+}
+
+static int tls_tl_read_message(fd_set * osip_fdset, fd_set * osip_wrset)
+{
+	int pos = 0;
+
+	if (FD_ISSET(tls_socket, osip_fdset))
+		_tls_tl_accept();
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tls_socket_tab[pos].socket > 0) {
-			if (FD_ISSET(tls_socket_tab[pos].socket, osip_fdset))
-				_tls_tl_recv(&tls_socket_tab[pos]);
+	for (pos = 0; pos < tls_socket_tab_size; pos++) {
+		if (tls_socket_tab[pos]->socket > 0) {
+			if (FD_ISSET(tls_socket_tab[pos]->socket, osip_fdset))
+				_tls_tl_recv(tls_socket_tab[pos]);
 		}
 	}
 
@@ -2417,10 +2511,10 @@ static int _tls_tl_find_socket(char *host, int port)
 {
 	int pos;
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tls_socket_tab[pos].socket != 0) {
-			if (0 == osip_strcasecmp(tls_socket_tab[pos].remote_ip, host)
-				&& port == tls_socket_tab[pos].remote_port)
+	for (pos = 0; pos < tls_socket_tab_size; pos++) {
+		if (tls_socket_tab[pos]->socket != 0) {
+			if (0 == osip_strcasecmp(tls_socket_tab[pos]->remote_ip, host)
+				&& port == tls_socket_tab[pos]->remote_port)
 				return pos;
 		}
 	}
@@ -2445,13 +2539,8 @@ static int _tls_tl_connect_socket(char *host, int port)
 	selected_ai_addrlen=0;
 	memset(&selected_ai_addr, 0, sizeof(struct sockaddr));
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tls_socket_tab[pos].socket == 0) {
-			break;
-		}
-	}
-
-	if (pos == EXOSIP_MAX_SOCKETS)
+	pos = _tls_tl_get_free_slot();
+	if (pos < 0)
 		return -1;
 
 	res = eXosip_get_addrinfo(&addrinfo, host, port, IPPROTO_TCP);
@@ -2627,22 +2716,22 @@ static int _tls_tl_connect_socket(char *host, int port)
 #ifdef MULTITASKING_ENABLED
 					if (kCFCoreFoundationVersionNumber > kCFCoreFoundationVersionNumber10_6) { /*I.E is >=OS4*/
 					
-						tls_socket_tab[pos].readStream = NULL;
-						tls_socket_tab[pos].writeStream = NULL;
+						tls_socket_tab[pos]->readStream = NULL;
+						tls_socket_tab[pos]->writeStream = NULL;
 						CFStreamCreatePairWithSocket(kCFAllocatorDefault, sock,
-													 &tls_socket_tab[pos].readStream, &tls_socket_tab[pos].writeStream);
-						if (tls_socket_tab[pos].readStream!=NULL)
-							CFReadStreamSetProperty(tls_socket_tab[pos].readStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
-						if (tls_socket_tab[pos].writeStream!=NULL)
-							CFWriteStreamSetProperty(tls_socket_tab[pos].writeStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
-						if (CFReadStreamOpen (tls_socket_tab[pos].readStream))
+													 &tls_socket_tab[pos]->readStream, &tls_socket_tab[pos]->writeStream);
+						if (tls_socket_tab[pos]->readStream!=NULL)
+							CFReadStreamSetProperty(tls_socket_tab[pos]->readStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
+						if (tls_socket_tab[pos]->writeStream!=NULL)
+							CFWriteStreamSetProperty(tls_socket_tab[pos]->writeStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
+						if (CFReadStreamOpen (tls_socket_tab[pos]->readStream))
 						{ 
 							OSIP_TRACE(osip_trace
 									   (__FILE__, __LINE__, OSIP_INFO2, NULL,
 										"CFReadStreamOpen Succeeded!\n"));
 						}
 						
-						CFWriteStreamOpen (tls_socket_tab[pos].writeStream);
+						CFWriteStreamOpen (tls_socket_tab[pos]->writeStream);
 					}
 #endif
 					OSIP_TRACE(osip_trace
@@ -2665,29 +2754,30 @@ static int _tls_tl_connect_socket(char *host, int port)
 	eXosip_freeaddrinfo(addrinfo);
 
 	if (sock > 0) {
-		tls_socket_tab[pos].socket = sock;
+		tls_socket_tab[pos]->socket = sock;
+		_eXosip_poll_add(sock, &_tls_tl_poll_cb, tls_socket_tab[pos]);
 
-		tls_socket_tab[pos].ai_addrlen = selected_ai_addrlen;
-		memset(&tls_socket_tab[pos].ai_addr, 0, sizeof(struct sockaddr));
+		tls_socket_tab[pos]->ai_addrlen = selected_ai_addrlen;
+		memset(&tls_socket_tab[pos]->ai_addr, 0, sizeof(struct sockaddr));
 		if (selected_ai_addrlen>0)
-			memcpy(&tls_socket_tab[pos].ai_addr, &selected_ai_addr, selected_ai_addrlen);
+			memcpy(&tls_socket_tab[pos]->ai_addr, &selected_ai_addr, selected_ai_addrlen);
 
 		if (src6host[0] == '\0')
-			osip_strncpy(tls_socket_tab[pos].remote_ip, host,
-						 sizeof(tls_socket_tab[pos].remote_ip) - 1);
+			osip_strncpy(tls_socket_tab[pos]->remote_ip, host,
+						 sizeof(tls_socket_tab[pos]->remote_ip) - 1);
 		else
-			osip_strncpy(tls_socket_tab[pos].remote_ip, src6host,
-						 sizeof(tls_socket_tab[pos].remote_ip) - 1);
+			osip_strncpy(tls_socket_tab[pos]->remote_ip, src6host,
+						 sizeof(tls_socket_tab[pos]->remote_ip) - 1);
 
-		tls_socket_tab[pos].remote_port = port;
-		tls_socket_tab[pos].ssl_conn = NULL;
-		tls_socket_tab[pos].ssl_state = ssl_state;
-		tls_socket_tab[pos].ssl_ctx = NULL;
+		tls_socket_tab[pos]->remote_port = port;
+		tls_socket_tab[pos]->ssl_conn = NULL;
+		tls_socket_tab[pos]->ssl_state = ssl_state;
+		tls_socket_tab[pos]->ssl_ctx = NULL;
 
-		if (tls_socket_tab[pos].ssl_state == 1) {	/* TCP connected but not TLS connected */
-			res = _tls_tl_ssl_connect_socket(&tls_socket_tab[pos]);
+		if (tls_socket_tab[pos]->ssl_state == 1) {	/* TCP connected but not TLS connected */
+			res = _tls_tl_ssl_connect_socket(tls_socket_tab[pos]);
 			if (res < 0) {
-				_tls_tl_close_sockinfo(&tls_socket_tab[pos]);
+				_tls_tl_close_sockinfo(tls_socket_tab[pos]);
 				return -1;
 			}
 		}
@@ -2702,7 +2792,7 @@ tls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 					int port, int out_socket)
 {
 	size_t length = 0;
-	char *message;
+	const char *message;
 	int i;
 
 	int pos;
@@ -2843,7 +2933,7 @@ tls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 		if (tag == NULL && route != NULL && route->url != NULL) {
 			osip_list_remove(&sip->routes, 0);
 		}
-		i = osip_message_to_str(sip, &message, &length);
+		i = osip_message_get_buffer(sip, &message, &length);
 		if (tag == NULL && route != NULL && route->url != NULL) {
 			osip_list_add(&sip->routes, route, 0);
 		}
@@ -2857,20 +2947,20 @@ tls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 	_tls_tl_check_connected();
 
 	if (out_socket > 0) {
-		for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-			if (tls_socket_tab[pos].socket != 0) {
-				if (tls_socket_tab[pos].socket == out_socket) {
-					out_socket = tls_socket_tab[pos].socket;
-					ssl = tls_socket_tab[pos].ssl_conn;
+		for (pos = 0; pos < tls_socket_tab_size; pos++) {
+			if (tls_socket_tab[pos]->socket != 0) {
+				if (tls_socket_tab[pos]->socket == out_socket) {
+					out_socket = tls_socket_tab[pos]->socket;
+					ssl = tls_socket_tab[pos]->ssl_conn;
 					OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
 										  "reusing REQUEST connection (to dest=%s:%i)\n",
-										  tls_socket_tab[pos].remote_ip,
-										  tls_socket_tab[pos].remote_port));
+										  tls_socket_tab[pos]->remote_ip,
+										  tls_socket_tab[pos]->remote_port));
 					break;
 				}
 			}
 		}
-		if (pos == EXOSIP_MAX_SOCKETS)
+		if (pos == tls_socket_tab_size)
 			out_socket = 0;
 	}
 
@@ -2883,17 +2973,16 @@ tls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 			pos = _tls_tl_connect_socket(host, port);
 		}
 		if (pos >= 0) {
-			out_socket = tls_socket_tab[pos].socket;
-			ssl = tls_socket_tab[pos].ssl_conn;
+			out_socket = tls_socket_tab[pos]->socket;
+			ssl = tls_socket_tab[pos]->ssl_conn;
 		}
 	}
 
 	if (out_socket <= 0) {
-		osip_free(message);
 		return -1;
 	}
 
-	if (tls_socket_tab[pos].ssl_state == 0) {
+	if (tls_socket_tab[pos]->ssl_state == 0) {
 		i = _tls_tl_is_connected(out_socket);
 		if (i > 0) {
 			time_t now;
@@ -2902,7 +2991,6 @@ tls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 					   (__FILE__, __LINE__, OSIP_INFO2, NULL,
 						"socket node:%s, socket %d [pos=%d], in progress\n",
 						host, out_socket, pos));
-			osip_free(message);
 			if (tr != NULL && now - tr->birth_time > 10 && now - tr->birth_time < 13)
 			{
 				/* avoid doing this twice... */
@@ -2926,60 +3014,56 @@ tls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 					   (__FILE__, __LINE__, OSIP_INFO2, NULL,
 						"socket node:%s , socket %d [pos=%d], connected\n",
 						host, out_socket, pos));
-			tls_socket_tab[pos].ssl_state = 1;
-			tls_socket_tab[pos].ai_addrlen = 0;
+			tls_socket_tab[pos]->ssl_state = 1;
+			tls_socket_tab[pos]->ai_addrlen = 0;
 		} else {
 			OSIP_TRACE(osip_trace
 					   (__FILE__, __LINE__, OSIP_ERROR, NULL,
 						"socket node:%s, socket %d [pos=%d], socket error\n",
 						host, out_socket, pos));
-			osip_free(message);
 			return -1;
 		}
 	}
 
-	if (tls_socket_tab[pos].ssl_state == 1) {	/* TCP connected but not TLS connected */
-		i = _tls_tl_ssl_connect_socket(&tls_socket_tab[pos]);
+	if (tls_socket_tab[pos]->ssl_state == 1) {	/* TCP connected but not TLS connected */
+		i = _tls_tl_ssl_connect_socket(tls_socket_tab[pos]);
 		if (i < 0) {
-			_tls_tl_close_sockinfo(&tls_socket_tab[pos]);
-			osip_free(message);
+			_tls_tl_close_sockinfo(tls_socket_tab[pos]);
 			return -1;
 		} else if (i > 0) {
 			OSIP_TRACE(osip_trace
 					   (__FILE__, __LINE__, OSIP_INFO2, NULL,
 						"socket node:%s, socket %d [pos=%d], connected (ssl in progress)\n",
 						host, out_socket, pos));
-			osip_free(message);
 			return 1;
 		}
-		ssl = tls_socket_tab[pos].ssl_conn;
+		ssl = tls_socket_tab[pos]->ssl_conn;
 	}
 
 	if (ssl == NULL) {
-		osip_free(message);
 		return -1;
 	}
 
 #ifdef MULTITASKING_ENABLED
 	if (kCFCoreFoundationVersionNumber > kCFCoreFoundationVersionNumber10_6) { /*I.E is >=OS4*/
-		if (tls_socket_tab[pos].readStream==NULL)
+		if (tls_socket_tab[pos]->readStream==NULL)
 		{
-			tls_socket_tab[pos].readStream = NULL;
-			tls_socket_tab[pos].writeStream = NULL;
-			CFStreamCreatePairWithSocket(kCFAllocatorDefault, tls_socket_tab[pos].socket,
-										 &tls_socket_tab[pos].readStream, &tls_socket_tab[pos].writeStream);
-			if (tls_socket_tab[pos].readStream!=NULL)
-				CFReadStreamSetProperty(tls_socket_tab[pos].readStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
-			if (tls_socket_tab[pos].writeStream!=NULL)
-				CFWriteStreamSetProperty(tls_socket_tab[pos].writeStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
-			if (CFReadStreamOpen (tls_socket_tab[pos].readStream))
+			tls_socket_tab[pos]->readStream = NULL;
+			tls_socket_tab[pos]->writeStream = NULL;
+			CFStreamCreatePairWithSocket(kCFAllocatorDefault, tls_socket_tab[pos]->socket,
+										 &tls_socket_tab[pos]->readStream, &tls_socket_tab[pos]->writeStream);
+			if (tls_socket_tab[pos]->readStream!=NULL)
+				CFReadStreamSetProperty(tls_socket_tab[pos]->readStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
+			if (tls_socket_tab[pos]->writeStream!=NULL)
+				CFWriteStreamSetProperty(tls_socket_tab[pos]->writeStream, kCFStreamNetworkServiceType, kCFStreamNetworkServiceTypeVoIP);
+			if (CFReadStreamOpen (tls_socket_tab[pos]->readStream))
 			{ 
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_INFO2, NULL,
 							"CFReadStreamOpen Succeeded!\n"));
 			}
 			
-			CFWriteStreamOpen (tls_socket_tab[pos].writeStream) ;
+			CFWriteStreamOpen (tls_socket_tab[pos]->writeStream) ;
 		}
 	}
 #endif
@@ -2999,13 +3083,11 @@ tls_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 				continue;
 			print_ssl_error(i);
 
-			osip_free(message);
 			return -1;
 		}
 		break;
 	}
 
-	osip_free(message);
 	return OSIP_SUCCESS;
 }
 
@@ -3022,15 +3104,15 @@ static int tls_tl_keepalive(void)
 	if (tls_socket <= 0)
 		return OSIP_UNDEFINED_ERROR;
 
-	for (pos = 0; pos < EXOSIP_MAX_SOCKETS; pos++) {
-		if (tls_socket_tab[pos].socket > 0 && tls_socket_tab[pos].ssl_state > 2) {
-			SSL_set_mode(tls_socket_tab[pos].ssl_conn, SSL_MODE_AUTO_RETRY);
+	for (pos = 0; pos < tls_socket_tab_size; pos++) {
+		if (tls_socket_tab[pos]->socket > 0 && tls_socket_tab[pos]->ssl_state > 2) {
+			SSL_set_mode(tls_socket_tab[pos]->ssl_conn, SSL_MODE_AUTO_RETRY);
 
 			while (1) {
-				i = SSL_write(tls_socket_tab[pos].ssl_conn, (const void *) buf, 4);
+				i = SSL_write(tls_socket_tab[pos]->ssl_conn, (const void *) buf, 4);
 
 				if (i <= 0) {
-					i = SSL_get_error(tls_socket_tab[pos].ssl_conn, i);
+					i = SSL_get_error(tls_socket_tab[pos]->ssl_conn, i);
 					if (i == SSL_ERROR_WANT_READ || i == SSL_ERROR_WANT_WRITE)
 						continue;
 					print_ssl_error(i);
@@ -3045,6 +3127,7 @@ static int tls_tl_keepalive(void)
 static int tls_tl_set_socket(int socket)
 {
 	tls_socket = socket;
+	_eXosip_poll_add(tls_socket, &_tls_tl_poll_accept_cb, NULL);
 
 	return OSIP_SUCCESS;
 }
@@ -45,6 +45,8 @@ static struct sockaddr_storage ai_addr;
 static char udp_firewall_ip[64];
 static char udp_firewall_port[10];
 
+static void _udp_tl_poll_cb(int sock, void *data);
+
 int eXosip_get_udp_socket(void){
 	return udp_socket;
 }
@@ -63,8 +65,10 @@ static int udp_tl_free(void)
 	memset(udp_firewall_ip, 0, sizeof(udp_firewall_ip));
 	memset(udp_firewall_port, 0, sizeof(udp_firewall_port));
 	memset(&ai_addr, 0, sizeof(struct sockaddr_storage));
-	if (udp_socket > 0)
+	if (udp_socket > 0) {
+		_eXosip_poll_remove(udp_socket);
 		close(udp_socket);
+	}
 
 	return OSIP_SUCCESS;
 }
@@ -171,6 +175,7 @@ static int udp_tl_open(void)
 	}
 
 	udp_socket = sock;
+	_eXosip_poll_add(udp_socket, &_udp_tl_poll_cb, NULL);
 
 	if (eXtl_udp.proto_family == AF_INET)
 	{
@@ -255,109 +260,121 @@ void udp_tl_learn_port_from_via(osip_message_t * sip)
 	return;
 }
 
-static int udp_tl_read_message(fd_set * osip_fdset, fd_set * osip_wrset)
+/* read one datagram from udp_socket */
+static int _udp_tl_recv(void)
 {
+	struct sockaddr_storage sa;
 	char *buf;
 	int i;
-
-	if (udp_socket <= 0)
-		return -1;
-
-	if (FD_ISSET(udp_socket, osip_fdset)) {
-		struct sockaddr_storage sa;
-
 #ifdef __linux
-		socklen_t slen;
+	socklen_t slen;
 #else
-		int slen;
+	int slen;
 #endif
-		if (eXtl_udp.proto_family == AF_INET)
-			slen = sizeof(struct sockaddr_in);
-		else
-			slen = sizeof(struct sockaddr_in6);
 
-		buf = (char *) osip_malloc(SIP_MESSAGE_MAX_LENGTH * sizeof(char) + 1);
-		if (buf == NULL)
-			return OSIP_NOMEM;
+	if (eXtl_udp.proto_family == AF_INET)
+		slen = sizeof(struct sockaddr_in);
+	else
+		slen = sizeof(struct sockaddr_in6);
 
-		i = recvfrom(udp_socket, buf,
-					 SIP_MESSAGE_MAX_LENGTH, 0, (struct sockaddr *) &sa, &slen);
+	buf = (char *) osip_malloc(SIP_MESSAGE_MAX_LENGTH * sizeof(char) + 1);
+	if (buf == NULL)
+		return OSIP_NOMEM;
 
-		if (i > 5) {
-			char src6host[NI_MAXHOST];
-			int recvport = 0;
-			int err;
+	i = recvfrom(udp_socket, buf,
+				 SIP_MESSAGE_MAX_LENGTH, 0, (struct sockaddr *) &sa, &slen);
 
-			buf[i] = '\0';
-			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
-								  "Received message: \n%s\n", buf));
+	if (i > 5) {
+		char src6host[NI_MAXHOST];
+		int recvport = 0;
+		int err;
 
-			memset(src6host, 0, sizeof(src6host));
+		buf[i] = '\0';
+		OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
+							  "Received message: \n%s\n", buf));
 
-			if (eXtl_udp.proto_family == AF_INET)
-				recvport = ntohs(((struct sockaddr_in *) &sa)->sin_port);
-			else
-				recvport = ntohs(((struct sockaddr_in6 *) &sa)->sin6_port);
+		memset(src6host, 0, sizeof(src6host));
 
-#if defined(__arc__)
-			{
-				struct sockaddr_in *fromsa = (struct sockaddr_in *) &sa;
-				char *tmp;
-				tmp = inet_ntoa(fromsa->sin_addr);
-				if (tmp == NULL) {
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_ERROR, NULL,
-								"Message received from: NULL:%i inet_ntoa failure\n",
-								recvport));
-				} else {
-					snprintf(src6host, sizeof(src6host), "%s", tmp);
-					OSIP_TRACE(osip_trace
-							   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-								"Message received from: %s:%i\n", src6host,
-								recvport));
-				}
-			}
-#else
-			err = getnameinfo((struct sockaddr *) &sa, slen,
-							  src6host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
+		if (eXtl_udp.proto_family == AF_INET)
+			recvport = ntohs(((struct sockaddr_in *) &sa)->sin_port);
+		else
+			recvport = ntohs(((struct sockaddr_in6 *) &sa)->sin6_port);
 
-			if (err != 0) {
+#if defined(__arc__)
+		{
+			struct sockaddr_in *fromsa = (struct sockaddr_in *) &sa;
+			char *tmp;
+			tmp = inet_ntoa(fromsa->sin_addr);
+			if (tmp == NULL) {
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_ERROR, NULL,
-							"Message received from: NULL:%i getnameinfo failure\n",
+							"Message received from: NULL:%i inet_ntoa failure\n",
 							recvport));
-				snprintf(src6host, sizeof(src6host), "127.0.0.1");
 			} else {
+				snprintf(src6host, sizeof(src6host), "%s", tmp);
 				OSIP_TRACE(osip_trace
 						   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-							"Message received from: %s:%i\n", src6host, recvport));
+							"Message received from: %s:%i\n", src6host,
+							recvport));
 			}
-#endif
+		}
+#else
+		err = getnameinfo((struct sockaddr *) &sa, slen,
+						  src6host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
 
+		if (err != 0) {
+			OSIP_TRACE(osip_trace
+					   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+						"Message received from: NULL:%i getnameinfo failure\n",
+						recvport));
+			snprintf(src6host, sizeof(src6host), "127.0.0.1");
+		} else {
 			OSIP_TRACE(osip_trace
 					   (__FILE__, __LINE__, OSIP_INFO1, NULL,
 						"Message received from: %s:%i\n", src6host, recvport));
+		}
+#endif
 
-			_eXosip_handle_incoming_message(buf, i, udp_socket, src6host,
-											recvport);
+		OSIP_TRACE(osip_trace
+				   (__FILE__, __LINE__, OSIP_INFO1, NULL,
+					"Message received from: %s:%i\n", src6host, recvport));
 
-		}
+		_eXosip_handle_incoming_message(buf, i, udp_socket, src6host,
+										recvport);
+
+	}
 #ifndef MINISIZE
-		else if (i < 0) {
-			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
-								  "Could not read socket\n"));
-				if (udp_socket > 0)
-					close(udp_socket);
-				udp_tl_open();
-		} else {
-			OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
-								  "Dummy SIP message received\n"));
-		}
+	else if (i < 0) {
+		OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_ERROR, NULL,
+							  "Could not read socket\n"));
+			if (udp_socket > 0) {
+				_eXosip_poll_remove(udp_socket);
+				close(udp_socket);
+			}
+			udp_tl_open();
+	} else {
+		OSIP_TRACE(osip_trace(__FILE__, __LINE__, OSIP_INFO1, NULL,
+							  "Dummy SIP message received\n"));
+	}
 #endif
 
-		osip_free(buf);
-	}
+	osip_free(buf);
+	return OSIP_SUCCESS;
+}
+
+static void _udp_tl_poll_cb(int sock, void *data)
+{
+	if (sock == udp_socket)
+		_udp_tl_recv();
+}
+
+static int udp_tl_read_message(fd_set * osip_fdset, fd_set * osip_wrset)
+{
+	if (udp_socket <= 0)
+		return -1;
 
+	if (FD_ISSET(udp_socket, osip_fdset))
+		return _udp_tl_recv();
 	return OSIP_SUCCESS;
 }
 
@@ -455,7 +472,7 @@ udp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 	size_t length = 0;
 	struct addrinfo *addrinfo;
 	struct __eXosip_sockaddr addr;
-	char *message = NULL;
+	const char *message = NULL;
 
 	char ipbuf[INET6_ADDRSTRLEN];
 	int i;
@@ -646,14 +663,13 @@ udp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 		if (tag == NULL && route != NULL && route->url != NULL) {
 			osip_list_remove(&sip->routes, 0);
 		}
-		i = osip_message_to_str(sip, &message, &length);
+		i = osip_message_get_buffer(sip, &message, &length);
 		if (tag == NULL && route != NULL && route->url != NULL) {
 			osip_list_add(&sip->routes, route, 0);
 		}
 	}
 
 	if (i != 0 || length <= 0) {
-		osip_free(message);
 		return -1;
 	}
 
@@ -705,13 +721,11 @@ udp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 			/* rotate on failure! */
 			if (eXosip_dnsutils_rotate_srv(&naptr_record->sipudp_record)>0)
 			{
-				osip_free(message);
 				return OSIP_SUCCESS + 1;	/* retry for next retransmission! */
 			}
 		}
 #endif
 		/* SIP_NETWORK_ERROR; */
-		osip_free(message);
 		return -1;
 	}
 	
@@ -747,7 +761,6 @@ udp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 						host, port,
 						naptr_record->sipudp_record.srventry[naptr_record->sipudp_record.index].srv,
 						naptr_record->sipudp_record.srventry[naptr_record->sipudp_record.index].port));
-					osip_free(message);
 					return OSIP_SUCCESS + 1;	/* retry for next retransmission! */
 				}
 			}
@@ -755,7 +768,6 @@ udp_tl_send_message(osip_transaction_t * tr, osip_message_t * sip, char *host,
 	}
 #endif
 
-	osip_free(message);
 	return OSIP_SUCCESS;
 }
 
@@ -787,6 +799,7 @@ static int udp_tl_keepalive(void)
 static int udp_tl_set_socket(int socket)
 {
 	udp_socket = socket;
+	_eXosip_poll_add(udp_socket, &_udp_tl_poll_cb, NULL);
 
 	return OSIP_SUCCESS;
 }
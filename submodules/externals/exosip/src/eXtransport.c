@@ -25,6 +25,10 @@
 
 #include "eXosip2.h"
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 extern eXosip_t eXosip;
 
 char *_eXosip_transport_protocol(osip_message_t * msg)
@@ -68,6 +72,220 @@ int eXosip_transport_set(osip_message_t * msg, const char *transport)
 	return OSIP_SUCCESS;
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+
+#ifndef EXOSIP_POLL_EVENTS
+#define EXOSIP_POLL_EVENTS 64
+#endif
+
+struct eXosip_poll_entry {
+	eXosip_poll_cb cb;
+	void *data;
+	unsigned int gen;			/* tells a stale event from a reused socket */
+};
+
+static int poll_fd = -1;
+static struct eXosip_poll_entry *poll_tab;	/* indexed by socket */
+static int poll_tab_size;
+static unsigned int poll_gen;
+#ifdef OSIP_MT
+static struct osip_mutex *poll_mutex;
+#endif
+
+int _eXosip_poll_init(void)
+{
+	if (poll_fd >= 0)
+		return OSIP_SUCCESS;
+
+#ifdef EPOLL_CLOEXEC
+	poll_fd = epoll_create1(EPOLL_CLOEXEC);
+#else
+	poll_fd = epoll_create(EXOSIP_POLL_EVENTS);
+#endif
+	if (poll_fd < 0) {
+		OSIP_TRACE(osip_trace
+				   (__FILE__, __LINE__, OSIP_WARNING, NULL,
+					"eXosip: epoll not available (%s), using select()\n",
+					strerror(errno)));
+		return OSIP_UNDEFINED_ERROR;
+	}
+#ifdef OSIP_MT
+	poll_mutex = osip_mutex_init();
+#endif
+	return OSIP_SUCCESS;
+}
+
+void _eXosip_poll_free(void)
+{
+	if (poll_fd >= 0)
+		close(poll_fd);
+	poll_fd = -1;
+	if (poll_tab != NULL)
+		osip_free(poll_tab);
+	poll_tab = NULL;
+	poll_tab_size = 0;
+#ifdef OSIP_MT
+	if (poll_mutex != NULL)
+		osip_mutex_destroy(poll_mutex);
+	poll_mutex = NULL;
+#endif
+}
+
+int _eXosip_poll_enabled(void)
+{
+	return poll_fd >= 0;
+}
+
+int _eXosip_poll_add(int sock, eXosip_poll_cb cb, void *data)
+{
+	struct epoll_event ev;
+	int i;
+
+	if (poll_fd < 0)
+		return OSIP_SUCCESS;
+	if (sock < 0 || cb == NULL)
+		return OSIP_BADPARAMETER;
+
+#ifdef OSIP_MT
+	osip_mutex_lock(poll_mutex);
+#endif
+	if (sock >= poll_tab_size) {
+		struct eXosip_poll_entry *tab;
+		int size = poll_tab_size > 0 ? poll_tab_size : EXOSIP_POLL_EVENTS;
+
+		while (size <= sock)
+			size *= 2;
+		tab = (struct eXosip_poll_entry *) osip_realloc(poll_tab,
+														size *
+														sizeof(struct
+															   eXosip_poll_entry));
+		if (tab == NULL) {
+#ifdef OSIP_MT
+			osip_mutex_unlock(poll_mutex);
+#endif
+			return OSIP_NOMEM;
+		}
+		memset(tab + poll_tab_size, 0,
+			   (size - poll_tab_size) * sizeof(struct eXosip_poll_entry));
+		poll_tab = tab;
+		poll_tab_size = size;
+	}
+
+	poll_gen++;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u64 = ((uint64_t) poll_gen << 32) | (uint32_t) sock;
+	i = epoll_ctl(poll_fd, EPOLL_CTL_ADD, sock, &ev);
+	if (i < 0 && errno == EEXIST)
+		i = epoll_ctl(poll_fd, EPOLL_CTL_MOD, sock, &ev);
+	if (i < 0) {
+		OSIP_TRACE(osip_trace
+				   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+					"eXosip: cannot poll socket %d (%s)\n", sock,
+					strerror(errno)));
+#ifdef OSIP_MT
+		osip_mutex_unlock(poll_mutex);
+#endif
+		return OSIP_UNDEFINED_ERROR;
+	}
+	poll_tab[sock].cb = cb;
+	poll_tab[sock].data = data;
+	poll_tab[sock].gen = poll_gen;
+#ifdef OSIP_MT
+	osip_mutex_unlock(poll_mutex);
+#endif
+	return OSIP_SUCCESS;
+}
+
+int _eXosip_poll_remove(int sock)
+{
+	if (poll_fd < 0 || sock < 0)
+		return OSIP_SUCCESS;
+
+#ifdef OSIP_MT
+	osip_mutex_lock(poll_mutex);
+#endif
+	if (sock < poll_tab_size && poll_tab[sock].cb != NULL) {
+		/* must be called before the socket is closed */
+		epoll_ctl(poll_fd, EPOLL_CTL_DEL, sock, NULL);
+		memset(&poll_tab[sock], 0, sizeof(struct eXosip_poll_entry));
+	}
+#ifdef OSIP_MT
+	osip_mutex_unlock(poll_mutex);
+#endif
+	return OSIP_SUCCESS;
+}
+
+/* wait up to timeout ms (-1: forever) and run the handler of every
+   ready socket: return the number of ready sockets, 0 on timeout and
+   -1 on error (see errno). */
+int _eXosip_poll_wait(int timeout)
+{
+	struct epoll_event events[EXOSIP_POLL_EVENTS];
+	int n;
+	int i;
+
+	if (poll_fd < 0)
+		return -1;
+
+	n = epoll_wait(poll_fd, events, EXOSIP_POLL_EVENTS, timeout);
+	for (i = 0; i < n; i++) {
+		int sock = (int) (events[i].data.u64 & 0xffffffff);
+		unsigned int gen = (unsigned int) (events[i].data.u64 >> 32);
+		eXosip_poll_cb cb = NULL;
+		void *data = NULL;
+
+		/* a previous handler may have closed this socket, and the
+		   number may even have been reused by a new one since. */
+#ifdef OSIP_MT
+		osip_mutex_lock(poll_mutex);
+#endif
+		if (sock < poll_tab_size && poll_tab[sock].gen == gen) {
+			cb = poll_tab[sock].cb;
+			data = poll_tab[sock].data;
+		}
+#ifdef OSIP_MT
+		osip_mutex_unlock(poll_mutex);
+#endif
+		if (cb != NULL)
+			cb(sock, data);
+	}
+	return n;
+}
+
+#else
+
+int _eXosip_poll_init(void)
+{
+	return OSIP_UNDEFINED_ERROR;
+}
+
+void _eXosip_poll_free(void)
+{
+}
+
+int _eXosip_poll_enabled(void)
+{
+	return 0;
+}
+
+int _eXosip_poll_add(int sock, eXosip_poll_cb cb, void *data)
+{
+	return OSIP_SUCCESS;
+}
+
+int _eXosip_poll_remove(int sock)
+{
+	return OSIP_SUCCESS;
+}
+
+int _eXosip_poll_wait(int timeout)
+{
+	return -1;
+}
+
+#endif
+
 #if 0
 #ifndef MINISIZE
 int
@@ -73,4 +73,26 @@ extern struct eXtl_protocol eXtl_dtls;
 #define eXFD_SET(A, B)   FD_SET(A, B)
 #endif
 
+/*
+ * Readiness registry used by eXosip_read_message.
+ *
+ * When epoll is available, each transport registers its sockets once
+ * (on open, accept and connect) together with the handler to run when
+ * the socket becomes readable, and unregisters them when it closes
+ * them. eXosip_read_message then only waits and dispatches, instead of
+ * rebuilding fd_sets for every transport on every iteration.
+ *
+ * Without epoll, every function below is a no-op and
+ * _eXosip_poll_enabled() returns 0: eXosip_read_message keeps using
+ * tl_set_fdset/tl_read_message and select().
+ */
+typedef void (*eXosip_poll_cb) (int sock, void *data);
+
+int _eXosip_poll_init(void);
+void _eXosip_poll_free(void);
+int _eXosip_poll_enabled(void);
+int _eXosip_poll_add(int sock, eXosip_poll_cb cb, void *data);
+int _eXosip_poll_remove(int sock);
+int _eXosip_poll_wait(int timeout);
+
 #endif
@@ -1633,6 +1633,26 @@ int eXosip_read_message(int max_message_nb, int sec_max, int usec_max)
 	tv.tv_sec = sec_max;
 	tv.tv_usec = usec_max;
 
+	if (_eXosip_poll_enabled()) {
+		/* sockets are registered by the transports: just wait and
+		   let _eXosip_poll_wait run their handlers */
+		int timeout = -1;
+
+		if ((sec_max != -1) && (usec_max != -1))
+			timeout = sec_max * 1000 + (usec_max + 999) / 1000;
+
+		while (max_message_nb != 0 && eXosip.j_stop_ua == 0) {
+			int i = _eXosip_poll_wait(timeout);
+
+			if ((i == -1) && (errno == EINTR || errno == EAGAIN))
+				continue;
+			if (-1 == i && eXosip.j_stop_ua == 0)
+				return -2000;	/* error */
+			max_message_nb--;
+		}
+		return OSIP_SUCCESS;
+	}
+
 	while (max_message_nb != 0 && eXosip.j_stop_ua == 0) {
 		int i;
 		int max = 0;
@@ -21,10 +21,6 @@
 #ifndef _OSIP_H_
 #define _OSIP_H_
 
-#if defined(HAVE_DICT_DICT_H)
-#include <dict/dict.h>
-#endif
-
 #include <osipparser2/osip_const.h>
 
 /* Time-related functions and data types */
@@ -373,6 +369,24 @@ struct osip_naptr {
 	struct osip_srv_record sipsctp_record;
 };
 
+/**
+ * Structure for timer scheduling.
+ * @var osip_timer_t
+ */
+	typedef struct osip_timer osip_timer_t;
+
+/**
+ * Structure for timer scheduling.
+ * Transactions and ixt elements register their next expiration
+ * in a heap owned by osip_t.
+ * @struct osip_timer
+ */
+	struct osip_timer {
+		struct timeval deadline;/**@internal next expiration */
+		int pos;				/**@internal position in heap, -1 if unused */
+		void *owner;			/**@internal element to wake up */
+	};
+
 /**
  * Structure for transaction handling.
  * @var osip_transaction_t
@@ -430,6 +444,8 @@ struct osip_naptr {
 		void *reserved4;	/**< User Defined Pointer. */
 		void *reserved5;	/**< User Defined Pointer. */
 		void *reserved6;	/**< User Defined Pointer. */
+
+		osip_timer_t timer;		/**@internal next timer of the transaction */
 	};
 
 
@@ -577,6 +593,7 @@ struct osip_naptr {
 		int port;				/**< destination port */
 		int sock;				/**< socket to use */
 		int counter;			/**< start at 7 */
+		osip_timer_t timer;		/**@internal next retransmission */
 	};
 
 
@@ -589,6 +606,23 @@ struct osip_naptr {
  */
 	typedef struct osip osip_t;
 
+/**
+ * Structure for transaction lookup.
+ * Transactions are hashed on the branch, method and sent-by of their
+ * top Via header so that incoming messages can be matched without
+ * walking the list of transactions.
+ * @var osip_transaction_index_t
+ */
+	typedef struct osip_transaction_index osip_transaction_index_t;
+
+/**
+ * Structure for timer lookup.
+ * A binary heap ordered on osip_timer_t deadlines: the next timeout
+ * is at the top and only expired entries are visited.
+ * @var osip_timer_heap_t
+ */
+	typedef struct osip_timer_heap osip_timer_heap_t;
+
 /**
  * Structure for osip handling.
  * @struct osip
@@ -608,7 +642,7 @@ struct osip_naptr {
 		osip_list_t osip_nist_transactions;
 										 /**< list of nist transactions */
 
-		osip_list_t ixt_retransmissions;/**< list of ixt elements */
+		osip_list_t ixt_retransmissions;/**< unused, the ixt elements are kept in ixt_timers */
 
 		osip_message_cb_t msg_callbacks[OSIP_MESSAGE_CALLBACK_COUNT];	 /**@internal */
 		osip_kill_transaction_cb_t kill_callbacks[OSIP_KILL_CALLBACK_COUNT];
@@ -621,12 +655,26 @@ struct osip_naptr {
 								int, int);
 										/**@internal */
 
-#if defined(HAVE_DICT_DICT_H)
-		dict *osip_ict_hastable;		  /**< htable of ict transactions */
-		dict *osip_ist_hastable;		  /**< htable of ist transactions */
-		dict *osip_nict_hastable;		  /**< htable of nict transactions */
-		dict *osip_nist_hastable;		  /**< htable of nist transactions */
-#endif
+		/* indexes of ict, ist, nict, nist transactions */
+		osip_transaction_index_t *osip_ict_index;
+										 /**< index of ict transactions */
+		osip_transaction_index_t *osip_ist_index;
+										 /**< index of ist transactions */
+		osip_transaction_index_t *osip_nict_index;
+										 /**< index of nict transactions */
+		osip_transaction_index_t *osip_nist_index;
+										 /**< index of nist transactions */
+
+		/* pending timers of ict, ist, nict, nist and ixt elements */
+		osip_timer_heap_t *osip_ict_timers;
+										 /**< timers of ict transactions */
+		osip_timer_heap_t *osip_ist_timers;
+										 /**< timers of ist transactions */
+		osip_timer_heap_t *osip_nict_timers;
+										 /**< timers of nict transactions */
+		osip_timer_heap_t *osip_nist_timers;
+										 /**< timers of nist transactions */
+		osip_timer_heap_t *ixt_timers;	 /**< timers of ixt elements */
 	};
 
 /**
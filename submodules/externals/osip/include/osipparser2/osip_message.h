@@ -175,6 +175,163 @@ extern "C" {
  */
 	int osip_message_to_str_sipfrag(osip_message_t * sip, char **dest,
 									size_t * message_length);
+/**
+ * Get the string representation of a osip_message_t element without copying it.
+ * The message is built only if it was modified since it was last built
+ * (see osip_message_force_update()). The buffer belongs to the element and
+ * stays valid until the element is modified, rebuilt or freed.
+ * @param sip The element to work on.
+ * @param dest A pointer on the buffer.
+ * @param message_length The length of the buffer.
+ */
+	int osip_message_get_buffer(osip_message_t * sip, const char **dest,
+								size_t * message_length);
+/**
+ * Structure for a header located by osip_message_view_parse().
+ * @var osip_message_view_header_t
+ */
+	typedef struct osip_message_view_header osip_message_view_header_t;
+
+/**
+ * Structure for a header located by osip_message_view_parse().
+ * Both spans point inside the buffer given to the view; hvalue
+ * may still contain folded lines (CRLF followed by SP or HT).
+ */
+	struct osip_message_view_header {
+		const char *hname;			  /**< Header name (not NUL terminated) */
+		size_t hname_len;			  /**< Length of the header name */
+		const char *hvalue;			  /**< Header value (not NUL terminated) */
+		size_t hvalue_len;			  /**< Length of the header value */
+	};
+
+#ifndef OSIP_MESSAGE_VIEW_HEADERS
+/**
+ * Number of headers a view can index without allocating.
+ */
+#define OSIP_MESSAGE_VIEW_HEADERS 32
+#endif
+
+/**
+ * Structure for a read-only view of a SIP message.
+ * @var osip_message_view_t
+ */
+	typedef struct osip_message_view osip_message_view_t;
+
+/**
+ * Structure for a read-only view of a SIP message.
+ *
+ * A view does not copy the message: osip_message_view_parse() walks
+ * the buffer once and only records where the start line, each header
+ * and the body are located. Via, From, To, Call-ID and CSeq are parsed
+ * into their usual structures the first time they are requested. The
+ * buffer must stay untouched until the view is freed or re-parsed.
+ */
+	struct osip_message_view {
+		const char *buf;			  /**< Buffer of the message */
+		size_t length;				  /**< Length of the buffer */
+		const char *sip_method;		  /**< Method of a request (not NUL terminated) */
+		size_t sip_method_len;		  /**< Length of the method */
+		int status_code;			  /**< Status code of a response */
+		const char *body;			  /**< Body of the message (or NULL) */
+		size_t body_len;			  /**< Length of the body */
+
+		osip_message_view_header_t *headers;
+									 /**< Headers found in the message */
+		int nb_headers;				  /**< Number of headers found */
+		int max_headers;			  /**< Capacity of headers */
+		osip_message_view_header_t static_headers[OSIP_MESSAGE_VIEW_HEADERS];
+									 /**@internal */
+
+		osip_list_t vias;			  /**@internal Via headers parsed so far */
+		int via_header;				  /**@internal next header to split */
+		size_t via_offset;			  /**@internal offset in this header */
+		osip_from_t *from;			  /**@internal */
+		osip_to_t *to;				  /**@internal */
+		osip_call_id_t *call_id;	  /**@internal */
+		osip_cseq_t *cseq;			  /**@internal */
+	};
+
+/**
+ * Initialise a osip_message_view_t element.
+ * A view may live on the stack and be re-used for several messages.
+ * @param view The element to initialise.
+ */
+	void osip_message_view_init(osip_message_view_t * view);
+/**
+ * Free all resource held by a osip_message_view_t element.
+ * @param view The element to work on.
+ */
+	void osip_message_view_free(osip_message_view_t * view);
+/**
+ * Locate the start line, the headers and the body of a message.
+ * The buffer is not copied and must outlive the view.
+ * @param view The element to work on.
+ * @param buf The buffer to index.
+ * @param length The length of the buffer.
+ */
+	int osip_message_view_parse(osip_message_view_t * view, const char *buf,
+								size_t length);
+/**
+ * Get the value of the header at index pos with name hname.
+ * Compact forms are accepted and the comparison is case-insensitive.
+ * @param view The element to work on.
+ * @param hname The name of the header.
+ * @param pos The index of the header among headers with this name.
+ * @param hvalue The value found (not NUL terminated).
+ * @param hvalue_len The length of the value found.
+ */
+	int osip_message_view_get_header(const osip_message_view_t * view,
+									 const char *hname, int pos,
+									 const char **hvalue, size_t * hvalue_len);
+/**
+ * Get the Via header at index pos, parsing it on first access.
+ * Comma separated values count as separate Via headers.
+ * The element is owned by the view.
+ * @param view The element to work on.
+ * @param pos The index of the Via header.
+ * @param dest A pointer on the header found.
+ */
+	int osip_message_view_get_via(osip_message_view_t * view, int pos,
+								  osip_via_t ** dest);
+/**
+ * Get the From header, parsing it on first access.
+ * The element is owned by the view.
+ * @param view The element to work on.
+ * @param dest A pointer on the header found.
+ */
+	int osip_message_view_get_from(osip_message_view_t * view,
+								   osip_from_t ** dest);
+/**
+ * Get the To header, parsing it on first access.
+ * The element is owned by the view.
+ * @param view The element to work on.
+ * @param dest A pointer on the header found.
+ */
+	int osip_message_view_get_to(osip_message_view_t * view, osip_to_t ** dest);
+/**
+ * Get the Call-ID header, parsing it on first access.
+ * The element is owned by the view.
+ * @param view The element to work on.
+ * @param dest A pointer on the header found.
+ */
+	int osip_message_view_get_call_id(osip_message_view_t * view,
+									  osip_call_id_t ** dest);
+/**
+ * Get the CSeq header, parsing it on first access.
+ * The element is owned by the view.
+ * @param view The element to work on.
+ * @param dest A pointer on the header found.
+ */
+	int osip_message_view_get_cseq(osip_message_view_t * view,
+								   osip_cseq_t ** dest);
+/**
+ * Fully parse the message indexed by a view into a osip_message_t element.
+ * @param view The element to work on.
+ * @param sip The resulting element.
+ */
+	int osip_message_view_to_message(const osip_message_view_t * view,
+									 osip_message_t * sip);
+
 /**
  * Clone a osip_message_t element.
  * @param sip The element to clone.
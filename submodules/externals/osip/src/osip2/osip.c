@@ -28,6 +28,7 @@ static struct osip_mutex *ict_fastmutex;
 static struct osip_mutex *ist_fastmutex;
 static struct osip_mutex *nict_fastmutex;
 static struct osip_mutex *nist_fastmutex;
+static struct osip_mutex *timers_fastmutex;
 static struct osip_mutex *id_mutex;
 #endif
 
@@ -60,6 +61,7 @@ static int __osip_global_init()
 	ist_fastmutex = osip_mutex_init();
 	nict_fastmutex = osip_mutex_init();
 	nist_fastmutex = osip_mutex_init();
+	timers_fastmutex = osip_mutex_init();
 
 	ixt_fastmutex = osip_mutex_init();
 
@@ -82,6 +84,7 @@ static void __osip_global_free()
 	osip_mutex_destroy(ist_fastmutex);
 	osip_mutex_destroy(nict_fastmutex);
 	osip_mutex_destroy(nist_fastmutex);
+	osip_mutex_destroy(timers_fastmutex);
 
 	osip_mutex_destroy(ixt_fastmutex);
 
@@ -137,6 +140,320 @@ osip_response_get_destination(osip_message_t * response, char **address,
 }
 
 
+#define OSIP_TIMER_HEAP_MIN_SIZE 64
+
+struct osip_timer_heap {
+	osip_timer_t **elts;
+	int len;
+	int size;
+};
+
+static osip_timer_heap_t *__osip_timer_heap_new(void)
+{
+	osip_timer_heap_t *heap;
+
+	heap = (osip_timer_heap_t *) osip_malloc(sizeof(osip_timer_heap_t));
+	if (heap == NULL)
+		return NULL;
+	heap->len = 0;
+	heap->size = OSIP_TIMER_HEAP_MIN_SIZE;
+	heap->elts =
+		(osip_timer_t **) osip_malloc(sizeof(osip_timer_t *) * heap->size);
+	if (heap->elts == NULL) {
+		osip_free(heap);
+		return NULL;
+	}
+	return heap;
+}
+
+static void __osip_timer_heap_free(osip_timer_heap_t * heap)
+{
+	int i;
+
+	if (heap == NULL)
+		return;
+	for (i = 0; i < heap->len; i++)
+		heap->elts[i]->pos = -1;
+	osip_free(heap->elts);
+	osip_free(heap);
+}
+
+static void __osip_timer_heap_place(osip_timer_heap_t * heap,
+									osip_timer_t * timer, int pos)
+{
+	heap->elts[pos] = timer;
+	timer->pos = pos;
+}
+
+static void __osip_timer_heap_up(osip_timer_heap_t * heap, int pos)
+{
+	osip_timer_t *timer = heap->elts[pos];
+
+	while (pos > 0) {
+		int parent = (pos - 1) / 2;
+
+		if (!osip_timercmp(&timer->deadline, &heap->elts[parent]->deadline, <))
+			break;
+		__osip_timer_heap_place(heap, heap->elts[parent], pos);
+		pos = parent;
+	}
+	__osip_timer_heap_place(heap, timer, pos);
+}
+
+static void __osip_timer_heap_down(osip_timer_heap_t * heap, int pos)
+{
+	osip_timer_t *timer = heap->elts[pos];
+
+	for (;;) {
+		int child = 2 * pos + 1;
+
+		if (child >= heap->len)
+			break;
+		if (child + 1 < heap->len
+			&& osip_timercmp(&heap->elts[child + 1]->deadline,
+							 &heap->elts[child]->deadline, <))
+			child++;
+		if (!osip_timercmp(&heap->elts[child]->deadline, &timer->deadline, <))
+			break;
+		__osip_timer_heap_place(heap, heap->elts[child], pos);
+		pos = child;
+	}
+	__osip_timer_heap_place(heap, timer, pos);
+}
+
+static void __osip_timer_heap_remove(osip_timer_heap_t * heap,
+									 osip_timer_t * timer)
+{
+	osip_timer_t *moved;
+	int pos = timer->pos;
+
+	if (pos < 0 || pos >= heap->len || heap->elts[pos] != timer)
+		return;
+	timer->pos = -1;
+	heap->len--;
+	if (pos == heap->len)
+		return;
+	moved = heap->elts[heap->len];
+	__osip_timer_heap_place(heap, moved, pos);
+	__osip_timer_heap_up(heap, pos);
+	__osip_timer_heap_down(heap, moved->pos);
+}
+
+/* insert the timer or move it to its new deadline */
+static int __osip_timer_heap_set(osip_timer_heap_t * heap, osip_timer_t * timer,
+								 struct timeval *deadline)
+{
+	timer->deadline = *deadline;
+	if (timer->pos >= 0 && timer->pos < heap->len
+		&& heap->elts[timer->pos] == timer) {
+		__osip_timer_heap_up(heap, timer->pos);
+		__osip_timer_heap_down(heap, timer->pos);
+		return OSIP_SUCCESS;
+	}
+	if (heap->len == heap->size) {
+		osip_timer_t **elts;
+
+		elts =
+			(osip_timer_t **) osip_realloc(heap->elts,
+										   sizeof(osip_timer_t *) *
+										   heap->size * 2);
+		if (elts == NULL)
+			return OSIP_NOMEM;
+		heap->elts = elts;
+		heap->size = heap->size * 2;
+	}
+	heap->len++;
+	__osip_timer_heap_place(heap, timer, heap->len - 1);
+	__osip_timer_heap_up(heap, heap->len - 1);
+	return OSIP_SUCCESS;
+}
+
+/* Remove all timers that expired before "now" from the heap and
+   return their owners. Owners are collected before being processed
+   because their new deadline may still be in the past. */
+static int __osip_timer_heap_pop_expired(osip_timer_heap_t * heap,
+										 struct timeval *now, void ***array)
+{
+	osip_timer_t *timer;
+	int len = 0;
+	int size = 0;
+
+	*array = NULL;
+	while (heap->len > 0 && osip_timercmp(now, &heap->elts[0]->deadline, >)) {
+		timer = heap->elts[0];
+		if (len == size) {
+			void **tmp;
+
+			size = size == 0 ? 16 : size * 2;
+			tmp = (void **) osip_realloc(*array, sizeof(void *) * size);
+			if (tmp == NULL)
+				break;			/* the others are kept for the next run */
+			*array = tmp;
+		}
+		__osip_timer_heap_remove(heap, timer);
+		(*array)[len++] = timer->owner;
+	}
+	return len;
+}
+
+static osip_timer_heap_t *__osip_transaction_timers(osip_transaction_t * tr)
+{
+	osip_t *osip = (osip_t *) tr->config;
+
+	if (tr->ctx_type == ICT)
+		return osip->osip_ict_timers;
+	if (tr->ctx_type == IST)
+		return osip->osip_ist_timers;
+	if (tr->ctx_type == NICT)
+		return osip->osip_nict_timers;
+	return osip->osip_nist_timers;
+}
+
+static void __osip_timer_min(struct timeval *deadline, struct timeval *timer)
+{
+	if (timer->tv_sec == -1)
+		return;					/* timer is not running */
+	if (deadline->tv_sec == -1 || osip_timercmp(deadline, timer, >))
+		*deadline = *timer;
+}
+
+/* Compute the next expiration of the timers that are running in the
+   current state of the transaction. This is the per transaction part
+   of the old osip_timers_gettimeout() scan: returns -1 when no timer
+   is running. */
+static int __osip_transaction_next_timer(osip_transaction_t * tr,
+										 struct timeval *deadline)
+{
+	deadline->tv_sec = -1;
+	deadline->tv_usec = 0;
+
+	if (tr->ctx_type == ICT && tr->ict_context != NULL) {
+		if (1 <= osip_fifo_size(tr->transactionff)) {
+			/* pending events must be processed without delay */
+			deadline->tv_sec = 0;
+			return OSIP_SUCCESS;
+		}
+		if (tr->state == ICT_CALLING) {
+			__osip_timer_min(deadline, &tr->ict_context->timer_b_start);
+			__osip_timer_min(deadline, &tr->ict_context->timer_a_start);
+		}
+		if (tr->state == ICT_COMPLETED)
+			__osip_timer_min(deadline, &tr->ict_context->timer_d_start);
+	} else if (tr->ctx_type == IST && tr->ist_context != NULL) {
+		if (tr->state == IST_CONFIRMED)
+			__osip_timer_min(deadline, &tr->ist_context->timer_i_start);
+		if (tr->state == IST_COMPLETED) {
+			__osip_timer_min(deadline, &tr->ist_context->timer_h_start);
+			__osip_timer_min(deadline, &tr->ist_context->timer_g_start);
+		}
+	} else if (tr->ctx_type == NICT && tr->nict_context != NULL) {
+		if (tr->state == NICT_COMPLETED)
+			__osip_timer_min(deadline, &tr->nict_context->timer_k_start);
+		if (tr->state == NICT_PROCEEDING || tr->state == NICT_TRYING) {
+			__osip_timer_min(deadline, &tr->nict_context->timer_f_start);
+			__osip_timer_min(deadline, &tr->nict_context->timer_e_start);
+		}
+	} else if (tr->ctx_type == NIST && tr->nist_context != NULL) {
+		if (tr->state == NIST_COMPLETED)
+			__osip_timer_min(deadline, &tr->nist_context->timer_j_start);
+	}
+	return deadline->tv_sec == -1 ? -1 : OSIP_SUCCESS;
+}
+
+int __osip_transaction_update_timer(osip_transaction_t * tr)
+{
+	osip_timer_heap_t *heap;
+	struct timeval deadline;
+	int i;
+
+	if (tr == NULL || tr->config == NULL)
+		return OSIP_BADPARAMETER;
+	heap = __osip_transaction_timers(tr);
+
+#ifdef OSIP_MT
+	osip_mutex_lock(timers_fastmutex);
+#endif
+	if (tr->timer.owner == NULL) {
+		/* not (or no more) managed by the osip stack */
+#ifdef OSIP_MT
+		osip_mutex_unlock(timers_fastmutex);
+#endif
+		return OSIP_SUCCESS;
+	}
+	i = __osip_transaction_next_timer(tr, &deadline);
+	if (i != 0) {
+		__osip_timer_heap_remove(heap, &tr->timer);
+		i = OSIP_SUCCESS;
+	} else {
+		i = __osip_timer_heap_set(heap, &tr->timer, &deadline);
+		if (i != 0) {
+			OSIP_TRACE(osip_trace
+					   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+						"cannot schedule timer of transaction %i\n",
+						tr->transactionid));
+		}
+	}
+#ifdef OSIP_MT
+	osip_mutex_unlock(timers_fastmutex);
+#endif
+	return i;
+}
+
+/* a transaction whose timers cannot be scheduled would never time
+   out: the caller must not add it to the stack */
+static int __osip_transaction_start_timer(osip_transaction_t * tr)
+{
+	int i;
+
+#ifdef OSIP_MT
+	osip_mutex_lock(timers_fastmutex);
+#endif
+	tr->timer.owner = tr;
+#ifdef OSIP_MT
+	osip_mutex_unlock(timers_fastmutex);
+#endif
+	i = __osip_transaction_update_timer(tr);
+	if (i != 0) {
+#ifdef OSIP_MT
+		osip_mutex_lock(timers_fastmutex);
+#endif
+		tr->timer.owner = NULL;
+#ifdef OSIP_MT
+		osip_mutex_unlock(timers_fastmutex);
+#endif
+	}
+	return i;
+}
+
+static void __osip_transaction_stop_timer(osip_transaction_t * tr)
+{
+#ifdef OSIP_MT
+	osip_mutex_lock(timers_fastmutex);
+#endif
+	tr->timer.owner = NULL;
+	__osip_timer_heap_remove(__osip_transaction_timers(tr), &tr->timer);
+#ifdef OSIP_MT
+	osip_mutex_unlock(timers_fastmutex);
+#endif
+}
+
+static int __osip_transaction_pop_expired(osip_timer_heap_t * heap,
+										  void ***array)
+{
+	struct timeval now;
+	int len;
+
+	osip_gettimeofday(&now, NULL);
+#ifdef OSIP_MT
+	osip_mutex_lock(timers_fastmutex);
+#endif
+	len = __osip_timer_heap_pop_expired(heap, &now, array);
+#ifdef OSIP_MT
+	osip_mutex_unlock(timers_fastmutex);
+#endif
+	return len;
+}
+
 int osip_ixt_lock(osip_t * osip)
 {
 #ifdef OSIP_MT
@@ -173,31 +490,30 @@ int osip_id_mutex_unlock(osip_t * osip)
 #endif
 }
 
-/* these are for transactions that would need retransmission not handled by state machines */
-void osip_add_ixt(osip_t * osip, ixt_t * ixt)
+/* these are for transactions that would need retransmission not handled by state machines.
+   The ixt elements are only kept in the ixt_timers heap: the position of their
+   timer is their index, so removing one does not need a search. */
+int osip_add_ixt(osip_t * osip, ixt_t * ixt)
 {
-	/* add in list osip_t->ixt */
+	int i;
+
 	osip_ixt_lock(osip);
-	osip_list_add(&osip->ixt_retransmissions, (void *) ixt, 0);
+	ixt->timer.owner = ixt;
+	i = __osip_timer_heap_set(osip->ixt_timers, &ixt->timer, &ixt->start);
 	osip_ixt_unlock(osip);
+	if (i != 0) {
+		OSIP_TRACE(osip_trace
+				   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+					"cannot schedule retransmissions\n"));
+		return i;
+	}
+	return OSIP_SUCCESS;
 }
 
 void osip_remove_ixt(osip_t * osip, ixt_t * ixt)
 {
-	int i;
-	int found = 0;
-	ixt_t *tmp;
-
-	/* add in list osip_t->ixt */
 	osip_ixt_lock(osip);
-	for (i = 0; !osip_list_eol(&osip->ixt_retransmissions, i); i++) {
-		tmp = (ixt_t *) osip_list_get(&osip->ixt_retransmissions, i);
-		if (tmp == ixt) {
-			osip_list_remove(&osip->ixt_retransmissions, i);
-			found = 1;
-			break;
-		}
-	}
+	__osip_timer_heap_remove(osip->ixt_timers, &ixt->timer);
 	osip_ixt_unlock(osip);
 }
 
@@ -218,6 +534,8 @@ int ixt_init(ixt_t ** ixt)
 	pixt->dest = NULL;
 	pixt->port = 5060;
 	pixt->sock = -1;
+	pixt->timer.pos = -1;
+	pixt->timer.owner = NULL;
 	return OSIP_SUCCESS;
 }
 
@@ -241,7 +559,8 @@ osip_start_200ok_retransmissions(osip_t * osip, osip_dialog_t * dialog,
 	osip_message_clone(msg200ok, &ixt->msg2xx);
 	ixt->sock = sock;
 	osip_response_get_destination(msg200ok, &ixt->dest, &ixt->port);
-	osip_add_ixt(osip, ixt);
+	if (osip_add_ixt(osip, ixt) != 0)
+		ixt_free(ixt);
 }
 
 void
@@ -260,7 +579,8 @@ osip_start_ack_retransmissions(osip_t * osip, osip_dialog_t * dialog,
 	ixt->dest = osip_strdup(dest);
 	ixt->port = port;
 	ixt->sock = sock;
-	osip_add_ixt(osip, ixt);
+	if (osip_add_ixt(osip, ixt) != 0)
+		ixt_free(ixt);
 }
 
 /* we stop the 200ok when receiving the corresponding ack */
@@ -272,10 +592,10 @@ struct osip_dialog *osip_stop_200ok_retransmissions(osip_t * osip,
 	ixt_t *ixt;
 
 	osip_ixt_lock(osip);
-	for (i = 0; !osip_list_eol(&osip->ixt_retransmissions, i); i++) {
-		ixt = (ixt_t *) osip_list_get(&osip->ixt_retransmissions, i);
+	for (i = 0; i < osip->ixt_timers->len; i++) {
+		ixt = (ixt_t *) osip->ixt_timers->elts[i]->owner;
 		if (osip_dialog_match_as_uas(ixt->dialog, ack) == 0) {
-			osip_list_remove(&osip->ixt_retransmissions, i);
+			__osip_timer_heap_remove(osip->ixt_timers, &ixt->timer);
 			dialog = ixt->dialog;
 			ixt_free(ixt);
 			break;
@@ -293,12 +613,13 @@ void osip_stop_retransmissions_from_dialog(osip_t * osip, osip_dialog_t * dialog
 	ixt_t *ixt;
 
 	osip_ixt_lock(osip);
-	for (i = 0; !osip_list_eol(&osip->ixt_retransmissions, i); i++) {
-		ixt = (ixt_t *) osip_list_get(&osip->ixt_retransmissions, i);
+	for (i = 0; i < osip->ixt_timers->len; i++) {
+		ixt = (ixt_t *) osip->ixt_timers->elts[i]->owner;
 		if (ixt->dialog == dialog) {
-			osip_list_remove(&osip->ixt_retransmissions, i);
+			__osip_timer_heap_remove(osip->ixt_timers, &ixt->timer);
 			ixt_free(ixt);
-			i--;
+			/* the removal reorders the heap: scan it again */
+			i = -1;
 		}
 	}
 	osip_ixt_unlock(osip);
@@ -323,23 +644,26 @@ void ixt_retransmit(osip_t * osip, ixt_t * ixt, struct timeval *current)
 void osip_retransmissions_execute(osip_t * osip)
 {
 	int i;
+	int len;
 	ixt_t *ixt;
+	void **array;
 	struct timeval current;
 
 	osip_gettimeofday(&current, NULL);
 
 	osip_ixt_lock(osip);
-	for (i = 0; !osip_list_eol(&osip->ixt_retransmissions, i); i++) {
-		ixt = (ixt_t *) osip_list_get(&osip->ixt_retransmissions, i);
+	len = __osip_timer_heap_pop_expired(osip->ixt_timers, &current, &array);
+	for (i = 0; i < len; i++) {
+		ixt = (ixt_t *) array[i];
 		ixt_retransmit(osip, ixt, &current);
 		if (ixt->counter == 0) {
-			/* remove it */
-			osip_list_remove(&osip->ixt_retransmissions, i);
+			/* popped from the heap, it is no more referenced */
 			ixt_free(ixt);
-			i--;
-		}
+		} else
+			__osip_timer_heap_set(osip->ixt_timers, &ixt->timer, &ixt->start);
 	}
 	osip_ixt_unlock(osip);
+	osip_free(array);
 }
 
 int osip_ict_lock(osip_t * osip)
@@ -414,175 +738,336 @@ int osip_nist_unlock(osip_t * osip)
 #endif
 }
 
-#if defined(HAVE_DICT_DICT_H)
-#define HSIZE           200
+#define OSIP_INDEX_MIN_SIZE 64
+
+typedef struct osip_index_node osip_index_node_t;
+
+struct osip_index_node {
+	osip_transaction_t *tr;
+	unsigned int key;			/* hash of branch, method and sent-by */
+	int keyed;					/* 0 when only reachable by a list scan */
+	osip_index_node_t *next_key;
+	osip_index_node_t *next_id;
+};
+
+/* Transactions are hashed twice: on their transactionid for outgoing
+   messages and on the top Via for incoming ones. Transactions created
+   by a request without a RFC3261 branch can not be keyed and are
+   counted in "unkeyed" so that lookups know when the list scan is
+   still needed. */
+struct osip_transaction_index {
+	osip_index_node_t **by_key;
+	osip_index_node_t **by_id;
+	unsigned int size;			/* always a power of 2 */
+	unsigned int count;
+	unsigned int unkeyed;
+};
+
+static osip_transaction_index_t *__osip_transaction_index_new(void)
+{
+	osip_transaction_index_t *index;
 
-unsigned s_hash(const unsigned char *p);
+	index =
+		(osip_transaction_index_t *)
+		osip_malloc(sizeof(osip_transaction_index_t));
+	if (index == NULL)
+		return NULL;
+	index->size = OSIP_INDEX_MIN_SIZE;
+	index->count = 0;
+	index->unkeyed = 0;
+	index->by_key =
+		(osip_index_node_t **) osip_malloc(sizeof(osip_index_node_t *) *
+										   index->size);
+	index->by_id =
+		(osip_index_node_t **) osip_malloc(sizeof(osip_index_node_t *) *
+										   index->size);
+	if (index->by_key == NULL || index->by_id == NULL) {
+		osip_free(index->by_key);
+		osip_free(index->by_id);
+		osip_free(index);
+		return NULL;
+	}
+	memset(index->by_key, 0, sizeof(osip_index_node_t *) * index->size);
+	memset(index->by_id, 0, sizeof(osip_index_node_t *) * index->size);
+	return index;
+}
 
-unsigned s_hash(const unsigned char *p)
+static void __osip_transaction_index_free(osip_transaction_index_t * index)
 {
-	unsigned hash = 0;
+	osip_index_node_t *node;
+	osip_index_node_t *next;
+	unsigned int i;
 
-	while (*p) {
-		hash *= 31;
-		hash ^= *p++;
+	if (index == NULL)
+		return;
+	/* transactions are owned by the application: only free the nodes */
+	for (i = 0; i < index->size; i++) {
+		for (node = index->by_id[i]; node != NULL; node = next) {
+			next = node->next_id;
+			osip_free(node);
+		}
 	}
+	osip_free(index->by_key);
+	osip_free(index->by_id);
+	osip_free(index);
+}
+
+static unsigned int __osip_hash_string(unsigned int hash, const char *p)
+{
+	/* FNV-1a, the terminating 0 is hashed to separate fields */
+	do {
+		hash ^= (unsigned char) *p;
+		hash *= 16777619U;
+	} while (*p++ != '\0');
 	return hash;
 }
-#endif
+
+/* Compute the key of a top Via for the transaction matching rules:
+   server transactions (sentby=1) use branch, method and sent-by as
+   described in 17.2.3 and only when the branch has the "z9hG4bK"
+   magic cookie; client transactions (sentby=0) use branch and method
+   as described in 17.1.3. A missing port is hashed as 5060 and ACK is
+   hashed as INVITE so that both match the same entries than
+   __osip_transaction_matching_request_osip_to_xist_17_2_3(). */
+static int
+__osip_transaction_key(osip_via_t * via, const char *method, int sentby,
+					   unsigned int *key)
+{
+	osip_generic_param_t *b_param = NULL;
+	unsigned int hash = 2166136261U;
+
+	if (via == NULL || method == NULL)
+		return OSIP_BADPARAMETER;
+	osip_via_param_get_byname(via, "branch", &b_param);
+	if (b_param == NULL || b_param->gvalue == NULL)
+		return OSIP_UNDEFINED_ERROR;
+	if (0 == strcmp(method, "ACK"))
+		method = "INVITE";
+
+	hash = __osip_hash_string(hash, b_param->gvalue);
+	hash = __osip_hash_string(hash, method);
+	if (sentby) {
+		char *host = via_get_host(via);
+		char *port = via_get_port(via);
+
+		if (0 != strncmp(b_param->gvalue, "z9hG4bK", 7))
+			return OSIP_UNDEFINED_ERROR;
+		if (host == NULL)
+			return OSIP_UNDEFINED_ERROR;
+		hash = __osip_hash_string(hash, host);
+		hash = __osip_hash_string(hash, port != NULL ? port : "5060");
+	}
+	*key = hash;
+	return OSIP_SUCCESS;
+}
+
+static void __osip_transaction_index_grow(osip_transaction_index_t * index)
+{
+	osip_index_node_t **by_key;
+	osip_index_node_t **by_id;
+	osip_index_node_t *node;
+	osip_index_node_t *next;
+	unsigned int size = index->size * 2;
+	unsigned int i;
+
+	by_key =
+		(osip_index_node_t **) osip_malloc(sizeof(osip_index_node_t *) * size);
+	by_id =
+		(osip_index_node_t **) osip_malloc(sizeof(osip_index_node_t *) * size);
+	if (by_key == NULL || by_id == NULL) {
+		/* keep the current table: lookups are still correct */
+		osip_free(by_key);
+		osip_free(by_id);
+		return;
+	}
+	memset(by_key, 0, sizeof(osip_index_node_t *) * size);
+	memset(by_id, 0, sizeof(osip_index_node_t *) * size);
+
+	for (i = 0; i < index->size; i++) {
+		for (node = index->by_id[i]; node != NULL; node = next) {
+			unsigned int pos;
+
+			next = node->next_id;
+			pos = (unsigned int) node->tr->transactionid & (size - 1);
+			node->next_id = by_id[pos];
+			by_id[pos] = node;
+			if (node->keyed) {
+				pos = node->key & (size - 1);
+				node->next_key = by_key[pos];
+				by_key[pos] = node;
+			}
+		}
+	}
+	osip_free(index->by_key);
+	osip_free(index->by_id);
+	index->by_key = by_key;
+	index->by_id = by_id;
+	index->size = size;
+}
+
+static int
+__osip_transaction_index_add(osip_transaction_index_t * index,
+							 osip_transaction_t * tr, int sentby)
+{
+	osip_index_node_t *node;
+	unsigned int pos;
+
+	node = (osip_index_node_t *) osip_malloc(sizeof(osip_index_node_t));
+	if (node == NULL)
+		return OSIP_NOMEM;
+	node->tr = tr;
+	node->keyed = 0;
+	node->next_key = NULL;
+
+	if (index->count >= index->size)
+		__osip_transaction_index_grow(index);
+
+	if (tr->cseq != NULL
+		&& 0 == __osip_transaction_key(tr->topvia, tr->cseq->method, sentby,
+									   &node->key)) {
+		node->keyed = 1;
+		pos = node->key & (index->size - 1);
+		node->next_key = index->by_key[pos];
+		index->by_key[pos] = node;
+	} else {
+		OSIP_TRACE(osip_trace
+				   (__FILE__, __LINE__, OSIP_INFO2, NULL,
+					"transaction %i is not indexed by branch\n",
+					tr->transactionid));
+		index->unkeyed++;
+	}
+
+	pos = (unsigned int) tr->transactionid & (index->size - 1);
+	node->next_id = index->by_id[pos];
+	index->by_id[pos] = node;
+	index->count++;
+	return OSIP_SUCCESS;
+}
+
+static void
+__osip_transaction_index_remove(osip_transaction_index_t * index,
+								osip_transaction_t * tr)
+{
+	osip_index_node_t **prev;
+	osip_index_node_t *node;
+
+	prev = &index->by_id[(unsigned int) tr->transactionid & (index->size - 1)];
+	for (node = *prev; node != NULL; node = *prev) {
+		if (node->tr == tr)
+			break;
+		prev = &node->next_id;
+	}
+	if (node == NULL)
+		return;
+	*prev = node->next_id;
+
+	if (node->keyed) {
+		prev = &index->by_key[node->key & (index->size - 1)];
+		while (*prev != node)
+			prev = &(*prev)->next_key;
+		*prev = node->next_key;
+	} else
+		index->unkeyed--;
+
+	index->count--;
+	osip_free(node);
+}
+
+static osip_transaction_t *__osip_transaction_index_find_id(osip_transaction_index_t
+															* index, int id)
+{
+	osip_index_node_t *node;
+
+	for (node = index->by_id[(unsigned int) id & (index->size - 1)];
+		 node != NULL; node = node->next_id) {
+		if (node->tr->transactionid == id)
+			return node->tr;
+	}
+	return NULL;
+}
 
 int __osip_add_ict(osip_t * osip, osip_transaction_t * ict)
 {
+	int i;
+
 #ifdef OSIP_MT
 	osip_mutex_lock(ict_fastmutex);
 #endif
-#if defined(HAVE_DICT_DICT_H)
-	{
-		osip_generic_param_t *b_request = NULL;
-		int rv = -99;
-
-		osip_via_param_get_byname(ict->topvia, "branch", &b_request);
-		if (b_request != NULL && b_request->gvalue != NULL)
-			rv = dict_insert(osip->osip_ict_hastable,
-							 b_request->gvalue, (void *) ict, FALSE);
-#if 0
+	i = __osip_transaction_index_add(osip->osip_ict_index, ict, 0);
+	if (i == 0) {
+		i = __osip_transaction_start_timer(ict);
+		if (i != 0)
+			__osip_transaction_index_remove(osip->osip_ict_index, ict);
 		else
-			rv = dict_insert(osip->osip_ict_hastable,
-							 b_request->gvalue, (void *) ict, FALSE);
-#endif
-
-		if (rv == 0) {
-			OSIP_TRACE(osip_trace
-					   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-						"New key inserted in ict hastable `%s'\n",
-						b_request->gvalue));
-		} else if (rv != -99) {
-			OSIP_TRACE(osip_trace
-					   (__FILE__, __LINE__, OSIP_WARNING, NULL,
-						"already inserted `%s'\n", b_request->gvalue));
-		}
+			osip_list_add(&osip->osip_ict_transactions, ict, -1);
 	}
-#endif
-	osip_list_add(&osip->osip_ict_transactions, ict, -1);
 #ifdef OSIP_MT
 	osip_mutex_unlock(ict_fastmutex);
 #endif
-	return OSIP_SUCCESS;
+	return i;
 }
 
 int __osip_add_ist(osip_t * osip, osip_transaction_t * ist)
 {
+	int i;
+
 #ifdef OSIP_MT
 	osip_mutex_lock(ist_fastmutex);
 #endif
-#if defined(HAVE_DICT_DICT_H)
-	{
-		osip_generic_param_t *b_request = NULL;
-		int rv = -99;
-
-		osip_via_param_get_byname(ist->topvia, "branch", &b_request);
-		if (b_request != NULL && b_request->gvalue != NULL)
-			rv = dict_insert(osip->osip_ist_hastable,
-							 b_request->gvalue, (void *) ist, FALSE);
+	i = __osip_transaction_index_add(osip->osip_ist_index, ist, 1);
+	if (i == 0) {
+		i = __osip_transaction_start_timer(ist);
+		if (i != 0)
+			__osip_transaction_index_remove(osip->osip_ist_index, ist);
 		else
-#if 0
-			rv = dict_insert(osip->osip_ist_hastable,
-							 b_request->gvalue, (void *) ist, FALSE);
-#endif
-		if (rv == 0) {
-			OSIP_TRACE(osip_trace
-					   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-						"New key inserted in ist hastable `%s'\n",
-						b_request->gvalue));
-		} else if (rv != -99) {
-			OSIP_TRACE(osip_trace
-					   (__FILE__, __LINE__, OSIP_WARNING, NULL,
-						"already inserted `%s'\n", b_request->gvalue));
-		}
+			osip_list_add(&osip->osip_ist_transactions, ist, -1);
 	}
-#endif
-	osip_list_add(&osip->osip_ist_transactions, ist, -1);
 #ifdef OSIP_MT
 	osip_mutex_unlock(ist_fastmutex);
 #endif
-	return OSIP_SUCCESS;
+	return i;
 }
 
 int __osip_add_nict(osip_t * osip, osip_transaction_t * nict)
 {
+	int i;
+
 #ifdef OSIP_MT
 	osip_mutex_lock(nict_fastmutex);
 #endif
-#if defined(HAVE_DICT_DICT_H)
-	{
-		osip_generic_param_t *b_request = NULL;
-		int rv = -99;
-
-		osip_via_param_get_byname(nict->topvia, "branch", &b_request);
-		if (b_request != NULL && b_request->gvalue != NULL)
-			rv = dict_insert(osip->osip_nict_hastable,
-							 b_request->gvalue, (void *) nict, FALSE);
-#if 0
+	i = __osip_transaction_index_add(osip->osip_nict_index, nict, 0);
+	if (i == 0) {
+		i = __osip_transaction_start_timer(nict);
+		if (i != 0)
+			__osip_transaction_index_remove(osip->osip_nict_index, nict);
 		else
-			rv = dict_insert(osip->osip_nict_hastable,
-							 b_request->gvalue, (void *) nict, FALSE);
-#endif
-
-		if (rv == 0) {
-			OSIP_TRACE(osip_trace
-					   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-						"New key inserted in nict hastable `%s'\n",
-						b_request->gvalue));
-		} else if (rv != -99) {
-			OSIP_TRACE(osip_trace
-					   (__FILE__, __LINE__, OSIP_WARNING, NULL,
-						"already inserted `%s'\n", b_request->gvalue));
-		}
+			osip_list_add(&osip->osip_nict_transactions, nict, -1);
 	}
-#endif
-	osip_list_add(&osip->osip_nict_transactions, nict, -1);
 #ifdef OSIP_MT
 	osip_mutex_unlock(nict_fastmutex);
 #endif
-	return OSIP_SUCCESS;
+	return i;
 }
 
 int __osip_add_nist(osip_t * osip, osip_transaction_t * nist)
 {
+	int i;
+
 #ifdef OSIP_MT
 	osip_mutex_lock(nist_fastmutex);
 #endif
-#if defined(HAVE_DICT_DICT_H)
-	{
-		osip_generic_param_t *b_request = NULL;
-		int rv = -99;
-
-		osip_via_param_get_byname(nist->topvia, "branch", &b_request);
-		if (b_request != NULL && b_request->gvalue != NULL)
-			rv = dict_insert(osip->osip_nist_hastable,
-							 b_request->gvalue, (void *) nist, FALSE);
-#if 0
+	i = __osip_transaction_index_add(osip->osip_nist_index, nist, 1);
+	if (i == 0) {
+		i = __osip_transaction_start_timer(nist);
+		if (i != 0)
+			__osip_transaction_index_remove(osip->osip_nist_index, nist);
 		else
-			rv = dict_insert(osip->osip_nist_hastable,
-							 b_request->gvalue, (void *) nist, FALSE);
-#endif
-		if (rv == 0) {
-			OSIP_TRACE(osip_trace
-					   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-						"New key inserted in ict hastable `%s'\n",
-						b_request->gvalue));
-		} else if (rv != -99) {
-			OSIP_TRACE(osip_trace
-					   (__FILE__, __LINE__, OSIP_WARNING, NULL,
-						"already inserted `%s'\n", b_request->gvalue));
-		}
+			osip_list_add(&osip->osip_nist_transactions, nist, -1);
 	}
-#endif
-	osip_list_add(&osip->osip_nist_transactions, nist, -1);
 #ifdef OSIP_MT
 	osip_mutex_unlock(nist_fastmutex);
 #endif
-	return OSIP_SUCCESS;
+	return i;
 }
 
 int osip_remove_transaction(osip_t * osip, osip_transaction_t * tr)
@@ -613,27 +1098,8 @@ int __osip_remove_ict_transaction(osip_t * osip, osip_transaction_t * ict)
 	osip_mutex_lock(ict_fastmutex);
 #endif
 
-#if defined(HAVE_DICT_DICT_H)
-	{
-		osip_generic_param_t *b_request = NULL;
-		int rv;
-
-		osip_via_param_get_byname(ict->topvia, "branch", &b_request);
-		if (b_request != NULL && b_request->gvalue != NULL) {
-			rv = dict_remove(osip->osip_ict_hastable, b_request->gvalue, TRUE);
-			if (rv == 0) {
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-							"New key deleted in ict hastable `%s'\n",
-							b_request->gvalue));
-			} else {
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_WARNING, NULL,
-							"key not removed `%s'\n", b_request->gvalue));
-			}
-		}
-	}
-#endif
+	__osip_transaction_index_remove(osip->osip_ict_index, ict);
+	__osip_transaction_stop_timer(ict);
 
 	tmp =
 		(osip_transaction_t *) osip_list_get_first(&osip->osip_ict_transactions,
@@ -663,28 +1129,8 @@ int __osip_remove_ist_transaction(osip_t * osip, osip_transaction_t * ist)
 	osip_mutex_lock(ist_fastmutex);
 #endif
 
-#if defined(HAVE_DICT_DICT_H)
-	{
-		osip_generic_param_t *b_request = NULL;
-		int rv;
-
-		osip_via_param_get_byname(ist->topvia, "branch", &b_request);
-		if (b_request != NULL && b_request->gvalue != NULL) {
-			rv = dict_remove(osip->osip_ist_hastable, b_request->gvalue, TRUE);
-
-			if (rv == 0) {
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-							"New key deleted in ist hastable `%s'\n",
-							b_request->gvalue));
-			} else {
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_WARNING, NULL,
-							"key not removed `%s'\n", b_request->gvalue));
-			}
-		}
-	}
-#endif
+	__osip_transaction_index_remove(osip->osip_ist_index, ist);
+	__osip_transaction_stop_timer(ist);
 
 	tmp =
 		(osip_transaction_t *) osip_list_get_first(&osip->osip_ist_transactions,
@@ -714,28 +1160,8 @@ int __osip_remove_nict_transaction(osip_t * osip, osip_transaction_t * nict)
 	osip_mutex_lock(nict_fastmutex);
 #endif
 
-#if defined(HAVE_DICT_DICT_H)
-	{
-		osip_generic_param_t *b_request = NULL;
-		int rv;
-
-		osip_via_param_get_byname(nict->topvia, "branch", &b_request);
-		if (b_request != NULL && b_request->gvalue != NULL) {
-			rv = dict_remove(osip->osip_nict_hastable, b_request->gvalue, TRUE);
-
-			if (rv == 0) {
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-							"New key deleted in nict hastable `%s'\n",
-							b_request->gvalue));
-			} else {
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_WARNING, NULL,
-							"key not removed `%s'\n", b_request->gvalue));
-			}
-		}
-	}
-#endif
+	__osip_transaction_index_remove(osip->osip_nict_index, nict);
+	__osip_transaction_stop_timer(nict);
 
 	tmp =
 		(osip_transaction_t *) osip_list_get_first(&osip->osip_nict_transactions,
@@ -765,28 +1191,8 @@ int __osip_remove_nist_transaction(osip_t * osip, osip_transaction_t * nist)
 	osip_mutex_lock(nist_fastmutex);
 #endif
 
-#if defined(HAVE_DICT_DICT_H)
-	{
-		osip_generic_param_t *b_request = NULL;
-		int rv;
-
-		osip_via_param_get_byname(nist->topvia, "branch", &b_request);
-		if (b_request != NULL && b_request->gvalue != NULL) {
-			rv = dict_remove(osip->osip_nist_hastable, b_request->gvalue, TRUE);
-
-			if (rv == 0) {
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_INFO1, NULL,
-							"New key deleted in ict hastable `%s'\n",
-							b_request->gvalue));
-			} else {
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_WARNING, NULL,
-							"key not removed `%s'\n", b_request->gvalue));
-			}
-		}
-	}
-#endif
+	__osip_transaction_index_remove(osip->osip_nist_index, nist);
+	__osip_transaction_stop_timer(nist);
 
 	tmp =
 		(osip_transaction_t *) osip_list_get_first(&osip->osip_nist_transactions,
@@ -970,11 +1376,27 @@ osip_transaction_t *osip_create_transaction(osip_t * osip, osip_event_t * evt)
 	return transaction;
 }
 
+static osip_transaction_index_t *__osip_transaction_index_of(osip_t * osip,
+															 osip_list_t *
+															 transactions)
+{
+	if (transactions == &osip->osip_ict_transactions)
+		return osip->osip_ict_index;
+	if (transactions == &osip->osip_ist_transactions)
+		return osip->osip_ist_index;
+	if (transactions == &osip->osip_nict_transactions)
+		return osip->osip_nict_index;
+	if (transactions == &osip->osip_nist_transactions)
+		return osip->osip_nist_index;
+	return NULL;				/* a list owned by the application */
+}
+
 osip_transaction_t *osip_transaction_find(osip_list_t * transactions,
 										  osip_event_t * evt)
 {
 	osip_list_iterator_t iterator;
 	osip_transaction_t *transaction;
+	osip_transaction_index_t *index;
 	osip_t *osip = NULL;
 
 	transaction =
@@ -983,12 +1405,11 @@ osip_transaction_t *osip_transaction_find(osip_list_t * transactions,
 		osip = (osip_t *) transaction->config;
 	if (osip == NULL)
 		return NULL;
+	index = __osip_transaction_index_of(osip, transactions);
 
 	if (EVT_IS_INCOMINGREQ(evt)) {
-#ifdef HAVE_DICT_DICT_H
-		/* search in hastable! */
-		osip_generic_param_t *b_request;
 		osip_via_t *topvia_request;
+		unsigned int key;
 
 		topvia_request = osip_list_get(&evt->sip->vias, 0);
 		if (topvia_request == NULL) {
@@ -997,29 +1418,23 @@ osip_transaction_t *osip_transaction_find(osip_list_t * transactions,
 						"Remote UA is not compliant: missing a Via header!\n"));
 			return NULL;
 		}
-		osip_via_param_get_byname(topvia_request, "branch", &b_request);
-		if (b_request != NULL && b_request->gvalue != NULL) {
-			if (MSG_IS_INVITE(evt->sip) || MSG_IS_ACK(evt->sip)) {
-				transaction =
-					(osip_transaction_t *) dict_search(osip->osip_ist_hastable,
-													   b_request->gvalue);
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_INFO2, NULL,
-							"Find matching Via header for INVITE(ACK) REQUEST!\n"));
-				if (transaction != NULL)
-					return transaction;
-			} else {
-				transaction =
-					(osip_transaction_t *) dict_search(osip->osip_nist_hastable,
-													   b_request->gvalue);
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_INFO2, NULL,
-							"Find matching Via header for NON-INVITE REQUEST!\n"));
-				if (transaction != NULL)
-					return transaction;
+		if (index != NULL
+			&& 0 == __osip_transaction_key(topvia_request,
+										   evt->sip->cseq->method, 1, &key)) {
+			osip_index_node_t *node;
+
+			for (node = index->by_key[key & (index->size - 1)]; node != NULL;
+				 node = node->next_key) {
+				if (node->key == key
+					&& 0 ==
+					__osip_transaction_matching_request_osip_to_xist_17_2_3
+					(node->tr, evt->sip))
+					return node->tr;
 			}
+			/* transactions without a RFC3261 branch may still match */
+			if (index->unkeyed == 0)
+				return NULL;
 		}
-#endif
 
 		transaction =
 			(osip_transaction_t *) osip_list_get_first(transactions, &iterator);
@@ -1031,41 +1446,32 @@ osip_transaction_t *osip_transaction_find(osip_list_t * transactions,
 			transaction = (osip_transaction_t *) osip_list_get_next(&iterator);
 		}
 	} else if (EVT_IS_INCOMINGRESP(evt)) {
-#ifdef HAVE_DICT_DICT_H
-		/* search in hastable! */
-		osip_generic_param_t *b_request;
-		osip_via_t *topvia_request;
+		osip_via_t *topvia_response;
+		unsigned int key;
 
-		topvia_request = osip_list_get(&evt->sip->vias, 0);
-		if (topvia_request == NULL) {
+		topvia_response = osip_list_get(&evt->sip->vias, 0);
+		if (topvia_response == NULL) {
 			OSIP_TRACE(osip_trace
 					   (__FILE__, __LINE__, OSIP_ERROR, NULL,
 						"Remote UA is not compliant: missing a Via header!\n"));
 			return NULL;
 		}
-		osip_via_param_get_byname(topvia_request, "branch", &b_request);
-		if (b_request != NULL && b_request->gvalue != NULL) {
-			if (MSG_IS_RESPONSE_FOR(evt->sip, "INVITE")) {
-				transaction =
-					(osip_transaction_t *) dict_search(osip->osip_ict_hastable,
-													   b_request->gvalue);
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_INFO2, NULL,
-							"Find matching Via header for INVITE ANSWER!\n"));
-				if (transaction != NULL)
-					return transaction;
-			} else {
-				transaction =
-					(osip_transaction_t *) dict_search(osip->osip_nict_hastable,
-													   b_request->gvalue);
-				OSIP_TRACE(osip_trace
-						   (__FILE__, __LINE__, OSIP_INFO2, NULL,
-							"Find matching Via header for NON-INVITE ANSWER!\n"));
-				if (transaction != NULL)
-					return transaction;
+		if (index != NULL
+			&& 0 == __osip_transaction_key(topvia_response,
+										   evt->sip->cseq->method, 0, &key)) {
+			osip_index_node_t *node;
+
+			for (node = index->by_key[key & (index->size - 1)]; node != NULL;
+				 node = node->next_key) {
+				if (node->key == key
+					&& 0 ==
+					__osip_transaction_matching_response_osip_to_xict_17_1_3
+					(node->tr, evt->sip))
+					return node->tr;
 			}
+			if (index->unkeyed == 0)
+				return NULL;
 		}
-#endif
 
 		transaction =
 			(osip_transaction_t *) osip_list_get_first(transactions, &iterator);
@@ -1078,6 +1484,9 @@ osip_transaction_t *osip_transaction_find(osip_list_t * transactions,
 		}
 	} else {					/* handle OUTGOING message */
 		/* THE TRANSACTION ID MUST BE SET */
+		if (index != NULL)
+			return __osip_transaction_index_find_id(index, evt->transactionid);
+
 		transaction =
 			(osip_transaction_t *) osip_list_get_first(transactions, &iterator);
 		while (osip_list_iterator_has_elem(iterator)) {
@@ -1152,31 +1561,41 @@ int osip_init(osip_t ** osip)
 	osip_list_init(&(*osip)->osip_nist_transactions);
 	osip_list_init(&(*osip)->ixt_retransmissions);
 
-#if defined(HAVE_DICT_DICT_H)
-	(*osip)->osip_ict_hastable = hashtable_dict_new((dict_cmp_func) strcmp,
-													(dict_hsh_func) s_hash,
-													NULL, NULL, HSIZE);
-	(*osip)->osip_ist_hastable = hashtable_dict_new((dict_cmp_func) strcmp,
-													(dict_hsh_func) s_hash,
-													NULL, NULL, HSIZE);
-	(*osip)->osip_nict_hastable = hashtable_dict_new((dict_cmp_func) strcmp,
-													 (dict_hsh_func) s_hash,
-													 NULL, NULL, HSIZE);
-	(*osip)->osip_nist_hastable = hashtable_dict_new((dict_cmp_func) strcmp,
-													 (dict_hsh_func) s_hash,
-													 NULL, NULL, HSIZE);
-#elif defined(HAVE_DICT_DICT_H_HASHTABLE)
-	(*osip)->osip_ict_hastable = rb_tree_new((dict_cmp_func) strcmp, NULL, NULL);
-	(*osip)->osip_ist_hastable = rb_tree_new((dict_cmp_func) strcmp, NULL, NULL);
-	(*osip)->osip_nict_hastable = rb_tree_new((dict_cmp_func) strcmp, NULL, NULL);
-	(*osip)->osip_nist_hastable = rb_tree_new((dict_cmp_func) strcmp, NULL, NULL);
-#endif
+	(*osip)->osip_ict_index = __osip_transaction_index_new();
+	(*osip)->osip_ist_index = __osip_transaction_index_new();
+	(*osip)->osip_nict_index = __osip_transaction_index_new();
+	(*osip)->osip_nist_index = __osip_transaction_index_new();
+	(*osip)->osip_ict_timers = __osip_timer_heap_new();
+	(*osip)->osip_ist_timers = __osip_timer_heap_new();
+	(*osip)->osip_nict_timers = __osip_timer_heap_new();
+	(*osip)->osip_nist_timers = __osip_timer_heap_new();
+	(*osip)->ixt_timers = __osip_timer_heap_new();
+	if ((*osip)->osip_ict_index == NULL || (*osip)->osip_ist_index == NULL
+		|| (*osip)->osip_nict_index == NULL
+		|| (*osip)->osip_nist_index == NULL
+		|| (*osip)->osip_ict_timers == NULL
+		|| (*osip)->osip_ist_timers == NULL
+		|| (*osip)->osip_nict_timers == NULL
+		|| (*osip)->osip_nist_timers == NULL || (*osip)->ixt_timers == NULL) {
+		osip_release(*osip);
+		*osip = NULL;
+		return OSIP_NOMEM;
+	}
 
 	return OSIP_SUCCESS;
 }
 
 void osip_release(osip_t * osip)
 {
+	__osip_transaction_index_free(osip->osip_ict_index);
+	__osip_transaction_index_free(osip->osip_ist_index);
+	__osip_transaction_index_free(osip->osip_nict_index);
+	__osip_transaction_index_free(osip->osip_nist_index);
+	__osip_timer_heap_free(osip->osip_ict_timers);
+	__osip_timer_heap_free(osip->osip_ist_timers);
+	__osip_timer_heap_free(osip->osip_nict_timers);
+	__osip_timer_heap_free(osip->osip_nist_timers);
+	__osip_timer_heap_free(osip->ixt_timers);
 	osip_free(osip);
 	decrease_ref_count();
 }
@@ -1426,153 +1845,39 @@ int osip_nist_execute(osip_t * osip)
 void osip_timers_gettimeout(osip_t * osip, struct timeval *lower_tv)
 {
 	struct timeval now;
-	osip_transaction_t *tr;
-	osip_list_iterator_t iterator;
+	osip_timer_heap_t *heaps[4];
+	int i;
 
 	osip_gettimeofday(&now, NULL);
 	lower_tv->tv_sec = now.tv_sec + 3600 * 24 * 365;	/* wake up evry year :-) */
 	lower_tv->tv_usec = now.tv_usec;
 
+	/* the next timeout of each kind of transaction is at the top of its heap */
+	heaps[0] = osip->osip_ict_timers;
+	heaps[1] = osip->osip_ist_timers;
+	heaps[2] = osip->osip_nict_timers;
+	heaps[3] = osip->osip_nist_timers;
 #ifdef OSIP_MT
-	osip_mutex_lock(ict_fastmutex);
-#endif
-	/* handle ict timers */
-	tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_ict_transactions,
-													&iterator);
-	while (osip_list_iterator_has_elem(iterator)) {
-		if (1 <= osip_fifo_size(tr->transactionff)) {
-			OSIP_TRACE(osip_trace
-					   (__FILE__, __LINE__, OSIP_INFO4, NULL,
-						"1 Pending event already in transaction !\n"));
-			lower_tv->tv_sec = 0;
-			lower_tv->tv_usec = 0;
-#ifdef OSIP_MT
-			osip_mutex_unlock(ict_fastmutex);
-#endif
-			return;
-		} else {
-			if (tr->state == ICT_CALLING)
-				min_timercmp(lower_tv, &tr->ict_context->timer_b_start);
-			if (tr->state == ICT_CALLING)
-				min_timercmp(lower_tv, &tr->ict_context->timer_a_start);
-			if (tr->state == ICT_COMPLETED)
-				min_timercmp(lower_tv, &tr->ict_context->timer_d_start);
-			if (osip_timercmp(&now, lower_tv, >)) {
-				lower_tv->tv_sec = 0;
-				lower_tv->tv_usec = 0;
-#ifdef OSIP_MT
-				osip_mutex_unlock(ict_fastmutex);
-#endif
-				return;
-			}
-		}
-		tr = (osip_transaction_t *) osip_list_get_next(&iterator);
-	}
-#ifdef OSIP_MT
-	osip_mutex_unlock(ict_fastmutex);
-#endif
-
-#ifdef OSIP_MT
-	osip_mutex_lock(ist_fastmutex);
-#endif
-	/* handle ist timers */
-	tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_ist_transactions,
-													&iterator);
-	while (osip_list_iterator_has_elem(iterator)) {
-		if (tr->state == IST_CONFIRMED)
-			min_timercmp(lower_tv, &tr->ist_context->timer_i_start);
-		if (tr->state == IST_COMPLETED)
-			min_timercmp(lower_tv, &tr->ist_context->timer_h_start);
-		if (tr->state == IST_COMPLETED)
-			min_timercmp(lower_tv, &tr->ist_context->timer_g_start);
-		if (osip_timercmp(&now, lower_tv, >)) {
-			lower_tv->tv_sec = 0;
-			lower_tv->tv_usec = 0;
-#ifdef OSIP_MT
-			osip_mutex_unlock(ist_fastmutex);
-#endif
-			return;
-		}
-		tr = (osip_transaction_t *) osip_list_get_next(&iterator);
-	}
-#ifdef OSIP_MT
-	osip_mutex_unlock(ist_fastmutex);
-#endif
-
-#ifdef OSIP_MT
-	osip_mutex_lock(nict_fastmutex);
-#endif
-	/* handle nict timers */
-	tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_nict_transactions,
-													&iterator);
-	while (osip_list_iterator_has_elem(iterator)) {
-		if (tr->state == NICT_COMPLETED)
-			min_timercmp(lower_tv, &tr->nict_context->timer_k_start);
-		if (tr->state == NICT_PROCEEDING || tr->state == NICT_TRYING)
-			min_timercmp(lower_tv, &tr->nict_context->timer_f_start);
-		if (tr->state == NICT_PROCEEDING || tr->state == NICT_TRYING)
-			min_timercmp(lower_tv, &tr->nict_context->timer_e_start);
-		if (osip_timercmp(&now, lower_tv, >)) {
-			lower_tv->tv_sec = 0;
-			lower_tv->tv_usec = 0;
-#ifdef OSIP_MT
-			osip_mutex_unlock(nict_fastmutex);
-#endif
-			return;
-		}
-		tr = (osip_transaction_t *) osip_list_get_next(&iterator);
-	}
-#ifdef OSIP_MT
-	osip_mutex_unlock(nict_fastmutex);
-#endif
-
-#ifdef OSIP_MT
-	osip_mutex_lock(nist_fastmutex);
-#endif
-	/* handle nist timers */
-	tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_nist_transactions,
-													&iterator);
-	while (osip_list_iterator_has_elem(iterator)) {
-		if (tr->state == NIST_COMPLETED)
-			min_timercmp(lower_tv, &tr->nist_context->timer_j_start);
-		if (osip_timercmp(&now, lower_tv, >)) {
-			lower_tv->tv_sec = 0;
-			lower_tv->tv_usec = 0;
-#ifdef OSIP_MT
-			osip_mutex_unlock(nist_fastmutex);
+	osip_mutex_lock(timers_fastmutex);
 #endif
-			return;
-		}
-		tr = (osip_transaction_t *) osip_list_get_next(&iterator);
+	for (i = 0; i < 4; i++) {
+		if (heaps[i]->len > 0)
+			min_timercmp(lower_tv, &heaps[i]->elts[0]->deadline);
 	}
 #ifdef OSIP_MT
-	osip_mutex_unlock(nist_fastmutex);
-#endif
-
-#ifdef OSIP_MT
-	osip_mutex_lock(ixt_fastmutex);
+	osip_mutex_unlock(timers_fastmutex);
 #endif
-	{
-		ixt_t *ixt;
 
-		ixt = (ixt_t *) osip_list_get_first(&osip->ixt_retransmissions, &iterator);
-		while (osip_list_iterator_has_elem(iterator)) {
-			min_timercmp(lower_tv, &ixt->start);
-			if (osip_timercmp(&now, lower_tv, >)) {
-				lower_tv->tv_sec = 0;
-				lower_tv->tv_usec = 0;
-#ifdef OSIP_MT
-				osip_mutex_unlock(ixt_fastmutex);
-#endif
-				return;
-			}
+	osip_ixt_lock(osip);
+	if (osip->ixt_timers->len > 0)
+		min_timercmp(lower_tv, &osip->ixt_timers->elts[0]->deadline);
+	osip_ixt_unlock(osip);
 
-			ixt = (ixt_t *) osip_list_get_next(&iterator);
-		}
+	if (osip_timercmp(&now, lower_tv, >)) {
+		lower_tv->tv_sec = 0;
+		lower_tv->tv_usec = 0;
+		return;
 	}
-#ifdef OSIP_MT
-	osip_mutex_unlock(ixt_fastmutex);
-#endif
 
 	lower_tv->tv_sec = lower_tv->tv_sec - now.tv_sec;
 	lower_tv->tv_usec = lower_tv->tv_usec - now.tv_usec;
@@ -1596,17 +1901,19 @@ void osip_timers_gettimeout(osip_t * osip, struct timeval *lower_tv)
 void osip_timers_ict_execute(osip_t * osip)
 {
 	osip_transaction_t *tr;
-	osip_list_iterator_t iterator;
+	void **array;
+	int len;
+	int index;
 
 #ifdef OSIP_MT
 	osip_mutex_lock(ict_fastmutex);
 #endif
-	/* handle ict timers */
-	tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_ict_transactions,
-													&iterator);
-	while (osip_list_iterator_has_elem(iterator)) {
+	/* handle expired ict timers */
+	len = __osip_transaction_pop_expired(osip->osip_ict_timers, &array);
+	for (index = 0; index < len; ++index) {
 		osip_event_t *evt;
 
+		tr = (osip_transaction_t *) array[index];
 		if (1 <= osip_fifo_size(tr->transactionff)) {
 			OSIP_TRACE(osip_trace
 					   (__FILE__, __LINE__, OSIP_INFO4, NULL,
@@ -1630,27 +1937,30 @@ void osip_timers_ict_execute(osip_t * osip)
 				}
 			}
 		}
-		tr = (osip_transaction_t *) osip_list_get_next(&iterator);
+		__osip_transaction_update_timer(tr);
 	}
 #ifdef OSIP_MT
 	osip_mutex_unlock(ict_fastmutex);
 #endif
+	osip_free(array);
 }
 
 void osip_timers_ist_execute(osip_t * osip)
 {
 	osip_transaction_t *tr;
-	osip_list_iterator_t iterator;
+	void **array;
+	int len;
+	int index;
 
 #ifdef OSIP_MT
 	osip_mutex_lock(ist_fastmutex);
 #endif
-	/* handle ist timers */
-	tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_ist_transactions,
-													&iterator);
-	while (osip_list_iterator_has_elem(iterator)) {
+	/* handle expired ist timers */
+	len = __osip_transaction_pop_expired(osip->osip_ist_timers, &array);
+	for (index = 0; index < len; ++index) {
 		osip_event_t *evt;
 
+		tr = (osip_transaction_t *) array[index];
 		evt = __osip_ist_need_timer_i_event(tr->ist_context, tr->state,
 											tr->transactionid);
 		if (evt != NULL)
@@ -1667,27 +1977,30 @@ void osip_timers_ist_execute(osip_t * osip)
 					osip_fifo_add(tr->transactionff, evt);
 			}
 		}
-		tr = (osip_transaction_t *) osip_list_get_next(&iterator);
+		__osip_transaction_update_timer(tr);
 	}
 #ifdef OSIP_MT
 	osip_mutex_unlock(ist_fastmutex);
 #endif
+	osip_free(array);
 }
 
 void osip_timers_nict_execute(osip_t * osip)
 {
 	osip_transaction_t *tr;
-	osip_list_iterator_t iterator;
+	void **array;
+	int len;
+	int index;
 
 #ifdef OSIP_MT
 	osip_mutex_lock(nict_fastmutex);
 #endif
-	/* handle nict timers */
-	tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_nict_transactions,
-													&iterator);
-	while (osip_list_iterator_has_elem(iterator)) {
+	/* handle expired nict timers */
+	len = __osip_transaction_pop_expired(osip->osip_nict_timers, &array);
+	for (index = 0; index < len; ++index) {
 		osip_event_t *evt;
 
+		tr = (osip_transaction_t *) array[index];
 		evt = __osip_nict_need_timer_k_event(tr->nict_context, tr->state,
 											 tr->transactionid);
 		if (evt != NULL)
@@ -1705,37 +2018,41 @@ void osip_timers_nict_execute(osip_t * osip)
 					osip_fifo_add(tr->transactionff, evt);
 			}
 		}
-		tr = (osip_transaction_t *) osip_list_get_next(&iterator);
+		__osip_transaction_update_timer(tr);
 	}
 #ifdef OSIP_MT
 	osip_mutex_unlock(nict_fastmutex);
 #endif
+	osip_free(array);
 }
 
 
 void osip_timers_nist_execute(osip_t * osip)
 {
 	osip_transaction_t *tr;
-	osip_list_iterator_t iterator;
+	void **array;
+	int len;
+	int index;
 
 #ifdef OSIP_MT
 	osip_mutex_lock(nist_fastmutex);
 #endif
-	/* handle nist timers */
-	tr = (osip_transaction_t *) osip_list_get_first(&osip->osip_nist_transactions,
-													&iterator);
-	while (osip_list_iterator_has_elem(iterator)) {
+	/* handle expired nist timers */
+	len = __osip_transaction_pop_expired(osip->osip_nist_timers, &array);
+	for (index = 0; index < len; ++index) {
 		osip_event_t *evt;
 
+		tr = (osip_transaction_t *) array[index];
 		evt = __osip_nist_need_timer_j_event(tr->nist_context, tr->state,
 											 tr->transactionid);
 		if (evt != NULL)
 			osip_fifo_add(tr->transactionff, evt);
-		tr = (osip_transaction_t *) osip_list_get_next(&iterator);
+		__osip_transaction_update_timer(tr);
 	}
 #ifdef OSIP_MT
 	osip_mutex_unlock(nist_fastmutex);
 #endif
+	osip_free(array);
 }
 
 void
@@ -149,6 +149,7 @@ osip_transaction_init(osip_transaction_t ** transaction,
 	memset(*transaction, 0, sizeof(osip_transaction_t));
 
 	(*transaction)->birth_time = now;
+	(*transaction)->timer.pos = -1;
 
 	osip_id_mutex_lock(osip);
 	(*transaction)->transactionid = transactionid;
@@ -223,7 +224,12 @@ osip_transaction_init(osip_transaction_t ** transaction,
 			*transaction = NULL;
 			return i;
 		}
-		__osip_add_ict(osip, *transaction);
+		i = __osip_add_ict(osip, *transaction);
+		if (i != 0) {
+			osip_transaction_free(*transaction);
+			*transaction = NULL;
+			return i;
+		}
 	} else if (ctx_type == IST) {
 		(*transaction)->state = IST_PRE_PROCEEDING;
 		i = __osip_ist_init(&((*transaction)->ist_context), osip, request);
@@ -232,7 +238,12 @@ osip_transaction_init(osip_transaction_t ** transaction,
 			*transaction = NULL;
 			return i;
 		}
-		__osip_add_ist(osip, *transaction);
+		i = __osip_add_ist(osip, *transaction);
+		if (i != 0) {
+			osip_transaction_free(*transaction);
+			*transaction = NULL;
+			return i;
+		}
 	} else if (ctx_type == NICT) {
 		(*transaction)->state = NICT_PRE_TRYING;
 		i = __osip_nict_init(&((*transaction)->nict_context), osip, request);
@@ -241,7 +252,12 @@ osip_transaction_init(osip_transaction_t ** transaction,
 			*transaction = NULL;
 			return i;
 		}
-		__osip_add_nict(osip, *transaction);
+		i = __osip_add_nict(osip, *transaction);
+		if (i != 0) {
+			osip_transaction_free(*transaction);
+			*transaction = NULL;
+			return i;
+		}
 	} else {
 		(*transaction)->state = NIST_PRE_TRYING;
 		i = __osip_nist_init(&((*transaction)->nist_context), osip, request);
@@ -250,7 +266,12 @@ osip_transaction_init(osip_transaction_t ** transaction,
 			*transaction = NULL;
 			return i;
 		}
-		__osip_add_nist(osip, *transaction);
+		i = __osip_add_nist(osip, *transaction);
+		if (i != 0) {
+			osip_transaction_free(*transaction);
+			*transaction = NULL;
+			return i;
+		}
 	}
 	return OSIP_SUCCESS;
 }
@@ -347,6 +368,8 @@ osip_transaction_add_event(osip_transaction_t * transaction, osip_event_t * evt)
 		return OSIP_BADPARAMETER;
 	evt->transactionid = transaction->transactionid;
 	osip_fifo_add(transaction->transactionff, evt);
+	/* an ict with pending events must be executed without delay */
+	__osip_transaction_update_timer(transaction);
 	return OSIP_SUCCESS;
 }
 
@@ -414,6 +437,8 @@ int osip_transaction_execute(osip_transaction_t * transaction, osip_event_t * ev
 					"sipevent evt: method called!\n"));
 	}
 	osip_free(evt);				/* this is the ONLY place for freeing event!! */
+	/* state and timers may have changed */
+	__osip_transaction_update_timer(transaction);
 	return 1;
 }
 
@@ -317,6 +317,15 @@ extern "C" {
  * @param nist The transaction to add.
  */
 	int __osip_remove_nist_transaction(osip_t * osip, osip_transaction_t * nist);
+/**
+ * Schedule the next timer of a transaction in the timers of osip_t.
+ * Must be called each time the state or the timers of the transaction
+ * might have changed.
+ * NOTE: THIS IS AN INTERNAL METHOD ONLY
+ * @param tr The transaction to schedule.
+ * @return OSIP_SUCCESS, or OSIP_NOMEM if the timer cannot be scheduled.
+ */
+	int __osip_transaction_update_timer(osip_transaction_t * tr);
 
 /**
  * Allocate a sipevent.
@@ -940,6 +940,514 @@ osip_message_parse_sipfrag(osip_message_t * sip, const char *buf, size_t length)
 }
 
 
+/* Read-only view of a message: the buffer is indexed in a single pass
+   and nothing is copied until a header is explicitly requested. */
+
+static const char *const view_compact_forms[][2] = {
+	{"v", "via"},
+	{"f", "from"},
+	{"t", "to"},
+	{"i", "call-id"},
+	{"l", "content-length"},
+	{"c", "content-type"},
+	{"m", "contact"},
+	{"e", "content-encoding"},
+	{"k", "supported"},
+	{"s", "subject"},
+	{NULL, NULL}
+};
+
+#define VIEW_IS_LWS(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+
+static void __osip_message_view_reset(osip_message_view_t * view)
+{
+	osip_list_special_free(&view->vias, (void (*)(void *)) &osip_via_free);
+	osip_from_free(view->from);
+	osip_to_free(view->to);
+	osip_call_id_free(view->call_id);
+	osip_cseq_free(view->cseq);
+	view->from = NULL;
+	view->to = NULL;
+	view->call_id = NULL;
+	view->cseq = NULL;
+	view->via_header = 0;
+	view->via_offset = 0;
+
+	view->buf = NULL;
+	view->length = 0;
+	view->sip_method = NULL;
+	view->sip_method_len = 0;
+	view->status_code = 0;
+	view->body = NULL;
+	view->body_len = 0;
+	view->nb_headers = 0;
+}
+
+void osip_message_view_init(osip_message_view_t * view)
+{
+	if (view == NULL)
+		return;
+	memset(view, 0, sizeof(osip_message_view_t));
+	osip_list_init(&view->vias);
+	view->headers = view->static_headers;
+	view->max_headers = OSIP_MESSAGE_VIEW_HEADERS;
+}
+
+void osip_message_view_free(osip_message_view_t * view)
+{
+	if (view == NULL)
+		return;
+	__osip_message_view_reset(view);
+	if (view->headers != view->static_headers)
+		osip_free(view->headers);
+	view->headers = view->static_headers;
+	view->max_headers = OSIP_MESSAGE_VIEW_HEADERS;
+}
+
+/* return the end of the header starting at p, folded lines included */
+static const char *__osip_message_view_header_end(const char *p,
+												  const char *end)
+{
+	const char *next;
+
+	for (;;) {
+		while (p < end && *p != '\r' && *p != '\n')
+			p++;
+		next = p;
+		if (next < end && *next == '\r')
+			next++;
+		if (next < end && *next == '\n')
+			next++;
+		if (next == p || next >= end || (*next != ' ' && *next != '\t'))
+			return p;
+		p = next;
+	}
+}
+
+/* skip the CRLF, CR or LF found at p */
+static const char *__osip_message_view_next_line(const char *p,
+												 const char *end)
+{
+	if (p < end && *p == '\r')
+		p++;
+	if (p < end && *p == '\n')
+		p++;
+	return p;
+}
+
+static int
+__osip_message_view_add_header(osip_message_view_t * view,
+							   const char *hname, size_t hname_len,
+							   const char *hvalue, size_t hvalue_len)
+{
+	osip_message_view_header_t *header;
+
+	if (view->nb_headers == view->max_headers) {
+		int max_headers = view->max_headers * 2;
+
+		if (view->headers == view->static_headers) {
+			header = (osip_message_view_header_t *)
+				osip_malloc(max_headers * sizeof(osip_message_view_header_t));
+			if (header != NULL)
+				memcpy(header, view->headers,
+					   view->nb_headers * sizeof(osip_message_view_header_t));
+		} else
+			header = (osip_message_view_header_t *)
+				osip_realloc(view->headers,
+							 max_headers * sizeof(osip_message_view_header_t));
+		if (header == NULL)
+			return OSIP_NOMEM;
+		view->headers = header;
+		view->max_headers = max_headers;
+	}
+
+	header = &view->headers[view->nb_headers];
+	header->hname = hname;
+	header->hname_len = hname_len;
+	header->hvalue = hvalue;
+	header->hvalue_len = hvalue_len;
+	view->nb_headers++;
+	return OSIP_SUCCESS;
+}
+
+static int
+__osip_message_view_startline(osip_message_view_t * view, const char *buf,
+							  const char *end_of_line)
+{
+	const char *sp;
+
+	sp = memchr(buf, ' ', end_of_line - buf);
+	if (sp == NULL || sp == buf)
+		return OSIP_SYNTAXERROR;
+
+	if (sp - buf > 4 && 0 == strncmp(buf, "SIP/", 4)) {
+		if (end_of_line - sp < 4
+			|| sp[1] < '0' || sp[1] > '9'
+			|| sp[2] < '0' || sp[2] > '9' || sp[3] < '0' || sp[3] > '9')
+			return OSIP_SYNTAXERROR;
+		view->status_code =
+			(sp[1] - '0') * 100 + (sp[2] - '0') * 10 + (sp[3] - '0');
+		return OSIP_SUCCESS;
+	}
+
+	/* Request-Line = Method SP Request-URI SP SIP-Version */
+	if (memchr(sp + 1, ' ', end_of_line - sp - 1) == NULL)
+		return OSIP_SYNTAXERROR;
+	view->sip_method = buf;
+	view->sip_method_len = sp - buf;
+	return OSIP_SUCCESS;
+}
+
+int
+osip_message_view_parse(osip_message_view_t * view, const char *buf,
+						size_t length)
+{
+	const char *p;
+	const char *end;
+	const char *end_of_header;
+	const char *colon;
+	const char *hname_end;
+	const char *hvalue;
+	const char *hvalue_end;
+	int i;
+
+	if (view == NULL || buf == NULL)
+		return OSIP_BADPARAMETER;
+	__osip_message_view_reset(view);
+	view->buf = buf;
+	view->length = length;
+
+	p = buf;
+	end = buf + length;
+	/* skip initial \r\n */
+	while (p < end && (*p == '\r' || *p == '\n'))
+		p++;
+
+	end_of_header = __osip_message_view_header_end(p, end);
+	i = __osip_message_view_startline(view, p, end_of_header);
+	if (i != 0) {
+		OSIP_TRACE(osip_trace
+				   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+					"Could not parse start line of message.\n"));
+		return i;
+	}
+	p = __osip_message_view_next_line(end_of_header, end);
+
+	while (p < end) {
+		if (*p == '\r' || *p == '\n') {
+			/* empty line: the body follows */
+			p = __osip_message_view_next_line(p, end);
+			if (p < end) {
+				view->body = p;
+				view->body_len = end - p;
+			}
+			return OSIP_SUCCESS;
+		}
+
+		end_of_header = __osip_message_view_header_end(p, end);
+		colon = memchr(p, ':', end_of_header - p);
+		if (colon == NULL) {
+			OSIP_TRACE(osip_trace
+					   (__FILE__, __LINE__, OSIP_ERROR, NULL,
+						"End of header Not found\n"));
+			return OSIP_SYNTAXERROR;
+		}
+		hname_end = colon;
+		while (hname_end > p && VIEW_IS_LWS(hname_end[-1]))
+			hname_end--;
+		if (hname_end == p)
+			return OSIP_SYNTAXERROR;
+
+		hvalue = colon + 1;
+		hvalue_end = end_of_header;
+		while (hvalue < hvalue_end && VIEW_IS_LWS(*hvalue))
+			hvalue++;
+		while (hvalue_end > hvalue && VIEW_IS_LWS(hvalue_end[-1]))
+			hvalue_end--;
+
+		i = __osip_message_view_add_header(view, p, hname_end - p,
+										   hvalue, hvalue_end - hvalue);
+		if (i != 0)
+			return i;
+		p = __osip_message_view_next_line(end_of_header, end);
+	}
+
+	/* no empty line: a message without body */
+	return OSIP_SUCCESS;
+}
+
+static int
+__osip_message_view_match(const osip_message_view_header_t * header,
+						  const char *hname, size_t hname_len, char compact)
+{
+	if (header->hname_len == hname_len
+		&& 0 == osip_strncasecmp(header->hname, hname, hname_len))
+		return 1;
+	if (compact != '\0' && header->hname_len == 1
+		&& (header->hname[0] | 0x20) == compact)
+		return 1;
+	return 0;
+}
+
+/* find the long name and the compact form for a header name */
+static void
+__osip_message_view_names(const char *hname, const char **long_name,
+						  char *compact)
+{
+	int i;
+
+	*long_name = hname;
+	*compact = '\0';
+	for (i = 0; view_compact_forms[i][0] != NULL; i++) {
+		if (hname[0] != '\0' && hname[1] == '\0'
+			&& (hname[0] | 0x20) == view_compact_forms[i][0][0]) {
+			*long_name = view_compact_forms[i][1];
+			*compact = view_compact_forms[i][0][0];
+			return;
+		}
+		if (0 == osip_strcasecmp(hname, view_compact_forms[i][1])) {
+			*compact = view_compact_forms[i][0][0];
+			return;
+		}
+	}
+}
+
+int
+osip_message_view_get_header(const osip_message_view_t * view,
+							 const char *hname, int pos,
+							 const char **hvalue, size_t * hvalue_len)
+{
+	const char *long_name;
+	char compact;
+	size_t len;
+	int i;
+
+	if (view == NULL || hname == NULL || hvalue == NULL || hvalue_len == NULL)
+		return OSIP_BADPARAMETER;
+	*hvalue = NULL;
+	*hvalue_len = 0;
+
+	__osip_message_view_names(hname, &long_name, &compact);
+	len = strlen(long_name);
+	for (i = 0; i < view->nb_headers; i++) {
+		if (!__osip_message_view_match(&view->headers[i], long_name, len,
+									   compact))
+			continue;
+		if (pos == 0) {
+			*hvalue = view->headers[i].hvalue;
+			*hvalue_len = view->headers[i].hvalue_len;
+			return OSIP_SUCCESS;
+		}
+		pos--;
+	}
+	return OSIP_UNDEFINED_ERROR;
+}
+
+/* like the full parser, empty values are ignored */
+static int
+__osip_message_view_get_value(const osip_message_view_t * view,
+							  const char *hname, const char **hvalue,
+							  size_t * hvalue_len)
+{
+	int pos;
+	int i;
+
+	for (pos = 0;; pos++) {
+		i = osip_message_view_get_header(view, hname, pos, hvalue, hvalue_len);
+		if (i != 0 || *hvalue_len > 0)
+			return i;
+	}
+}
+
+/* copy a value into a NUL terminated string, replacing line ends and
+   TAB symbols by SP like osip_util_replace_all_lws() does. The local
+   buffer is used when the value fits in it. */
+static char *__osip_message_view_value(const char *hvalue, size_t len,
+									   char *local, size_t local_size)
+{
+	char *value;
+	size_t i;
+
+	if (len < local_size)
+		value = local;
+	else {
+		value = (char *) osip_malloc(len + 1);
+		if (value == NULL)
+			return NULL;
+	}
+	for (i = 0; i < len; i++) {
+		if (hvalue[i] == '\r' || hvalue[i] == '\n' || hvalue[i] == '\t')
+			value[i] = ' ';
+		else
+			value[i] = hvalue[i];
+	}
+	value[len] = '\0';
+	return value;
+}
+
+/* parse the next comma separated value of the Via headers */
+static int __osip_message_view_next_via(osip_message_view_t * view)
+{
+	const osip_message_view_header_t *header;
+	const char *beg;
+	const char *p;
+	const char *end;
+	char local[256];
+	char *value;
+	osip_via_t *via;
+	int quoted;
+	int i;
+
+	for (;;) {
+		for (; view->via_header < view->nb_headers;
+			 view->via_header++, view->via_offset = 0) {
+			header = &view->headers[view->via_header];
+			if (view->via_offset < header->hvalue_len
+				&& __osip_message_view_match(header, "via", 3, 'v'))
+				break;
+		}
+		if (view->via_header >= view->nb_headers)
+			return OSIP_UNDEFINED_ERROR;
+
+		beg = header->hvalue + view->via_offset;
+		end = header->hvalue + header->hvalue_len;
+		quoted = 0;
+		for (p = beg; p < end; p++) {
+			if (quoted && *p == '\\' && p + 1 < end)
+				p++;
+			else if (*p == '"')
+				quoted = !quoted;
+			else if (*p == ',' && !quoted)
+				break;
+		}
+		view->via_offset = (p - header->hvalue) + 1;
+
+		while (beg < p && VIEW_IS_LWS(*beg))
+			beg++;
+		while (p > beg && VIEW_IS_LWS(p[-1]))
+			p--;
+		if (p > beg)
+			break;
+		/* empty element */
+	}
+
+	value = __osip_message_view_value(beg, p - beg, local, sizeof(local));
+	if (value == NULL)
+		return OSIP_NOMEM;
+	i = osip_via_init(&via);
+	if (i == 0) {
+		i = osip_via_parse(via, value);
+		if (i == 0)
+			i = osip_list_add(&view->vias, via, -1) < 0 ? OSIP_NOMEM : 0;
+		if (i != 0)
+			osip_via_free(via);
+	}
+	if (value != local)
+		osip_free(value);
+	return i;
+}
+
+int
+osip_message_view_get_via(osip_message_view_t * view, int pos,
+						  osip_via_t ** dest)
+{
+	int i;
+
+	if (view == NULL || dest == NULL || pos < 0)
+		return OSIP_BADPARAMETER;
+	*dest = NULL;
+	while (osip_list_size(&view->vias) <= pos) {
+		i = __osip_message_view_next_via(view);
+		if (i != 0)
+			return i;
+	}
+	*dest = (osip_via_t *) osip_list_get(&view->vias, pos);
+	return OSIP_SUCCESS;
+}
+
+/* copy the first value of a header into value, which is local or a
+   buffer to release with osip_free() when it differs from local */
+static int
+__osip_message_view_first_value(const osip_message_view_t * view,
+								const char *hname, char *local,
+								size_t local_size, char **value)
+{
+	const char *hvalue;
+	size_t len;
+	int i;
+
+	i = __osip_message_view_get_value(view, hname, &hvalue, &len);
+	if (i != 0)
+		return i;
+	*value = __osip_message_view_value(hvalue, len, local, local_size);
+	if (*value == NULL)
+		return OSIP_NOMEM;
+	return OSIP_SUCCESS;
+}
+
+/* parse the first value of a header into view->field, once, with the
+   osip_<field>_init/parse/free functions of its type */
+#define VIEW_GET_PARSED(view, hname, field, dest) \
+	do { \
+		char local[256]; \
+		char *value; \
+		int i; \
+		if (view == NULL || dest == NULL) \
+			return OSIP_BADPARAMETER; \
+		*dest = NULL; \
+		if (view->field == NULL) { \
+			i = __osip_message_view_first_value(view, hname, local, \
+												sizeof(local), &value); \
+			if (i != 0) \
+				return i; \
+			i = osip_##field##_init(&view->field); \
+			if (i == 0) { \
+				i = osip_##field##_parse(view->field, value); \
+				if (i != 0) { \
+					osip_##field##_free(view->field); \
+					view->field = NULL; \
+				} \
+			} \
+			if (value != local) \
+				osip_free(value); \
+			if (i != 0) \
+				return i; \
+		} \
+		*dest = view->field; \
+		return OSIP_SUCCESS; \
+	} while (0)
+
+int osip_message_view_get_from(osip_message_view_t * view, osip_from_t ** dest)
+{
+	VIEW_GET_PARSED(view, "from", from, dest);
+}
+
+int osip_message_view_get_to(osip_message_view_t * view, osip_to_t ** dest)
+{
+	VIEW_GET_PARSED(view, "to", to, dest);
+}
+
+int
+osip_message_view_get_call_id(osip_message_view_t * view,
+							  osip_call_id_t ** dest)
+{
+	VIEW_GET_PARSED(view, "call-id", call_id, dest);
+}
+
+int osip_message_view_get_cseq(osip_message_view_t * view, osip_cseq_t ** dest)
+{
+	VIEW_GET_PARSED(view, "cseq", cseq, dest);
+}
+
+int
+osip_message_view_to_message(const osip_message_view_t * view,
+							 osip_message_t * sip)
+{
+	if (view == NULL || view->buf == NULL || sip == NULL)
+		return OSIP_BADPARAMETER;
+	return osip_message_parse(sip, view->buf, view->length);
+}
+
 /* This method just add a received parameter in the Via
    as requested by rfc3261 */
 int
@@ -28,6 +28,8 @@
 
 extern const char *osip_protocol_version;
 
+static int _osip_message_realloc(char **message, char **dest, size_t needed,
+								 size_t * malloc_size);
 static int strcat_simple_header(char **_string, size_t * malloc_size,
 								char **_message, void *ptr_header,
 								char *header_name, size_t size_of_header,
@@ -50,14 +52,14 @@ static int strcat_headers_all_on_one_line(char **_string,
 										  char **next);
 #endif
 
-static int __osip_message_startline_to_strreq(osip_message_t * sip, char **dest)
+static int
+__osip_message_startline_to_strreq(osip_message_t * sip, char **dest,
+								   size_t * malloc_size, char **message)
 {
 	const char *sip_version;
-	char *tmp;
 	char *rquri;
 	int i;
 
-	*dest = NULL;
 	if ((sip == NULL) || (sip->req_uri == NULL) || (sip->sip_method == NULL))
 		return OSIP_BADPARAMETER;
 
@@ -70,33 +72,33 @@ static int __osip_message_startline_to_strreq(osip_message_t * sip, char **dest)
 	else
 		sip_version = sip->sip_version;
 
-	*dest = (char *) osip_malloc(strlen(sip->sip_method)
-								 + strlen(rquri) + strlen(sip_version) + 3);
-	if (*dest == NULL) {
+	i = _osip_message_realloc(message, dest, strlen(sip->sip_method)
+							  + strlen(rquri) + strlen(sip_version) + 4,
+							  malloc_size);
+	if (i != 0) {
 		osip_free(rquri);
-		return OSIP_NOMEM;
+		return i;
 	}
-	tmp = *dest;
 
-	tmp = osip_str_append(tmp, sip->sip_method);
-	*tmp = ' ';
-	tmp++;
-	tmp = osip_str_append(tmp, rquri);
-	*tmp = ' ';
-	tmp++;
-	strcpy(tmp, sip_version);
+	*message = osip_str_append(*message, sip->sip_method);
+	*message = osip_strn_append(*message, " ", 1);
+	*message = osip_str_append(*message, rquri);
+	*message = osip_strn_append(*message, " ", 1);
+	*message = osip_str_append(*message, sip_version);
+	*message = osip_strn_append(*message, CRLF, 2);
 
 	osip_free(rquri);
 	return OSIP_SUCCESS;
 }
 
-static int __osip_message_startline_to_strresp(osip_message_t * sip, char **dest)
+static int
+__osip_message_startline_to_strresp(osip_message_t * sip, char **dest,
+									size_t * malloc_size, char **message)
 {
-	char *tmp;
 	const char *sip_version;
 	char status_code[5];
+	int i;
 
-	*dest = NULL;
 	if ((sip == NULL) || (sip->reason_phrase == NULL)
 		|| (sip->status_code < 100) || (sip->status_code > 699))
 		return OSIP_BADPARAMETER;
@@ -108,31 +110,34 @@ static int __osip_message_startline_to_strresp(osip_message_t * sip, char **dest
 
 	sprintf(status_code, "%u", sip->status_code);
 
-	*dest = (char *) osip_malloc(strlen(sip_version)
-								 + 3 + strlen(sip->reason_phrase) + 4);
-	if (*dest == NULL)
-		return OSIP_NOMEM;
-	tmp = *dest;
-
-	tmp = osip_str_append(tmp, sip_version);
-	*tmp = ' ';
-	tmp++;
+	i = _osip_message_realloc(message, dest, strlen(sip_version)
+							  + 3 + strlen(sip->reason_phrase) + 4,
+							  malloc_size);
+	if (i != 0)
+		return i;
 
-	tmp = osip_strn_append(tmp, status_code, 3);
-	*tmp = ' ';
-	tmp++;
-	strcpy(tmp, sip->reason_phrase);
+	*message = osip_str_append(*message, sip_version);
+	*message = osip_strn_append(*message, " ", 1);
+	*message = osip_strn_append(*message, status_code, 3);
+	*message = osip_strn_append(*message, " ", 1);
+	*message = osip_str_append(*message, sip->reason_phrase);
+	*message = osip_strn_append(*message, CRLF, 2);
 
 	return OSIP_SUCCESS;
 }
 
-static int __osip_message_startline_to_str(osip_message_t * sip, char **dest)
+/* the start line is written directly into the message buffer */
+static int
+__osip_message_startline_to_str(osip_message_t * sip, char **dest,
+								size_t * malloc_size, char **message)
 {
 
 	if (sip->sip_method != NULL)
-		return __osip_message_startline_to_strreq(sip, dest);
+		return __osip_message_startline_to_strreq(sip, dest, malloc_size,
+												  message);
 	if (sip->status_code != 0)
-		return __osip_message_startline_to_strresp(sip, dest);
+		return __osip_message_startline_to_strresp(sip, dest, malloc_size,
+												   message);
 
 	OSIP_TRACE(osip_trace
 			   (__FILE__, __LINE__, TRACE_LEVEL1, NULL,
@@ -181,19 +186,11 @@ strcat_simple_header(char **_string, size_t * malloc_size,
 	message = *_message;
 
 	if (ptr_header != NULL) {
-		if (*malloc_size < message - string + 100 + size_of_header)
-			/* take some memory avoid to osip_realloc too much often */
-		{						/* should not happen often */
-			size_t size = message - string;
-
-			*malloc_size = message - string + size_of_header + 100;
-			string = osip_realloc(string, *malloc_size);
-			if (string == NULL) {
-				*_string = NULL;
-				*_message = NULL;
-				return OSIP_NOMEM;
-			}
-			message = string + size;
+		if (_osip_message_realloc(&message, &string, size_of_header,
+								  malloc_size) != 0) {
+			*_string = NULL;
+			*_message = NULL;
+			return OSIP_NOMEM;
 		}
 		message = osip_strn_append(message, header_name, size_of_header);
 
@@ -204,17 +201,12 @@ strcat_simple_header(char **_string, size_t * malloc_size,
 			*next = NULL;
 			return i;
 		}
-		if (*malloc_size < message - string + strlen(tmp) + 100) {
-			size_t size = message - string;
-
-			*malloc_size = message - string + strlen(tmp) + 100;
-			string = osip_realloc(string, *malloc_size);
-			if (string == NULL) {
-				*_string = NULL;
-				*_message = NULL;
-				return OSIP_NOMEM;
-			}
-			message = string + size;
+		if (_osip_message_realloc(&message, &string, strlen(tmp) + 2,
+								  malloc_size) != 0) {
+			osip_free(tmp);
+			*_string = NULL;
+			*_message = NULL;
+			return OSIP_NOMEM;
 		}
 
 		message = osip_str_append(message, tmp);
@@ -247,19 +239,11 @@ strcat_headers_one_per_line(char **_string, size_t * malloc_size,
 
 		elt = (void *) osip_list_get(headers, pos);
 
-		if (*malloc_size < message - string + 100 + size_of_header)
-			/* take some memory avoid to osip_realloc too much often */
-		{						/* should not happen often */
-			size_t size = message - string;
-
-			*malloc_size = message - string + size_of_header + 100;
-			string = osip_realloc(string, *malloc_size);
-			if (string == NULL) {
-				*_string = NULL;
-				*_message = NULL;
-				return OSIP_NOMEM;
-			}
-			message = string + size;
+		if (_osip_message_realloc(&message, &string, size_of_header,
+								  malloc_size) != 0) {
+			*_string = NULL;
+			*_message = NULL;
+			return OSIP_NOMEM;
 		}
 		osip_strncpy(message, header, size_of_header);
 		i = xxx_to_str(elt, &tmp);
@@ -271,17 +255,12 @@ strcat_headers_one_per_line(char **_string, size_t * malloc_size,
 		}
 		message = message + strlen(message);
 
-		if (*malloc_size < message - string + strlen(tmp) + 100) {
-			size_t size = message - string;
-
-			*malloc_size = message - string + strlen(tmp) + 100;
-			string = osip_realloc(string, *malloc_size);
-			if (string == NULL) {
-				*_string = NULL;
-				*_message = NULL;
-				return OSIP_NOMEM;
-			}
-			message = string + size;
+		if (_osip_message_realloc(&message, &string, strlen(tmp) + 2,
+								  malloc_size) != 0) {
+			osip_free(tmp);
+			*_string = NULL;
+			*_message = NULL;
+			return OSIP_NOMEM;
 		}
 		message = osip_str_append(message, tmp);
 		osip_free(tmp);
@@ -394,21 +373,151 @@ _osip_message_realloc(char **message, char **dest, size_t needed,
 					  size_t * malloc_size)
 {
 	size_t size = *message - *dest;
+	char *tmp;
 
 	if (*malloc_size < (size_t) (size + needed + 100)) {
-		*malloc_size = size + needed + 100;
-		*dest = osip_realloc(*dest, *malloc_size);
-		if (*dest == NULL)
+		/* grow by half to avoid a osip_realloc for each header */
+		*malloc_size = *malloc_size + *malloc_size / 2;
+		if (*malloc_size < (size_t) (size + needed + 100))
+			*malloc_size = size + needed + 100;
+		tmp = osip_realloc(*dest, *malloc_size);
+		if (tmp == NULL) {
+			osip_free(*dest);
+			*dest = NULL;
 			return OSIP_NOMEM;
+		}
+		*dest = tmp;
 		*message = *dest + size;
 	}
 
 	return OSIP_SUCCESS;
 }
 
+/* Call-ID and CSeq are written directly into the message buffer */
 static int
-_osip_message_to_str(osip_message_t * sip, char **dest,
-					 size_t * message_length, int sipfrag)
+__osip_call_id_to_buf(void *header, char **dest, size_t * malloc_size,
+					  char **message)
+{
+	osip_call_id_t *callid = (osip_call_id_t *) header;
+	size_t len;
+	int i;
+
+	if (callid == NULL)
+		return OSIP_SUCCESS;
+	if (callid->number == NULL)
+		return OSIP_BADPARAMETER;
+
+	len = strlen(callid->number);
+	if (callid->host != NULL)
+		len += strlen(callid->host) + 1;
+	i = _osip_message_realloc(message, dest, len + 11, malloc_size);
+	if (i != 0)
+		return i;
+
+	*message = osip_strn_append(*message, "Call-ID: ", 9);
+	*message = osip_str_append(*message, callid->number);
+	if (callid->host != NULL) {
+		*message = osip_strn_append(*message, "@", 1);
+		*message = osip_str_append(*message, callid->host);
+	}
+	*message = osip_strn_append(*message, CRLF, 2);
+	return OSIP_SUCCESS;
+}
+
+static int
+__osip_cseq_to_buf(void *header, char **dest, size_t * malloc_size,
+				   char **message)
+{
+	osip_cseq_t *cseq = (osip_cseq_t *) header;
+	int i;
+
+	if (cseq == NULL)
+		return OSIP_SUCCESS;
+	if ((cseq->number == NULL) || (cseq->method == NULL))
+		return OSIP_BADPARAMETER;
+
+	i = _osip_message_realloc(message, dest, strlen(cseq->number)
+							  + strlen(cseq->method) + 9, malloc_size);
+	if (i != 0)
+		return i;
+
+	*message = osip_strn_append(*message, "CSeq: ", 6);
+	*message = osip_str_append(*message, cseq->number);
+	*message = osip_strn_append(*message, " ", 1);
+	*message = osip_str_append(*message, cseq->method);
+	*message = osip_strn_append(*message, CRLF, 2);
+	return OSIP_SUCCESS;
+}
+
+/* same output as osip_header_to_str() followed by CRLF */
+static int
+__osip_header_to_buf(const osip_header_t * header, char **dest,
+					 size_t * malloc_size, char **message)
+{
+	char *start;
+	int i;
+
+	if ((header == NULL) || (header->hname == NULL))
+		return OSIP_BADPARAMETER;
+
+	i = _osip_message_realloc(message, dest, strlen(header->hname)
+							  + (header->hvalue != NULL ?
+								 strlen(header->hvalue) : 0) + 4, malloc_size);
+	if (i != 0)
+		return i;
+
+	start = *message;
+	*message = osip_str_append(*message, header->hname);
+	*message = osip_strn_append(*message, ": ", 2);
+	if (header->hvalue != NULL)
+		*message = osip_str_append(*message, header->hvalue);
+	*message = osip_strn_append(*message, CRLF, 2);
+
+	if (start[0] > 'a' && start[0] < 'z')
+		start[0] = (start[0] - 32);
+	return OSIP_SUCCESS;
+}
+
+/* A buffer large enough for most messages: the length of the previous
+   build when the message is rebuilt, or the usual size plus bodies. */
+static size_t __osip_message_size_hint(const osip_message_t * sip)
+{
+	osip_body_t *body;
+	size_t size;
+	int pos;
+
+	if (sip->message_length > 0)
+		return sip->message_length + 100;
+
+	size = SIP_MESSAGE_MAX_LENGTH;
+	pos = 0;
+	while (!osip_list_eol(&sip->bodies, pos)) {
+		body = (osip_body_t *) osip_list_get(&sip->bodies, pos);
+		size += body->length + 100;
+		pos++;
+	}
+	return size;
+}
+
+/* keep the built message in sip->message until the message is modified */
+static void
+__osip_message_set_cache(osip_message_t * sip, char *buf, size_t length)
+{
+	char *tmp;
+
+	/* give back the unused part of the buffer */
+	tmp = osip_realloc(buf, length + 1);
+	if (tmp != NULL)
+		buf = tmp;
+	buf[length] = '\0';
+
+	sip->message_property = 1;
+	sip->message = buf;
+	sip->message_length = length;
+}
+
+/* build the message in a new buffer kept in sip->message */
+static int _osip_message_build(osip_message_t * sip, int sipfrag)
 {
 	size_t malloc_size;
 	size_t total_length = 0;
@@ -417,6 +526,8 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 	char *start_of_bodies;
 	char *content_length_to_modify = NULL;
 
+	char *buf;
+	char **dest = &buf;
 	char *message;
 	char *next;
 	char *tmp;
@@ -424,49 +535,25 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 	int i;
 	char *boundary = NULL;
 
-	malloc_size = SIP_MESSAGE_MAX_LENGTH;
-
-	*dest = NULL;
-	if (sip == NULL)
-		return OSIP_BADPARAMETER;
-
-	{
-		if (1 == osip_message_get__property(sip)) {	/* message is already available in "message" */
+	/* message should be rebuilt: delete the old one if exists. */
+	osip_free(sip->message);
+	sip->message = NULL;
 
-			*dest = osip_malloc(sip->message_length + 1);
-			if (*dest == NULL)
-				return OSIP_NOMEM;
-			memcpy(*dest, sip->message, sip->message_length);
-			(*dest)[sip->message_length] = '\0';
-			if (message_length != NULL)
-				*message_length = sip->message_length;
-			return OSIP_SUCCESS;
-		} else {
-			/* message should be rebuilt: delete the old one if exists. */
-			osip_free(sip->message);
-			sip->message = NULL;
-		}
-	}
-
-	message = (char *) osip_malloc(SIP_MESSAGE_MAX_LENGTH);	/* ???? message could be > 4000  */
+	malloc_size = __osip_message_size_hint(sip);
+	message = (char *) osip_malloc(malloc_size);
 	if (message == NULL)
 		return OSIP_NOMEM;
 	*dest = message;
 
 	/* add the first line of message */
-	i = __osip_message_startline_to_str(sip, &tmp);
+	i = __osip_message_startline_to_str(sip, dest, &malloc_size, &message);
 	if (i != 0) {
-		if (!sipfrag) {
+		if (!sipfrag || *dest == NULL) {
 			osip_free(*dest);
-			*dest = NULL;
 			return i;
 		}
 
 		/* A start-line isn't required for message/sipfrag parts. */
-	} else {
-		message = osip_str_append(message, tmp);
-		osip_free(tmp);
-		message = osip_strn_append(message, CRLF, 2);
 	}
 
 	{
@@ -476,6 +563,7 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 			osip_list_t *header_list;
 			void *header_data;
 			int (*to_str) (void *, char **);
+			int (*to_buf) (void *, char **, size_t *, char **);
 		}
 #ifndef MINISIZE
 		table[25] =
@@ -542,7 +630,9 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 		table[3].header_data = sip->from;
 		table[4].header_data = sip->to;
 		table[5].header_data = sip->call_id;
+		table[5].to_buf = &__osip_call_id_to_buf;
 		table[6].header_data = sip->cseq;
+		table[6].to_buf = &__osip_cseq_to_buf;
 		table[7].header_list = &sip->contacts;
 		table[8].header_list = &sip->authorizations;
 		table[9].header_list = &sip->www_authenticates;
@@ -565,6 +655,16 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 
 		pos = 0;
 		while (table[pos].header_name[0] != '\0') {
+			if (table[pos].to_buf != NULL) {
+				i = table[pos].to_buf(table[pos].header_data, dest,
+									  &malloc_size, &message);
+				if (i != 0) {
+					osip_free(*dest);
+					return i;
+				}
+				pos++;
+				continue;
+			}
 			if (table[13].header_list == NULL)
 				i = strcat_simple_header(dest, &malloc_size, &message,
 										 table[pos].header_data,
@@ -580,7 +680,6 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 											 table[pos].to_str), &next);
 			if (i != 0) {
 				osip_free(*dest);
-				*dest = NULL;
 				return i;
 			}
 			message = next;
@@ -592,29 +691,14 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 	pos = 0;
 	while (!osip_list_eol(&sip->headers, pos)) {
 		osip_header_t *header;
-		size_t header_len = 0;
 
 		header = (osip_header_t *) osip_list_get(&sip->headers, pos);
-		i = osip_header_to_str(header, &tmp);
+		i = __osip_header_to_buf(header, dest, &malloc_size, &message);
 		if (i != 0) {
 			osip_free(*dest);
-			*dest = NULL;
 			return i;
 		}
 
-		header_len = strlen(tmp);
-
-		if (_osip_message_realloc(&message, dest, header_len + 3, &malloc_size) <
-			0) {
-			osip_free(tmp);
-			*dest = NULL;
-			return OSIP_NOMEM;
-		}
-
-		message = osip_str_append(message, tmp);
-		osip_free(tmp);
-		message = osip_strn_append(message, CRLF, 2);
-
 		pos++;
 	}
 
@@ -629,13 +713,7 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 		osip_strncpy(message, CRLF, 2);
 		message = message + 2;
 
-		/* same remark as at the beginning of the method */
-		sip->message_property = 1;
-		sip->message = osip_strdup(*dest);
-		sip->message_length = message - *dest;
-		if (message_length != NULL)
-			*message_length = message - *dest;
-
+		__osip_message_set_cache(sip, *dest, message - *dest);
 		return OSIP_SUCCESS;	/* it's all done */
 	}
 
@@ -683,13 +761,7 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 	total_length = start_of_bodies - *dest;
 
 	if (osip_list_eol(&sip->bodies, 0)) {
-		/* same remark as at the beginning of the method */
-		sip->message_property = 1;
-		sip->message = osip_strdup(*dest);
-		sip->message_length = total_length;
-		if (message_length != NULL)
-			*message_length = total_length;
-
+		__osip_message_set_cache(sip, *dest, total_length);
 		return OSIP_SUCCESS;	/* it's all done */
 	}
 
@@ -741,13 +813,20 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 			message = osip_strn_append(message, CRLF, 2);
 		}
 
-		i = osip_body_to_str(body, &tmp, &body_length);
-		if (i != 0) {
-			osip_free(*dest);
-			*dest = NULL;
-			if (boundary)
-				osip_free(boundary);
-			return i;
+		if (body->body != NULL && body->headers != NULL && body->length > 0
+			&& body->content_type == NULL && osip_list_size(body->headers) == 0) {
+			/* without part headers, the body is copied as is */
+			tmp = NULL;
+			body_length = body->length;
+		} else {
+			i = osip_body_to_str(body, &tmp, &body_length);
+			if (i != 0) {
+				osip_free(*dest);
+				*dest = NULL;
+				if (boundary)
+					osip_free(boundary);
+				return i;
+			}
 		}
 
 		if (malloc_size < message - *dest + 100 + body_length) {
@@ -773,7 +852,7 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 			message = *dest + size;
 		}
 
-		memcpy(message, tmp, body_length);
+		memcpy(message, tmp != NULL ? tmp : body->body, body_length);
 		message[body_length] = '\0';
 		osip_free(tmp);
 		message = message + body_length;
@@ -809,16 +888,33 @@ _osip_message_to_str(osip_message_t * sip, char **dest,
 		strncpy(content_length_to_modify + 5 - strlen(tmp2), tmp2, strlen(tmp2));
 	}
 
-	/* same remark as at the beginning of the method */
-	sip->message_property = 1;
-	sip->message = osip_malloc(total_length + 1);
-	if (sip->message != NULL) {
-		memcpy(sip->message, *dest, total_length);
-		sip->message[total_length] = '\0';
-		sip->message_length = total_length;
-		if (message_length != NULL)
-			*message_length = total_length;
+	__osip_message_set_cache(sip, *dest, total_length);
+	return OSIP_SUCCESS;
+}
+
+static int
+_osip_message_to_str(osip_message_t * sip, char **dest,
+					 size_t * message_length, int sipfrag)
+{
+	int i;
+
+	*dest = NULL;
+	if (sip == NULL)
+		return OSIP_BADPARAMETER;
+
+	/* the message is rebuilt only if it was modified since last call */
+	if (1 != osip_message_get__property(sip) || sip->message == NULL) {
+		i = _osip_message_build(sip, sipfrag);
+		if (i != 0)
+			return i;
 	}
+
+	*dest = osip_malloc(sip->message_length + 1);
+	if (*dest == NULL)
+		return OSIP_NOMEM;
+	memcpy(*dest, sip->message, sip->message_length + 1);
+	if (message_length != NULL)
+		*message_length = sip->message_length;
 	return OSIP_SUCCESS;
 }
 
@@ -833,3 +929,26 @@ osip_message_to_str_sipfrag(osip_message_t * sip, char **dest,
 {
 	return _osip_message_to_str(sip, dest, message_length, 1);
 }
+
+int
+osip_message_get_buffer(osip_message_t * sip, const char **dest,
+						size_t * message_length)
+{
+	int i;
+
+	if (dest != NULL)
+		*dest = NULL;
+	if (sip == NULL || dest == NULL)
+		return OSIP_BADPARAMETER;
+
+	if (1 != osip_message_get__property(sip) || sip->message == NULL) {
+		i = _osip_message_build(sip, 0);
+		if (i != 0)
+			return i;
+	}
+
+	*dest = sip->message;
+	if (message_length != NULL)
+		*message_length = sip->message_length;
+	return OSIP_SUCCESS;
+}
@@ -0,0 +1,325 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001,2002,2003,2004,2005,2006,2007 Aymeric MOIZARD jack@atosc.org
+  
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+  
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+  
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <osipparser2/osip_parser.h>
+
+/* Compare osip_message_parse() with osip_message_view_parse() followed
+   by the headers needed to match a transaction (top Via, From, To,
+   Call-ID and CSeq) on the messages of the torture directory, then
+   measure how the same messages are built and sent again. */
+
+#define MAX_MESSAGES 128
+
+static unsigned long nb_allocs;
+
+#if !defined(WIN32) && !defined(_WIN32_WCE) && !defined(MINISIZE)
+static void *count_malloc(size_t size)
+{
+	nb_allocs++;
+	return malloc(size);
+}
+
+static void *count_realloc(void *ptr, size_t size)
+{
+	nb_allocs++;
+	return realloc(ptr, size);
+}
+#endif
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: ./tbench torture_dir [iterations]\n");
+	exit(1);
+}
+
+static char *read_message(const char *path, size_t * len)
+{
+	FILE *file;
+	char *msg;
+	char *sep;
+
+	file = fopen(path, "r");
+	if (file == NULL)
+		return NULL;
+	msg = (char *) malloc(100000);	/* msg are under 10000 */
+	if (msg == NULL) {
+		fclose(file);
+		return NULL;
+	}
+	*len = fread(msg, 1, 99999, file);
+	fclose(file);
+	msg[*len] = '\0';
+
+	/* text files may end with a "|" separator line */
+	sep = strstr(msg, "\n|");
+	if (sep != NULL)
+		*len = sep - msg + 1;
+	return msg;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* compare and release two strings built by the *_to_str functions */
+static int same_str(char *tmp1, char *tmp2)
+{
+	int same = (0 == strcmp(tmp1, tmp2));
+
+	osip_free(tmp1);
+	osip_free(tmp2);
+	return same;
+}
+
+static int check_view(osip_message_t * sip, osip_message_view_t * view)
+{
+	osip_via_t *via1;
+	osip_via_t *via2;
+	osip_cseq_t *cseq;
+	osip_call_id_t *call_id;
+	osip_from_t *from;
+	osip_to_t *to;
+	char *tmp1 = NULL;
+	char *tmp2 = NULL;
+	int pos;
+	int i = 0;
+
+	for (pos = 0; i == 0; pos++) {
+		via1 = (osip_via_t *) osip_list_get(&sip->vias, pos);
+		osip_message_view_get_via(view, pos, &via2);
+		if (via1 == NULL || via2 == NULL) {
+			if (via1 != via2)
+				i = -1;
+			break;
+		}
+		if (osip_via_to_str(via1, &tmp1) != 0
+			|| osip_via_to_str(via2, &tmp2) != 0 || !same_str(tmp1, tmp2))
+			i = -1;
+	}
+
+	if (osip_message_view_get_cseq(view, &cseq) != 0
+		|| osip_cseq_to_str(sip->cseq, &tmp1) != 0
+		|| osip_cseq_to_str(cseq, &tmp2) != 0 || !same_str(tmp1, tmp2))
+		i = -1;
+	if (osip_message_view_get_call_id(view, &call_id) != 0
+		|| osip_call_id_to_str(sip->call_id, &tmp1) != 0
+		|| osip_call_id_to_str(call_id, &tmp2) != 0 || !same_str(tmp1, tmp2))
+		i = -1;
+	if (osip_message_view_get_from(view, &from) != 0
+		|| osip_from_to_str(sip->from, &tmp1) != 0
+		|| osip_from_to_str(from, &tmp2) != 0 || !same_str(tmp1, tmp2))
+		i = -1;
+	if (osip_message_view_get_to(view, &to) != 0
+		|| osip_to_to_str(sip->to, &tmp1) != 0
+		|| osip_to_to_str(to, &tmp2) != 0 || !same_str(tmp1, tmp2))
+		i = -1;
+	if (MSG_IS_REQUEST(sip)) {
+		if (view->sip_method == NULL
+			|| strlen(sip->sip_method) != view->sip_method_len
+			|| strncmp(sip->sip_method, view->sip_method, view->sip_method_len))
+			i = -1;
+	} else if (sip->status_code != view->status_code)
+		i = -1;
+	return i;
+}
+
+int main(int argc, char **argv)
+{
+	char *msgs[MAX_MESSAGES];
+	size_t lens[MAX_MESSAGES];
+	char path[1024];
+	osip_message_t *sip;
+	osip_message_t *sips[MAX_MESSAGES];
+	osip_message_view_t view;
+	osip_via_t *via;
+	osip_cseq_t *cseq;
+	osip_call_id_t *call_id;
+	osip_from_t *from;
+	osip_to_t *to;
+	unsigned long allocs;
+	int nb_msgs;
+	int iterations = 1000;
+	int nb_parsed;
+	int errors = 0;
+	double start;
+	double full;
+	double lazy;
+	const char *buf;
+	char *tmp;
+	size_t len;
+	int i, k;
+
+	if (argc < 2)
+		usage();
+	if (argc > 2)
+		iterations = atoi(argv[2]);
+	if (iterations <= 0)
+		usage();
+
+	parser_init();
+
+	for (nb_msgs = 0; nb_msgs < MAX_MESSAGES; nb_msgs++) {
+		snprintf(path, sizeof(path), "%s/sip%i", argv[1], nb_msgs);
+		msgs[nb_msgs] = read_message(path, &lens[nb_msgs]);
+		if (msgs[nb_msgs] == NULL)
+			break;
+	}
+	if (nb_msgs == 0)
+		usage();
+
+	/* messages rejected by the full parser are not measured */
+	osip_message_view_init(&view);
+	for (k = 0; k < nb_msgs; k++) {
+		osip_message_init(&sip);
+		if (osip_message_parse(sip, msgs[k], lens[k]) != 0) {
+			free(msgs[k]);
+			msgs[k] = NULL;
+		} else if (osip_message_view_parse(&view, msgs[k], lens[k]) != 0
+				   || check_view(sip, &view) != 0) {
+			fprintf(stderr, "sip%i: view does not match the message\n", k);
+			errors++;
+		}
+		osip_message_free(sip);
+	}
+
+#if !defined(WIN32) && !defined(_WIN32_WCE) && !defined(MINISIZE)
+	osip_set_allocators(count_malloc, count_realloc, free);
+#endif
+
+	nb_allocs = 0;
+	nb_parsed = 0;
+	start = now();
+	for (i = 0; i < iterations; i++) {
+		for (k = 0; k < nb_msgs; k++) {
+			if (msgs[k] == NULL)
+				continue;
+			osip_message_init(&sip);
+			osip_message_parse(sip, msgs[k], lens[k]);
+			osip_message_free(sip);
+			nb_parsed++;
+		}
+	}
+	full = now() - start;
+	allocs = nb_allocs;
+	fprintf(stdout, "osip_message_parse: %.0f msg/s, %.1f allocations/msg\n",
+			nb_parsed / full, (double) allocs / nb_parsed);
+
+	nb_allocs = 0;
+	start = now();
+	for (i = 0; i < iterations; i++) {
+		for (k = 0; k < nb_msgs; k++) {
+			if (msgs[k] == NULL)
+				continue;
+			osip_message_view_parse(&view, msgs[k], lens[k]);
+			osip_message_view_get_via(&view, 0, &via);
+			osip_message_view_get_from(&view, &from);
+			osip_message_view_get_to(&view, &to);
+			osip_message_view_get_call_id(&view, &call_id);
+			osip_message_view_get_cseq(&view, &cseq);
+		}
+	}
+	lazy = now() - start;
+	allocs = nb_allocs;
+	fprintf(stdout,
+			"osip_message_view_parse + Via/From/To/Call-ID/CSeq: %.0f msg/s, %.1f allocations/msg\n",
+			nb_parsed / lazy, (double) allocs / nb_parsed);
+
+	nb_allocs = 0;
+	start = now();
+	for (i = 0; i < iterations; i++) {
+		for (k = 0; k < nb_msgs; k++) {
+			if (msgs[k] == NULL)
+				continue;
+			osip_message_view_parse(&view, msgs[k], lens[k]);
+		}
+	}
+	lazy = now() - start;
+	allocs = nb_allocs;
+	fprintf(stdout, "osip_message_view_parse: %.0f msg/s, %.1f allocations/msg\n",
+			nb_parsed / lazy, (double) allocs / nb_parsed);
+
+	osip_message_view_free(&view);
+
+	for (k = 0; k < nb_msgs; k++) {
+		sips[k] = NULL;
+		if (msgs[k] == NULL)
+			continue;
+		osip_message_init(&sips[k]);
+		osip_message_parse(sips[k], msgs[k], lens[k]);
+	}
+
+	nb_allocs = 0;
+	start = now();
+	for (i = 0; i < iterations; i++) {
+		for (k = 0; k < nb_msgs; k++) {
+			if (sips[k] == NULL)
+				continue;
+			osip_message_force_update(sips[k]);
+			osip_message_get_buffer(sips[k], &buf, &len);
+		}
+	}
+	full = now() - start;
+	allocs = nb_allocs;
+	fprintf(stdout, "build after a modification: %.0f msg/s, %.1f allocations/msg\n",
+			nb_parsed / full, (double) allocs / nb_parsed);
+
+	nb_allocs = 0;
+	for (i = 0; i < iterations; i++) {
+		for (k = 0; k < nb_msgs; k++) {
+			if (sips[k] == NULL)
+				continue;
+			osip_message_to_str(sips[k], &tmp, &len);
+			osip_free(tmp);
+		}
+	}
+	allocs = nb_allocs;
+	fprintf(stdout, "retransmission with osip_message_to_str: %.1f allocations/msg\n",
+			(double) allocs / nb_parsed);
+
+	nb_allocs = 0;
+	for (i = 0; i < iterations; i++) {
+		for (k = 0; k < nb_msgs; k++) {
+			if (sips[k] == NULL)
+				continue;
+			osip_message_get_buffer(sips[k], &buf, &len);
+		}
+	}
+	allocs = nb_allocs;
+	fprintf(stdout, "retransmission with osip_message_get_buffer: %.1f allocations/msg\n",
+			(double) allocs / nb_parsed);
+
+	for (k = 0; k < nb_msgs; k++)
+		osip_message_free(sips[k]);
+	for (k = 0; k < nb_msgs; k++)
+		free(msgs[k]);
+	return errors ? -1 : 0;
+}
@@ -0,0 +1,185 @@
+/*
+  The oSIP library implements the Session Initiation Protocol (SIP -rfc3261-)
+  Copyright (C) 2001,2002,2003,2004,2005,2006,2007 Aymeric MOIZARD jack@atosc.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifdef ENABLE_MPATROL
+#include <mpatrol.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <osip2/osip.h>
+#include <osip2/osip_dialog.h>
+
+/* Check that the ixt retransmissions expire in the order of their
+   deadlines, that removed ones are never sent, and that the timers of
+   a transaction are cancelled when it is removed from the stack. */
+
+/* internal to osip2, not declared by its headers */
+extern int ixt_init(ixt_t ** ixt);
+extern int osip_add_ixt(osip_t * osip, ixt_t * ixt);
+extern void osip_remove_ixt(osip_t * osip, ixt_t * ixt);
+extern void ixt_free(ixt_t * ixt);
+
+#define NB_IXT 6
+
+static int sent_ports[64];
+static int nb_sent;
+static int failures;
+
+static void check(int cond, const char *what)
+{
+	if (!cond) {
+		fprintf(stdout, "FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+static int cb_send_message(osip_transaction_t * tr, osip_message_t * sip,
+						   char *host, int port, int out_socket)
+{
+	if (tr == NULL && nb_sent < 64)
+		sent_ports[nb_sent++] = port;
+	return 0;
+}
+
+static ixt_t *add_ixt(osip_t * osip, int port, long ms_ago, void *dialog)
+{
+	ixt_t *ixt;
+
+	if (ixt_init(&ixt) != 0)
+		return NULL;
+	gettimeofday(&ixt->start, NULL);
+	ixt->start.tv_sec -= ms_ago / 1000;
+	ixt->start.tv_usec -= (ms_ago % 1000) * 1000;
+	if (ixt->start.tv_usec < 0) {
+		ixt->start.tv_sec--;
+		ixt->start.tv_usec += 1000000;
+	}
+	ixt->dialog = (osip_dialog_t *) dialog;
+	ixt->dest = osip_strdup("127.0.0.1");
+	ixt->port = port;
+	osip_message_init(&ixt->ack);
+	if (osip_add_ixt(osip, ixt) != 0) {
+		ixt_free(ixt);
+		return NULL;
+	}
+	return ixt;
+}
+
+static void test_ixt(osip_t * osip)
+{
+	/* deadlines in the past, in scrambled order: port i expires i*10 ms ago */
+	static const int ports[NB_IXT] = { 3, 1, 6, 2, 5, 4 };
+	ixt_t *ixts[NB_IXT + 1];
+	int dialog_a, dialog_b;
+	struct timeval tv;
+	long ms;
+	int i;
+
+	for (i = 0; i < NB_IXT; i++)
+		ixts[ports[i]] =
+			add_ixt(osip, ports[i], ports[i] * 10,
+					ports[i] <= 2 ? (void *) &dialog_a : (void *) &dialog_b);
+	/* a retransmission in the future */
+	add_ixt(osip, 100, -10000, &dialog_b);
+
+	/* cancel 5, then the ixts of dialog_a (1 and 2) */
+	osip_remove_ixt(osip, ixts[5]);
+	ixt_free(ixts[5]);
+	osip_stop_retransmissions_from_dialog(osip, (osip_dialog_t *) & dialog_a);
+
+	nb_sent = 0;
+	osip_retransmissions_execute(osip);
+	check(nb_sent == 3, "only the ixts not removed and expired are sent");
+	check(nb_sent == 3 && sent_ports[0] == 6 && sent_ports[1] == 4
+		  && sent_ports[2] == 3, "ixts are sent in the order of their deadlines");
+
+	/* the next deadline is the second retransmission of 6, 4 and 3, twice
+	   T1 after their first one */
+	osip_timers_gettimeout(osip, &tv);
+	ms = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+	check(ms > DEFAULT_T1 && ms <= 2 * DEFAULT_T1,
+		  "the next timeout is the earliest retransmission");
+
+	osip_stop_retransmissions_from_dialog(osip, (osip_dialog_t *) & dialog_b);
+	osip_timers_gettimeout(osip, &tv);
+	check(tv.tv_sec > 3600, "no timer is left once all ixts are removed");
+}
+
+static void test_transaction(osip_t * osip)
+{
+	const char *request =
+		"REGISTER sip:example.org SIP/2.0\r\n"
+		"Via: SIP/2.0/UDP 127.0.0.1:5060;branch=z9hG4bK776asdhds\r\n"
+		"Max-Forwards: 70\r\n"
+		"To: <sip:bob@example.org>\r\n"
+		"From: <sip:bob@example.org>;tag=456248\r\n"
+		"Call-ID: 843817637684230@998sdasdh09\r\n"
+		"CSeq: 1826 REGISTER\r\n"
+		"Contact: <sip:bob@127.0.0.1>\r\n" "Content-Length: 0\r\n\r\n";
+	osip_message_t *sip;
+	osip_transaction_t *tr;
+	struct timeval tv;
+	long ms;
+
+	osip_message_init(&sip);
+	if (osip_message_parse(sip, request, strlen(request)) != 0) {
+		check(0, "the request is parsed");
+		osip_message_free(sip);
+		return;
+	}
+	if (osip_transaction_init(&tr, NICT, osip, sip) != 0) {
+		check(0, "a transaction is created");
+		osip_message_free(sip);
+		return;
+	}
+	osip_transaction_add_event(tr, osip_new_outgoing_sipmessage(sip));
+	osip_nict_execute(osip);
+
+	/* timer E (T1) and timer F (64*T1) are running */
+	osip_timers_gettimeout(osip, &tv);
+	ms = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+	check(ms > 0 && ms <= DEFAULT_T1, "timer E is the next timeout");
+
+	osip_remove_transaction(osip, tr);
+	osip_timers_gettimeout(osip, &tv);
+	check(tv.tv_sec > 3600, "the timers of a removed transaction are cancelled");
+	osip_transaction_free(tr);
+}
+
+int main(int argc, char **argv)
+{
+	osip_t *osip;
+
+	if (osip_init(&osip) != 0) {
+		fprintf(stdout, "cannot initialize osip\n");
+		return 1;
+	}
+	osip_set_cb_send_message(osip, &cb_send_message);
+	test_ixt(osip);
+	test_transaction(osip);
+	osip_release(osip);
+	if (failures == 0)
+		fprintf(stdout, "all tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -1411,6 +1411,49 @@ aes_expand_encryption_key(const v128_t *key,
   }
 }
 
+/*
+ * aes_expand_encryption_key_256() computes the fifteen round keys of
+ * a 256 bit key: each word of the schedule is the exor of the word
+ * eight words before and of the previous one, substituted (and
+ * rotated, with the round constant, at the start of a 256 bit group)
+ */
+
+void
+aes_expand_encryption_key_256(const uint8_t key[32],
+			      aes_expanded_key_256_t expanded_key) {
+  uint8_t *w = expanded_key[0].v8;
+  uint8_t tmp[4], t;
+  gf2_8 rc = 1;
+  int i;
+
+  for (i=0; i < 32; i++)
+    w[i] = key[i];
+
+  for (i=32; i < 15*16; i += 4) {
+    tmp[0] = w[i-4];
+    tmp[1] = w[i-3];
+    tmp[2] = w[i-2];
+    tmp[3] = w[i-1];
+    if (i % 32 == 0) {
+      t = tmp[0];
+      tmp[0] = aes_sbox[tmp[1]] ^ rc;
+      tmp[1] = aes_sbox[tmp[2]];
+      tmp[2] = aes_sbox[tmp[3]];
+      tmp[3] = aes_sbox[t];
+      rc = gf2_8_shift(rc);
+    } else if (i % 32 == 16) {
+      tmp[0] = aes_sbox[tmp[0]];
+      tmp[1] = aes_sbox[tmp[1]];
+      tmp[2] = aes_sbox[tmp[2]];
+      tmp[3] = aes_sbox[tmp[3]];
+    }
+    w[i]   = w[i-32] ^ tmp[0];
+    w[i+1] = w[i-31] ^ tmp[1];
+    w[i+2] = w[i-30] ^ tmp[2];
+    w[i+3] = w[i-29] ^ tmp[3];
+  }
+}
+
 void
 aes_expand_decryption_key(const v128_t *key, 
 			  aes_expanded_key_t expanded_key) {
@@ -1930,6 +1973,21 @@ aes_encrypt(v128_t *plaintext, const aes_expanded_key_t exp_key) {
  aes_final_round(plaintext, exp_key + 10);  
 }
 
+void
+aes_encrypt_256(v128_t *plaintext, const aes_expanded_key_256_t exp_key) {
+  int i;
+
+  /* add in the subkey */
+  v128_xor_eq(plaintext, exp_key + 0);
+
+  /* now do thirteen rounds */
+  for (i=1; i < 14; i++)
+    aes_round(plaintext, exp_key + i);
+
+  /* the last round is different */
+  aes_final_round(plaintext, exp_key + 14);
+}
+
 void
 aes_decrypt(v128_t *plaintext, const aes_expanded_key_t exp_key) {
 
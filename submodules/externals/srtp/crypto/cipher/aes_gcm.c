@@ -0,0 +1,837 @@
+/*
+ * aes_gcm.c
+ *
+ * AES Galois/Counter Mode (NIST SP 800-38D), as used by srtp (RFC 7714)
+ *
+ */
+
+/*
+ *
+ * Copyright (c) 2001-2006, Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "aes_gcm.h"
+#include "alloc.h"
+
+/*
+ * the counter blocks are encrypted and the ciphertext is hashed in
+ * the same pass over the message.  Two implementations are provided:
+ *
+ *  - a portable one, using the table driven aes of aes.c and a ghash
+ *    with a table of 16 multiples of h (4 bits of data at a time)
+ *
+ *  - one using the AES-NI and PCLMULQDQ instructions on x86, which
+ *    encrypts four counter blocks at once and hashes four blocks with
+ *    a single reduction, using the precomputed powers h, h^2, h^3, h^4
+ *
+ * the second is selected at run time when the processor has them.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define AES_GCM_HW_X86 1
+# include <cpuid.h>
+# include <wmmintrin.h>
+# include <tmmintrin.h>
+#endif
+
+debug_module_t mod_aes_gcm = {
+  0,                 /* debugging is off by default */
+  "aes gcm"          /* printable module name       */
+};
+
+/*
+ * aes_gcm_blocks_func_t encrypts (or decrypts) num_blocks whole
+ * blocks of buf in counter mode, hashes the ciphertext and advances
+ * the counter
+ */
+typedef void (*aes_gcm_blocks_func_t)(aes_gcm_ctx_t *c, uint8_t *buf,
+				      unsigned int num_blocks, int encrypt);
+
+/* aes_gcm_hash_func_t hashes num_blocks whole blocks of data */
+typedef void (*aes_gcm_hash_func_t)(aes_gcm_ctx_t *c, const uint8_t *data,
+				    unsigned int num_blocks);
+
+/* aes_gcm_init_func_t precomputes what the hash needs from c->h */
+typedef void (*aes_gcm_init_func_t)(aes_gcm_ctx_t *c);
+
+typedef struct {
+  aes_gcm_blocks_func_t blocks;
+  aes_gcm_hash_func_t   hash;
+  aes_gcm_init_func_t   init;
+} aes_gcm_impl_t;
+
+static const aes_gcm_impl_t *aes_gcm_impl = NULL;
+
+static inline void
+aes_gcm_encrypt_block(const aes_gcm_ctx_t *c, v128_t *block) {
+  if (c->rounds == 10)
+    aes_encrypt(block, c->round_keys);
+  else
+    aes_encrypt_256(block, c->round_keys);
+}
+
+/* increments the last 32 bits of the counter block, big-endian */
+static inline void
+aes_gcm_inc32(v128_t *counter) {
+  counter->v32[3] = htonl(ntohl(counter->v32[3]) + 1);
+}
+
+/*
+ * portable implementation
+ */
+
+static const uint64_t aes_gcm_last4[16] = {
+  0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+  0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+static inline uint64_t
+aes_gcm_load64(const uint8_t *p) {
+  return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48)
+    | ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32)
+    | ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16)
+    | ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+}
+
+static inline void
+aes_gcm_store64(uint8_t *p, uint64_t v) {
+  int i;
+  for (i=7; i >= 0; i--) {
+    p[i] = (uint8_t)v;
+    v >>= 8;
+  }
+}
+
+static void
+aes_gcm_soft_init(aes_gcm_ctx_t *c) {
+  uint64_t vh, vl;
+  int i, j;
+
+  vh = aes_gcm_load64(c->h.v8);
+  vl = aes_gcm_load64(c->h.v8 + 8);
+
+  /* hl[8]/hh[8] is h, each halving divides by x */
+  c->hl[8] = vl;
+  c->hh[8] = vh;
+  c->hl[0] = 0;
+  c->hh[0] = 0;
+  for (i = 4; i > 0; i >>= 1) {
+    uint32_t t = (uint32_t)(vl & 1) * 0xe1000000U;
+    vl = (vh << 63) | (vl >> 1);
+    vh = (vh >> 1) ^ ((uint64_t)t << 32);
+    c->hl[i] = vl;
+    c->hh[i] = vh;
+  }
+  /* the others are sums of those */
+  for (i = 2; i <= 8; i *= 2) {
+    vh = c->hh[i];
+    vl = c->hl[i];
+    for (j = 1; j < i; j++) {
+      c->hh[i+j] = vh ^ c->hh[j];
+      c->hl[i+j] = vl ^ c->hl[j];
+    }
+  }
+}
+
+/* c->ghash = c->ghash * h */
+static void
+aes_gcm_soft_mult(aes_gcm_ctx_t *c) {
+  const uint8_t *x = c->ghash.v8;
+  uint64_t zh, zl;
+  uint8_t lo, hi, rem;
+  int i;
+
+  lo = x[15] & 0xf;
+  zh = c->hh[lo];
+  zl = c->hl[lo];
+  for (i = 15; i >= 0; i--) {
+    lo = x[i] & 0xf;
+    hi = (x[i] >> 4) & 0xf;
+    if (i != 15) {
+      rem = (uint8_t)zl & 0xf;
+      zl = (zh << 60) | (zl >> 4);
+      zh = (zh >> 4) ^ (aes_gcm_last4[rem] << 48);
+      zh ^= c->hh[lo];
+      zl ^= c->hl[lo];
+    }
+    rem = (uint8_t)zl & 0xf;
+    zl = (zh << 60) | (zl >> 4);
+    zh = (zh >> 4) ^ (aes_gcm_last4[rem] << 48);
+    zh ^= c->hh[hi];
+    zl ^= c->hl[hi];
+  }
+  aes_gcm_store64(c->ghash.v8, zh);
+  aes_gcm_store64(c->ghash.v8 + 8, zl);
+}
+
+static void
+aes_gcm_soft_hash(aes_gcm_ctx_t *c, const uint8_t *data,
+		  unsigned int num_blocks) {
+  unsigned int i, j;
+
+  for (i=0; i < num_blocks; i++) {
+    for (j=0; j < sizeof(v128_t); j++)
+      c->ghash.v8[j] ^= data[j];
+    aes_gcm_soft_mult(c);
+    data += sizeof(v128_t);
+  }
+}
+
+static void
+aes_gcm_soft_blocks(aes_gcm_ctx_t *c, uint8_t *buf,
+		    unsigned int num_blocks, int encrypt) {
+  v128_t keystream;
+  unsigned int i, j;
+
+  for (i=0; i < num_blocks; i++) {
+    v128_copy(&keystream, &c->counter);
+    aes_gcm_encrypt_block(c, &keystream);
+    aes_gcm_inc32(&c->counter);
+    if (!encrypt)
+      aes_gcm_soft_hash(c, buf, 1);
+    for (j=0; j < sizeof(v128_t); j++)
+      buf[j] ^= keystream.v8[j];
+    if (encrypt)
+      aes_gcm_soft_hash(c, buf, 1);
+    buf += sizeof(v128_t);
+  }
+}
+
+static const aes_gcm_impl_t aes_gcm_soft_impl = {
+  aes_gcm_soft_blocks,
+  aes_gcm_soft_hash,
+  aes_gcm_soft_init
+};
+
+#if AES_GCM_HW_X86
+
+/*
+ * the hash works on byte reflected values, as in the Intel white
+ * paper "Intel Carry-Less Multiplication Instruction and its Usage
+ * for Computing the GCM Mode": the 256 bit product is shifted left by
+ * one bit, then reduced modulo x^128 + x^7 + x^2 + x + 1.  The
+ * products of several blocks are summed before a single reduction.
+ */
+
+#define AES_GCM_HW_TARGET __attribute__((target("aes,pclmul,sse2,ssse3")))
+
+static int
+aes_gcm_hw_cpu_supported(void) {
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return 0;
+  return (ecx & bit_AES) && (ecx & bit_PCLMUL) && (ecx & bit_SSSE3)
+    && (edx & bit_SSE2);
+}
+
+AES_GCM_HW_TARGET static inline __m128i
+aes_gcm_hw_bswap(__m128i x) {
+  return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+					  8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+/* accumulates the unreduced product of a and b into lo and hi */
+AES_GCM_HW_TARGET static inline void
+aes_gcm_hw_mul(__m128i a, __m128i b, __m128i *lo, __m128i *hi) {
+  __m128i t0, t1, t2, t3;
+
+  t0 = _mm_clmulepi64_si128(a, b, 0x00);
+  t1 = _mm_clmulepi64_si128(a, b, 0x10);
+  t2 = _mm_clmulepi64_si128(a, b, 0x01);
+  t3 = _mm_clmulepi64_si128(a, b, 0x11);
+  t1 = _mm_xor_si128(t1, t2);
+  *lo = _mm_xor_si128(*lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+  *hi = _mm_xor_si128(*hi, _mm_xor_si128(t3, _mm_srli_si128(t1, 8)));
+}
+
+AES_GCM_HW_TARGET static inline __m128i
+aes_gcm_hw_reduce(__m128i lo, __m128i hi) {
+  __m128i t2, t4, t5, t7, t8, t9;
+
+  /* shift the product left by one bit */
+  t7 = _mm_srli_epi32(lo, 31);
+  t8 = _mm_srli_epi32(hi, 31);
+  lo = _mm_slli_epi32(lo, 1);
+  hi = _mm_slli_epi32(hi, 1);
+  t9 = _mm_srli_si128(t7, 12);
+  t8 = _mm_slli_si128(t8, 4);
+  t7 = _mm_slli_si128(t7, 4);
+  lo = _mm_or_si128(lo, t7);
+  hi = _mm_or_si128(hi, t8);
+  hi = _mm_or_si128(hi, t9);
+
+  /* first phase of the reduction */
+  t7 = _mm_slli_epi32(lo, 31);
+  t8 = _mm_slli_epi32(lo, 30);
+  t9 = _mm_slli_epi32(lo, 25);
+  t7 = _mm_xor_si128(t7, t8);
+  t7 = _mm_xor_si128(t7, t9);
+  t8 = _mm_srli_si128(t7, 4);
+  t7 = _mm_slli_si128(t7, 12);
+  lo = _mm_xor_si128(lo, t7);
+
+  /* second phase */
+  t2 = _mm_srli_epi32(lo, 1);
+  t4 = _mm_srli_epi32(lo, 2);
+  t5 = _mm_srli_epi32(lo, 7);
+  t2 = _mm_xor_si128(t2, t4);
+  t2 = _mm_xor_si128(t2, t5);
+  t2 = _mm_xor_si128(t2, t8);
+  lo = _mm_xor_si128(lo, t2);
+  return _mm_xor_si128(hi, lo);
+}
+
+AES_GCM_HW_TARGET static inline __m128i
+aes_gcm_hw_gfmul(__m128i a, __m128i b) {
+  __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+  aes_gcm_hw_mul(a, b, &lo, &hi);
+  return aes_gcm_hw_reduce(lo, hi);
+}
+
+AES_GCM_HW_TARGET static void
+aes_gcm_hw_init(aes_gcm_ctx_t *c) {
+  __m128i h, hn;
+  int i;
+
+  h = aes_gcm_hw_bswap(_mm_loadu_si128((const __m128i *)&c->h));
+  hn = h;
+  _mm_storeu_si128((__m128i *)&c->h_pow[0], h);
+  for (i=1; i < 4; i++) {
+    hn = aes_gcm_hw_gfmul(hn, h);
+    _mm_storeu_si128((__m128i *)&c->h_pow[i], hn);
+  }
+}
+
+/* x = (x + d0) * h^4 + d1 * h^3 + d2 * h^2 + d3 * h, one reduction */
+AES_GCM_HW_TARGET static inline __m128i
+aes_gcm_hw_hash4(const aes_gcm_ctx_t *c, __m128i x, const __m128i d[4]) {
+  __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+  aes_gcm_hw_mul(_mm_xor_si128(x, aes_gcm_hw_bswap(d[0])),
+		 _mm_loadu_si128((const __m128i *)&c->h_pow[3]), &lo, &hi);
+  aes_gcm_hw_mul(aes_gcm_hw_bswap(d[1]),
+		 _mm_loadu_si128((const __m128i *)&c->h_pow[2]), &lo, &hi);
+  aes_gcm_hw_mul(aes_gcm_hw_bswap(d[2]),
+		 _mm_loadu_si128((const __m128i *)&c->h_pow[1]), &lo, &hi);
+  aes_gcm_hw_mul(aes_gcm_hw_bswap(d[3]),
+		 _mm_loadu_si128((const __m128i *)&c->h_pow[0]), &lo, &hi);
+  return aes_gcm_hw_reduce(lo, hi);
+}
+
+AES_GCM_HW_TARGET static inline __m128i
+aes_gcm_hw_hash1(const aes_gcm_ctx_t *c, __m128i x, __m128i d) {
+  return aes_gcm_hw_gfmul(_mm_xor_si128(x, aes_gcm_hw_bswap(d)),
+			  _mm_loadu_si128((const __m128i *)&c->h_pow[0]));
+}
+
+AES_GCM_HW_TARGET static void
+aes_gcm_hw_hash(aes_gcm_ctx_t *c, const uint8_t *data,
+		unsigned int num_blocks) {
+  __m128i x = aes_gcm_hw_bswap(_mm_loadu_si128((const __m128i *)&c->ghash));
+  __m128i d[4];
+  int j;
+
+  for (; num_blocks >= 4; num_blocks -= 4) {
+    for (j=0; j < 4; j++)
+      d[j] = _mm_loadu_si128((const __m128i *)(data + 16 * j));
+    x = aes_gcm_hw_hash4(c, x, d);
+    data += 64;
+  }
+  for (; num_blocks > 0; num_blocks--) {
+    x = aes_gcm_hw_hash1(c, x, _mm_loadu_si128((const __m128i *)data));
+    data += 16;
+  }
+  _mm_storeu_si128((__m128i *)&c->ghash, aes_gcm_hw_bswap(x));
+}
+
+/* encrypts n counter blocks, starting at ctr */
+AES_GCM_HW_TARGET static inline void
+aes_gcm_hw_keystream(const aes_gcm_ctx_t *c, v128_t *ctr, __m128i *ks,
+		     int n) {
+  uint32_t count = ntohl(ctr->v32[3]);
+  __m128i rk;
+  int i, j;
+
+  rk = _mm_loadu_si128((const __m128i *)&c->round_keys[0]);
+  for (j=0; j < n; j++) {
+    ctr->v32[3] = htonl(count++);
+    ks[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)ctr), rk);
+  }
+  ctr->v32[3] = htonl(count);
+  for (i=1; i < c->rounds; i++) {
+    rk = _mm_loadu_si128((const __m128i *)&c->round_keys[i]);
+    for (j=0; j < n; j++)
+      ks[j] = _mm_aesenc_si128(ks[j], rk);
+  }
+  rk = _mm_loadu_si128((const __m128i *)&c->round_keys[c->rounds]);
+  for (j=0; j < n; j++)
+    ks[j] = _mm_aesenclast_si128(ks[j], rk);
+}
+
+AES_GCM_HW_TARGET static void
+aes_gcm_hw_blocks(aes_gcm_ctx_t *c, uint8_t *buf,
+		  unsigned int num_blocks, int encrypt) {
+  __m128i x = aes_gcm_hw_bswap(_mm_loadu_si128((const __m128i *)&c->ghash));
+  __m128i ks[4], d[4];
+  int j;
+
+  for (; num_blocks >= 4; num_blocks -= 4) {
+    aes_gcm_hw_keystream(c, &c->counter, ks, 4);
+    for (j=0; j < 4; j++) {
+      __m128i in = _mm_loadu_si128((const __m128i *)(buf + 16 * j));
+      __m128i out = _mm_xor_si128(in, ks[j]);
+      _mm_storeu_si128((__m128i *)(buf + 16 * j), out);
+      d[j] = encrypt ? out : in;
+    }
+    x = aes_gcm_hw_hash4(c, x, d);
+    buf += 64;
+  }
+  for (; num_blocks > 0; num_blocks--) {
+    __m128i in = _mm_loadu_si128((const __m128i *)buf);
+    __m128i out;
+    aes_gcm_hw_keystream(c, &c->counter, ks, 1);
+    out = _mm_xor_si128(in, ks[0]);
+    _mm_storeu_si128((__m128i *)buf, out);
+    x = aes_gcm_hw_hash1(c, x, encrypt ? out : in);
+    buf += 16;
+  }
+  _mm_storeu_si128((__m128i *)&c->ghash, aes_gcm_hw_bswap(x));
+}
+
+static const aes_gcm_impl_t aes_gcm_hw_impl = {
+  aes_gcm_hw_blocks,
+  aes_gcm_hw_hash,
+  aes_gcm_hw_init
+};
+
+#endif /* AES_GCM_HW_X86 */
+
+int
+aes_gcm_hw_available(void) {
+  if (aes_gcm_impl == NULL) {
+#if AES_GCM_HW_X86
+    if (aes_gcm_hw_cpu_supported())
+      aes_gcm_impl = &aes_gcm_hw_impl;
+    else
+#endif
+      aes_gcm_impl = &aes_gcm_soft_impl;
+  }
+  return aes_gcm_impl != &aes_gcm_soft_impl;
+}
+
+static err_status_t
+aes_gcm_alloc(cipher_t **c, int key_len, cipher_type_t *type) {
+  uint8_t *pointer;
+  aes_gcm_ctx_t *gcm;
+  int tmp;
+
+  debug_print(mod_aes_gcm,
+            "allocating cipher with key length %d", key_len);
+
+  /* select the implementation */
+  aes_gcm_hw_available();
+
+  /* allocate memory a cipher of type aes_gcm */
+  tmp = (sizeof(aes_gcm_ctx_t) + sizeof(cipher_t));
+  pointer = (uint8_t*)crypto_alloc(tmp);
+  if (pointer == NULL)
+    return err_status_alloc_fail;
+  octet_string_set_to_zero(pointer, tmp);
+
+  /* set pointers */
+  *c = (cipher_t *)pointer;
+  (*c)->type = type;
+  (*c)->state = pointer + sizeof(cipher_t);
+  gcm = (aes_gcm_ctx_t *)(*c)->state;
+  gcm->key_size = key_len - AES_GCM_SALT_LEN;
+  gcm->rounds = gcm->key_size == 16 ? 10 : 14;
+
+  /* increment ref_count */
+  type->ref_count++;
+
+  /* set key size        */
+  (*c)->key_len = key_len;
+
+  return err_status_ok;
+}
+
+err_status_t
+aes_gcm_128_alloc(cipher_t **c, int key_len) {
+  if (key_len != AES_128_GCM_KEY_LEN_WSALT)
+    return err_status_bad_param;
+  return aes_gcm_alloc(c, key_len, &aes_gcm_128);
+}
+
+err_status_t
+aes_gcm_256_alloc(cipher_t **c, int key_len) {
+  if (key_len != AES_256_GCM_KEY_LEN_WSALT)
+    return err_status_bad_param;
+  return aes_gcm_alloc(c, key_len, &aes_gcm_256);
+}
+
+err_status_t
+aes_gcm_dealloc(cipher_t *c) {
+  cipher_type_t *type = c->type;
+
+  /* zeroize entire state*/
+  octet_string_set_to_zero((uint8_t *)c,
+			   sizeof(aes_gcm_ctx_t) + sizeof(cipher_t));
+
+  /* free memory */
+  crypto_free(c);
+
+  /* decrement ref_count */
+  type->ref_count--;
+
+  return err_status_ok;
+}
+
+/*
+ * aes_gcm_context_init(...) expands the key, computes the hash
+ * subkey and keeps the salt, which follows the key
+ */
+
+err_status_t
+aes_gcm_context_init(aes_gcm_ctx_t *c, const uint8_t *key) {
+  v128_t tmp_key;
+
+  if (c->key_size == 16) {
+    v128_copy_octet_string(&tmp_key, key);
+    aes_expand_encryption_key(&tmp_key, c->round_keys);
+  } else {
+    aes_expand_encryption_key_256(key, c->round_keys);
+  }
+
+  v128_set_to_zero(&c->salt);
+  memcpy(c->salt.v8, key + c->key_size, AES_GCM_SALT_LEN);
+
+  debug_print(mod_aes_gcm,
+	      "salt: %s", v128_hex_string(&c->salt));
+
+  /* h is the encryption of the zero block */
+  v128_set_to_zero(&c->h);
+  aes_gcm_encrypt_block(c, &c->h);
+  aes_gcm_impl->init(c);
+
+  return err_status_ok;
+}
+
+/*
+ * aes_gcm_set_iv(c, iv) starts a message: the pre-counter block is
+ * the exor of the 12 octet iv with the salt, followed by a 32 bit
+ * counter set to one
+ */
+
+err_status_t
+aes_gcm_set_iv(aes_gcm_ctx_t *c, void *iv) {
+  const uint8_t *nonce = (const uint8_t *)iv;
+  int i;
+
+  for (i=0; i < AES_GCM_IV_LEN; i++)
+    c->j0.v8[i] = nonce[i] ^ c->salt.v8[i];
+  c->j0.v32[3] = htonl(1);
+  v128_copy(&c->counter, &c->j0);
+  aes_gcm_inc32(&c->counter);
+
+  debug_print(mod_aes_gcm,
+	      "j0: %s", v128_hex_string(&c->j0));
+
+  v128_set_to_zero(&c->ghash);
+  c->aad_buffered = 0;
+  c->aad_len = 0;
+
+  return err_status_ok;
+}
+
+/*
+ * aes_gcm_set_aad(c, aad, len) adds len octets to the additional
+ * authenticated data of the message
+ */
+
+err_status_t
+aes_gcm_set_aad(aes_gcm_ctx_t *c, const uint8_t *aad, unsigned int aad_len) {
+  unsigned int num_blocks;
+
+  c->aad_len += aad_len;
+
+  /* complete the block left by a previous call */
+  if (c->aad_buffered > 0) {
+    while (aad_len > 0 && c->aad_buffered < (int)sizeof(v128_t)) {
+      c->aad_block.v8[c->aad_buffered++] = *aad++;
+      aad_len--;
+    }
+    if (c->aad_buffered < (int)sizeof(v128_t))
+      return err_status_ok;
+    aes_gcm_impl->hash(c, c->aad_block.v8, 1);
+    c->aad_buffered = 0;
+  }
+
+  num_blocks = aad_len / sizeof(v128_t);
+  if (num_blocks > 0) {
+    aes_gcm_impl->hash(c, aad, num_blocks);
+    aad += num_blocks * sizeof(v128_t);
+    aad_len -= num_blocks * sizeof(v128_t);
+  }
+
+  /* keep the rest, it may be followed by more aad */
+  if (aad_len > 0) {
+    memcpy(c->aad_block.v8, aad, aad_len);
+    c->aad_buffered = aad_len;
+  }
+
+  return err_status_ok;
+}
+
+/* hashes the last, incomplete, block of aad */
+static void
+aes_gcm_finish_aad(aes_gcm_ctx_t *c) {
+  if (c->aad_buffered > 0) {
+    memset(c->aad_block.v8 + c->aad_buffered, 0,
+	   sizeof(v128_t) - c->aad_buffered);
+    aes_gcm_impl->hash(c, c->aad_block.v8, 1);
+    c->aad_buffered = 0;
+  }
+}
+
+/*
+ * processes the message, then computes the tag: the hash of the
+ * lengths block, exored with the encryption of the pre-counter block
+ */
+static void
+aes_gcm_process(aes_gcm_ctx_t *c, uint8_t *buf, unsigned int len,
+		int encrypt, v128_t *tag) {
+  unsigned int num_blocks = len / sizeof(v128_t);
+  unsigned int tail = len % sizeof(v128_t);
+  v128_t block, keystream;
+  unsigned int i;
+
+  aes_gcm_finish_aad(c);
+
+  if (num_blocks > 0) {
+    aes_gcm_impl->blocks(c, buf, num_blocks, encrypt);
+    buf += num_blocks * sizeof(v128_t);
+  }
+
+  if (tail) {
+    v128_copy(&keystream, &c->counter);
+    aes_gcm_encrypt_block(c, &keystream);
+    aes_gcm_inc32(&c->counter);
+    v128_set_to_zero(&block);
+    if (!encrypt)
+      memcpy(block.v8, buf, tail);
+    for (i=0; i < tail; i++)
+      buf[i] ^= keystream.v8[i];
+    if (encrypt)
+      memcpy(block.v8, buf, tail);
+    aes_gcm_impl->hash(c, block.v8, 1);
+  }
+
+  /* lengths in bits, big-endian */
+  aes_gcm_store64(block.v8, (uint64_t)c->aad_len * 8);
+  aes_gcm_store64(block.v8 + 8, (uint64_t)len * 8);
+  aes_gcm_impl->hash(c, block.v8, 1);
+
+  v128_copy(tag, &c->j0);
+  aes_gcm_encrypt_block(c, tag);
+  v128_xor_eq(tag, &c->ghash);
+
+  debug_print(mod_aes_gcm, "tag: %s", v128_hex_string(tag));
+}
+
+/*
+ * aes_gcm_encrypt() encrypts the message in place and writes the tag
+ * after it, so buf must have room for AES_GCM_TAG_LEN more octets
+ */
+
+err_status_t
+aes_gcm_encrypt(aes_gcm_ctx_t *c,
+		unsigned char *buf, unsigned int *enc_len) {
+  v128_t tag;
+
+  aes_gcm_process(c, buf, *enc_len, 1, &tag);
+  memcpy(buf + *enc_len, tag.v8, AES_GCM_TAG_LEN);
+  *enc_len += AES_GCM_TAG_LEN;
+
+  return err_status_ok;
+}
+
+/*
+ * aes_gcm_decrypt() decrypts the message in place and checks the tag
+ * that ends it
+ */
+
+err_status_t
+aes_gcm_decrypt(aes_gcm_ctx_t *c,
+		unsigned char *buf, unsigned int *enc_len) {
+  v128_t tag;
+  uint8_t diff = 0;
+  unsigned int len, i;
+
+  if (*enc_len < AES_GCM_TAG_LEN)
+    return err_status_bad_param;
+  len = *enc_len - AES_GCM_TAG_LEN;
+
+  aes_gcm_process(c, buf, len, 0, &tag);
+
+  /* compare in constant time */
+  for (i=0; i < AES_GCM_TAG_LEN; i++)
+    diff |= tag.v8[i] ^ buf[len + i];
+  if (diff)
+    return err_status_auth_fail;
+
+  *enc_len = len;
+  return err_status_ok;
+}
+
+
+char
+aes_gcm_128_description[] = "aes-128 galois counter mode";
+
+char
+aes_gcm_256_description[] = "aes-256 galois counter mode";
+
+/*
+ * test cases 3 and 15 of the GCM specification (McGrew and Viega),
+ * with a zero salt so that the iv is the one of the test case
+ */
+
+uint8_t aes_gcm_test_case_plaintext[64] = {
+  0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5,
+  0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5, 0x26, 0x9a,
+  0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda,
+  0x2e, 0x4c, 0x30, 0x3d, 0x8a, 0x31, 0x8a, 0x72,
+  0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68, 0x09, 0x53,
+  0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25,
+  0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57,
+  0xba, 0x63, 0x7b, 0x39, 0x1a, 0xaf, 0xd2, 0x55
+};
+
+uint8_t aes_gcm_test_case_iv[12] = {
+  0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad,
+  0xde, 0xca, 0xf8, 0x88
+};
+
+uint8_t aes_gcm_128_test_case_0_key[AES_128_GCM_KEY_LEN_WSALT] = {
+  0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,
+  0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00
+};
+
+uint8_t aes_gcm_128_test_case_0_ciphertext[80] = {
+  0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24,
+  0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0, 0xd4, 0x9c,
+  0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0,
+  0x35, 0xc1, 0x7e, 0x23, 0x29, 0xac, 0xa1, 0x2e,
+  0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66, 0x93, 0x1c,
+  0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05,
+  0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97,
+  0x3d, 0x58, 0xe0, 0x91, 0x47, 0x3f, 0x59, 0x85,
+  /* tag */
+  0x4d, 0x5c, 0x2a, 0xf3, 0x27, 0xcd, 0x64, 0xa6,
+  0x2c, 0xf3, 0x5a, 0xbd, 0x2b, 0xa6, 0xfa, 0xb4
+};
+
+cipher_test_case_t aes_gcm_128_test_case_0 = {
+  AES_128_GCM_KEY_LEN_WSALT,             /* octets in key            */
+  aes_gcm_128_test_case_0_key,           /* key                      */
+  aes_gcm_test_case_iv,                  /* packet index             */
+  64,                                    /* octets in plaintext      */
+  aes_gcm_test_case_plaintext,           /* plaintext                */
+  80,                                    /* octets in ciphertext     */
+  aes_gcm_128_test_case_0_ciphertext,    /* ciphertext               */
+  NULL                                   /* pointer to next testcase */
+};
+
+uint8_t aes_gcm_256_test_case_0_key[AES_256_GCM_KEY_LEN_WSALT] = {
+  0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,
+  0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+  0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,
+  0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00
+};
+
+uint8_t aes_gcm_256_test_case_0_ciphertext[80] = {
+  0x52, 0x2d, 0xc1, 0xf0, 0x99, 0x56, 0x7d, 0x07,
+  0xf4, 0x7f, 0x37, 0xa3, 0x2a, 0x84, 0x42, 0x7d,
+  0x64, 0x3a, 0x8c, 0xdc, 0xbf, 0xe5, 0xc0, 0xc9,
+  0x75, 0x98, 0xa2, 0xbd, 0x25, 0x55, 0xd1, 0xaa,
+  0x8c, 0xb0, 0x8e, 0x48, 0x59, 0x0d, 0xbb, 0x3d,
+  0xa7, 0xb0, 0x8b, 0x10, 0x56, 0x82, 0x88, 0x38,
+  0xc5, 0xf6, 0x1e, 0x63, 0x93, 0xba, 0x7a, 0x0a,
+  0xbc, 0xc9, 0xf6, 0x62, 0x89, 0x80, 0x15, 0xad,
+  /* tag */
+  0xb0, 0x94, 0xda, 0xc5, 0xd9, 0x34, 0x71, 0xbd,
+  0xec, 0x1a, 0x50, 0x22, 0x70, 0xe3, 0xcc, 0x6c
+};
+
+cipher_test_case_t aes_gcm_256_test_case_0 = {
+  AES_256_GCM_KEY_LEN_WSALT,             /* octets in key            */
+  aes_gcm_256_test_case_0_key,           /* key                      */
+  aes_gcm_test_case_iv,                  /* packet index             */
+  64,                                    /* octets in plaintext      */
+  aes_gcm_test_case_plaintext,           /* plaintext                */
+  80,                                    /* octets in ciphertext     */
+  aes_gcm_256_test_case_0_ciphertext,    /* ciphertext               */
+  NULL                                   /* pointer to next testcase */
+};
+
+cipher_type_t aes_gcm_128 = {
+  (cipher_alloc_func_t)          aes_gcm_128_alloc,
+  (cipher_dealloc_func_t)        aes_gcm_dealloc,
+  (cipher_init_func_t)           aes_gcm_context_init,
+  (cipher_encrypt_func_t)        aes_gcm_encrypt,
+  (cipher_decrypt_func_t)        aes_gcm_decrypt,
+  (cipher_set_iv_func_t)         aes_gcm_set_iv,
+  (char *)                       aes_gcm_128_description,
+  (int)                          0,   /* instance count */
+  (cipher_test_case_t *)        &aes_gcm_128_test_case_0,
+  (debug_module_t *)            &mod_aes_gcm
+};
+
+cipher_type_t aes_gcm_256 = {
+  (cipher_alloc_func_t)          aes_gcm_256_alloc,
+  (cipher_dealloc_func_t)        aes_gcm_dealloc,
+  (cipher_init_func_t)           aes_gcm_context_init,
+  (cipher_encrypt_func_t)        aes_gcm_encrypt,
+  (cipher_decrypt_func_t)        aes_gcm_decrypt,
+  (cipher_set_iv_func_t)         aes_gcm_set_iv,
+  (char *)                       aes_gcm_256_description,
+  (int)                          0,   /* instance count */
+  (cipher_test_case_t *)        &aes_gcm_256_test_case_0,
+  (debug_module_t *)            &mod_aes_gcm
+};
@@ -0,0 +1,527 @@
+/*
+ * aes_icm_hw.c
+ *
+ * AES Integer Counter Mode using the AES instructions of the processor
+ * (AES-NI on x86, the ARMv8 cryptography extension on arm64)
+ *
+ */
+
+/*
+ *
+ * Copyright (c) 2001-2006, Cisco Systems, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ *   Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ *   Neither the name of the Cisco Systems, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "aes_icm.h"
+#include "alloc.h"
+
+/*
+ * the hardware cipher uses the same context as aes_icm: the round keys
+ * computed by aes_expand_encryption_key() are in the byte order the
+ * AES instructions expect, so that both ciphers produce the same
+ * keystream and aes_icm_set_iv() and aes_icm_context_init() are shared.
+ *
+ * the instructions are selected when the processor is checked, at the
+ * first allocation or when aes_icm_hw_available() is called.  Several
+ * counter blocks are encrypted at once so that the latency of the
+ * aes round instructions is hidden, also across the packets passed to
+ * aes_icm_hw_encrypt_multi().
+ */
+
+#define AES_ICM_HW_BLOCKS 8   /* counter blocks encrypted at once */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define AES_ICM_HW_X86 1
+# include <cpuid.h>
+# include <wmmintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+# define AES_ICM_HW_ARM 1
+# include <arm_neon.h>
+# if defined(__linux__)
+#  include <sys/auxv.h>
+#  include <asm/hwcap.h>
+# endif
+#endif
+
+debug_module_t mod_aes_icm_hw = {
+  0,                 /* debugging is off by default */
+  "aes icm hw"       /* printable module name       */
+};
+
+/*
+ * a keystream function xors the keystream of num_blocks counter
+ * blocks, starting at the counter of the context, into buf (or
+ * writes it when xor is zero), and advances the counter
+ */
+typedef void (*aes_icm_hw_keystream_func_t)(aes_icm_ctx_t *c, uint8_t *buf,
+					    unsigned int num_blocks, int xor);
+
+static aes_icm_hw_keystream_func_t aes_icm_hw_keystream = NULL;
+
+/*
+ * a blocks function encrypts num_blocks blocks in place, at most
+ * AES_ICM_HW_BLOCKS, with the key of the context
+ */
+typedef void (*aes_icm_hw_blocks_func_t)(aes_icm_ctx_t *c, v128_t *buf,
+					 unsigned int num_blocks);
+
+static aes_icm_hw_blocks_func_t aes_icm_hw_blocks = NULL;
+
+/*
+ * the block counter is the last 16 bits of the counter, the same way
+ * as aes_icm_advance() counts
+ */
+static inline uint16_t
+aes_icm_hw_get_block_index(const v128_t *counter) {
+  return (uint16_t)((counter->v8[14] << 8) | counter->v8[15]);
+}
+
+static inline void
+aes_icm_hw_set_block_index(v128_t *counter, uint16_t index) {
+  counter->v8[14] = (uint8_t)(index >> 8);
+  counter->v8[15] = (uint8_t)index;
+}
+
+/* software version, used when the processor has no aes instructions */
+static void
+aes_icm_hw_keystream_soft(aes_icm_ctx_t *c, uint8_t *buf,
+			  unsigned int num_blocks, int xor) {
+  uint16_t index = aes_icm_hw_get_block_index(&c->counter);
+  v128_t block;
+  unsigned int i, j;
+
+  for (i=0; i < num_blocks; i++) {
+    v128_copy(&block, &c->counter);
+    aes_encrypt(&block, c->expanded_key);
+    for (j=0; j < sizeof(v128_t); j++)
+      buf[j] = xor ? buf[j] ^ block.v8[j] : block.v8[j];
+    buf += sizeof(v128_t);
+    aes_icm_hw_set_block_index(&c->counter, ++index);
+  }
+}
+
+static void
+aes_icm_hw_blocks_soft(aes_icm_ctx_t *c, v128_t *buf,
+		       unsigned int num_blocks) {
+  unsigned int i;
+
+  for (i=0; i < num_blocks; i++)
+    aes_encrypt(&buf[i], c->expanded_key);
+}
+
+#if AES_ICM_HW_X86
+
+static int
+aes_icm_hw_cpu_supported(void) {
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return 0;
+  return (ecx & bit_AES) && (edx & bit_SSE2);
+}
+
+#define AES_ICM_HW_ROUND(i)					\
+  for (j=0; j < n; j++)						\
+    blocks[j] = _mm_aesenc_si128(blocks[j], rk[i])
+
+__attribute__((target("aes,sse2")))
+static void
+aes_icm_hw_keystream_aesni(aes_icm_ctx_t *c, uint8_t *buf,
+			   unsigned int num_blocks, int xor) {
+  __m128i rk[11];
+  __m128i blocks[AES_ICM_HW_BLOCKS];
+  uint16_t index = aes_icm_hw_get_block_index(&c->counter);
+  v128_t counter;
+  unsigned int i, j, n;
+
+  for (i=0; i < 11; i++)
+    rk[i] = _mm_loadu_si128((const __m128i *)&c->expanded_key[i]);
+
+  v128_copy(&counter, &c->counter);
+  while (num_blocks > 0) {
+    n = num_blocks < AES_ICM_HW_BLOCKS ? num_blocks : AES_ICM_HW_BLOCKS;
+
+    /* first round: the round key is xored into each counter block */
+    for (j=0; j < n; j++) {
+      aes_icm_hw_set_block_index(&counter, index++);
+      blocks[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&counter),
+				rk[0]);
+    }
+    AES_ICM_HW_ROUND(1);
+    AES_ICM_HW_ROUND(2);
+    AES_ICM_HW_ROUND(3);
+    AES_ICM_HW_ROUND(4);
+    AES_ICM_HW_ROUND(5);
+    AES_ICM_HW_ROUND(6);
+    AES_ICM_HW_ROUND(7);
+    AES_ICM_HW_ROUND(8);
+    AES_ICM_HW_ROUND(9);
+    for (j=0; j < n; j++) {
+      __m128i ks = _mm_aesenclast_si128(blocks[j], rk[10]);
+      if (xor)
+	ks = _mm_xor_si128(ks, _mm_loadu_si128((const __m128i *)buf));
+      _mm_storeu_si128((__m128i *)buf, ks);
+      buf += sizeof(v128_t);
+    }
+    num_blocks -= n;
+  }
+  aes_icm_hw_set_block_index(&c->counter, index);
+}
+
+__attribute__((target("aes,sse2")))
+static void
+aes_icm_hw_blocks_aesni(aes_icm_ctx_t *c, v128_t *buf,
+			unsigned int num_blocks) {
+  __m128i rk[11];
+  __m128i blocks[AES_ICM_HW_BLOCKS];
+  unsigned int i, j, n = num_blocks;
+
+  for (i=0; i < 11; i++)
+    rk[i] = _mm_loadu_si128((const __m128i *)&c->expanded_key[i]);
+
+  for (j=0; j < n; j++)
+    blocks[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&buf[j]),
+			      rk[0]);
+  AES_ICM_HW_ROUND(1);
+  AES_ICM_HW_ROUND(2);
+  AES_ICM_HW_ROUND(3);
+  AES_ICM_HW_ROUND(4);
+  AES_ICM_HW_ROUND(5);
+  AES_ICM_HW_ROUND(6);
+  AES_ICM_HW_ROUND(7);
+  AES_ICM_HW_ROUND(8);
+  AES_ICM_HW_ROUND(9);
+  for (j=0; j < n; j++)
+    _mm_storeu_si128((__m128i *)&buf[j],
+		     _mm_aesenclast_si128(blocks[j], rk[10]));
+}
+
+#elif AES_ICM_HW_ARM
+
+static int
+aes_icm_hw_cpu_supported(void) {
+#if defined(__linux__) && defined(HWCAP_AES)
+  return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+  /* built for a processor with the cryptography extension */
+  return 1;
+#endif
+}
+
+#define AES_ICM_HW_ROUND(i)						\
+  for (j=0; j < n; j++)							\
+    blocks[j] = vaesmcq_u8(vaeseq_u8(blocks[j], rk[i]))
+
+static void
+aes_icm_hw_keystream_armv8(aes_icm_ctx_t *c, uint8_t *buf,
+			   unsigned int num_blocks, int xor) {
+  uint8x16_t rk[11];
+  uint8x16_t blocks[AES_ICM_HW_BLOCKS];
+  uint16_t index = aes_icm_hw_get_block_index(&c->counter);
+  v128_t counter;
+  unsigned int i, j, n;
+
+  for (i=0; i < 11; i++)
+    rk[i] = vld1q_u8(c->expanded_key[i].v8);
+
+  v128_copy(&counter, &c->counter);
+  while (num_blocks > 0) {
+    n = num_blocks < AES_ICM_HW_BLOCKS ? num_blocks : AES_ICM_HW_BLOCKS;
+
+    for (j=0; j < n; j++) {
+      aes_icm_hw_set_block_index(&counter, index++);
+      blocks[j] = vld1q_u8(counter.v8);
+    }
+    /* aese xors the round key before substitution, so round i uses rk[i] */
+    AES_ICM_HW_ROUND(0);
+    AES_ICM_HW_ROUND(1);
+    AES_ICM_HW_ROUND(2);
+    AES_ICM_HW_ROUND(3);
+    AES_ICM_HW_ROUND(4);
+    AES_ICM_HW_ROUND(5);
+    AES_ICM_HW_ROUND(6);
+    AES_ICM_HW_ROUND(7);
+    AES_ICM_HW_ROUND(8);
+    for (j=0; j < n; j++) {
+      uint8x16_t ks = veorq_u8(vaeseq_u8(blocks[j], rk[9]), rk[10]);
+      if (xor)
+	ks = veorq_u8(ks, vld1q_u8(buf));
+      vst1q_u8(buf, ks);
+      buf += sizeof(v128_t);
+    }
+    num_blocks -= n;
+  }
+  aes_icm_hw_set_block_index(&c->counter, index);
+}
+
+static void
+aes_icm_hw_blocks_armv8(aes_icm_ctx_t *c, v128_t *buf,
+			unsigned int num_blocks) {
+  uint8x16_t rk[11];
+  uint8x16_t blocks[AES_ICM_HW_BLOCKS];
+  unsigned int i, j, n = num_blocks;
+
+  for (i=0; i < 11; i++)
+    rk[i] = vld1q_u8(c->expanded_key[i].v8);
+
+  for (j=0; j < n; j++)
+    blocks[j] = vld1q_u8(buf[j].v8);
+  AES_ICM_HW_ROUND(0);
+  AES_ICM_HW_ROUND(1);
+  AES_ICM_HW_ROUND(2);
+  AES_ICM_HW_ROUND(3);
+  AES_ICM_HW_ROUND(4);
+  AES_ICM_HW_ROUND(5);
+  AES_ICM_HW_ROUND(6);
+  AES_ICM_HW_ROUND(7);
+  AES_ICM_HW_ROUND(8);
+  for (j=0; j < n; j++)
+    vst1q_u8(buf[j].v8, veorq_u8(vaeseq_u8(blocks[j], rk[9]), rk[10]));
+}
+
+#endif
+
+/*
+ * aes_icm_hw_available() returns 1 if the processor has aes
+ * instructions that this cipher uses, and selects them
+ */
+
+int
+aes_icm_hw_available(void) {
+  if (aes_icm_hw_keystream == NULL) {
+#if AES_ICM_HW_X86
+    if (aes_icm_hw_cpu_supported()) {
+      aes_icm_hw_keystream = aes_icm_hw_keystream_aesni;
+      aes_icm_hw_blocks = aes_icm_hw_blocks_aesni;
+    }
+#elif AES_ICM_HW_ARM
+    if (aes_icm_hw_cpu_supported()) {
+      aes_icm_hw_keystream = aes_icm_hw_keystream_armv8;
+      aes_icm_hw_blocks = aes_icm_hw_blocks_armv8;
+    }
+#endif
+    if (aes_icm_hw_keystream == NULL) {
+      aes_icm_hw_keystream = aes_icm_hw_keystream_soft;
+      aes_icm_hw_blocks = aes_icm_hw_blocks_soft;
+    }
+    debug_print(mod_aes_icm_hw, "aes instructions %s",
+		aes_icm_hw_keystream == aes_icm_hw_keystream_soft ?
+		"not available" : "available");
+  }
+  return aes_icm_hw_keystream != aes_icm_hw_keystream_soft;
+}
+
+err_status_t
+aes_icm_hw_alloc(cipher_t **c, int key_len) {
+  extern cipher_type_t aes_icm_hw;
+  uint8_t *pointer;
+  int tmp;
+
+  debug_print(mod_aes_icm_hw,
+            "allocating cipher with key length %d", key_len);
+
+  if (key_len != 30)
+    return err_status_bad_param;
+
+  /* select the keystream function */
+  aes_icm_hw_available();
+
+  /* allocate memory a cipher of type aes_icm_hw */
+  tmp = (sizeof(aes_icm_ctx_t) + sizeof(cipher_t));
+  pointer = (uint8_t*)crypto_alloc(tmp);
+  if (pointer == NULL)
+    return err_status_alloc_fail;
+
+  /* set pointers */
+  *c = (cipher_t *)pointer;
+  (*c)->type = &aes_icm_hw;
+  (*c)->state = pointer + sizeof(cipher_t);
+
+  /* increment ref_count */
+  aes_icm_hw.ref_count++;
+
+  /* set key size        */
+  (*c)->key_len = key_len;
+
+  return err_status_ok;
+}
+
+err_status_t
+aes_icm_hw_dealloc(cipher_t *c) {
+  extern cipher_type_t aes_icm_hw;
+
+  /* zeroize entire state*/
+  octet_string_set_to_zero((uint8_t *)c,
+			   sizeof(aes_icm_ctx_t) + sizeof(cipher_t));
+
+  /* free memory */
+  crypto_free(c);
+
+  /* decrement ref_count */
+  aes_icm_hw.ref_count--;
+
+  return err_status_ok;
+}
+
+/*
+ * aes_icm_hw_encrypt(...) is aes_icm_encrypt(), with whole blocks of
+ * keystream generated several at a time
+ */
+
+err_status_t
+aes_icm_hw_encrypt(aes_icm_ctx_t *c,
+		   unsigned char *buf, unsigned int *enc_len) {
+  unsigned int bytes_to_encr = *enc_len;
+  unsigned int num_blocks;
+  unsigned int i;
+
+  /* check that there's enough segment left */
+  if ((bytes_to_encr + htons(c->counter.v16[7])) > 0xffff)
+    return err_status_terminus;
+
+  debug_print(mod_aes_icm_hw, "block index: %d",
+	      htons(c->counter.v16[7]));
+
+  /* use the keystream left from the previous call */
+  if (bytes_to_encr <= (unsigned int)c->bytes_in_buffer) {
+    for (i = (sizeof(v128_t) - c->bytes_in_buffer);
+	 i < (sizeof(v128_t) - c->bytes_in_buffer + bytes_to_encr); i++)
+      *buf++ ^= c->keystream_buffer.v8[i];
+    c->bytes_in_buffer -= bytes_to_encr;
+    return err_status_ok;
+  }
+  for (i=(sizeof(v128_t) - c->bytes_in_buffer); i < sizeof(v128_t); i++)
+    *buf++ ^= c->keystream_buffer.v8[i];
+  bytes_to_encr -= c->bytes_in_buffer;
+  c->bytes_in_buffer = 0;
+
+  /* whole blocks */
+  num_blocks = bytes_to_encr / sizeof(v128_t);
+  if (num_blocks > 0) {
+    aes_icm_hw_keystream(c, buf, num_blocks, 1);
+    buf += num_blocks * sizeof(v128_t);
+  }
+
+  /* keep the keystream of the tail end, for the next call */
+  if ((bytes_to_encr & 0xf) != 0) {
+    aes_icm_hw_keystream(c, c->keystream_buffer.v8, 1, 0);
+    for (i=0; i < (bytes_to_encr & 0xf); i++)
+      *buf++ ^= c->keystream_buffer.v8[i];
+    c->bytes_in_buffer = sizeof(v128_t) - i;
+  }
+
+  return err_status_ok;
+}
+
+/*
+ * aes_icm_hw_encrypt_multi(c, counters, bufs, lens, num) encrypts num
+ * buffers with the key of c, the context of an aes_icm_hw cipher:
+ * buffer i with the keystream that starts at counters[i], the counter
+ * that aes_icm_set_iv() sets for it.  The counter blocks of all the
+ * buffers are encrypted together, so that short packets fill the
+ * AES_ICM_HW_BLOCKS of the aes instructions as well as long ones.  The
+ * counter of the context is not used, and a buffer must not be longer
+ * than the 0xffff octets aes_icm_hw_encrypt() accepts.
+ */
+
+static inline void
+aes_icm_hw_xor_block(uint8_t *buf, const v128_t *ks, unsigned int len) {
+  v128_t tmp;
+  unsigned int i;
+
+  if (len == sizeof(v128_t)) {
+    memcpy(&tmp, buf, sizeof(v128_t));
+    v128_xor_eq(&tmp, ks);
+    memcpy(buf, &tmp, sizeof(v128_t));
+  } else {
+    for (i=0; i < len; i++)
+      buf[i] ^= ks->v8[i];
+  }
+}
+
+void
+aes_icm_hw_encrypt_multi(aes_icm_ctx_t *c, const v128_t counters[],
+			 uint8_t *bufs[], const unsigned int lens[], int num) {
+  v128_t blocks[AES_ICM_HW_BLOCKS];
+  uint8_t *dst[AES_ICM_HW_BLOCKS];
+  unsigned int dst_len[AES_ICM_HW_BLOCKS];
+  unsigned int n = 0, off, j;
+  uint16_t index;
+  int i;
+
+  for (i=0; i < num; i++) {
+    index = aes_icm_hw_get_block_index(&counters[i]);
+    for (off=0; off < lens[i]; off += sizeof(v128_t)) {
+      v128_copy(&blocks[n], &counters[i]);
+      aes_icm_hw_set_block_index(&blocks[n], index++);
+      dst[n] = bufs[i] + off;
+      dst_len[n] = lens[i] - off < sizeof(v128_t) ?
+	lens[i] - off : sizeof(v128_t);
+      if (++n == AES_ICM_HW_BLOCKS) {
+	aes_icm_hw_blocks(c, blocks, n);
+	for (j=0; j < n; j++)
+	  aes_icm_hw_xor_block(dst[j], &blocks[j], dst_len[j]);
+	n = 0;
+      }
+    }
+  }
+  if (n > 0) {
+    aes_icm_hw_blocks(c, blocks, n);
+    for (j=0; j < n; j++)
+      aes_icm_hw_xor_block(dst[j], &blocks[j], dst_len[j]);
+  }
+}
+
+char
+aes_icm_hw_description[] = "aes integer counter mode (aes instructions)";
+
+/* the test case of aes_icm applies */
+extern cipher_test_case_t aes_icm_test_case_0;
+
+/*
+ * note: the encrypt function is identical to the decrypt function
+ */
+
+cipher_type_t aes_icm_hw = {
+  (cipher_alloc_func_t)          aes_icm_hw_alloc,
+  (cipher_dealloc_func_t)        aes_icm_hw_dealloc,
+  (cipher_init_func_t)           aes_icm_context_init,
+  (cipher_encrypt_func_t)        aes_icm_hw_encrypt,
+  (cipher_decrypt_func_t)        aes_icm_hw_encrypt,
+  (cipher_set_iv_func_t)         aes_icm_set_iv,
+  (char *)                       aes_icm_hw_description,
+  (int)                          0,   /* instance count */
+  (cipher_test_case_t *)        &aes_icm_test_case_0,
+  (debug_module_t *)            &mod_aes_icm_hw
+};
@@ -381,9 +381,10 @@ cipher_bits_per_second(cipher_t *c, int octets_in_buffer, int num_trials) {
   v128_t nonce;
   clock_t timer;
   unsigned char *enc_buf;
-  unsigned int len = octets_in_buffer;
+  unsigned int len;
 
-  enc_buf = (unsigned char*) crypto_alloc(octets_in_buffer);
+  /* leave room for the tag of the authenticated ciphers */
+  enc_buf = (unsigned char*) crypto_alloc(octets_in_buffer + 16);
   if (enc_buf == NULL)
     return 0;  /* indicate bad parameters by returning null */
   
@@ -392,6 +393,7 @@ cipher_bits_per_second(cipher_t *c, int octets_in_buffer, int num_trials) {
   timer = clock();
   for(i=0; i < num_trials; i++, nonce.v32[3] = i) {
     cipher_set_iv(c, &nonce);
+    len = octets_in_buffer;
     cipher_encrypt(c, enc_buf, &len);
   }
   timer = clock() - timer;
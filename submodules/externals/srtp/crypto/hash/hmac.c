@@ -112,6 +112,7 @@ err_status_t
 hmac_init(hmac_ctx_t *state, const uint8_t *key, int key_len) {
   int i;
   uint8_t ipad[64]; 
+  uint8_t opad[64];
   
     /*
    * check key length - note that we don't support keys larger
@@ -126,12 +127,12 @@ hmac_init(hmac_ctx_t *state, const uint8_t *key, int key_len) {
    */
   for (i=0; i < key_len; i++) {    
     ipad[i] = key[i] ^ 0x36;
-    state->opad[i] = key[i] ^ 0x5c;
+    opad[i] = key[i] ^ 0x5c;
   }  
   /* set the rest of ipad, opad to constant values */
   for (   ; i < 64; i++) {    
     ipad[i] = 0x36;
-    ((uint8_t *)state->opad)[i] = 0x5c;
+    opad[i] = 0x5c;
   }  
 
   debug_print(mod_hmac, "ipad: %s", octet_string_hex_string(ipad, 64));
@@ -143,6 +144,13 @@ hmac_init(hmac_ctx_t *state, const uint8_t *key, int key_len) {
   sha1_update(&state->init_ctx, ipad, 64);
   memcpy(&state->ctx, &state->init_ctx, sizeof(sha1_ctx_t)); 
 
+  /* hash opad ^ key, for hmac_compute() */
+  sha1_init(&state->opad_ctx);
+  sha1_update(&state->opad_ctx, opad, 64);
+
+  octet_string_set_to_zero(ipad, sizeof(ipad));
+  octet_string_set_to_zero(opad, sizeof(opad));
+
   return err_status_ok;
 }
 
@@ -188,11 +196,8 @@ hmac_compute(hmac_ctx_t *state, const void *message,
   debug_print(mod_hmac, "intermediate state: %s", 
 	      octet_string_hex_string((uint8_t *)H, 20));
 
-  /* re-initialize hash context */
-  sha1_init(&state->ctx);
-  
-  /* hash opad ^ key  */
-  sha1_update(&state->ctx, (uint8_t *)state->opad, 64);
+  /* start from the hash of opad ^ key */
+  memcpy(&state->ctx, &state->opad_ctx, sizeof(sha1_ctx_t));
 
   /* hash the result of the inner hash */
   sha1_update(&state->ctx, (uint8_t *)H, 20);
@@ -47,11 +47,40 @@
 
 #include "sha1.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define SHA1_HW_X86 1
+# include <cpuid.h>
+# include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+# define SHA1_HW_ARM 1
+# include <arm_neon.h>
+# if defined(__linux__)
+#  include <sys/auxv.h>
+#  include <asm/hwcap.h>
+# endif
+#endif
+
 debug_module_t mod_sha1 = {
   0,                 /* debugging is off by default */
   "sha-1"            /* printable module name       */
 };
 
+/*
+ * a blocks function runs the compression function over num_blocks
+ * consecutive 64-octet blocks of message, updating the intermediate
+ * state H (in host byte order)
+ *
+ * it is chosen by sha1_init(): the processor's sha instructions
+ * if it has them, sha1_core() otherwise
+ */
+typedef void (*sha1_blocks_func_t)(uint32_t H[5], const uint8_t *blocks,
+				   int num_blocks);
+
+static void
+sha1_blocks_soft(uint32_t H[5], const uint8_t *blocks, int num_blocks);
+
+static sha1_blocks_func_t sha1_blocks = NULL;
+
 /* SN == Rotate left N bits */
 #define S1(X)  ((X << 1)  | (X >> 31))
 #define S5(X)  ((X << 5)  | (X >> 27))
@@ -182,8 +211,215 @@ sha1_core(const uint32_t M[16], uint32_t hash_value[5]) {
   return;
 }
 
+static void
+sha1_blocks_soft(uint32_t H[5], const uint8_t *blocks, int num_blocks) {
+  uint32_t M[16];
+
+  while (num_blocks-- > 0) {
+    /* the message need not be aligned */
+    memcpy(M, blocks, 64);
+    sha1_core(M, H);
+    blocks += 64;
+  }
+}
+
+#if SHA1_HW_X86
+
+static int
+sha1_hw_cpu_supported(void) {
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return 0;
+  if (!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+    return 0;
+  if (__get_cpuid_max(0, NULL) < 7)
+    return 0;
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return (ebx & (1 << 29)) != 0;       /* sha extensions */
+}
+
+/*
+ * the message schedule words of four rounds are computed from the
+ * ones of the previous sixteen rounds, and m0 (the oldest) is
+ * replaced by the new ones
+ */
+#define SHA1_SHANI_SCHEDULE(m0, m1, m2, m3)				\
+  m0 = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(m0, m1), m2), m3)
+
+/* four rounds of function f, the next e being saved in e_next */
+#define SHA1_SHANI_ROUNDS(e, e_next, m, f)		\
+  e = _mm_sha1nexte_epu32(e, m);			\
+  e_next = abcd;					\
+  abcd = _mm_sha1rnds4_epu32(abcd, e, f)
+
+#define SHA1_SHANI_16_ROUNDS(fa, fb, fc, fd)		\
+  SHA1_SHANI_SCHEDULE(m0, m1, m2, m3);			\
+  SHA1_SHANI_ROUNDS(e0, e1, m0, fa);			\
+  SHA1_SHANI_SCHEDULE(m1, m2, m3, m0);			\
+  SHA1_SHANI_ROUNDS(e1, e0, m1, fb);			\
+  SHA1_SHANI_SCHEDULE(m2, m3, m0, m1);			\
+  SHA1_SHANI_ROUNDS(e0, e1, m2, fc);			\
+  SHA1_SHANI_SCHEDULE(m3, m0, m1, m2);			\
+  SHA1_SHANI_ROUNDS(e1, e0, m3, fd)
+
+__attribute__((target("sha,sse4.1,ssse3")))
+static void
+sha1_blocks_shani(uint32_t H[5], const uint8_t *blocks, int num_blocks) {
+  const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL,
+				       0x08090a0b0c0d0e0fULL);
+  __m128i abcd, abcd_save, e0, e0_save, e1;
+  __m128i m0, m1, m2, m3;
+
+  /* the instructions keep a in the most significant word */
+  abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)H), 0x1b);
+  e0 = _mm_set_epi32((int)H[4], 0, 0, 0);
+
+  while (num_blocks-- > 0) {
+    abcd_save = abcd;
+    e0_save = e0;
+
+    m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)blocks), bswap);
+    m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(blocks + 16)),
+			  bswap);
+    m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(blocks + 32)),
+			  bswap);
+    m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(blocks + 48)),
+			  bswap);
+
+    /* rounds 0 to 15 use the message words themselves */
+    e0 = _mm_add_epi32(e0, m0);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    SHA1_SHANI_ROUNDS(e1, e0, m1, 0);
+    SHA1_SHANI_ROUNDS(e0, e1, m2, 0);
+    SHA1_SHANI_ROUNDS(e1, e0, m3, 0);
+
+    /* rounds 16 to 79 */
+    SHA1_SHANI_16_ROUNDS(0, 1, 1, 1);
+    SHA1_SHANI_16_ROUNDS(1, 1, 2, 2);
+    SHA1_SHANI_16_ROUNDS(2, 2, 2, 3);
+    SHA1_SHANI_16_ROUNDS(3, 3, 3, 3);
+
+    e0 = _mm_sha1nexte_epu32(e0, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+    blocks += 64;
+  }
+
+  _mm_storeu_si128((__m128i *)H, _mm_shuffle_epi32(abcd, 0x1b));
+  H[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#elif SHA1_HW_ARM
+
+static int
+sha1_hw_cpu_supported(void) {
+#if defined(__linux__) && defined(HWCAP_SHA1)
+  return (getauxval(AT_HWCAP) & HWCAP_SHA1) != 0;
+#else
+  /* built for a processor with the cryptography extension */
+  return 1;
+#endif
+}
+
+#define SHA1_ARM_SCHEDULE(m0, m1, m2, m3)			\
+  m0 = vsha1su1q_u32(vsha1su0q_u32(m0, m1, m2), m3)
+
+/* four rounds of operation op, the next e being saved in e_next */
+#define SHA1_ARM_ROUNDS(op, e, e_next, m, k)			\
+  e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));			\
+  abcd = op(abcd, e, vaddq_u32(m, k))
+
+#define SHA1_ARM_16_ROUNDS(opa, ka, opb, kb, opc, kc, opd, kd)	\
+  SHA1_ARM_SCHEDULE(m0, m1, m2, m3);				\
+  SHA1_ARM_ROUNDS(opa, e0, e1, m0, ka);				\
+  SHA1_ARM_SCHEDULE(m1, m2, m3, m0);				\
+  SHA1_ARM_ROUNDS(opb, e1, e0, m1, kb);				\
+  SHA1_ARM_SCHEDULE(m2, m3, m0, m1);				\
+  SHA1_ARM_ROUNDS(opc, e0, e1, m2, kc);				\
+  SHA1_ARM_SCHEDULE(m3, m0, m1, m2);				\
+  SHA1_ARM_ROUNDS(opd, e1, e0, m3, kd)
+
+static void
+sha1_blocks_armv8(uint32_t H[5], const uint8_t *blocks, int num_blocks) {
+  const uint32x4_t k0 = vdupq_n_u32(0x5A827999);
+  const uint32x4_t k1 = vdupq_n_u32(0x6ED9EBA1);
+  const uint32x4_t k2 = vdupq_n_u32(0x8F1BBCDC);
+  const uint32x4_t k3 = vdupq_n_u32(0xCA62C1D6);
+  uint32x4_t abcd, abcd_save;
+  uint32x4_t m0, m1, m2, m3;
+  uint32_t e0, e0_save, e1;
+
+  abcd = vld1q_u32(H);
+  e0 = H[4];
+
+  while (num_blocks-- > 0) {
+    abcd_save = abcd;
+    e0_save = e0;
+
+    m0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks)));
+    m1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 16)));
+    m2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 32)));
+    m3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 48)));
+
+    /* rounds 0 to 15 use the message words themselves */
+    SHA1_ARM_ROUNDS(vsha1cq_u32, e0, e1, m0, k0);
+    SHA1_ARM_ROUNDS(vsha1cq_u32, e1, e0, m1, k0);
+    SHA1_ARM_ROUNDS(vsha1cq_u32, e0, e1, m2, k0);
+    SHA1_ARM_ROUNDS(vsha1cq_u32, e1, e0, m3, k0);
+
+    /* rounds 16 to 79 */
+    SHA1_ARM_16_ROUNDS(vsha1cq_u32, k0, vsha1pq_u32, k1,
+		       vsha1pq_u32, k1, vsha1pq_u32, k1);
+    SHA1_ARM_16_ROUNDS(vsha1pq_u32, k1, vsha1pq_u32, k1,
+		       vsha1mq_u32, k2, vsha1mq_u32, k2);
+    SHA1_ARM_16_ROUNDS(vsha1mq_u32, k2, vsha1mq_u32, k2,
+		       vsha1mq_u32, k2, vsha1pq_u32, k3);
+    SHA1_ARM_16_ROUNDS(vsha1pq_u32, k3, vsha1pq_u32, k3,
+		       vsha1pq_u32, k3, vsha1pq_u32, k3);
+
+    e0 += e0_save;
+    abcd = vaddq_u32(abcd, abcd_save);
+    blocks += 64;
+  }
+
+  vst1q_u32(H, abcd);
+  H[4] = e0;
+}
+
+#endif
+
+/*
+ * sha1_hw_available() returns 1 if the processor has sha
+ * instructions that sha1_update() and sha1_final() use, and selects
+ * them
+ */
+
+int
+sha1_hw_available(void) {
+  if (sha1_blocks == NULL) {
+#if SHA1_HW_X86
+    if (sha1_hw_cpu_supported())
+      sha1_blocks = sha1_blocks_shani;
+#elif SHA1_HW_ARM
+    if (sha1_hw_cpu_supported())
+      sha1_blocks = sha1_blocks_armv8;
+#endif
+    if (sha1_blocks == NULL)
+      sha1_blocks = sha1_blocks_soft;
+    debug_print(mod_sha1, "sha instructions %s",
+		sha1_blocks == sha1_blocks_soft ?
+		"not available" : "available");
+  }
+  return sha1_blocks != sha1_blocks_soft;
+}
+
 void
 sha1_init(sha1_ctx_t *ctx) {
+
+  /* select the compression function */
+  if (sha1_blocks == NULL)
+    sha1_hw_available();
  
   /* initialize state vector */
   ctx->H[0] = 0x67452301;
@@ -202,45 +438,44 @@ sha1_init(sha1_ctx_t *ctx) {
 
 void
 sha1_update(sha1_ctx_t *ctx, const uint8_t *msg, int octets_in_msg) {
-  int i;
   uint8_t *buf = (uint8_t *)ctx->M;
+  int n;
 
   /* update message bit-count */
   ctx->num_bits_in_msg += octets_in_msg * 8;
 
-  /* loop over 16-word blocks of M */
-  while (octets_in_msg > 0) {
-    
-    if (octets_in_msg + ctx->octets_in_buffer >= 64) {
-
-      /* 
-       * copy words of M into msg buffer until that buffer is full,
-       * converting them into host byte order as needed
-       */
-      octets_in_msg -= (64 - ctx->octets_in_buffer);
-      for (i=ctx->octets_in_buffer; i < 64; i++) 
-	buf[i] = *msg++;
-      ctx->octets_in_buffer = 0;
-
-      /* process a whole block */
-
-      debug_print(mod_sha1, "(update) running sha1_core()", NULL);
-
-      sha1_core(ctx->M, ctx->H);
-
-    } else {
+  /* complete the block in the buffer, if there is one */
+  if (ctx->octets_in_buffer > 0) {
+    n = 64 - ctx->octets_in_buffer;
+    if (n > octets_in_msg)
+      n = octets_in_msg;
+    memcpy(buf + ctx->octets_in_buffer, msg, n);
+    ctx->octets_in_buffer += n;
+    msg += n;
+    octets_in_msg -= n;
+    if (ctx->octets_in_buffer < 64)
+      return;
+
+    debug_print(mod_sha1, "(update) running sha1_core()", NULL);
+
+    sha1_blocks(ctx->H, buf, 1);
+    ctx->octets_in_buffer = 0;
+  }
 
-      debug_print(mod_sha1, "(update) not running sha1_core()", NULL);
+  /* process the whole blocks where they are */
+  n = octets_in_msg / 64;
+  if (n > 0) {
 
-      for (i=ctx->octets_in_buffer; 
-	   i < (ctx->octets_in_buffer + octets_in_msg); i++)
-	buf[i] = *msg++;
-      ctx->octets_in_buffer += octets_in_msg;
-      octets_in_msg = 0;
-    }
+    debug_print(mod_sha1, "(update) running sha1_core()", NULL);
 
+    sha1_blocks(ctx->H, msg, n);
+    msg += n * 64;
+    octets_in_msg -= n * 64;
   }
 
+  /* keep the rest for later */
+  memcpy(buf, msg, octets_in_msg);
+  ctx->octets_in_buffer = octets_in_msg;
 }
 
 /*
@@ -250,142 +485,33 @@ sha1_update(sha1_ctx_t *ctx, const uint8_t *msg, int octets_in_msg) {
 
 void
 sha1_final(sha1_ctx_t *ctx, uint32_t *output) {
-  uint32_t A, B, C, D, E, TEMP;
-  uint32_t W[80];  
-  int i, t;
+  uint8_t *buf = (uint8_t *)ctx->M;
+  int i = ctx->octets_in_buffer;
 
-  /*
-   * process the remaining octets_in_buffer, padding and terminating as
-   * necessary
+  /* 
+   * set the high bit of the octet immediately following the message,
+   * and zeroize the rest of the block; if there is no room for the
+   * length at the end of the block, then we need to do one more run
+   * of the compression algo
    */
-  {
-    int tail = ctx->octets_in_buffer % 4;
-    
-    /* copy/xor message into array */
-    for (i=0; i < (ctx->octets_in_buffer+3)/4; i++) 
-      W[i]  = be32_to_cpu(ctx->M[i]);
-
-    /* set the high bit of the octet immediately following the message */
-    switch (tail) {
-    case (3):
-      W[i-1] = (be32_to_cpu(ctx->M[i-1]) & 0xffffff00) | 0x80;
-      W[i] = 0x0;
-      break;
-    case (2):      
-      W[i-1] = (be32_to_cpu(ctx->M[i-1]) & 0xffff0000) | 0x8000;
-      W[i] = 0x0;
-      break;
-    case (1):
-      W[i-1] = (be32_to_cpu(ctx->M[i-1]) & 0xff000000) | 0x800000;
-      W[i] = 0x0;
-      break;
-    case (0):
-      W[i] = 0x80000000;
-      break;
-    }
-    
-    /* zeroize remaining words */
-    for (i++   ; i < 15; i++)
-      W[i] = 0x0;
-
-    /* 
-     * if there is room at the end of the word array, then set the
-     * last word to the bit-length of the message; otherwise, set that
-     * word to zero and then we need to do one more run of the
-     * compression algo.
-     */
-    if (ctx->octets_in_buffer < 56) 
-      W[15] = ctx->num_bits_in_msg;
-    else if (ctx->octets_in_buffer < 60)
-      W[15] = 0x0;
-
-    /* process the word array */    for (t=16; t < 80; t++) {
-      TEMP = W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16];
-      W[t] = S1(TEMP);
-    }
-
-    A = ctx->H[0]; 
-    B = ctx->H[1]; 
-    C = ctx->H[2]; 
-    D = ctx->H[3]; 
-    E = ctx->H[4];
-
-    for (t=0; t < 20; t++) {
-      TEMP = S5(A) + f0(B,C,D) + E + W[t] + SHA_K0;
-      E = D; D = C; C = S30(B); B = A; A = TEMP;
-    }
-    for (   ; t < 40; t++) {
-      TEMP = S5(A) + f1(B,C,D) + E + W[t] + SHA_K1;
-      E = D; D = C; C = S30(B); B = A; A = TEMP;
-    }
-    for (   ; t < 60; t++) {
-      TEMP = S5(A) + f2(B,C,D) + E + W[t] + SHA_K2;
-      E = D; D = C; C = S30(B); B = A; A = TEMP;
-    }
-    for (   ; t < 80; t++) {
-      TEMP = S5(A) + f3(B,C,D) + E + W[t] + SHA_K3;
-      E = D; D = C; C = S30(B); B = A; A = TEMP;
-    }
-
-    ctx->H[0] += A;
-    ctx->H[1] += B;
-    ctx->H[2] += C;
-    ctx->H[3] += D;
-    ctx->H[4] += E;
+  buf[i++] = 0x80;
+  if (i > 56) {
+    memset(buf + i, 0, 64 - i);
 
+    debug_print(mod_sha1, "(final) running sha1_core()", NULL);
+
+    sha1_blocks(ctx->H, buf, 1);
+    i = 0;
   }
+  memset(buf + i, 0, 56 - i);
+
+  /* the last eight octets are the bit-length of the message */
+  ctx->M[14] = 0;
+  ctx->M[15] = be32_to_cpu(ctx->num_bits_in_msg);
 
   debug_print(mod_sha1, "(final) running sha1_core()", NULL);
 
-  if (ctx->octets_in_buffer >= 56) {
-
-    debug_print(mod_sha1, "(final) running sha1_core() again", NULL);
-
-    /* we need to do one final run of the compression algo */
-
-    /* 
-     * set initial part of word array to zeros, and set the 
-     * final part to the number of bits in the message
-     */
-    for (i=0; i < 15; i++)
-      W[i] = 0x0;
-    W[15] = ctx->num_bits_in_msg;
-
-    /* process the word array */
-    for (t=16; t < 80; t++) {
-      TEMP = W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16];
-      W[t] = S1(TEMP);
-    }
-
-    A = ctx->H[0]; 
-    B = ctx->H[1]; 
-    C = ctx->H[2]; 
-    D = ctx->H[3]; 
-    E = ctx->H[4];
-
-    for (t=0; t < 20; t++) {
-      TEMP = S5(A) + f0(B,C,D) + E + W[t] + SHA_K0;
-      E = D; D = C; C = S30(B); B = A; A = TEMP;
-    }
-    for (   ; t < 40; t++) {
-      TEMP = S5(A) + f1(B,C,D) + E + W[t] + SHA_K1;
-      E = D; D = C; C = S30(B); B = A; A = TEMP;
-    }
-    for (   ; t < 60; t++) {
-      TEMP = S5(A) + f2(B,C,D) + E + W[t] + SHA_K2;
-      E = D; D = C; C = S30(B); B = A; A = TEMP;
-    }
-    for (   ; t < 80; t++) {
-      TEMP = S5(A) + f3(B,C,D) + E + W[t] + SHA_K3;
-      E = D; D = C; C = S30(B); B = A; A = TEMP;
-    }
-
-    ctx->H[0] += A;
-    ctx->H[1] += B;
-    ctx->H[2] += C;
-    ctx->H[3] += D;
-    ctx->H[4] += E;
-  }
+  sha1_blocks(ctx->H, buf, 1);
 
   /* copy result into output buffer */
   output[0] = be32_to_cpu(ctx->H[0]);
@@ -66,6 +66,17 @@ aes_expand_decryption_key(const v128_t *key,
 void
 aes_encrypt(v128_t *plaintext, const aes_expanded_key_t exp_key);
 
+/* aes with 256 bit keys, which has 14 rounds */
+
+typedef v128_t aes_expanded_key_256_t[15];
+
+void
+aes_expand_encryption_key_256(const uint8_t key[32],
+			      aes_expanded_key_256_t expanded_key);
+
+void
+aes_encrypt_256(v128_t *plaintext, const aes_expanded_key_256_t exp_key);
+
 void
 aes_decrypt(v128_t *plaintext, const aes_expanded_key_t exp_key);
 
@@ -0,0 +1,74 @@
+/*
+ * aes_gcm.h
+ *
+ * Header for AES Galois/Counter Mode, the authenticated encryption
+ * used by the AEAD_AES_128_GCM and AEAD_AES_256_GCM srtp profiles
+ * (RFC 7714)
+ *
+ */
+
+#ifndef AES_GCM_H
+#define AES_GCM_H
+
+#include "aes.h"
+#include "cipher.h"
+
+#define AES_GCM_TAG_LEN   16   /* octets of authentication tag appended */
+#define AES_GCM_SALT_LEN  12   /* octets of salt after the key          */
+#define AES_GCM_IV_LEN    12   /* octets of iv passed to aes_gcm_set_iv */
+
+/* key lengths, including the salt, passed to cipher_type_alloc() */
+#define AES_128_GCM_KEY_LEN_WSALT (16 + AES_GCM_SALT_LEN)
+#define AES_256_GCM_KEY_LEN_WSALT (32 + AES_GCM_SALT_LEN)
+
+typedef struct {
+  v128_t   round_keys[15];    /* the expanded aes key                  */
+  int      rounds;            /* 10 or 14                              */
+  int      key_size;          /* 16 or 32, the salt not included       */
+  v128_t   salt;              /* exored into the iv, last octets zero  */
+  v128_t   h;                 /* hash subkey                           */
+  v128_t   h_pow[4];          /* h to h^4, for the clmul ghash         */
+  uint64_t hl[16];            /* multiples of h, for the table ghash   */
+  uint64_t hh[16];
+  v128_t   j0;                /* pre-counter block of the message      */
+  v128_t   counter;           /* next counter block                    */
+  v128_t   ghash;             /* hash of the data so far               */
+  v128_t   aad_block;         /* aad octets not hashed yet             */
+  int      aad_buffered;      /* number of octets in aad_block         */
+  unsigned int aad_len;       /* octets of aad of the message          */
+} aes_gcm_ctx_t;
+
+/*
+ * a message is processed by aes_gcm_set_iv(), then aes_gcm_set_aad()
+ * as many times as needed, then a single call to cipher_encrypt(),
+ * which appends the tag, or cipher_decrypt(), which checks and
+ * removes it (and returns err_status_auth_fail if it does not match)
+ */
+
+err_status_t
+aes_gcm_context_init(aes_gcm_ctx_t *c, const uint8_t *key);
+
+err_status_t
+aes_gcm_set_iv(aes_gcm_ctx_t *c, void *iv);
+
+err_status_t
+aes_gcm_set_aad(aes_gcm_ctx_t *c, const uint8_t *aad, unsigned int aad_len);
+
+err_status_t
+aes_gcm_encrypt(aes_gcm_ctx_t *c,
+		unsigned char *buf, unsigned int *bytes_to_encr);
+
+err_status_t
+aes_gcm_decrypt(aes_gcm_ctx_t *c,
+		unsigned char *buf, unsigned int *bytes_to_decr);
+
+/* returns 1 if the aes and carry-less multiply instructions are used */
+int
+aes_gcm_hw_available(void);
+
+extern cipher_type_t aes_gcm_128;
+extern cipher_type_t aes_gcm_256;
+
+#define cipher_type_is_aes_gcm(ct) ((ct) == &aes_gcm_128 || (ct) == &aes_gcm_256)
+
+#endif /* AES_GCM_H */
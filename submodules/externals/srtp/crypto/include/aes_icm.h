@@ -52,5 +52,27 @@ aes_icm_alloc_ismacryp(cipher_t **c,
 		       int key_len, 
 		       int forIsmacryp);
 
+/*
+ * aes_icm_hw is aes_icm using the aes instructions of the processor,
+ * it shares the aes_icm context and produces the same keystream
+ */
+
+int
+aes_icm_hw_available(void);
+
+err_status_t
+aes_icm_hw_encrypt(aes_icm_ctx_t *c,
+		   unsigned char *buf, unsigned int *bytes_to_encr);
+
+void
+aes_icm_hw_encrypt_multi(aes_icm_ctx_t *c, const v128_t counters[],
+			 uint8_t *bufs[], const unsigned int lens[], int num);
+
+extern cipher_type_t aes_icm;
+extern cipher_type_t aes_icm_hw;
+
+/* true for the cipher types that use an aes_icm_ctx_t */
+#define cipher_type_is_aes_icm(ct) ((ct) == &aes_icm || (ct) == &aes_icm_hw)
+
 #endif /* AES_ICM_H */
 
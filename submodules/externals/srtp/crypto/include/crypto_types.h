@@ -120,6 +120,23 @@
  */
 #define AES_128_CBC        3            
 
+/**
+ * @brief AES-128 Galois/Counter Mode (AES GCM)
+ *
+ * AES-128 GCM is the authenticated encryption of the AEAD_AES_128_GCM
+ * srtp profile (RFC 7714).  This cipher uses a 16-octet key followed
+ * by a 12-octet salt, and appends a 16-octet authentication tag.
+ */
+#define AES_128_GCM        6
+
+/**
+ * @brief AES-256 Galois/Counter Mode (AES GCM)
+ *
+ * AES-256 GCM is AES GCM with a 32-octet key, used by the
+ * AEAD_AES_256_GCM srtp profile.
+ */
+#define AES_256_GCM        7
+
 /**
  * @brief Strongest available cipher.
  *
@@ -49,10 +49,15 @@
 #include "auth.h"
 #include "sha1.h"
 
+/*
+ * init_ctx and opad_ctx are the sha1 states after hashing the key
+ * exored with ipad and with opad, so that a message costs no
+ * compression for them
+ */
 typedef struct {
-  uint8_t    opad[64];
   sha1_ctx_t ctx;
   sha1_ctx_t init_ctx;
+  sha1_ctx_t opad_ctx;
 } hmac_ctx_t;
 
 err_status_t
@@ -46,6 +46,7 @@
 #include "alloc.h"
 
 #include "crypto_kernel.h"
+#include "aes_icm.h"          /* for aes_icm_hw_available() */
 
 /* the debug module for the crypto_kernel */
 
@@ -69,7 +70,10 @@ extern debug_module_t mod_alloc;
 
 extern cipher_type_t null_cipher;
 extern cipher_type_t aes_icm;
+extern cipher_type_t aes_icm_hw;
 extern cipher_type_t aes_cbc;
+extern cipher_type_t aes_gcm_128;
+extern cipher_type_t aes_gcm_256;
 
 
 /*
@@ -151,10 +155,20 @@ crypto_kernel_init() {
   status = crypto_kernel_load_cipher_type(&null_cipher, NULL_CIPHER);
   if (status) 
     return status;
-  status = crypto_kernel_load_cipher_type(&aes_icm, AES_128_ICM);
+  /* aes icm uses the aes instructions of the processor when it has them */
+  if (aes_icm_hw_available())
+    status = crypto_kernel_load_cipher_type(&aes_icm_hw, AES_128_ICM);
+  else
+    status = crypto_kernel_load_cipher_type(&aes_icm, AES_128_ICM);
   if (status) 
     return status;
   status = crypto_kernel_load_cipher_type(&aes_cbc, AES_128_CBC);
+  if (status) 
+    return status;
+  status = crypto_kernel_load_cipher_type(&aes_gcm_128, AES_128_GCM);
+  if (status) 
+    return status;
+  status = crypto_kernel_load_cipher_type(&aes_gcm_256, AES_256_GCM);
   if (status) 
     return status;
 
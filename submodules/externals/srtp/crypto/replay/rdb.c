@@ -113,9 +113,12 @@ rdb_add_index(rdb_t *rdb, uint32_t index) {
     
     delta -= rdb_bits_in_bitmask - 1;
 
-    /* shift the window forward by delta bits*/
+    /*
+     * shift the window forward by delta bits, so that index is the
+     * last bit of the window
+     */
     v128_left_shift(&rdb->bitmask, delta);
-    v128_set_bit(&rdb->bitmask, rdb_bits_in_bitmask-delta);
+    v128_set_bit(&rdb->bitmask, rdb_bits_in_bitmask-1);
     rdb->window_start += delta;
 
   }    
@@ -49,6 +49,7 @@
 #include <unistd.h>          /* for getopt() */
 #include "cipher.h"
 #include "aes_icm.h"
+#include "aes_gcm.h"
 #include "null_cipher.h"
 
 #define PRINT_DEBUG 0
@@ -69,6 +70,15 @@ cipher_driver_self_test(cipher_type_t *ct);
 err_status_t
 cipher_driver_test_buffering(cipher_t *c);
 
+/*
+ * cipher_driver_test_same_output(c0, c1) checks that two ciphers
+ * initialized with the same key produce the same output, for random
+ * ivs and message lengths
+ */
+
+err_status_t
+cipher_driver_test_same_output(cipher_t *c0, cipher_t *c1);
+
 
 /*
  * functions for testing cipher cache thrash
@@ -114,11 +124,12 @@ check_status(err_status_t s) {
 
 extern cipher_type_t null_cipher;
 extern cipher_type_t aes_icm;
+extern cipher_type_t aes_icm_hw;
 extern cipher_type_t aes_cbc;
 
 int
 main(int argc, char *argv[]) {
-  cipher_t *c = NULL;
+  cipher_t *c = NULL, *c_hw = NULL;
   err_status_t status;
   unsigned char test_key[20] = {
     0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
@@ -168,6 +179,9 @@ main(int argc, char *argv[]) {
     for (num_cipher=1; num_cipher < max_num_cipher; num_cipher *=8)
       cipher_driver_test_array_throughput(&aes_icm, 30, num_cipher); 
 
+    for (num_cipher=1; num_cipher < max_num_cipher; num_cipher *=8)
+      cipher_driver_test_array_throughput(&aes_icm_hw, 30, num_cipher); 
+
     for (num_cipher=1; num_cipher < max_num_cipher; num_cipher *=8)
       cipher_driver_test_array_throughput(&aes_cbc, 16, num_cipher); 
  
@@ -176,7 +190,10 @@ main(int argc, char *argv[]) {
   if (do_validation) {
     cipher_driver_self_test(&null_cipher);
     cipher_driver_self_test(&aes_icm);
+    cipher_driver_self_test(&aes_icm_hw);
     cipher_driver_self_test(&aes_cbc);
+    cipher_driver_self_test(&aes_gcm_128);
+    cipher_driver_self_test(&aes_gcm_256);
   }
 
   /* do timing and/or buffer_test on null_cipher */
@@ -213,9 +230,61 @@ main(int argc, char *argv[]) {
       status = cipher_driver_test_buffering(c);
       check_status(status);
     }
+
+  /* run the same tests on aes_icm_hw, and compare it to aes_icm */
+    printf("aes instructions %s\n",
+	   aes_icm_hw_available() ? "available" : "not available");
+    status = cipher_type_alloc(&aes_icm_hw, &c_hw, 30);
+    if (status) {
+      fprintf(stderr, "error: can't allocate cipher\n");
+      exit(status);
+    }
+
+    status = cipher_init(c_hw, test_key, direction_encrypt);
+    check_status(status);
+
+    if (do_timing_test)
+      cipher_driver_test_throughput(c_hw);
+
+    if (do_validation) {
+      status = cipher_driver_test_buffering(c_hw);
+      check_status(status);
+      status = cipher_driver_test_same_output(c, c_hw);
+      check_status(status);
+    }
+
+    status = cipher_dealloc(c_hw);
+    check_status(status);
     
     status = cipher_dealloc(c);
     check_status(status);
+
+  /* run the throughput test on the aes gcm ciphers */
+  if (do_timing_test) {
+    unsigned char gcm_key[AES_256_GCM_KEY_LEN_WSALT];
+    int i;
+
+    printf("aes and carry-less multiply instructions %s\n",
+	   aes_gcm_hw_available() ? "available" : "not available");
+    for (i=0; i < AES_256_GCM_KEY_LEN_WSALT; i++)
+      gcm_key[i] = (unsigned char)i;
+
+    status = cipher_type_alloc(&aes_gcm_128, &c, AES_128_GCM_KEY_LEN_WSALT);
+    check_status(status);
+    status = cipher_init(c, gcm_key, direction_encrypt);
+    check_status(status);
+    cipher_driver_test_throughput(c);
+    status = cipher_dealloc(c);
+    check_status(status);
+
+    status = cipher_type_alloc(&aes_gcm_256, &c, AES_256_GCM_KEY_LEN_WSALT);
+    check_status(status);
+    status = cipher_init(c, gcm_key, direction_encrypt);
+    check_status(status);
+    cipher_driver_test_throughput(c);
+    status = cipher_dealloc(c);
+    check_status(status);
+  }
   
   return 0;
 }
@@ -333,6 +402,69 @@ cipher_driver_test_buffering(cipher_t *c) {
 }
 
 
+err_status_t
+cipher_driver_test_same_output(cipher_t *c0, cipher_t *c1) {
+  int i, j, num_trials = 1000;
+  unsigned len, len0, len1, buflen = 1024;
+  uint8_t buffer0[buflen], buffer1[buflen];
+  uint8_t idx[16];
+  err_status_t status;
+
+  printf("testing that %s and %s have the same output...",
+	 c0->type->description, c1->type->description);
+
+  for (i=0; i < num_trials; i++) {
+
+    /* random index, with room left in the block counter */
+    for (j=0; j < 14; j++)
+      idx[j] = (uint8_t) rand();
+    idx[14] = idx[15] = 0;
+    len = rand() % buflen;
+    for (j=0; j < len; j++)
+      buffer0[j] = buffer1[j] = (uint8_t) rand();
+
+    status = cipher_set_iv(c0, idx);
+    if (status)
+      return status;
+    status = cipher_set_iv(c1, idx);
+    if (status)
+      return status;
+
+    /* encrypt in two parts, to use the keystream kept between calls */
+    len0 = len / 3;
+    len1 = len - len0;
+    status = cipher_encrypt(c0, buffer0, &len0);
+    if (status)
+      return status;
+    status = cipher_encrypt(c0, buffer0 + len0, &len1);
+    if (status)
+      return status;
+    len0 = len / 3;
+    len1 = len - len0;
+    status = cipher_encrypt(c1, buffer1, &len0);
+    if (status)
+      return status;
+    status = cipher_encrypt(c1, buffer1 + len0, &len1);
+    if (status)
+      return status;
+
+    for (j=0; j < len; j++)
+      if (buffer0[j] != buffer1[j]) {
+#if PRINT_DEBUG
+	printf("test case %d failed at byte %d\n", i, j);
+	printf("computed: %s\n", octet_string_hex_string(buffer1, len));
+	printf("expected: %s\n", octet_string_hex_string(buffer0, len));
+#endif
+	return err_status_algo_fail;
+      }
+  }
+
+  printf("passed\n");
+
+  return err_status_ok;
+}
+
+
 /*
  * The function cipher_test_throughput_array() tests the effect of CPU
  * cache thrash on cipher throughput.  
@@ -80,7 +80,7 @@ extern "C" {
  * SRTP_MAX_TAG_LEN is the maximum tag length supported by libSRTP
  */
 
-#define SRTP_MAX_TAG_LEN 12 
+#define SRTP_MAX_TAG_LEN 16 
 
 /**
  * SRTP_MAX_TRAILER_LEN is the maximum length of the SRTP trailer
@@ -342,6 +342,60 @@ err_status_t
 srtp_unprotect(srtp_t ctx, void *srtp_hdr, int *len_ptr);
 
 
+/**
+ * @brief srtp_protect_batch() applies srtp_protect() to several
+ * packets.
+ *
+ * The function call srtp_protect_batch(ctx, rtp_hdr, len, status, n)
+ * has the same effect as calling srtp_protect(ctx, rtp_hdr[i],
+ * &len[i]) for each i from 0 to n-1, in that order, but the stream
+ * found for a packet is kept for the following ones as long as their
+ * SSRC does not change, as is the case for the fragments of a video
+ * frame or for a burst of packets read with a single system call.
+ * With the aes instructions cipher, the keystream of the packets is
+ * generated in one pass over their counter blocks before they are
+ * authenticated, which keeps the instructions busy for short packets.
+ *
+ * @param ctx is the session context.
+ *
+ * @param rtp_hdr is an array of n pointers to RTP packets, each with
+ * room for SRTP_MAX_TRAILER_LEN octets after it.
+ *
+ * @param len_ptr is an array of n packet lengths, updated as
+ * srtp_protect() does.
+ *
+ * @param status is either NULL or an array of n elements, set to the
+ * status of each packet.
+ *
+ * @param num_pkts is the number of packets.
+ *
+ * @return err_status_ok if all packets were protected, otherwise the
+ * status of the first packet that was not.
+ */
+
+err_status_t
+srtp_protect_batch(srtp_t ctx, void *rtp_hdr[], int len_ptr[],
+		   err_status_t status[], int num_pkts);
+
+/**
+ * @brief srtp_unprotect_batch() applies srtp_unprotect() to several
+ * packets.
+ *
+ * The function call srtp_unprotect_batch(ctx, srtp_hdr, len, status,
+ * n) has the same effect as calling srtp_unprotect(ctx, srtp_hdr[i],
+ * &len[i]) for each i from 0 to n-1, in that order; see
+ * srtp_protect_batch().  A packet failing the checks does not prevent
+ * the following ones from being processed.
+ *
+ * @return err_status_ok if all packets are valid, otherwise the status
+ * of the first packet that is not.
+ */
+
+err_status_t
+srtp_unprotect_batch(srtp_t ctx, void *srtp_hdr[], int len_ptr[],
+		     err_status_t status[], int num_pkts);
+
+
 /**
  * @brief srtp_create() allocates and initializes an SRTP session.
 
@@ -568,6 +622,43 @@ crypto_policy_set_aes_cm_128_null_auth(crypto_policy_t *p);
 void
 crypto_policy_set_null_cipher_hmac_sha1_80(crypto_policy_t *p);
 
+/**
+ * @brief crypto_policy_set_aes_gcm_128_16_auth() sets a crypto
+ * policy structure to the AEAD_AES_128_GCM policy
+ *
+ * @param p is a pointer to the policy structure to be set 
+ * 
+ * The function call crypto_policy_set_aes_gcm_128_16_auth(&p) sets
+ * the crypto_policy_t at location p to use AES-128 Galois/Counter
+ * Mode, which provides both encryption and message authentication
+ * with a 16 octet tag, as specified by RFC 7714.  The master key is
+ * 16 octets and the master salt 12 octets.
+ * 
+ * @return void.
+ * 
+ */
+
+void
+crypto_policy_set_aes_gcm_128_16_auth(crypto_policy_t *p);
+
+/**
+ * @brief crypto_policy_set_aes_gcm_256_16_auth() sets a crypto
+ * policy structure to the AEAD_AES_256_GCM policy
+ *
+ * @param p is a pointer to the policy structure to be set 
+ * 
+ * The function call crypto_policy_set_aes_gcm_256_16_auth(&p) sets
+ * the crypto_policy_t at location p to use AES-256 Galois/Counter
+ * Mode with a 16 octet tag, as specified by RFC 7714.  The master key
+ * is 32 octets and the master salt 12 octets.
+ * 
+ * @return void.
+ * 
+ */
+
+void
+crypto_policy_set_aes_gcm_256_16_auth(crypto_policy_t *p);
+
 /**
  * @brief srtp_dealloc() deallocates storage for an SRTP session
  * context.
@@ -604,6 +695,8 @@ typedef enum {
   srtp_profile_aes256_cm_sha1_32  = 4,
   srtp_profile_null_sha1_80       = 5,
   srtp_profile_null_sha1_32       = 6,
+  srtp_profile_aead_aes_128_gcm   = 7,
+  srtp_profile_aead_aes_256_gcm   = 8,
 } srtp_profile_t;
 
 
@@ -169,6 +169,14 @@ typedef struct {
 srtp_stream_t 
 srtp_get_stream(srtp_t srtp, uint32_t ssrc);
 
+/*
+ * srtp_insert_stream(srtp, s) adds the stream s to the stream list
+ * and to the table used by srtp_get_stream()
+ */
+
+err_status_t
+srtp_insert_stream(srtp_t srtp, srtp_stream_t stream);
+
 
 /*
  * srtp_stream_init_keys(s, k) (re)initializes the srtp_stream_t s by
@@ -215,11 +223,19 @@ typedef struct srtp_stream_ctx_t {
 
 /*
  * an srtp_ctx_t holds a stream list and a service description
+ *
+ * the streams of the list are also indexed by ssrc in stream_table,
+ * an open addressing (linear probing) hash table that is kept at most
+ * half full, so that finding the stream of a packet does not depend
+ * on the number of streams
  */
 
 typedef struct srtp_ctx_t {
   srtp_stream_ctx_t *stream_list;     /* linked list of streams            */
   srtp_stream_ctx_t *stream_template; /* act as template for other streams */
+  srtp_stream_ctx_t **stream_table;   /* streams by ssrc, NULL if empty    */
+  unsigned int stream_table_size;     /* slots in table, a power of two    */
+  unsigned int num_streams;           /* streams in the table              */
 } srtp_ctx_t;
 
 
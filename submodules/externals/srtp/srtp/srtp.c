@@ -45,6 +45,7 @@
 
 #include "srtp_priv.h"
 #include "aes_icm.h"         /* aes_icm is used in the KDF  */
+#include "aes_gcm.h"         /* for the aead transforms     */
 #include "alloc.h"           /* for crypto_alloc()          */
 
 #ifndef SRTP_KERNEL
@@ -283,7 +284,8 @@ srtp_stream_clone(const srtp_stream_ctx_t *stream_template,
  *
  * srtp_kdf_t is a key derivation context
  *
- * srtp_kdf_init(&kdf, k) initializes kdf with the key k
+ * srtp_kdf_init(&kdf, k, kl, sl) initializes kdf with the master key
+ * k of kl octets, followed by a master salt of sl octets
  * 
  * srtp_kdf_generate(&kdf, l, kl, keylen) derives the key
  * corresponding to label l and puts it into kl; the length
@@ -305,17 +307,38 @@ typedef enum {
 
 /*
  * srtp_kdf_t represents a key derivation function.  The SRTP
- * default KDF is the only one implemented at present.
+ * default KDF is the only one implemented at present: aes counter
+ * mode keyed with the master key, the counter starting at the master
+ * salt exored with the label.  The master key is 16 octets (the
+ * AES_CM_PRF) or 32 octets (the AES_256_CM_PRF of RFC 6188, used by
+ * AEAD_AES_256_GCM); the 12 octet salt of the aead profiles is padded
+ * with zeros, as required by RFC 7714.
  */
 
 typedef struct { 
-  aes_icm_ctx_t c;    /* cipher used for key derivation  */  
+  aes_expanded_key_256_t round_keys; /* the expanded master key        */
+  int     key_len;                   /* 16 or 32                       */
+  v128_t  offset;                    /* master salt, last octets zero  */
 } srtp_kdf_t;
 
 err_status_t
-srtp_kdf_init(srtp_kdf_t *kdf, const uint8_t key[30]) {
+srtp_kdf_init(srtp_kdf_t *kdf, const uint8_t *key, int key_len,
+	      int salt_len) {
+  v128_t tmp_key;
 
-  aes_icm_context_init(&kdf->c, key);
+  if ((key_len != 16 && key_len != 32) || salt_len > 14)
+    return err_status_bad_param;
+
+  kdf->key_len = key_len;
+  if (key_len == 16) {
+    v128_copy_octet_string(&tmp_key, key);
+    aes_expand_encryption_key(&tmp_key, kdf->round_keys);
+  } else {
+    aes_expand_encryption_key_256(key, kdf->round_keys);
+  }
+
+  v128_set_to_zero(&kdf->offset);
+  memcpy(kdf->offset.v8, key + key_len, salt_len);
 
   return err_status_ok;
 }
@@ -323,17 +346,30 @@ srtp_kdf_init(srtp_kdf_t *kdf, const uint8_t key[30]) {
 err_status_t
 srtp_kdf_generate(srtp_kdf_t *kdf, srtp_prf_label label,
 		  uint8_t *key, int length) {
+  v128_t block;
+  uint16_t i = 0;
+  int n;
+
+  while (length > 0) {
+    /* exor <label> into the eighth octet, the block index into the last two */
+    v128_copy(&block, &kdf->offset);
+    block.v8[7] ^= label;
+    block.v8[14] = (uint8_t)(i >> 8);
+    block.v8[15] = (uint8_t)i;
+    i++;
+
+    if (kdf->key_len == 16)
+      aes_encrypt(&block, kdf->round_keys);
+    else
+      aes_encrypt_256(&block, kdf->round_keys);
+
+    n = length < 16 ? length : 16;
+    memcpy(key, block.v8, n);
+    key += n;
+    length -= n;
+  }
 
-  v128_t nonce;
-  
-  /* set eigth octet of nonce to <label>, set the rest of it to zero */
-  v128_set_to_zero(&nonce);
-  nonce.v8[7] = label;
- 
-  aes_icm_set_iv(&kdf->c, &nonce);  
-  
-  /* generate keystream output */
-  aes_icm_output(&kdf->c, key, length);
+  octet_string_set_to_zero(block.v8, sizeof(block));
 
   return err_status_ok;
 }
@@ -353,6 +389,17 @@ srtp_kdf_clear(srtp_kdf_t *kdf) {
 
 #define MAX_SRTP_KEY_LEN 256
 
+/*
+ * srtp_cipher_base_key_len(c) returns the number of octets of the
+ * key of the cipher c that precede its salt
+ */
+
+static int
+srtp_cipher_base_key_len(const cipher_t *c) {
+  if (cipher_type_is_aes_gcm(c->type))
+    return cipher_get_key_length(c) - AES_GCM_SALT_LEN;
+  return 16;
+}
 
 err_status_t
 srtp_stream_init_keys(srtp_stream_ctx_t *srtp, const void *key) {
@@ -360,8 +407,18 @@ srtp_stream_init_keys(srtp_stream_ctx_t *srtp, const void *key) {
   srtp_kdf_t kdf;
   uint8_t tmp_key[MAX_SRTP_KEY_LEN];
   
-  /* initialize KDF state     */
-  srtp_kdf_init(&kdf, (const uint8_t *)key);
+  /*
+   * initialize KDF state - the aead profiles have a 12 octet salt
+   * and, for AEAD_AES_256_GCM, a 32 octet master key
+   */
+  if (cipher_type_is_aes_gcm(srtp->rtp_cipher->type))
+    stat = srtp_kdf_init(&kdf, (const uint8_t *)key,
+			 srtp_cipher_base_key_len(srtp->rtp_cipher),
+			 AES_GCM_SALT_LEN);
+  else
+    stat = srtp_kdf_init(&kdf, (const uint8_t *)key, 16, 14);
+  if (stat)
+    return err_status_init_fail;
   
   /* generate encryption key  */
   srtp_kdf_generate(&kdf, label_rtp_encryption, 
@@ -370,12 +427,12 @@ srtp_stream_init_keys(srtp_stream_ctx_t *srtp, const void *key) {
    * if the cipher in the srtp context is aes_icm, then we need
    * to generate the salt value
    */
-  if (srtp->rtp_cipher->type == &aes_icm) {
-    /* FIX!!! this is really the cipher key length; rest is salt */
-    int base_key_len = 16;
+  if (cipher_type_is_aes_icm(srtp->rtp_cipher->type)
+      || cipher_type_is_aes_gcm(srtp->rtp_cipher->type)) {
+    int base_key_len = srtp_cipher_base_key_len(srtp->rtp_cipher);
     int salt_len = cipher_get_key_length(srtp->rtp_cipher) - base_key_len;
     
-    debug_print(mod_srtp, "found aes_icm, generating salt", NULL);
+    debug_print(mod_srtp, "found aes_icm or aes_gcm, generating salt", NULL);
 
     /* generate encryption salt, put after encryption key */
     srtp_kdf_generate(&kdf, label_rtp_salt, 
@@ -419,12 +476,13 @@ srtp_stream_init_keys(srtp_stream_ctx_t *srtp, const void *key) {
    * if the cipher in the srtp context is aes_icm, then we need
    * to generate the salt value
    */
-  if (srtp->rtcp_cipher->type == &aes_icm) {
-    /* FIX!!! this is really the cipher key length; rest is salt */
-    int base_key_len = 16;
+  if (cipher_type_is_aes_icm(srtp->rtcp_cipher->type)
+      || cipher_type_is_aes_gcm(srtp->rtcp_cipher->type)) {
+    int base_key_len = srtp_cipher_base_key_len(srtp->rtcp_cipher);
     int salt_len = cipher_get_key_length(srtp->rtcp_cipher) - base_key_len;
 
-    debug_print(mod_srtp, "found aes_icm, generating rtcp salt", NULL);
+    debug_print(mod_srtp, "found aes_icm or aes_gcm, generating rtcp salt",
+		NULL);
 
     /* generate encryption salt, put after encryption key */
     srtp_kdf_generate(&kdf, label_rtcp_salt, 
@@ -568,8 +626,309 @@ srtp_stream_init(srtp_stream_ctx_t *srtp,
    return err_status_ok;
  }
 
- err_status_t
- srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
+/*
+ * the aead transforms of RFC 7714 (AEAD_AES_128_GCM and
+ * AEAD_AES_256_GCM): the rtp header, up to the end of the header
+ * extension, is the additional authenticated data, the payload is
+ * encrypted and followed by the tag of the cipher, and there is no
+ * separate authentication function
+ *
+ * the 12 octet iv is 00 00 || SSRC || ROC || SEQ, the cipher exors
+ * it with the session salt
+ */
+
+static void
+srtp_calc_aead_iv(v128_t *iv, const srtp_hdr_t *hdr, xtd_seq_num_t est) {
+  v128_set_to_zero(iv);
+  memcpy(iv->v8 + 2, &hdr->ssrc, 4);  /* still in network order */
+#ifdef NO_64BIT_MATH
+  est = be64_to_cpu(make64((high32(est) << 16) | (low32(est) >> 16),
+			   low32(est) << 16));
+#else
+  est = be64_to_cpu(est << 16);
+#endif
+  memcpy(iv->v8 + 6, &est, 6);
+}
+
+/* returns the number of octets of the rtp header, with csrcs and extension */
+static int
+srtp_get_rtp_header_len(const srtp_hdr_t *hdr, int pkt_octet_len) {
+  int len = octets_in_rtp_header + 4 * hdr->cc;
+
+  if (hdr->x == 1) {
+    const srtp_hdr_xtnd_t *xtn_hdr;
+
+    if (len + 4 > pkt_octet_len)
+      return -1;
+    xtn_hdr = (const srtp_hdr_xtnd_t *)((const uint8_t *)hdr + len);
+    len += 4 * (ntohs(xtn_hdr->length) + 1);
+  }
+  if (len > pkt_octet_len)
+    return -1;
+  return len;
+}
+
+static err_status_t
+srtp_protect_aead(srtp_ctx_t *ctx, srtp_stream_ctx_t *stream,
+		  void *rtp_hdr, int *pkt_octet_len) {
+  srtp_hdr_t *hdr = (srtp_hdr_t *)rtp_hdr;
+  aes_gcm_ctx_t *gcm = (aes_gcm_ctx_t *)stream->rtp_cipher->state;
+  unsigned int enc_octet_len;
+  int aad_len;
+  xtd_seq_num_t est;
+  int delta;
+  v128_t iv;
+  err_status_t status;
+
+  aad_len = srtp_get_rtp_header_len(hdr, *pkt_octet_len);
+  if (aad_len < 0)
+    return err_status_bad_param;
+
+  /* without confidentiality the whole packet is authenticated data */
+  if (!(stream->rtp_services & sec_serv_conf))
+    aad_len = *pkt_octet_len;
+  enc_octet_len = (unsigned int)(*pkt_octet_len - aad_len);
+
+  /* estimate the packet index and check that it is not reused */
+  delta = rdbx_estimate_index(&stream->rtp_rdbx, &est, ntohs(hdr->seq));
+  status = rdbx_check(&stream->rtp_rdbx, delta);
+  if (status)
+    return status;
+  rdbx_add_index(&stream->rtp_rdbx, delta);
+
+  srtp_calc_aead_iv(&iv, hdr, est);
+  status = aes_gcm_set_iv(gcm, &iv);
+  if (status)
+    return err_status_cipher_fail;
+  status = aes_gcm_set_aad(gcm, (uint8_t *)hdr, aad_len);
+  if (status)
+    return err_status_cipher_fail;
+
+  /* encrypt the payload, the tag is written after it */
+  status = aes_gcm_encrypt(gcm, (uint8_t *)hdr + aad_len, &enc_octet_len);
+  if (status)
+    return err_status_cipher_fail;
+
+  *pkt_octet_len += AES_GCM_TAG_LEN;
+
+  return err_status_ok;
+}
+
+static err_status_t
+srtp_unprotect_aead(srtp_ctx_t *ctx, srtp_stream_ctx_t *stream, int delta,
+		    xtd_seq_num_t est, void *srtp_hdr, int *pkt_octet_len) {
+  srtp_hdr_t *hdr = (srtp_hdr_t *)srtp_hdr;
+  aes_gcm_ctx_t *gcm = (aes_gcm_ctx_t *)stream->rtp_cipher->state;
+  unsigned int enc_octet_len;
+  int aad_len;
+  v128_t iv;
+  err_status_t status;
+
+  if (*pkt_octet_len < octets_in_rtp_header + AES_GCM_TAG_LEN)
+    return err_status_bad_param;
+  aad_len = srtp_get_rtp_header_len(hdr, *pkt_octet_len - AES_GCM_TAG_LEN);
+  if (aad_len < 0)
+    return err_status_bad_param;
+  if (!(stream->rtp_services & sec_serv_conf))
+    aad_len = *pkt_octet_len - AES_GCM_TAG_LEN;
+  enc_octet_len = (unsigned int)(*pkt_octet_len - aad_len);
+
+  srtp_calc_aead_iv(&iv, hdr, est);
+  status = aes_gcm_set_iv(gcm, &iv);
+  if (status)
+    return err_status_cipher_fail;
+  status = aes_gcm_set_aad(gcm, (uint8_t *)hdr, aad_len);
+  if (status)
+    return err_status_cipher_fail;
+
+  /* decrypt the payload and check the tag */
+  status = aes_gcm_decrypt(gcm, (uint8_t *)hdr + aad_len, &enc_octet_len);
+  if (status)
+    return err_status_auth_fail;
+
+  /* 
+   * the packet is authentic, so update the key usage limit
+   */
+  switch(key_limit_update(stream->limit)) {
+  case key_event_normal:
+    break;
+  case key_event_soft_limit: 
+    srtp_handle_event(ctx, stream, event_key_soft_limit);
+    break; 
+  case key_event_hard_limit:
+    srtp_handle_event(ctx, stream, event_key_hard_limit);
+    return err_status_key_expired;
+  default:
+    break;
+  }
+
+  /* verify that stream is for received traffic, see srtp_unprotect() */
+  if (stream->direction != dir_srtp_receiver) {
+    if (stream->direction == dir_unknown) {
+      stream->direction = dir_srtp_receiver;
+    } else {
+      srtp_handle_event(ctx, stream, event_ssrc_collision);
+    }
+  }
+
+  /* replace a provisional stream by a new one, see srtp_unprotect() */
+  if (stream == ctx->stream_template) {  
+    srtp_stream_ctx_t *new_stream;
+
+    status = srtp_stream_clone(ctx->stream_template, hdr->ssrc, &new_stream); 
+    if (status)
+      return status;
+    
+    status = srtp_insert_stream(ctx, new_stream);
+    if (status) {
+      srtp_stream_dealloc(ctx, new_stream);
+      return status;
+    }
+    stream = new_stream;
+  }
+  
+  rdbx_add_index(&stream->rtp_rdbx, delta);
+
+  *pkt_octet_len -= AES_GCM_TAG_LEN;
+
+  return err_status_ok;  
+}
+
+/*
+ * a packet of a batch whose aes icm keystream is generated together
+ * with the keystream of the other packets, by srtp_batch_encrypt():
+ * the cipher and the counter set for the packet, the octets to
+ * encrypt or decrypt, and what srtp_protect_auth() needs once the
+ * packet is encrypted
+ */
+typedef struct {
+  cipher_t *cipher;          /* NULL if the packet is not deferred */
+  v128_t counter;
+  uint8_t *enc_start;
+  unsigned int enc_octet_len;
+  srtp_stream_ctx_t *stream;
+  uint32_t *auth_start;
+  uint8_t *auth_tag;
+  xtd_seq_num_t est;         /* shifted, in network byte order */
+  int *pkt_octet_len;
+} srtp_deferred_t;
+
+#define SRTP_BATCH_DEFERRED 32   /* packets whose keystream is made at once */
+
+/*
+ * the keystream of a packet can be deferred when it comes from the aes
+ * instructions, and no part of it is used before the payload is
+ * encrypted (there is no universal hash prefix)
+ */
+static inline int
+srtp_can_defer(srtp_stream_ctx_t *stream, unsigned int enc_octet_len) {
+  return stream->rtp_cipher->type == &aes_icm_hw &&
+    auth_get_prefix_length(stream->rtp_auth) == 0 &&
+    enc_octet_len <= 0xffff;
+}
+
+static void
+srtp_defer(srtp_deferred_t *deferred, srtp_stream_ctx_t *stream,
+	   uint32_t *enc_start, unsigned int enc_octet_len) {
+  deferred->cipher = stream->rtp_cipher;
+  v128_copy(&deferred->counter,
+	    &((aes_icm_ctx_t *)stream->rtp_cipher->state)->counter);
+  deferred->enc_start = (uint8_t *)enc_start;
+  deferred->enc_octet_len = enc_octet_len;
+  deferred->stream = stream;
+}
+
+/*
+ * srtp_batch_encrypt() xors the keystream into the deferred packets,
+ * the consecutive packets using the same cipher in a single call
+ */
+static void
+srtp_batch_encrypt(srtp_deferred_t deferred[], int num) {
+  v128_t counters[SRTP_BATCH_DEFERRED];
+  uint8_t *bufs[SRTP_BATCH_DEFERRED];
+  unsigned int lens[SRTP_BATCH_DEFERRED];
+  cipher_t *cipher = NULL;
+  int i, n = 0;
+
+  for (i=0; i <= num; i++) {
+    if (i < num && deferred[i].cipher == NULL)
+      continue;
+    if (n > 0 && (i == num || deferred[i].cipher != cipher)) {
+      aes_icm_hw_encrypt_multi((aes_icm_ctx_t *)cipher->state,
+			       counters, bufs, lens, n);
+      n = 0;
+    }
+    if (i == num)
+      break;
+    cipher = deferred[i].cipher;
+    v128_copy(&counters[n], &deferred[i].counter);
+    bufs[n] = deferred[i].enc_start;
+    lens[n] = deferred[i].enc_octet_len;
+    n++;
+  }
+}
+
+/*
+ * srtp_protect_auth() computes the authentication tag of an encrypted
+ * packet, the last step of srtp_protect()
+ */
+static err_status_t
+srtp_protect_auth(srtp_stream_ctx_t *stream, uint32_t *auth_start,
+		  uint8_t *auth_tag, xtd_seq_num_t est, int *pkt_octet_len) {
+  err_status_t status;
+  int tag_len;
+
+  /* get tag length from stream */
+  tag_len = auth_get_tag_length(stream->rtp_auth); 
+
+  /*
+   *  if we're authenticating, run authentication function and put result
+   *  into the auth_tag 
+   */
+  if (auth_start) {        
+
+    /* initialize auth func context */
+    status = auth_start(stream->rtp_auth);
+    if (status) return status;
+
+    /* run auth func over packet */
+    status = auth_update(stream->rtp_auth, 
+			 (uint8_t *)auth_start, *pkt_octet_len);
+    if (status) return status;
+    
+    /* run auth func over ROC, put result into auth_tag */
+    debug_print(mod_srtp, "estimated packet index: %016llx", est);
+    status = auth_compute(stream->rtp_auth, (uint8_t *)&est, 4, auth_tag); 
+    debug_print(mod_srtp, "srtp auth tag:    %s", 
+		octet_string_hex_string(auth_tag, tag_len));
+    if (status)
+      return err_status_auth_fail;   
+
+  }
+
+  if (auth_tag) {
+
+    /* increase the packet length by the length of the auth tag */
+    *pkt_octet_len += tag_len;
+  }
+
+  return err_status_ok;  
+}
+
+/*
+ * srtp_protect_one() and srtp_unprotect_one() process a packet like
+ * srtp_protect() and srtp_unprotect(); *last_stream is either NULL or
+ * the stream used for a previous packet, which is reused if the ssrc
+ * matches, and is set to the stream used for this packet.  If deferred
+ * is not NULL and the packet can be, its encryption is left to
+ * srtp_batch_encrypt(), and for srtp_protect_one() the authentication
+ * too, and deferred is set for it
+ */
+
+static err_status_t
+srtp_protect_one(srtp_ctx_t *ctx, srtp_stream_ctx_t **last_stream,
+		 void *rtp_hdr, int *pkt_octet_len,
+		 srtp_deferred_t *deferred) {
    srtp_hdr_t *hdr = (srtp_hdr_t *)rtp_hdr;
    uint32_t *enc_start;        /* pointer to start of encrypted portion  */
    uint32_t *auth_start;       /* pointer to start of auth. portion      */
@@ -578,7 +937,6 @@ srtp_stream_init(srtp_stream_ctx_t *srtp,
    int delta;                  /* delta of local pkt idx and that in hdr */
    uint8_t *auth_tag = NULL;   /* location of auth_tag within packet     */
    err_status_t status;   
-   int tag_len;
    srtp_stream_ctx_t *stream;
    int prefix_len;
 
@@ -597,7 +955,9 @@ srtp_stream_init(srtp_stream_ctx_t *srtp,
     * supports key-sharing, then we assume that a new stream using
     * that key has just started up
     */
-   stream = srtp_get_stream(ctx, hdr->ssrc);
+   stream = *last_stream;
+   if (stream == NULL || stream->ssrc != hdr->ssrc)
+     stream = srtp_get_stream(ctx, hdr->ssrc);
    if (stream == NULL) {
      if (ctx->stream_template != NULL) {
        srtp_stream_ctx_t *new_stream;
@@ -608,9 +968,12 @@ srtp_stream_init(srtp_stream_ctx_t *srtp,
        if (status)
 	 return status;
 
-       /* add new stream to the head of the stream_list */
-       new_stream->next = ctx->stream_list;
-       ctx->stream_list = new_stream;
+       /* add new stream to the stream list and table */
+       status = srtp_insert_stream(ctx, new_stream);
+       if (status) {
+         srtp_stream_dealloc(ctx, new_stream);
+         return status;
+       }
 
        /* set direction to outbound */
        new_stream->direction = dir_srtp_sender;
@@ -622,6 +985,7 @@ srtp_stream_init(srtp_stream_ctx_t *srtp,
        return err_status_no_ctx;
      } 
    }
+   *last_stream = stream;
 
    /* 
     * verify that stream is for sending traffic - this check will
@@ -655,8 +1019,9 @@ srtp_stream_init(srtp_stream_ctx_t *srtp,
     break;
   }
 
-   /* get tag length from stream */
-   tag_len = auth_get_tag_length(stream->rtp_auth); 
+   /* the aead transforms have their own packet processing */
+   if (cipher_type_is_aes_gcm(stream->rtp_cipher->type))
+     return srtp_protect_aead(ctx, stream, rtp_hdr, pkt_octet_len);
 
    /*
     * find starting point for encryption and length of data to be
@@ -711,7 +1076,7 @@ srtp_stream_init(srtp_stream_ctx_t *srtp,
    /* 
     * if we're using rindael counter mode, set nonce and seq 
     */
-   if (stream->rtp_cipher->type == &aes_icm) {
+   if (cipher_type_is_aes_icm(stream->rtp_cipher->type)) {
      v128_t iv;
 
      iv.v32[0] = 0;
@@ -748,6 +1113,17 @@ srtp_stream_init(srtp_stream_ctx_t *srtp,
 #else
    est = be64_to_cpu(est << 16);
 #endif
+
+   /* in a batch, the packet is encrypted with the other packets */
+   if (deferred != NULL && enc_start &&
+       srtp_can_defer(stream, enc_octet_len)) {
+     srtp_defer(deferred, stream, enc_start, enc_octet_len);
+     deferred->auth_start = auth_start;
+     deferred->auth_tag = auth_tag;
+     deferred->est = est;
+     deferred->pkt_octet_len = pkt_octet_len;
+     return err_status_ok;
+   }
    
    /* 
     * if we're authenticating using a universal hash, put the keystream
@@ -773,43 +1149,58 @@ srtp_stream_init(srtp_stream_ctx_t *srtp,
       return err_status_cipher_fail;
   }
 
-  /*
-   *  if we're authenticating, run authentication function and put result
-   *  into the auth_tag 
-   */
-  if (auth_start) {        
+  return srtp_protect_auth(stream, auth_start, auth_tag, est, pkt_octet_len);
+}
 
-    /* initialize auth func context */
-    status = auth_start(stream->rtp_auth);
-    if (status) return status;
 
-    /* run auth func over packet */
-    status = auth_update(stream->rtp_auth, 
-			 (uint8_t *)auth_start, *pkt_octet_len);
-    if (status) return status;
-    
-    /* run auth func over ROC, put result into auth_tag */
-    debug_print(mod_srtp, "estimated packet index: %016llx", est);
-    status = auth_compute(stream->rtp_auth, (uint8_t *)&est, 4, auth_tag); 
-    debug_print(mod_srtp, "srtp auth tag:    %s", 
-		octet_string_hex_string(auth_tag, tag_len));
-    if (status)
-      return err_status_auth_fail;   
+err_status_t
+srtp_protect(srtp_ctx_t *ctx, void *rtp_hdr, int *pkt_octet_len) {
+  srtp_stream_ctx_t *stream = NULL;
 
-  }
+  return srtp_protect_one(ctx, &stream, rtp_hdr, pkt_octet_len, NULL);
+}
 
-  if (auth_tag) {
+err_status_t
+srtp_protect_batch(srtp_ctx_t *ctx, void *rtp_hdr[], int pkt_octet_len[],
+		   err_status_t status[], int num_pkts) {
+  srtp_deferred_t deferred[SRTP_BATCH_DEFERRED];
+  err_status_t err[SRTP_BATCH_DEFERRED];
+  srtp_stream_ctx_t *stream = NULL;
+  err_status_t first_error = err_status_ok;
+  int first, i, n;
+
+  for (first=0; first < num_pkts; first += n) {
+    n = num_pkts - first;
+    if (n > SRTP_BATCH_DEFERRED)
+      n = SRTP_BATCH_DEFERRED;
+
+    for (i=0; i < n; i++) {
+      deferred[i].cipher = NULL;
+      err[i] = srtp_protect_one(ctx, &stream, rtp_hdr[first + i],
+				&pkt_octet_len[first + i], &deferred[i]);
+    }
 
-    /* increase the packet length by the length of the auth tag */
-    *pkt_octet_len += tag_len;
+    /* encrypt the deferred packets together, then authenticate them */
+    srtp_batch_encrypt(deferred, n);
+    for (i=0; i < n; i++) {
+      if (deferred[i].cipher != NULL)
+	err[i] = srtp_protect_auth(deferred[i].stream, deferred[i].auth_start,
+				   deferred[i].auth_tag, deferred[i].est,
+				   deferred[i].pkt_octet_len);
+      if (status != NULL)
+	status[first + i] = err[i];
+      if (err[i] && !first_error)
+	first_error = err[i];
+    }
   }
 
-  return err_status_ok;  
+  return first_error;
 }
 
-
-err_status_t
-srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len) {
+static err_status_t
+srtp_unprotect_one(srtp_ctx_t *ctx, srtp_stream_ctx_t **last_stream,
+		   void *srtp_hdr, int *pkt_octet_len,
+		   srtp_deferred_t *deferred) {
   srtp_hdr_t *hdr = (srtp_hdr_t *)srtp_hdr;
   uint32_t *enc_start;      /* pointer to start of encrypted portion  */
   uint32_t *auth_start;     /* pointer to start of auth. portion      */
@@ -838,7 +1229,11 @@ srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len) {
    * supports key-sharing, then we assume that a new stream using
    * that key has just started up
    */
-  stream = srtp_get_stream(ctx, hdr->ssrc);
+  stream = *last_stream;
+  if (stream == NULL || stream->ssrc != hdr->ssrc)
+    stream = srtp_get_stream(ctx, hdr->ssrc);
+  /* the provisional stream is not kept for the next packet */
+  *last_stream = stream;
   if (stream == NULL) {
     if (ctx->stream_template != NULL) {
       stream = ctx->stream_template;
@@ -881,6 +1276,11 @@ srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len) {
   debug_print(mod_srtp, "estimated u_packet index: %016llx", est);
 #endif
 
+  /* the aead transforms have their own packet processing */
+  if (cipher_type_is_aes_gcm(stream->rtp_cipher->type))
+    return srtp_unprotect_aead(ctx, stream, delta, est,
+			       srtp_hdr, pkt_octet_len);
+
   /* get tag length from stream */
   tag_len = auth_get_tag_length(stream->rtp_auth); 
 
@@ -888,7 +1288,7 @@ srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len) {
    * set the cipher's IV properly, depending on whatever cipher we
    * happen to be using
    */
-  if (stream->rtp_cipher->type == &aes_icm) {
+  if (cipher_type_is_aes_icm(stream->rtp_cipher->type)) {
 
     /* aes counter mode */
     iv.v32[0] = 0;
@@ -1022,10 +1422,15 @@ srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len) {
 
   /* if we're encrypting, add keystream into ciphertext */
   if (enc_start) {
-    status = cipher_encrypt(stream->rtp_cipher, 
-			    (uint8_t *)enc_start, &enc_octet_len);
-    if (status)
-      return err_status_cipher_fail;
+    if (deferred != NULL && srtp_can_defer(stream, enc_octet_len)) {
+      /* in a batch, the packet is decrypted with the other packets */
+      srtp_defer(deferred, stream, enc_start, enc_octet_len);
+    } else {
+      status = cipher_encrypt(stream->rtp_cipher, 
+			      (uint8_t *)enc_start, &enc_octet_len);
+      if (status)
+	return err_status_cipher_fail;
+    }
   }
 
   /* 
@@ -1065,9 +1470,12 @@ srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len) {
     if (status)
       return status;
     
-    /* add new stream to the head of the stream_list */
-    new_stream->next = ctx->stream_list;
-    ctx->stream_list = new_stream;
+    /* add new stream to the stream list and table */
+    status = srtp_insert_stream(ctx, new_stream);
+    if (status) {
+      srtp_stream_dealloc(ctx, new_stream);
+      return status;
+    }
     
     /* set stream (the pointer used in this function) */
     stream = new_stream;
@@ -1085,6 +1493,45 @@ srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len) {
   return err_status_ok;  
 }
 
+
+err_status_t
+srtp_unprotect(srtp_ctx_t *ctx, void *srtp_hdr, int *pkt_octet_len) {
+  srtp_stream_ctx_t *stream = NULL;
+
+  return srtp_unprotect_one(ctx, &stream, srtp_hdr, pkt_octet_len, NULL);
+}
+
+err_status_t
+srtp_unprotect_batch(srtp_ctx_t *ctx, void *srtp_hdr[], int pkt_octet_len[],
+		     err_status_t status[], int num_pkts) {
+  srtp_deferred_t deferred[SRTP_BATCH_DEFERRED];
+  srtp_stream_ctx_t *stream = NULL;
+  err_status_t first_error = err_status_ok;
+  err_status_t err;
+  int first, i, n;
+
+  for (first=0; first < num_pkts; first += n) {
+    n = num_pkts - first;
+    if (n > SRTP_BATCH_DEFERRED)
+      n = SRTP_BATCH_DEFERRED;
+
+    for (i=0; i < n; i++) {
+      deferred[i].cipher = NULL;
+      err = srtp_unprotect_one(ctx, &stream, srtp_hdr[first + i],
+			       &pkt_octet_len[first + i], &deferred[i]);
+      if (status != NULL)
+	status[first + i] = err;
+      if (err && !first_error)
+	first_error = err;
+    }
+
+    /* decrypt the deferred packets together */
+    srtp_batch_encrypt(deferred, n);
+  }
+
+  return first_error;
+}
+
 err_status_t
 srtp_init() {
   err_status_t status;
@@ -1128,22 +1575,135 @@ srtp_get_trailer_length(const srtp_stream_t s) {
  * this is an internal function 
  */
 
+/* srtp_stream_table_hash(ssrc, mask) returns the home slot of ssrc */
+
+static inline unsigned int
+srtp_stream_table_hash(uint32_t ssrc, unsigned int mask) {
+  uint32_t h = ssrc * 0x9e3779b1U;   /* mixes the octets of the ssrc */
+
+  return (h ^ (h >> 16)) & mask;
+}
+
 srtp_stream_ctx_t *
 srtp_get_stream(srtp_t srtp, uint32_t ssrc) {
   srtp_stream_ctx_t *stream;
+  unsigned int mask, i;
 
-  /* walk down list until ssrc is found */
-  stream = srtp->stream_list;
-  while (stream != NULL) {
+  if (srtp->stream_table == NULL)
+    return NULL;
+
+  /* probe from the home slot until ssrc or an empty slot is found */
+  mask = srtp->stream_table_size - 1;
+  i = srtp_stream_table_hash(ssrc, mask);
+  while ((stream = srtp->stream_table[i]) != NULL) {
     if (stream->ssrc == ssrc)
       return stream;
-    stream = stream->next;
+    i = (i + 1) & mask;
   }
   
   /* we haven't found our ssrc, so return a null */
   return NULL;
 }
 
+/*
+ * srtp_stream_table_add(srtp, s) puts s in the table, in place of
+ * any stream with the same ssrc (the newest stream wins, as when the
+ * streams were only kept in a list)
+ */
+
+static void
+srtp_stream_table_add(srtp_t srtp, srtp_stream_ctx_t *stream) {
+  unsigned int mask = srtp->stream_table_size - 1;
+  unsigned int i = srtp_stream_table_hash(stream->ssrc, mask);
+
+  while (srtp->stream_table[i] != NULL) {
+    if (srtp->stream_table[i]->ssrc == stream->ssrc) {
+      srtp->stream_table[i] = stream;
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  srtp->stream_table[i] = stream;
+  srtp->num_streams++;
+}
+
+/*
+ * srtp_stream_table_remove(srtp, s) removes s from the table, moving
+ * back the entries that follow it so that no probe sequence is broken
+ */
+
+static void
+srtp_stream_table_remove(srtp_t srtp, srtp_stream_ctx_t *stream) {
+  unsigned int mask, i, j, home;
+
+  if (srtp->stream_table == NULL)
+    return;
+  mask = srtp->stream_table_size - 1;
+  i = srtp_stream_table_hash(stream->ssrc, mask);
+  while (srtp->stream_table[i] != stream) {
+    if (srtp->stream_table[i] == NULL)
+      return;
+    i = (i + 1) & mask;
+  }
+  srtp->stream_table[i] = NULL;
+  srtp->num_streams--;
+
+  for (j = (i + 1) & mask; srtp->stream_table[j] != NULL; j = (j + 1) & mask) {
+    home = srtp_stream_table_hash(srtp->stream_table[j]->ssrc, mask);
+    /* move the entry at j to the hole at i unless its home is in (i, j] */
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      srtp->stream_table[i] = srtp->stream_table[j];
+      srtp->stream_table[j] = NULL;
+      i = j;
+    }
+  }
+}
+
+/* srtp_stream_table_resize(srtp, n) rebuilds the table with n slots */
+
+static err_status_t
+srtp_stream_table_resize(srtp_t srtp, unsigned int size) {
+  srtp_stream_ctx_t **table, *stream;
+
+  table = (srtp_stream_ctx_t **)crypto_alloc(size * sizeof(*table));
+  if (table == NULL)
+    return err_status_alloc_fail;
+  memset(table, 0, size * sizeof(*table));
+
+  if (srtp->stream_table != NULL)
+    crypto_free(srtp->stream_table);
+  srtp->stream_table = table;
+  srtp->stream_table_size = size;
+  srtp->num_streams = 0;
+
+  /* the list starts with the newest streams, older ones are shadowed */
+  for (stream = srtp->stream_list; stream != NULL; stream = stream->next)
+    if (srtp_get_stream(srtp, stream->ssrc) == NULL)
+      srtp_stream_table_add(srtp, stream);
+
+  return err_status_ok;
+}
+
+err_status_t
+srtp_insert_stream(srtp_t srtp, srtp_stream_ctx_t *stream) {
+  err_status_t status;
+
+  /* keep the table at most half full */
+  if (2 * (srtp->num_streams + 1) > srtp->stream_table_size) {
+    unsigned int size = srtp->stream_table_size ? 
+      2 * srtp->stream_table_size : 16;
+    status = srtp_stream_table_resize(srtp, size);
+    if (status)
+      return status;
+  }
+
+  stream->next = srtp->stream_list;
+  srtp->stream_list = stream;
+  srtp_stream_table_add(srtp, stream);
+
+  return err_status_ok;
+}
+
 err_status_t
 srtp_dealloc(srtp_t session) {
   srtp_stream_ctx_t *stream;
@@ -1183,6 +1743,10 @@ srtp_dealloc(srtp_t session) {
     crypto_free(session->stream_template);
   }
 
+  /* deallocate the stream table */
+  if (session->stream_table != NULL)
+    crypto_free(session->stream_table);
+
   /* deallocate session context */
   crypto_free(session);
 
@@ -1237,8 +1801,11 @@ srtp_add_stream(srtp_t session,
     session->stream_template->direction = dir_srtp_receiver;
     break;
   case (ssrc_specific):
-    tmp->next = session->stream_list;
-    session->stream_list = tmp;
+    status = srtp_insert_stream(session, tmp);
+    if (status) {
+      srtp_stream_dealloc(session, tmp);
+      return status;
+    }
     break;
   case (ssrc_undefined):
   default:
@@ -1272,6 +1839,9 @@ srtp_create(srtp_t *session,               /* handle for session     */
    */
   ctx->stream_template = NULL;
   ctx->stream_list = NULL;
+  ctx->stream_table = NULL;
+  ctx->stream_table_size = 0;
+  ctx->num_streams = 0;
   while (policy != NULL) {    
 
     stat = srtp_add_stream(ctx, policy);
@@ -1299,7 +1869,8 @@ srtp_remove_stream(srtp_t session, uint32_t ssrc) {
     return err_status_bad_param;
   
   /* find stream in list; complain if not found */
-  last_stream = stream = session->stream_list;
+  last_stream = NULL;
+  stream = session->stream_list;
   while ((stream != NULL) && (ssrc != stream->ssrc)) {
     last_stream = stream;
     stream = stream->next;
@@ -1307,8 +1878,20 @@ srtp_remove_stream(srtp_t session, uint32_t ssrc) {
   if (stream == NULL)
     return err_status_no_ctx;
 
-  /* remove stream from the list */
-  last_stream->next = stream->next;
+  /* remove stream from the list and the table */
+  if (last_stream == NULL)
+    session->stream_list = stream->next;
+  else
+    last_stream->next = stream->next;
+  srtp_stream_table_remove(session, stream);
+
+  /* an older stream with the same ssrc becomes visible again */
+  for (last_stream = stream->next; last_stream != NULL;
+       last_stream = last_stream->next)
+    if (last_stream->ssrc == ssrc) {
+      srtp_stream_table_add(session, last_stream);
+      break;
+    }
 
   /* deallocate the stream */
   status = srtp_stream_dealloc(session, stream);
@@ -1411,11 +1994,198 @@ crypto_policy_set_null_cipher_hmac_sha1_80(crypto_policy_t *p) {
   
 }
 
+void
+crypto_policy_set_aes_gcm_128_16_auth(crypto_policy_t *p) {
+
+  /*
+   * corresponds to RFC 7714, the tag is produced by the cipher
+   */
+
+  p->cipher_type     = AES_128_GCM;           
+  p->cipher_key_len  = AES_128_GCM_KEY_LEN_WSALT; 
+  p->auth_type       = NULL_AUTH;             
+  p->auth_key_len    = 0; 
+  p->auth_tag_len    = AES_GCM_TAG_LEN; 
+  p->sec_serv        = sec_serv_conf_and_auth;
+  
+}
+
+void
+crypto_policy_set_aes_gcm_256_16_auth(crypto_policy_t *p) {
+
+  p->cipher_type     = AES_256_GCM;           
+  p->cipher_key_len  = AES_256_GCM_KEY_LEN_WSALT; 
+  p->auth_type       = NULL_AUTH;             
+  p->auth_key_len    = 0; 
+  p->auth_tag_len    = AES_GCM_TAG_LEN; 
+  p->sec_serv        = sec_serv_conf_and_auth;
+  
+}
+
 
 /* 
  * secure rtcp functions
  */
 
+/*
+ * the aead transforms for srtcp (RFC 7714 section 9): the packet is
+ * header || encrypted portion || tag || E+index, the additional
+ * authenticated data is the 8 octet header followed by the E+index
+ * word, and the iv is 00 00 || SSRC || 00 00 || E+index with the E
+ * bit cleared
+ */
+
+static void
+srtp_calc_aead_iv_srtcp(v128_t *iv, const srtcp_hdr_t *hdr,
+			uint32_t seq_num) {
+  v128_set_to_zero(iv);
+  memcpy(iv->v8 + 2, &hdr->ssrc, 4);  /* still in network order */
+  iv->v32[2] = htonl(seq_num & SRTCP_INDEX_MASK);
+}
+
+static err_status_t
+srtp_protect_rtcp_aead(srtp_t ctx, srtp_stream_ctx_t *stream,
+		       void *rtcp_hdr, int *pkt_octet_len) {
+  srtcp_hdr_t *hdr = (srtcp_hdr_t *)rtcp_hdr;
+  aes_gcm_ctx_t *gcm = (aes_gcm_ctx_t *)stream->rtcp_cipher->state;
+  unsigned int enc_octet_len;
+  uint32_t trailer;
+  uint32_t seq_num;
+  v128_t iv;
+  err_status_t status;
+
+  if (*pkt_octet_len < octets_in_rtcp_header)
+    return err_status_bad_param;
+  enc_octet_len = *pkt_octet_len - octets_in_rtcp_header;
+
+  status = rdb_increment(&stream->rtcp_rdb);
+  if (status)
+    return status;
+  seq_num = rdb_get_value(&stream->rtcp_rdb);
+  debug_print(mod_srtp, "srtcp index: %x", seq_num);
+
+  if (stream->rtcp_services & sec_serv_conf)
+    trailer = htonl(SRTCP_E_BIT | seq_num);
+  else
+    trailer = htonl(seq_num);
+
+  srtp_calc_aead_iv_srtcp(&iv, hdr, seq_num);
+  status = aes_gcm_set_iv(gcm, &iv);
+  if (status)
+    return err_status_cipher_fail;
+
+  /* without confidentiality the whole packet is authenticated data */
+  if (stream->rtcp_services & sec_serv_conf) {
+    status = aes_gcm_set_aad(gcm, (uint8_t *)hdr, octets_in_rtcp_header);
+  } else {
+    status = aes_gcm_set_aad(gcm, (uint8_t *)hdr, *pkt_octet_len);
+    enc_octet_len = 0;
+  }
+  if (status)
+    return err_status_cipher_fail;
+  status = aes_gcm_set_aad(gcm, (uint8_t *)&trailer, sizeof(trailer));
+  if (status)
+    return err_status_cipher_fail;
+
+  /* encrypt, the tag is written after the encrypted portion */
+  status = aes_gcm_encrypt(gcm,
+			   (uint8_t *)hdr + *pkt_octet_len - enc_octet_len,
+			   &enc_octet_len);
+  if (status)
+    return err_status_cipher_fail;
+
+  /* the E+index word follows the tag */
+  memcpy((uint8_t *)hdr + *pkt_octet_len + AES_GCM_TAG_LEN,
+	 &trailer, sizeof(trailer));
+
+  *pkt_octet_len += AES_GCM_TAG_LEN + sizeof(srtcp_trailer_t);
+
+  return err_status_ok;
+}
+
+static err_status_t
+srtp_unprotect_rtcp_aead(srtp_t ctx, srtp_stream_ctx_t *stream,
+			 void *srtcp_hdr, int *pkt_octet_len) {
+  srtcp_hdr_t *hdr = (srtcp_hdr_t *)srtcp_hdr;
+  aes_gcm_ctx_t *gcm = (aes_gcm_ctx_t *)stream->rtcp_cipher->state;
+  unsigned int enc_octet_len;
+  uint32_t trailer;
+  uint32_t seq_num;
+  int data_len;
+  v128_t iv;
+  err_status_t status;
+
+  data_len = *pkt_octet_len - (AES_GCM_TAG_LEN + sizeof(srtcp_trailer_t));
+  if (data_len < octets_in_rtcp_header)
+    return err_status_bad_param;
+
+  memcpy(&trailer, (uint8_t *)hdr + *pkt_octet_len - sizeof(trailer),
+	 sizeof(trailer));
+  seq_num = ntohl(trailer) & SRTCP_INDEX_MASK;
+  debug_print(mod_srtp, "srtcp index: %x", seq_num);
+  status = rdb_check(&stream->rtcp_rdb, seq_num);
+  if (status)
+    return status;
+
+  srtp_calc_aead_iv_srtcp(&iv, hdr, seq_num);
+  status = aes_gcm_set_iv(gcm, &iv);
+  if (status)
+    return err_status_cipher_fail;
+
+  if (*((unsigned char *)&trailer) & SRTCP_E_BYTE_BIT) {
+    status = aes_gcm_set_aad(gcm, (uint8_t *)hdr, octets_in_rtcp_header);
+    enc_octet_len = data_len - octets_in_rtcp_header;
+  } else {
+    status = aes_gcm_set_aad(gcm, (uint8_t *)hdr, data_len);
+    enc_octet_len = 0;
+  }
+  if (status)
+    return err_status_cipher_fail;
+  status = aes_gcm_set_aad(gcm, (uint8_t *)&trailer, sizeof(trailer));
+  if (status)
+    return err_status_cipher_fail;
+
+  /* decrypt and check the tag */
+  enc_octet_len += AES_GCM_TAG_LEN;
+  status = aes_gcm_decrypt(gcm,
+			   (uint8_t *)hdr + data_len + AES_GCM_TAG_LEN
+			   - enc_octet_len,
+			   &enc_octet_len);
+  if (status)
+    return err_status_auth_fail;
+
+  *pkt_octet_len = data_len;
+
+  /* verify that stream is for received traffic, see srtp_unprotect() */
+  if (stream->direction != dir_srtp_receiver) {
+    if (stream->direction == dir_unknown) {
+      stream->direction = dir_srtp_receiver;
+    } else {
+      srtp_handle_event(ctx, stream, event_ssrc_collision);
+    }
+  }
+
+  /* replace a provisional stream by a new one, see srtp_unprotect() */
+  if (stream == ctx->stream_template) {  
+    srtp_stream_ctx_t *new_stream;
+
+    status = srtp_stream_clone(ctx->stream_template, hdr->ssrc, &new_stream); 
+    if (status)
+      return status;
+    
+    status = srtp_insert_stream(ctx, new_stream);
+    if (status) {
+      srtp_stream_dealloc(ctx, new_stream);
+      return status;
+    }
+    stream = new_stream;
+  }
+
+  rdb_add_index(&stream->rtcp_rdb, seq_num);
+
+  return err_status_ok;
+}
+
 err_status_t 
 srtp_protect_rtcp(srtp_t ctx, void *rtcp_hdr, int *pkt_octet_len) {
   srtcp_hdr_t *hdr = (srtcp_hdr_t *)rtcp_hdr;
@@ -1449,9 +2219,12 @@ srtp_protect_rtcp(srtp_t ctx, void *rtcp_hdr, int *pkt_octet_len) {
       if (status)
 	return status;
       
-      /* add new stream to the head of the stream_list */
-      new_stream->next = ctx->stream_list;
-      ctx->stream_list = new_stream;
+      /* add new stream to the stream list and table */
+      status = srtp_insert_stream(ctx, new_stream);
+      if (status) {
+        srtp_stream_dealloc(ctx, new_stream);
+        return status;
+      }
       
       /* set stream (the pointer used in this function) */
       stream = new_stream;
@@ -1475,6 +2248,10 @@ srtp_protect_rtcp(srtp_t ctx, void *rtcp_hdr, int *pkt_octet_len) {
     }
   }  
 
+  /* the aead transforms have their own packet processing */
+  if (cipher_type_is_aes_gcm(stream->rtcp_cipher->type))
+    return srtp_protect_rtcp_aead(ctx, stream, rtcp_hdr, pkt_octet_len);
+
   /* get tag length from stream context */
   tag_len = auth_get_tag_length(stream->rtcp_auth); 
 
@@ -1523,7 +2300,7 @@ srtp_protect_rtcp(srtp_t ctx, void *rtcp_hdr, int *pkt_octet_len) {
   /* 
    * if we're using rindael counter mode, set nonce and seq 
    */
-  if (stream->rtcp_cipher->type == &aes_icm) {
+  if (cipher_type_is_aes_icm(stream->rtcp_cipher->type)) {
     v128_t iv;
     
     iv.v32[0] = 0;
@@ -1630,6 +2407,10 @@ srtp_unprotect_rtcp(srtp_t ctx, void *srtcp_hdr, int *pkt_octet_len) {
     } 
   }
   
+  /* the aead transforms have their own packet processing */
+  if (cipher_type_is_aes_gcm(stream->rtcp_cipher->type))
+    return srtp_unprotect_rtcp_aead(ctx, stream, srtcp_hdr, pkt_octet_len);
+
   /* get tag length from stream context */
   tag_len = auth_get_tag_length(stream->rtcp_auth); 
 
@@ -1676,7 +2457,7 @@ srtp_unprotect_rtcp(srtp_t ctx, void *srtcp_hdr, int *pkt_octet_len) {
   /* 
    * if we're using aes counter mode, set nonce and seq 
    */
-  if (stream->rtcp_cipher->type == &aes_icm) {
+  if (cipher_type_is_aes_icm(stream->rtcp_cipher->type)) {
     v128_t iv;
 
     iv.v32[0] = 0;
@@ -1778,9 +2559,12 @@ srtp_unprotect_rtcp(srtp_t ctx, void *srtcp_hdr, int *pkt_octet_len) {
     if (status)
       return status;
     
-    /* add new stream to the head of the stream_list */
-    new_stream->next = ctx->stream_list;
-    ctx->stream_list = new_stream;
+    /* add new stream to the stream list and table */
+    status = srtp_insert_stream(ctx, new_stream);
+    if (status) {
+      srtp_stream_dealloc(ctx, new_stream);
+      return status;
+    }
     
     /* set stream (the pointer used in this function) */
     stream = new_stream;
@@ -1817,6 +2601,12 @@ crypto_policy_set_from_profile_for_rtp(crypto_policy_t *policy,
     crypto_policy_set_null_cipher_hmac_sha1_80(policy);
     crypto_policy_set_null_cipher_hmac_sha1_80(policy);
     break;
+  case srtp_profile_aead_aes_128_gcm:
+    crypto_policy_set_aes_gcm_128_16_auth(policy);
+    break;
+  case srtp_profile_aead_aes_256_gcm:
+    crypto_policy_set_aes_gcm_256_16_auth(policy);
+    break;
     /* the following profiles are not (yet) supported */
   case srtp_profile_null_sha1_32:
   case srtp_profile_aes256_cm_sha1_80:
@@ -1843,6 +2633,12 @@ crypto_policy_set_from_profile_for_rtcp(crypto_policy_t *policy,
   case srtp_profile_null_sha1_80:
     crypto_policy_set_null_cipher_hmac_sha1_80(policy);
     break;
+  case srtp_profile_aead_aes_128_gcm:
+    crypto_policy_set_aes_gcm_128_16_auth(policy);
+    break;
+  case srtp_profile_aead_aes_256_gcm:
+    crypto_policy_set_aes_gcm_256_16_auth(policy);
+    break;
     /* the following profiles are not (yet) supported */
   case srtp_profile_null_sha1_32:
   case srtp_profile_aes256_cm_sha1_80:
@@ -1875,6 +2671,12 @@ srtp_profile_get_master_key_length(srtp_profile_t profile) {
   case srtp_profile_null_sha1_80:
     return 16;
     break;
+  case srtp_profile_aead_aes_128_gcm:
+    return 16;
+    break;
+  case srtp_profile_aead_aes_256_gcm:
+    return 32;
+    break;
     /* the following profiles are not (yet) supported */
   case srtp_profile_null_sha1_32:
   case srtp_profile_aes256_cm_sha1_80:
@@ -1897,6 +2699,10 @@ srtp_profile_get_master_salt_length(srtp_profile_t profile) {
   case srtp_profile_null_sha1_80:
     return 14;
     break;
+  case srtp_profile_aead_aes_128_gcm:
+  case srtp_profile_aead_aes_256_gcm:
+    return AES_GCM_SALT_LEN;
+    break;
     /* the following profiles are not (yet) supported */
   case srtp_profile_null_sha1_32:
   case srtp_profile_aes256_cm_sha1_80:
@@ -62,12 +62,29 @@
 err_status_t
 srtp_validate(void);
 
+err_status_t
+srtp_validate_aead(int key_len, const uint8_t *srtp_ref,
+		   const uint8_t *srtcp_ref);
+
+extern const uint8_t rfc7714_srtp_128[], rfc7714_srtcp_128[];
+extern const uint8_t rfc7714_srtp_256[], rfc7714_srtcp_256[];
+extern unsigned char test_key_gcm[];
+
 err_status_t
 srtp_create_big_policy(srtp_policy_t **list);
 
 err_status_t
 srtp_test_remove_stream(void);
 
+err_status_t
+srtp_test_many_streams(void);
+
+err_status_t
+srtp_test_batch(const srtp_policy_t *policy);
+
+void
+srtp_do_stream_count_timing(void);
+
 double
 srtp_bits_per_second(int msg_len_octets, const srtp_policy_t *policy);
 
@@ -237,6 +254,13 @@ main (int argc, char *argv[]) {
 	printf("failed\n");
 	exit(1);
       }
+      printf("testing srtp_protect_batch and srtp_unprotect_batch...");
+      if (srtp_test_batch(*policy) == err_status_ok)
+	printf("passed\n\n");
+      else {
+	printf("failed\n");
+	exit(1);
+      }
       policy++;
     }
 
@@ -277,6 +301,29 @@ main (int argc, char *argv[]) {
        exit(1); 
     }
 
+    /*
+     * run validation test against the reference packets of RFC 7714
+     * for the aead policies
+     */
+    printf("testing AEAD_AES_128_GCM against the RFC 7714 "
+	   "reference packets...");
+    if (srtp_validate_aead(16, rfc7714_srtp_128, rfc7714_srtcp_128)
+	== err_status_ok)
+      printf("passed\n");
+    else {
+      printf("failed\n");
+      exit(1);
+    }
+    printf("testing AEAD_AES_256_GCM against the RFC 7714 "
+	   "reference packets...");
+    if (srtp_validate_aead(32, rfc7714_srtp_256, rfc7714_srtcp_256)
+	== err_status_ok)
+      printf("passed\n\n");
+    else {
+      printf("failed\n");
+      exit(1);
+    }
+
     /*
      * test the function srtp_remove_stream()
      */
@@ -287,6 +334,17 @@ main (int argc, char *argv[]) {
       printf("failed\n");
       exit(1);
     }
+
+    /*
+     * test stream lookup and removal in a session with many streams
+     */
+    printf("testing srtp_get_stream() with many streams...");
+    if (srtp_test_many_streams() == err_status_ok)
+      printf("passed\n");
+    else {
+      printf("failed\n");
+      exit(1);
+    }
   }
   
   if (do_timing_test) {
@@ -300,6 +358,9 @@ main (int argc, char *argv[]) {
     }
   }
 
+  if (do_timing_test)
+    srtp_do_stream_count_timing();
+
   if (do_rejection_test) {
     const srtp_policy_t **policy = policy_array;
     
@@ -452,6 +513,77 @@ srtp_do_rejection_timing(const srtp_policy_t *policy) {
 }
 
 
+/*
+ * srtp_do_stream_count_timing() measures the cost of srtp_protect()
+ * in a session holding a growing number of streams, the packets
+ * going to each stream in turn; it should not depend on the number
+ * of streams
+ */
+
+void
+srtp_do_stream_count_timing(void) {
+  srtp_policy_t *policy;
+  srtp_t srtp;
+  srtp_hdr_t *mesg;
+  int num_streams, i, len;
+  int num_trials = 200000;
+  int msg_len_octets = 160;
+  clock_t timer;
+  err_status_t status;
+
+  printf("# testing srtp_protect() cost with many streams:\r\n");
+  printf("# number of streams\tmicroseconds per packet\r\n");
+
+  for (num_streams=1; num_streams <= 1024; num_streams *= 4) {
+    policy = (srtp_policy_t *)malloc(num_streams * sizeof(srtp_policy_t));
+    if (policy == NULL) {
+      printf("error: malloc() failed\n");
+      exit(1);
+    }
+    for (i=0; i < num_streams; i++) {
+      crypto_policy_set_rtp_default(&policy[i].rtp);
+      crypto_policy_set_rtcp_default(&policy[i].rtcp);
+      policy[i].ssrc.type  = ssrc_specific;
+      policy[i].ssrc.value = 0x1000 + i;
+      policy[i].key  = test_key;
+      policy[i].next = (i + 1 < num_streams) ? &policy[i+1] : NULL;
+    }
+    status = srtp_create(&srtp, policy);
+    if (status) {
+      printf("error: srtp_create() failed with error code %d\n", status);
+      exit(1);
+    }
+
+    mesg = srtp_create_test_packet(msg_len_octets, 0x1000);
+    if (mesg == NULL) {
+      printf("error: malloc() failed\n");
+      exit(1);
+    }
+
+    timer = clock();
+    for (i=0; i < num_trials; i++) {
+      mesg->ssrc = htonl(0x1000 + (i % num_streams));
+      mesg->seq = htons((uint16_t)(i / num_streams));
+      len = msg_len_octets + 12;
+      status = srtp_protect(srtp, mesg, &len);
+      if (status) {
+	printf("error: srtp_protect() failed with error code %d\n", status);
+	exit(1);
+      }
+    }
+    timer = clock() - timer;
+
+    printf("%d\t\t\t%f\r\n", num_streams,
+	   (double)timer * 1.0E6 / CLOCKS_PER_SEC / num_trials);
+
+    free(mesg);
+    srtp_dealloc(srtp);
+    free(policy);
+  }
+
+  printf("\r\n\r\n");
+}
+
 #define MAX_MSG_LEN 1024
 
 double
@@ -1215,6 +1347,224 @@ srtp_validate() {
   return err_status_ok;
 }
 
+/*
+ * the test vectors of RFC 7714, section 16: a 12 octet rtp header with
+ * the 38 octet payload "Gallia est omnis divisa in partes tres", and a
+ * 52 octet rtcp sender report sent with the srtcp index 0x5d4.  The
+ * session key is 00 01 02 ... (16 or 32 octets) and the session salt
+ * "Quid pro quo".
+ */
+
+#define RFC7714_SRTP_LEN   (12 + 38)
+#define RFC7714_SRTCP_LEN  52
+#define RFC7714_SRTCP_INDEX 0x5d4
+
+const uint8_t rfc7714_rtp_plaintext[RFC7714_SRTP_LEN] = {
+  0x80, 0x40, 0xf1, 0x7b, 0x80, 0x41, 0xf8, 0xd3,
+  0x55, 0x01, 0xa0, 0xb2, 0x47, 0x61, 0x6c, 0x6c,
+  0x69, 0x61, 0x20, 0x65, 0x73, 0x74, 0x20, 0x6f,
+  0x6d, 0x6e, 0x69, 0x73, 0x20, 0x64, 0x69, 0x76,
+  0x69, 0x73, 0x61, 0x20, 0x69, 0x6e, 0x20, 0x70,
+  0x61, 0x72, 0x74, 0x65, 0x73, 0x20, 0x74, 0x72,
+  0x65, 0x73
+};
+
+const uint8_t rfc7714_rtcp_plaintext[RFC7714_SRTCP_LEN] = {
+  0x81, 0xc8, 0x00, 0x0d, 0x4d, 0x61, 0x72, 0x73,
+  0x4e, 0x54, 0x50, 0x31, 0x4e, 0x54, 0x50, 0x32,
+  0x52, 0x54, 0x50, 0x20, 0x00, 0x00, 0x04, 0x2a,
+  0x00, 0x00, 0xe9, 0x30, 0x4c, 0x75, 0x6e, 0x61,
+  0xde, 0xad, 0xbe, 0xef, 0xde, 0xad, 0xbe, 0xef,
+  0xde, 0xad, 0xbe, 0xef, 0xde, 0xad, 0xbe, 0xef,
+  0xde, 0xad, 0xbe, 0xef
+};
+
+/* AEAD_AES_128_GCM srtp packet */
+const uint8_t rfc7714_srtp_128[RFC7714_SRTP_LEN + 16] = {
+  0x80, 0x40, 0xf1, 0x7b, 0x80, 0x41, 0xf8, 0xd3,
+  0x55, 0x01, 0xa0, 0xb2, 0xf2, 0x4d, 0xe3, 0xa3,
+  0xfb, 0x34, 0xde, 0x6c, 0xac, 0xba, 0x86, 0x1c,
+  0x9d, 0x7e, 0x4b, 0xca, 0xbe, 0x63, 0x3b, 0xd5,
+  0x0d, 0x29, 0x4e, 0x6f, 0x42, 0xa5, 0xf4, 0x7a,
+  0x51, 0xc7, 0xd1, 0x9b, 0x36, 0xde, 0x3a, 0xdf,
+  0x88, 0x33, 0x89, 0x9d, 0x7f, 0x27, 0xbe, 0xb1,
+  0x6a, 0x91, 0x52, 0xcf, 0x76, 0x5e, 0xe4, 0x39,
+  0x0c, 0xce
+};
+
+/* AEAD_AES_128_GCM srtcp packet */
+const uint8_t rfc7714_srtcp_128[RFC7714_SRTCP_LEN + 16 + 4] = {
+  0x81, 0xc8, 0x00, 0x0d, 0x4d, 0x61, 0x72, 0x73,
+  0x63, 0xe9, 0x48, 0x85, 0xdc, 0xda, 0xb6, 0x7c,
+  0xa7, 0x27, 0xd7, 0x66, 0x2f, 0x6b, 0x7e, 0x99,
+  0x7f, 0xf5, 0xc0, 0xf7, 0x6c, 0x06, 0xf3, 0x2d,
+  0xc6, 0x76, 0xa5, 0xf1, 0x73, 0x0d, 0x6f, 0xda,
+  0x4c, 0xe0, 0x9b, 0x46, 0x86, 0x30, 0x3d, 0xed,
+  0x0b, 0xb9, 0x27, 0x5b, 0xc8, 0x4a, 0xa4, 0x58,
+  0x96, 0xcf, 0x4d, 0x2f, 0xc5, 0xab, 0xf8, 0x72,
+  0x45, 0xd9, 0xea, 0xde, 0x80, 0x00, 0x05, 0xd4
+};
+
+/* AEAD_AES_256_GCM srtp packet */
+const uint8_t rfc7714_srtp_256[RFC7714_SRTP_LEN + 16] = {
+  0x80, 0x40, 0xf1, 0x7b, 0x80, 0x41, 0xf8, 0xd3,
+  0x55, 0x01, 0xa0, 0xb2, 0x32, 0xb1, 0xde, 0x78,
+  0xa8, 0x22, 0xfe, 0x12, 0xef, 0x9f, 0x78, 0xfa,
+  0x33, 0x2e, 0x33, 0xaa, 0xb1, 0x80, 0x12, 0x38,
+  0x9a, 0x58, 0xe2, 0xf3, 0xb5, 0x0b, 0x2a, 0x02,
+  0x76, 0xff, 0xae, 0x0f, 0x1b, 0xa6, 0x37, 0x99,
+  0xb8, 0x7b, 0x7a, 0xa3, 0xdb, 0x36, 0xdf, 0xff,
+  0xd6, 0xb0, 0xf9, 0xbb, 0x78, 0x78, 0xd7, 0xa7,
+  0x6c, 0x13
+};
+
+/* AEAD_AES_256_GCM srtcp packet */
+const uint8_t rfc7714_srtcp_256[RFC7714_SRTCP_LEN + 16 + 4] = {
+  0x81, 0xc8, 0x00, 0x0d, 0x4d, 0x61, 0x72, 0x73,
+  0xd5, 0x0a, 0xe4, 0xd1, 0xf5, 0xce, 0x5d, 0x30,
+  0x4b, 0xa2, 0x97, 0xe4, 0x7d, 0x47, 0x0c, 0x28,
+  0x2c, 0x3e, 0xce, 0x5d, 0xbf, 0xfe, 0x0a, 0x50,
+  0xa2, 0xea, 0xa5, 0xc1, 0x11, 0x05, 0x55, 0xbe,
+  0x84, 0x15, 0xf6, 0x58, 0xc6, 0x1d, 0xe0, 0x47,
+  0x6f, 0x1b, 0x6f, 0xad, 0x1d, 0x1e, 0xb3, 0x0c,
+  0x44, 0x46, 0x83, 0x9f, 0x57, 0xff, 0x6f, 0x6c,
+  0xb2, 0x6a, 0xc3, 0xbe, 0x80, 0x00, 0x05, 0xd4
+};
+
+/*
+ * RFC 7714 gives the session keys, while srtp_create() derives them
+ * from a master key: srtp_set_rfc7714_keys() replaces the keys of the
+ * stream with the ones of the test vectors
+ */
+
+static err_status_t
+srtp_set_rfc7714_keys(srtp_t srtp, uint32_t ssrc, int key_len) {
+  uint8_t key[32 + 12];
+  const uint8_t salt[12] = {
+    0x51, 0x75, 0x69, 0x64, 0x20, 0x70, 0x72, 0x6f,
+    0x20, 0x71, 0x75, 0x6f
+  };
+  srtp_stream_ctx_t *stream;
+  err_status_t status;
+  int i;
+
+  stream = srtp_get_stream(srtp, htonl(ssrc));
+  if (stream == NULL)
+    return err_status_no_ctx;
+  for (i = 0; i < key_len; i++)
+    key[i] = (uint8_t)i;
+  memcpy(key + key_len, salt, sizeof(salt));
+  status = cipher_init(stream->rtp_cipher, key, direction_any);
+  if (status)
+    return status;
+  return cipher_init(stream->rtcp_cipher, key, direction_any);
+}
+
+static err_status_t
+srtp_create_rfc7714(srtp_t *srtp, int key_len, uint32_t ssrc) {
+  srtp_policy_t policy;
+  err_status_t status;
+
+  if (key_len == 16) {
+    crypto_policy_set_aes_gcm_128_16_auth(&policy.rtp);
+    crypto_policy_set_aes_gcm_128_16_auth(&policy.rtcp);
+  } else {
+    crypto_policy_set_aes_gcm_256_16_auth(&policy.rtp);
+    crypto_policy_set_aes_gcm_256_16_auth(&policy.rtcp);
+  }
+  policy.ssrc.type  = ssrc_specific;
+  policy.ssrc.value = ssrc;
+  policy.key  = test_key_gcm;
+  policy.next = NULL;
+
+  status = srtp_create(srtp, &policy);
+  if (status)
+    return status;
+  status = srtp_set_rfc7714_keys(*srtp, ssrc, key_len);
+  if (status)
+    srtp_dealloc(*srtp);
+  return status;
+}
+
+/*
+ * srtp_validate_aead() protects the rtp and rtcp packets of RFC 7714
+ * with the aead policy of key_len octets, compares them with the
+ * reference packets, then unprotects the reference packets
+ */
+
+err_status_t
+srtp_validate_aead(int key_len, const uint8_t *srtp_ref,
+		   const uint8_t *srtcp_ref) {
+  uint8_t packet[RFC7714_SRTCP_LEN + 16 + 4];
+  srtp_t srtp_snd, srtp_recv;
+  srtp_stream_ctx_t *stream;
+  err_status_t status;
+  int len;
+
+  /* srtp, sent with a rollover counter of 0 */
+  status = srtp_create_rfc7714(&srtp_snd, key_len, 0x5501a0b2);
+  if (status)
+    return status;
+  memcpy(packet, rfc7714_rtp_plaintext, RFC7714_SRTP_LEN);
+  len = RFC7714_SRTP_LEN;
+  status = srtp_protect(srtp_snd, packet, &len);
+  if (status || len != RFC7714_SRTP_LEN + 16
+      || octet_string_is_eq(packet, (uint8_t *)srtp_ref, len)) {
+    srtp_dealloc(srtp_snd);
+    return err_status_fail;
+  }
+  srtp_dealloc(srtp_snd);
+
+  status = srtp_create_rfc7714(&srtp_recv, key_len, 0x5501a0b2);
+  if (status)
+    return status;
+  memcpy(packet, srtp_ref, RFC7714_SRTP_LEN + 16);
+  len = RFC7714_SRTP_LEN + 16;
+  status = srtp_unprotect(srtp_recv, packet, &len);
+  if (status || len != RFC7714_SRTP_LEN
+      || octet_string_is_eq(packet, (uint8_t *)rfc7714_rtp_plaintext, len)) {
+    srtp_dealloc(srtp_recv);
+    return err_status_fail;
+  }
+  /* a modified tag must be rejected */
+  memcpy(packet, srtp_ref, RFC7714_SRTP_LEN + 16);
+  packet[RFC7714_SRTP_LEN + 15] ^= 0x01;
+  len = RFC7714_SRTP_LEN + 16;
+  status = srtp_unprotect(srtp_recv, packet, &len);
+  srtp_dealloc(srtp_recv);
+  if (status != err_status_auth_fail && status != err_status_replay_fail)
+    return err_status_fail;
+
+  /* srtcp, the index of the sender is set so that the next one is 0x5d4 */
+  status = srtp_create_rfc7714(&srtp_snd, key_len, 0x4d617273);
+  if (status)
+    return status;
+  stream = srtp_get_stream(srtp_snd, htonl(0x4d617273));
+  stream->rtcp_rdb.window_start = RFC7714_SRTCP_INDEX - 1;
+  memcpy(packet, rfc7714_rtcp_plaintext, RFC7714_SRTCP_LEN);
+  len = RFC7714_SRTCP_LEN;
+  status = srtp_protect_rtcp(srtp_snd, packet, &len);
+  if (status || len != RFC7714_SRTCP_LEN + 16 + 4
+      || octet_string_is_eq(packet, (uint8_t *)srtcp_ref, len)) {
+    srtp_dealloc(srtp_snd);
+    return err_status_fail;
+  }
+  srtp_dealloc(srtp_snd);
+
+  status = srtp_create_rfc7714(&srtp_recv, key_len, 0x4d617273);
+  if (status)
+    return status;
+  memcpy(packet, srtcp_ref, RFC7714_SRTCP_LEN + 16 + 4);
+  len = RFC7714_SRTCP_LEN + 16 + 4;
+  status = srtp_unprotect_rtcp(srtp_recv, packet, &len);
+  srtp_dealloc(srtp_recv);
+  if (status || len != RFC7714_SRTCP_LEN
+      || octet_string_is_eq(packet, (uint8_t *)rfc7714_rtcp_plaintext, len))
+    return err_status_fail;
+
+  return err_status_ok;
+}
+
 
 err_status_t
 srtp_create_big_policy(srtp_policy_t **list) {
@@ -1292,9 +1642,197 @@ srtp_test_remove_stream() {
   if (stream == NULL)
     return err_status_fail;  
 
+  /* removing the first stream of the list must unlink it */
+  status = srtp_remove_stream(session, htonl(0x3));
+  if (status != err_status_ok)
+    return err_status_fail;
+  if (srtp_get_stream(session, htonl(0x3)) != NULL)
+    return err_status_fail;
+  status = srtp_remove_stream(session, htonl(0x3));
+  if (status != err_status_no_ctx)
+    return err_status_fail;
+
+  status = srtp_dealloc(session);
+  if (status)
+    return status;
+
   return err_status_ok;  
 }
 
+/*
+ * srtp_test_batch(policy) checks that srtp_protect_batch() gives the
+ * same packets as srtp_protect() called on each of them, for packets
+ * from two sources, and that srtp_unprotect_batch() recovers them and
+ * reports a packet that was tampered with
+ */
+
+#define BATCH_TEST_PKTS 8
+
+err_status_t
+srtp_test_batch(const srtp_policy_t *policy) {
+  static const uint32_t ssrcs[BATCH_TEST_PKTS] =
+    { 0x1, 0x1, 0x1, 0x2, 0x2, 0x1, 0x2, 0x2 };
+  srtp_hdr_t *ref[BATCH_TEST_PKTS], *pkt[BATCH_TEST_PKTS];
+  void *hdrs[BATCH_TEST_PKTS];
+  int ref_len[BATCH_TEST_PKTS], len[BATCH_TEST_PKTS];
+  err_status_t pkt_status[BATCH_TEST_PKTS];
+  srtp_policy_t rcvr_policy;
+  srtp_t srtp_sndr = NULL, srtp_batch = NULL, srtp_rcvr = NULL;
+  err_status_t status = err_status_ok;
+  int tampered = -1;
+  int i, msg_len_octets;
+
+  /* the packets come from several sources, which needs a template */
+  if (policy->ssrc.type != ssrc_any_outbound)
+    return err_status_ok;
+
+  for (i=0; i < BATCH_TEST_PKTS; i++)
+    ref[i] = pkt[i] = NULL;
+
+  memcpy(&rcvr_policy, policy, sizeof(srtp_policy_t));
+  rcvr_policy.ssrc.type = ssrc_any_inbound;
+  if (srtp_create(&srtp_sndr, policy) ||
+      srtp_create(&srtp_batch, policy) ||
+      srtp_create(&srtp_rcvr, &rcvr_policy)) {
+    status = err_status_init_fail;
+    goto done;
+  }
+
+  for (i=0; i < BATCH_TEST_PKTS; i++) {
+    msg_len_octets = 100 + 12 * i;
+    ref[i] = srtp_create_test_packet(msg_len_octets, ssrcs[i]);
+    pkt[i] = srtp_create_test_packet(msg_len_octets, ssrcs[i]);
+    if (ref[i] == NULL || pkt[i] == NULL) {
+      status = err_status_alloc_fail;
+      goto done;
+    }
+    ref[i]->seq = pkt[i]->seq = htons(i);
+    ref_len[i] = len[i] = msg_len_octets + 12;
+    hdrs[i] = pkt[i];
+  }
+
+  /* protect the packets one by one, and all at once */
+  for (i=0; i < BATCH_TEST_PKTS; i++) {
+    status = srtp_protect(srtp_sndr, ref[i], &ref_len[i]);
+    if (status)
+      goto done;
+  }
+  status = srtp_protect_batch(srtp_batch, hdrs, len, pkt_status,
+			      BATCH_TEST_PKTS);
+  if (status)
+    goto done;
+  for (i=0; i < BATCH_TEST_PKTS; i++) {
+    if (pkt_status[i] != err_status_ok || len[i] != ref_len[i] ||
+	memcmp(ref[i], pkt[i], len[i]) != 0) {
+      status = err_status_algo_fail;
+      goto done;
+    }
+  }
+
+  /* tamper with one packet, if it would be noticed */
+  if (policy->rtp.sec_serv & sec_serv_auth) {
+    tampered = 5;
+    ((uint8_t *)pkt[tampered])[len[tampered] - 1] ^= 0x01;
+  }
+
+  status = srtp_unprotect_batch(srtp_rcvr, hdrs, len, pkt_status,
+				BATCH_TEST_PKTS);
+  if (status != (tampered < 0 ? err_status_ok : err_status_auth_fail)) {
+    status = err_status_algo_fail;
+    goto done;
+  }
+  status = err_status_ok;
+  for (i=0; i < BATCH_TEST_PKTS; i++) {
+    srtp_hdr_t *orig;
+
+    if (i == tampered) {
+      if (pkt_status[i] != err_status_auth_fail)
+	status = err_status_algo_fail;
+      continue;
+    }
+    orig = srtp_create_test_packet(100 + 12 * i, ssrcs[i]);
+    if (orig == NULL) {
+      status = err_status_alloc_fail;
+      goto done;
+    }
+    orig->seq = htons(i);
+    if (pkt_status[i] != err_status_ok || len[i] != 100 + 12 * i + 12 ||
+	memcmp(orig, pkt[i], len[i]) != 0)
+      status = err_status_algo_fail;
+    free(orig);
+  }
+
+done:
+  for (i=0; i < BATCH_TEST_PKTS; i++) {
+    if (ref[i] != NULL)
+      free(ref[i]);
+    if (pkt[i] != NULL)
+      free(pkt[i]);
+  }
+  if (srtp_sndr != NULL)
+    srtp_dealloc(srtp_sndr);
+  if (srtp_batch != NULL)
+    srtp_dealloc(srtp_batch);
+  if (srtp_rcvr != NULL)
+    srtp_dealloc(srtp_rcvr);
+
+  return status;
+}
+
+/*
+ * srtp_test_many_streams() checks that every stream of a session with
+ * several hundred streams is found, also after half of them have been
+ * removed
+ */
+
+err_status_t
+srtp_test_many_streams() {
+  extern srtp_stream_t srtp_get_stream(srtp_t srtp, uint32_t ssrc);
+  int num_streams = 300;
+  srtp_policy_t *policy;
+  srtp_stream_t stream;
+  srtp_t session;
+  err_status_t status;
+  int i;
+
+  policy = (srtp_policy_t *)malloc(num_streams * sizeof(srtp_policy_t));
+  if (policy == NULL)
+    return err_status_alloc_fail;
+  for (i=0; i < num_streams; i++) {
+    crypto_policy_set_rtp_default(&policy[i].rtp);
+    crypto_policy_set_rtcp_default(&policy[i].rtcp);
+    policy[i].ssrc.type  = ssrc_specific;
+    policy[i].ssrc.value = 0x10000 * i + 7;
+    policy[i].key  = test_key;
+    policy[i].next = (i + 1 < num_streams) ? &policy[i+1] : NULL;
+  }
+  status = srtp_create(&session, policy);
+  free(policy);
+  if (status)
+    return status;
+
+  for (i=0; i < num_streams; i++) {
+    stream = srtp_get_stream(session, htonl(0x10000 * i + 7));
+    if (stream == NULL || stream->ssrc != htonl(0x10000 * i + 7))
+      return err_status_fail;
+  }
+  if (srtp_get_stream(session, htonl(0x10000 * num_streams + 7)) != NULL)
+    return err_status_fail;
+
+  for (i=0; i < num_streams; i += 2) {
+    status = srtp_remove_stream(session, htonl(0x10000 * i + 7));
+    if (status)
+      return status;
+  }
+  for (i=0; i < num_streams; i++) {
+    stream = srtp_get_stream(session, htonl(0x10000 * i + 7));
+    if ((stream != NULL) != (i % 2 == 1))
+      return err_status_fail;
+  }
+
+  return srtp_dealloc(session);
+}
+
 /*
  * srtp policy definitions - these definitions are used above
  */
@@ -1306,6 +1844,16 @@ unsigned char test_key[30] = {
     0xb6, 0x96, 0x0b, 0x3a, 0xab, 0xe6
 };
 
+/* master key and salt for the aead policies, the longest is 32 + 12 */
+unsigned char test_key_gcm[44] = {
+    0xe1, 0xf9, 0x7a, 0x0d, 0x3e, 0x01, 0x8b, 0xe0,
+    0xd6, 0x4f, 0xa3, 0x2c, 0x06, 0xde, 0x41, 0x39,
+    0x0e, 0xc6, 0x75, 0xad, 0x49, 0x8a, 0xfe, 0xeb,
+    0xb6, 0x96, 0x0b, 0x3a, 0xab, 0xe6, 0xc1, 0x73,
+    0xc3, 0x17, 0xf2, 0xda, 0xbe, 0x35, 0x77, 0x93,
+    0xb6, 0x96, 0x0b, 0x3a
+};
+
 
 const srtp_policy_t default_policy = {
   { ssrc_any_outbound, 0 },  /* SSRC                           */
@@ -1417,6 +1965,50 @@ const srtp_policy_t hmac_only_policy = {
   NULL
 };
 
+const srtp_policy_t aes_gcm_128_policy = {
+  { ssrc_any_outbound, 0 },     /* SSRC                        */ 
+  {
+    AES_128_GCM,            /* cipher type                 */
+    28,                     /* cipher key length in octets */
+    NULL_AUTH,              /* authentication func type    */
+    0,                      /* auth key length in octets   */
+    16,                     /* auth tag length in octets   */
+    sec_serv_conf_and_auth  /* security services flag      */
+  },
+  {
+    AES_128_GCM,            /* cipher type                 */
+    28,                     /* cipher key length in octets */
+    NULL_AUTH,              /* authentication func type    */
+    0,                      /* auth key length in octets   */
+    16,                     /* auth tag length in octets   */
+    sec_serv_conf_and_auth  /* security services flag      */
+  },
+  test_key_gcm,
+  NULL
+};
+
+const srtp_policy_t aes_gcm_256_policy = {
+  { ssrc_any_outbound, 0 },     /* SSRC                        */ 
+  {
+    AES_256_GCM,            /* cipher type                 */
+    44,                     /* cipher key length in octets */
+    NULL_AUTH,              /* authentication func type    */
+    0,                      /* auth key length in octets   */
+    16,                     /* auth tag length in octets   */
+    sec_serv_conf_and_auth  /* security services flag      */
+  },
+  {
+    AES_256_GCM,            /* cipher type                 */
+    44,                     /* cipher key length in octets */
+    NULL_AUTH,              /* authentication func type    */
+    0,                      /* auth key length in octets   */
+    16,                     /* auth tag length in octets   */
+    sec_serv_conf_and_auth  /* security services flag      */
+  },
+  test_key_gcm,
+  NULL
+};
+
 const srtp_policy_t null_policy = {
   { ssrc_any_outbound, 0 },     /* SSRC                        */ 
   {
@@ -1464,6 +2056,8 @@ policy_array[] = {
 #endif
   &default_policy,
   &null_policy,
+  &aes_gcm_128_policy,
+  &aes_gcm_256_policy,
   NULL
 };
 
@@ -58,7 +58,7 @@ static bool_t generate_b64_crypto_key(int key_length, char* key_out) {
 		return FALSE;
 	}
 	key_out[b64_size] = '\0';
-	b64_encode((const char*)tmp, key_length, key_out, 40);
+	b64_encode((const char*)tmp, key_length, key_out, b64_size);
 	free(tmp);
 	return TRUE;
 }
@@ -230,15 +230,23 @@ static SalMediaDescription *_create_local_media_description(LinphoneCore *lc, Li
 	
 	for(i=0; i<md->nstreams; i++) {
 		if (md->streams[i].proto == SalProtoRtpSavp) {
+			/*the aead suites come first: they are both faster and stronger*/
 			md->streams[i].crypto[0].tag = 1;
-			md->streams[i].crypto[0].algo = AES_128_SHA1_80;
-			if (!generate_b64_crypto_key(30, md->streams[i].crypto[0].master_key))
+			md->streams[i].crypto[0].algo = AEAD_AES_128_GCM;
+			if (!generate_b64_crypto_key(28, md->streams[i].crypto[0].master_key))
 				md->streams[i].crypto[0].algo = 0;
 			md->streams[i].crypto[1].tag = 2;
-			md->streams[i].crypto[1].algo = AES_128_SHA1_32;
-			if (!generate_b64_crypto_key(30, md->streams[i].crypto[1].master_key))
+			md->streams[i].crypto[1].algo = AEAD_AES_256_GCM;
+			if (!generate_b64_crypto_key(44, md->streams[i].crypto[1].master_key))
 				md->streams[i].crypto[1].algo = 0;
-			md->streams[i].crypto[2].algo = 0;
+			md->streams[i].crypto[2].tag = 3;
+			md->streams[i].crypto[2].algo = AES_128_SHA1_80;
+			if (!generate_b64_crypto_key(30, md->streams[i].crypto[2].master_key))
+				md->streams[i].crypto[2].algo = 0;
+			md->streams[i].crypto[3].tag = 4;
+			md->streams[i].crypto[3].algo = AES_128_SHA1_32;
+			if (!generate_b64_crypto_key(30, md->streams[i].crypto[3].master_key))
+				md->streams[i].crypto[3].algo = 0;
 		}
 	}
 	
@@ -1237,7 +1245,7 @@ static void linphone_call_start_video_stream(LinphoneCall *call, const char *cna
 				video_stream_enable_strp(
 					call->videostream, 
 					vstream->crypto[0].algo,
-					local_st_desc->crypto[0].master_key, 
+					local_st_desc->crypto[find_crypto_index_from_tag(local_st_desc->crypto,vstream->crypto[0].tag)].master_key, 
 					vstream->crypto[0].master_key
 					);
 				call->videostream_encrypted=TRUE;
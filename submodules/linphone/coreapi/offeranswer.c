@@ -139,13 +139,13 @@ static bool_t match_crypto_algo(const SalSrtpCryptoAlgo* local, const SalSrtpCry
 			if (remote[i].algo == local[j].algo) {
 				result->algo = remote[i].algo;
 				if (use_local_key) {
-					strncpy(result->master_key, local[j].master_key, 41);
+					strncpy(result->master_key, local[j].master_key, sizeof(result->master_key));
 					result->tag = local[j].tag;
 				} else {
-					strncpy(result->master_key, remote[i].master_key, 41);
+					strncpy(result->master_key, remote[i].master_key, sizeof(result->master_key));
 					result->tag = remote[i].tag;
 				}
-				result->master_key[40] = '\0';
+				result->master_key[sizeof(result->master_key)-1] = '\0';
 				return TRUE;
 			}
 		}
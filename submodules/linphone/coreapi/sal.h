@@ -115,8 +115,8 @@ typedef struct SalEndpointCandidate{
 typedef struct SalSrtpCryptoAlgo {
 	unsigned int tag;
 	enum ortp_srtp_crypto_suite_t algo;
-	/* 41= 40 max(key_length for all algo) + '\0' */
-	char master_key[41];
+	/* 61= 60 max(key_length for all algo, AEAD_AES_256_GCM) + '\0' */
+	char master_key[61];
 } SalSrtpCryptoAlgo;
 
 #define SAL_CRYPTO_ALGO_MAX 4
@@ -258,6 +258,18 @@ static void add_line(sdp_message_t *msg, int lineno, const SalStreamDescription
 					sdp_message_a_attribute_add(msg, lineno, osip_strdup("crypto"),
 						osip_strdup(buffer));
 					break;
+				case AEAD_AES_128_GCM:
+					snprintf(buffer, 1024, "%d %s inline:%s",
+						desc->crypto[i].tag, "AEAD_AES_128_GCM", desc->crypto[i].master_key);
+					sdp_message_a_attribute_add(msg, lineno, osip_strdup("crypto"),
+						osip_strdup(buffer));
+					break;
+				case AEAD_AES_256_GCM:
+					snprintf(buffer, 1024, "%d %s inline:%s",
+						desc->crypto[i].tag, "AEAD_AES_256_GCM", desc->crypto[i].master_key);
+					sdp_message_a_attribute_add(msg, lineno, osip_strdup("crypto"),
+						osip_strdup(buffer));
+					break;
 				case AES_128_NO_AUTH:
 					ms_warning("Unsupported crypto suite: AES_128_NO_AUTH");
 					break;
@@ -435,13 +447,17 @@ int sdp_to_media_description(sdp_message_t *msg, SalMediaDescription *desc){
 							stream->crypto[valid_count].algo = AES_128_SHA1_80;
 						else if (strcmp(tmp, "AES_CM_128_HMAC_SHA1_32") == 0)
 							stream->crypto[valid_count].algo = AES_128_SHA1_32;
+						else if (strcmp(tmp, "AEAD_AES_128_GCM") == 0)
+							stream->crypto[valid_count].algo = AEAD_AES_128_GCM;
+						else if (strcmp(tmp, "AEAD_AES_256_GCM") == 0)
+							stream->crypto[valid_count].algo = AEAD_AES_256_GCM;
 						else {
 							ms_warning("Failed to parse crypto-algo: '%s'", tmp);
 							stream->crypto[valid_count].algo = 0;
 						}
 						if (stream->crypto[valid_count].algo) {
-							strncpy(stream->crypto[valid_count].master_key, tmp2, 41);
-							stream->crypto[valid_count].master_key[40] = '\0';
+							strncpy(stream->crypto[valid_count].master_key, tmp2, sizeof(stream->crypto[valid_count].master_key));
+							stream->crypto[valid_count].master_key[sizeof(stream->crypto[valid_count].master_key)-1] = '\0';
 							ms_message("Found valid crypto line (tag:%d algo:'%s' key:'%s'", 
 								stream->crypto[valid_count].tag, 
 								tmp, 
@@ -64,6 +64,7 @@ LOCAL_SRC_FILES = \
 	mswebcam.c \
 	equalizer.c \
 	dsptools.c \
+	audiokernels.c \
 	kiss_fft.c \
 	kiss_fftr.c \
 	void.c \
@@ -381,6 +381,46 @@ void ms_ifft(void *table, ms_word16_t *in, ms_word16_t *out);
 /** digital filtering api*/
 void ms_fir_mem16(const ms_word16_t *x, const ms_coef_t *num, ms_word16_t *y, int N, int ord, ms_mem_t *mem);
 
+/*loops on 16 bits samples, vectorized when the processor allows it (SSE2, AVX2 or NEON)*/
+
+/** Select the fastest implementation of the audio kernels for the running processor, called by ms_init() */
+MS2_PUBLIC void ms_audio_kernels_init(void);
+
+/** Name of the implementation in use: "c", "sse2", "avx2" or "neon" */
+MS2_PUBLIC const char *ms_audio_kernels_get_implementation(void);
+
+/** Force an implementation of the audio kernels (for tests), returns -1 if not supported */
+MS2_PUBLIC int ms_audio_kernels_set_implementation(const char *name);
+
+/** Mixing: sum[i]+=samples[i] */
+MS2_PUBLIC void ms_audio_accumulate(int32_t *sum, const int16_t *samples, int nsamples);
+
+/** Mixing output: out[i]=sum[i]-sub[i] (sub may be NULL), saturated to [-limit,limit] */
+MS2_PUBLIC void ms_audio_saturate(int16_t *out, const int32_t *sum, const int16_t *sub, int nsamples, int16_t limit);
+
+/** samples[i]=(int)(gain*samples[i]), saturated to [-32767,32767] */
+MS2_PUBLIC void ms_audio_apply_gain(int16_t *samples, int nsamples, float gain);
+
+/** Returns the exact sum of the squared samples (the RMS value is sqrt(energy/nsamples)),
+ * and stores the largest absolute value of the samples in peak if not NULL */
+MS2_PUBLIC uint64_t ms_audio_energy(const int16_t *samples, int nsamples, int *peak);
+
+/** Energy of a signal at a single frequency, as computed by the Goertzel algorithm, but evaluated
+ * as a correlation with precomputed tables so that it is vectorized */
+typedef struct _MSGoertzel{
+	int nsamples;
+	float *cos_table;
+	float *sin_table;
+}MSGoertzel;
+
+/** Prepare the evaluation of frequency on blocks of nsamples samples */
+MS2_PUBLIC void ms_goertzel_init(MSGoertzel *g, float frequency, int rate, int nsamples);
+
+/** Returns the energy at the frequency of a block of g->nsamples samples */
+MS2_PUBLIC float ms_goertzel_run(const MSGoertzel *g, const int16_t *samples);
+
+MS2_PUBLIC void ms_goertzel_uninit(MSGoertzel *g);
+
 #ifdef __cplusplus
 }
 #endif
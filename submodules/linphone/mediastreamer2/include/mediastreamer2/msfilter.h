@@ -71,6 +71,25 @@ struct _MSFilterMethod{
  * @var MSFilterMethod
  */
 typedef struct _MSFilterMethod MSFilterMethod;
+
+struct _MSFilterMethodCall{
+	unsigned int id;
+	void *arg;
+};
+
+/**
+ * Structure for one of the method calls made by ms_filter_call_methods().
+ * @var MSFilterMethodCall
+ */
+typedef struct _MSFilterMethodCall MSFilterMethodCall;
+
+struct _MSFilterMethodTable;
+
+/**
+ * Methods of a filter description, indexed when the filter is registered.
+ * @var MSFilterMethodTable
+ */
+typedef struct _MSFilterMethodTable MSFilterMethodTable;
 /**
  * Filter's category
  *
@@ -146,6 +165,7 @@ struct _MSFilter{
 	/*private attributes */
 	uint32_t last_tick;
 	MSFilterStats *stats;
+	MSFilterMethodTable *method_table;
 	bool_t seen;
 };
 
@@ -358,6 +378,25 @@ MS2_PUBLIC int ms_filter_call_method(MSFilter *f, unsigned int id, void *arg);
  */
 MS2_PUBLIC int ms_filter_call_method_noarg(MSFilter *f, unsigned int id);
 
+/**
+ * Call several methods of a filter to set options, all of them between two ticks.
+ *
+ * When the filter is attached to a ticker, the ticker is locked once for all the calls,
+ * so that the filter is never processed with only part of the options set.
+ * All the calls are made, even if some of them fail.
+ * When called from the ticker's own threads (from the process function of a filter or
+ * from a notify callback), the ticker is already locked and the calls are made right away;
+ * with several threads (see ms_ticker_set_thread_count()) the filter may then be processed
+ * concurrently by another thread of the ticker, as with ms_filter_call_method().
+ *
+ * @param f      A MSFilter object.
+ * @param calls  An array of method ids and arguments.
+ * @param ncalls The number of elements of calls.
+ *
+ * Returns: 0 if all the calls were successfull, -1 otherwise.
+ */
+MS2_PUBLIC int ms_filter_call_methods(MSFilter *f, const MSFilterMethodCall *calls, int ncalls);
+
 
 /**
  * Returns whether the filter implements a given method
@@ -466,7 +505,8 @@ MS2_PUBLIC int ms_connection_helper_unlink(MSConnectionHelper *h, MSFilter *f, i
 
 /**
  * \brief Enable processing time measurements statistics for filters.
- *
+ * The measurements are aggregated per filter type; see ms_ticker_enable_profiling()
+ * for per instance, per tick measurements.
 **/
 MS2_PUBLIC void ms_filter_enable_statistics(bool_t enabled);
 
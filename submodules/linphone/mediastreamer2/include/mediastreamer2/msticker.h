@@ -56,6 +56,10 @@ enum _MSTickerPrio{
 
 typedef enum _MSTickerPrio MSTickerPrio;
 
+struct _MSTickerPlan;
+struct _MSTickerPool;
+struct _MSTickerProfiler;
+
 struct _MSTicker
 {
 	ms_mutex_t lock;
@@ -72,7 +76,14 @@ struct _MSTicker
 	char *name;
 	double av_load;	/*average load of the ticker */
 	MSTickerPrio prio;
+	int nthreads; /* number of threads running the filters, 1 by default*/
+	struct _MSTickerPlan *plan; /* filters in execution order, sorted by level*/
+	struct _MSTickerPool *pool; /* worker threads helping the ticker thread*/
+	struct _MSTickerProfiler *profiler; /* per filter measurements, NULL unless enabled*/
+	MSList *destroyed; /* filters destroyed during the tick, freed at its end*/
 	bool_t run;       /* flag to indicate whether the ticker must be run or not */
+	bool_t plan_dirty; /* the graph changed since the plan was computed*/
+	bool_t in_pass; /* the filters of the plan are being run*/
 };
 
 /**
@@ -81,6 +92,58 @@ struct _MSTicker
  */
 typedef struct _MSTicker MSTicker;
 
+/**
+ * Number of buckets of a #MSTimeHistogram.
+**/
+#define MS_TIME_HISTOGRAM_BUCKETS 128
+
+/**
+ * Histogram of durations expressed in nanoseconds.
+ * Each power of two is split into four buckets, so that percentiles are known within 25%.
+**/
+struct _MSTimeHistogram{
+	uint64_t count; /**<number of samples*/
+	uint64_t total; /**<sum of the samples*/
+	uint64_t max; /**<largest sample*/
+	uint32_t buckets[MS_TIME_HISTOGRAM_BUCKETS];
+};
+
+typedef struct _MSTimeHistogram MSTimeHistogram;
+
+/**
+ * Measurements made by a ticker for one of its filters, see ms_ticker_enable_profiling().
+**/
+struct _MSFilterProfile{
+	MSFilter *filter;
+	MSTimeHistogram process_time; /**<time spent processing at each tick the filter had data*/
+	unsigned int late_ticks; /**<number of late ticks during which this filter was the slowest one*/
+};
+
+typedef struct _MSFilterProfile MSFilterProfile;
+
+/**
+ * Depth of an input queue of a filter, sampled before each process() of the filter.
+**/
+struct _MSQueueProfile{
+	int depth; /**<number of messages waiting at the last tick*/
+	int max_depth; /**<largest number of messages waiting*/
+	uint64_t total_depth; /**<sum of the samples, to be divided by the count of the filter's process_time*/
+};
+
+typedef struct _MSQueueProfile MSQueueProfile;
+
+/**
+ * Measurements made by a ticker for all its graphs, see ms_ticker_enable_profiling().
+**/
+struct _MSTickerProfile{
+	MSTimeHistogram tick_time; /**<time spent running all the filters at each tick*/
+	unsigned int ticks; /**<number of ticks measured*/
+	unsigned int late_ticks; /**<number of ticks that ended after the start of the next one*/
+	int max_late; /**<largest delay at the end of a tick, in milliseconds*/
+};
+
+typedef struct _MSTickerProfile MSTickerProfile;
+
 
 #ifdef __cplusplus
 extern "C"{
@@ -105,6 +168,23 @@ MS2_PUBLIC void ms_ticker_set_name(MSTicker *ticker, const char *name);
 **/
 MS2_PUBLIC void ms_ticker_set_priority(MSTicker *ticker, MSTickerPrio prio);
 	
+/**
+ * Set the number of threads used to run the filters of the ticker.
+ *
+ * By default (nthreads=1) the ticker thread runs all the filters serially.
+ * The graphs are sorted by level when filters are attached or detached: with nthreads>1,
+ * the filters of a level, which do not depend on each other (for example the decoding
+ * chains of the participants of a conference), are shared out, at each tick,
+ * between the ticker thread and nthreads-1 worker threads. A level only starts once the
+ * previous one is complete.
+ * This is only worth it when the graphs are heavy enough for one core to run late; filters
+ * processed concurrently must not share unprotected state.
+ *
+ * @param ticker    A #MSTicker object.
+ * @param nthreads  The number of threads, including the ticker thread.
+**/
+MS2_PUBLIC void ms_ticker_set_thread_count(MSTicker *ticker, int nthreads);
+
 /**
  * Attach a chain of filters to a ticker.
  * The processing chain will be executed until ms_ticker_detach
@@ -137,6 +217,18 @@ MS2_PUBLIC int ms_ticker_detach(MSTicker *ticker,MSFilter *f);
  */
 MS2_PUBLIC void ms_ticker_destroy(MSTicker *ticker);
 
+/**
+ * Tells whether the calling thread runs the filters of a ticker, that is whether it is
+ * the ticker thread or one of its worker threads (see ms_ticker_set_thread_count()).
+ * This is the case in the process functions of the filters and in the notify callbacks
+ * they call, which run with the ticker locked.
+ *
+ * @param ticker  A #MSTicker object.
+ *
+ * Returns: TRUE if the calling thread runs the filters of the ticker, FALSE otherwise.
+ */
+MS2_PUBLIC bool_t ms_ticker_is_current_thread(const MSTicker *ticker);
+
 /**
  * Override MSTicker's time function.
  * This can be used to control the ticker from an external time provider, for example the 
@@ -163,9 +255,124 @@ MS2_PUBLIC void ms_ticker_print_graphs(MSTicker *ticker);
  * A load greater than 100% clearly means that the ticker is over loaded and runs late.
 **/
 MS2_PUBLIC float ms_ticker_get_average_load(MSTicker *ticker);
+
+/**
+ * Enable or disable per filter measurements.
+ *
+ * When enabled, the ticker measures at each tick the time spent in each of its filters
+ * and the depth of their input queues, counts the ticks that end late and, for each of
+ * them, blames the slowest filter of the tick. Disabling it discards the measurements
+ * and stops the trace, if any.
+ *
+ * @param ticker  A #MSTicker object.
+ * @param enabled TRUE to enable the measurements.
+**/
+MS2_PUBLIC void ms_ticker_enable_profiling(MSTicker *ticker, bool_t enabled);
+
+/**
+ * Reset the measurements of the ticker and of its filters.
+ *
+ * @param ticker  A #MSTicker object.
+**/
+MS2_PUBLIC void ms_ticker_reset_profiling(MSTicker *ticker);
+
+/**
+ * Get the measurements of the ticker.
+ *
+ * @param ticker  A #MSTicker object.
+ * @param profile Filled with the measurements.
+ *
+ * Returns: 0 if successfull, -1 if profiling is not enabled.
+**/
+MS2_PUBLIC int ms_ticker_get_profile(MSTicker *ticker, MSTickerProfile *profile);
+
+/**
+ * Get the measurements of a filter run by the ticker.
+ *
+ * @param ticker  A #MSTicker object.
+ * @param f       A filter attached to the ticker.
+ * @param profile Filled with the measurements.
+ *
+ * Returns: 0 if successfull, -1 if profiling is not enabled or the filter is not run by the ticker.
+**/
+MS2_PUBLIC int ms_ticker_get_filter_profile(MSTicker *ticker, MSFilter *f, MSFilterProfile *profile);
+
+/**
+ * Get the measurements of all the filters run by the ticker.
+ *
+ * @param ticker  A #MSTicker object.
+ *
+ * Returns: a list of MSFilterProfile, in execution order, to be freed with ms_list_for_each(l,ms_free) and ms_list_free().
+**/
+MS2_PUBLIC MSList *ms_ticker_get_filter_profiles(MSTicker *ticker);
+
+/**
+ * Get the depth measurements of an input queue of a filter run by the ticker.
+ *
+ * @param ticker  A #MSTicker object.
+ * @param f       A filter attached to the ticker.
+ * @param pin     An input pin of the filter.
+ * @param profile Filled with the measurements.
+ *
+ * Returns: 0 if successfull, -1 if profiling is not enabled or the input is not connected.
+**/
+MS2_PUBLIC int ms_ticker_get_queue_profile(MSTicker *ticker, MSFilter *f, int pin, MSQueueProfile *profile);
+
+/**
+ * Log the measurements of the ticker and of its filters, slowest filters first.
+ *
+ * @param ticker  A #MSTicker object.
+**/
+MS2_PUBLIC void ms_ticker_log_profile(MSTicker *ticker);
+
+/**
+ * Start writing the execution of the filters to a file, in the Chrome trace event format
+ * (to be loaded in chrome://tracing or similar tools). This enables profiling.
+ * Filters running on worker threads (see ms_ticker_set_thread_count()) appear as
+ * separate threads; late ticks appear as instant events naming the slowest filter.
+ *
+ * @param ticker   A #MSTicker object.
+ * @param filename The file to write, truncated if it exists.
+ *
+ * Returns: 0 if successfull, -1 otherwise.
+**/
+MS2_PUBLIC int ms_ticker_start_trace(MSTicker *ticker, const char *filename);
+
+/**
+ * Stop the trace started by ms_ticker_start_trace() and close the file.
+ *
+ * @param ticker  A #MSTicker object.
+**/
+MS2_PUBLIC void ms_ticker_stop_trace(MSTicker *ticker);
+
+/**
+ * Add a duration to a #MSTimeHistogram, initially filled with zeroes.
+ *
+ * @param h       A #MSTimeHistogram.
+ * @param value   The duration, in nanoseconds.
+**/
+MS2_PUBLIC void ms_time_histogram_add(MSTimeHistogram *h, uint64_t value);
+
+/**
+ * Get a percentile of a #MSTimeHistogram.
+ *
+ * @param h       A #MSTimeHistogram.
+ * @param percent The percentile, between 0 and 100.
+ *
+ * Returns: the upper bound of the bucket containing the percentile, in nanoseconds.
+**/
+MS2_PUBLIC uint64_t ms_time_histogram_get_percentile(const MSTimeHistogram *h, float percent);
 	
 /* private functions:*/
 
+/* to be called around a change of the links of a filter scheduled by the ticker,
+so that the plan is recomputed before the next tick*/
+void ms_ticker_begin_graph_change(MSTicker *ticker);
+void ms_ticker_end_graph_change(MSTicker *ticker);
+/* returns TRUE if the filter is destroyed at the end of the current tick instead of
+at once, the pass or the other threads of the ticker still referring to it*/
+bool_t ms_ticker_defer_destroy(MSFilter *f);
+
 #ifdef __cplusplus
 }
 #endif
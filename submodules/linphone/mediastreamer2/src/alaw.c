@@ -72,7 +72,7 @@ static void alaw_enc_process(MSFilter *obj){
 		ms_bufferizer_put(bz,m);
 	}
 	while (ms_bufferizer_read(bz,buffer,size_of_pcm)==size_of_pcm){
-		mblk_t *o=allocb(size_of_pcm/2,0);
+		mblk_t *o=rtp_payload_allocb(size_of_pcm/2);
 		int i;
 		for (i=0;i<size_of_pcm/2;i++){
 			*o->b_wptr=s16_to_alaw(((int16_t*)buffer)[i]);
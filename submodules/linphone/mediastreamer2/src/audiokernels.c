@@ -0,0 +1,574 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2006  Simon MORLAT (simon.morlat@linphone.org)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+/* Loops on 16 bits audio samples shared by the mixers, the conference,
+the volume and the tone detector, with vectorized versions. */
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "mediastreamer2/dsptools.h"
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI       3.14159265358979323846
+#endif
+
+#if defined(__SSE2__) || (defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)))
+#define AUDIO_KERNELS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* AVX2 functions are compiled with a target attribute and only selected at runtime
+if the processor supports them */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+	((defined(__clang__) && (__clang_major__>3 || (__clang_major__==3 && __clang_minor__>=8))) || \
+	(!defined(__clang__) && (__GNUC__>4 || (__GNUC__==4 && __GNUC_MINOR__>=9))))
+#define AUDIO_KERNELS_AVX2 1
+#define AVX2_FUNC __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define AUDIO_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef struct _MSAudioKernels{
+	const char *name;
+	void (*accumulate)(int32_t *sum, const int16_t *samples, int nsamples);
+	void (*saturate)(int16_t *out, const int32_t *sum, const int16_t *sub, int nsamples, int16_t limit);
+	void (*apply_gain)(int16_t *samples, int nsamples, float gain);
+	uint64_t (*energy)(const int16_t *samples, int nsamples, int *peak);
+	void (*correlate)(const int16_t *samples, const float *t1, const float *t2, int nsamples, float *r1, float *r2);
+}MSAudioKernels;
+
+
+/* C implementation, also used for the samples left by the vectorized loops */
+
+static void accumulate_c(int32_t *sum, const int16_t *samples, int nsamples){
+	int i;
+	for(i=0;i<nsamples;++i)
+		sum[i]+=samples[i];
+}
+
+static void saturate_c(int16_t *out, const int32_t *sum, const int16_t *sub, int nsamples, int16_t limit){
+	int i;
+	for(i=0;i<nsamples;++i){
+		int32_t s=sub ? sum[i]-sub[i] : sum[i];
+		out[i]=(int16_t)((s>limit) ? limit : ((s<-limit) ? -limit : s));
+	}
+}
+
+static void apply_gain_c(int16_t *samples, int nsamples, float gain){
+	int i;
+	for(i=0;i<nsamples;++i){
+		int s=(int)(gain*(float)samples[i]);
+		samples[i]=(int16_t)((s>32767) ? 32767 : ((s<-32767) ? -32767 : s));
+	}
+}
+
+static uint64_t energy_c(const int16_t *samples, int nsamples, int *peak){
+	uint64_t en=0;
+	int pk=0;
+	int i;
+	for(i=0;i<nsamples;++i){
+		int s=samples[i];
+		en+=(uint32_t)(s*s);
+		if (s<0) s=-s;
+		if (s>pk) pk=s;
+	}
+	if (peak) *peak=pk;
+	return en;
+}
+
+static void correlate_c(const int16_t *samples, const float *t1, const float *t2, int nsamples, float *r1, float *r2){
+	float a1=0,a2=0;
+	int i;
+	for(i=0;i<nsamples;++i){
+		float s=(float)samples[i];
+		a1+=s*t1[i];
+		a2+=s*t2[i];
+	}
+	*r1=a1;
+	*r2=a2;
+}
+
+static MSAudioKernels kernels_c={
+	"c",
+	accumulate_c,
+	saturate_c,
+	apply_gain_c,
+	energy_c,
+	correlate_c
+};
+
+
+#ifdef AUDIO_KERNELS_SSE2
+
+/* sign extension of 8 samples to 2x4 32 bits integers */
+#define SSE2_UNPACK16(s,lo,hi) \
+	lo=_mm_srai_epi32(_mm_unpacklo_epi16(s,s),16); \
+	hi=_mm_srai_epi32(_mm_unpackhi_epi16(s,s),16)
+
+static void accumulate_sse2(int32_t *sum, const int16_t *samples, int nsamples){
+	int i;
+	for(i=0;i+8<=nsamples;i+=8){
+		__m128i s=_mm_loadu_si128((const __m128i*)(samples+i));
+		__m128i lo,hi;
+		__m128i *d=(__m128i*)(sum+i);
+		SSE2_UNPACK16(s,lo,hi);
+		_mm_storeu_si128(d,_mm_add_epi32(_mm_loadu_si128(d),lo));
+		_mm_storeu_si128(d+1,_mm_add_epi32(_mm_loadu_si128(d+1),hi));
+	}
+	accumulate_c(sum+i,samples+i,nsamples-i);
+}
+
+static void saturate_sse2(int16_t *out, const int32_t *sum, const int16_t *sub, int nsamples, int16_t limit){
+	__m128i max=_mm_set1_epi16(limit);
+	__m128i min=_mm_set1_epi16(-limit);
+	int i;
+	for(i=0;i+8<=nsamples;i+=8){
+		__m128i lo=_mm_loadu_si128((const __m128i*)(sum+i));
+		__m128i hi=_mm_loadu_si128((const __m128i*)(sum+i+4));
+		__m128i r;
+		if (sub){
+			__m128i s=_mm_loadu_si128((const __m128i*)(sub+i));
+			__m128i slo,shi;
+			SSE2_UNPACK16(s,slo,shi);
+			lo=_mm_sub_epi32(lo,slo);
+			hi=_mm_sub_epi32(hi,shi);
+		}
+		r=_mm_packs_epi32(lo,hi);
+		r=_mm_min_epi16(_mm_max_epi16(r,min),max);
+		_mm_storeu_si128((__m128i*)(out+i),r);
+	}
+	saturate_c(out+i,sum+i,sub ? sub+i : NULL,nsamples-i,limit);
+}
+
+static void apply_gain_sse2(int16_t *samples, int nsamples, float gain){
+	__m128 g=_mm_set1_ps(gain);
+	__m128i min=_mm_set1_epi16(-32767);
+	int i;
+	for(i=0;i+8<=nsamples;i+=8){
+		__m128i s=_mm_loadu_si128((const __m128i*)(samples+i));
+		__m128i lo,hi;
+		SSE2_UNPACK16(s,lo,hi);
+		/*truncation, as the (int) cast of the C version*/
+		lo=_mm_cvttps_epi32(_mm_mul_ps(g,_mm_cvtepi32_ps(lo)));
+		hi=_mm_cvttps_epi32(_mm_mul_ps(g,_mm_cvtepi32_ps(hi)));
+		_mm_storeu_si128((__m128i*)(samples+i),_mm_max_epi16(_mm_packs_epi32(lo,hi),min));
+	}
+	apply_gain_c(samples+i,nsamples-i,gain);
+}
+
+static uint64_t energy_sse2(const int16_t *samples, int nsamples, int *peak){
+	__m128i zero=_mm_setzero_si128();
+	__m128i acc=zero;
+	__m128i max=_mm_set1_epi16(0);
+	__m128i min=_mm_set1_epi16(0);
+	int16_t vmax[8],vmin[8];
+	uint64_t en[2];
+	int pk;
+	int i,j;
+	for(i=0;i+8<=nsamples;i+=8){
+		__m128i s=_mm_loadu_si128((const __m128i*)(samples+i));
+		/*pairs of squares are at most 2^31: they fit in unsigned 32 bits*/
+		__m128i p=_mm_madd_epi16(s,s);
+		acc=_mm_add_epi64(acc,_mm_unpacklo_epi32(p,zero));
+		acc=_mm_add_epi64(acc,_mm_unpackhi_epi32(p,zero));
+		max=_mm_max_epi16(max,s);
+		min=_mm_min_epi16(min,s);
+	}
+	_mm_storeu_si128((__m128i*)en,acc);
+	_mm_storeu_si128((__m128i*)vmax,max);
+	_mm_storeu_si128((__m128i*)vmin,min);
+	pk=0;
+	for(j=0;j<8;++j){
+		if (vmax[j]>pk) pk=vmax[j];
+		if (-vmin[j]>pk) pk=-vmin[j];
+	}
+	en[0]+=en[1]+energy_c(samples+i,nsamples-i,peak);
+	if (peak && pk>*peak) *peak=pk;
+	return en[0];
+}
+
+static void correlate_sse2(const int16_t *samples, const float *t1, const float *t2, int nsamples, float *r1, float *r2){
+	__m128 a1=_mm_setzero_ps();
+	__m128 a2=_mm_setzero_ps();
+	float v1[4],v2[4];
+	float c1,c2;
+	int i;
+	for(i=0;i+8<=nsamples;i+=8){
+		__m128i s=_mm_loadu_si128((const __m128i*)(samples+i));
+		__m128i lo,hi;
+		__m128 flo,fhi;
+		SSE2_UNPACK16(s,lo,hi);
+		flo=_mm_cvtepi32_ps(lo);
+		fhi=_mm_cvtepi32_ps(hi);
+		a1=_mm_add_ps(a1,_mm_add_ps(_mm_mul_ps(flo,_mm_loadu_ps(t1+i)),_mm_mul_ps(fhi,_mm_loadu_ps(t1+i+4))));
+		a2=_mm_add_ps(a2,_mm_add_ps(_mm_mul_ps(flo,_mm_loadu_ps(t2+i)),_mm_mul_ps(fhi,_mm_loadu_ps(t2+i+4))));
+	}
+	_mm_storeu_ps(v1,a1);
+	_mm_storeu_ps(v2,a2);
+	correlate_c(samples+i,t1+i,t2+i,nsamples-i,&c1,&c2);
+	*r1=v1[0]+v1[1]+v1[2]+v1[3]+c1;
+	*r2=v2[0]+v2[1]+v2[2]+v2[3]+c2;
+}
+
+static MSAudioKernels kernels_sse2={
+	"sse2",
+	accumulate_sse2,
+	saturate_sse2,
+	apply_gain_sse2,
+	energy_sse2,
+	correlate_sse2
+};
+
+#endif
+
+
+#ifdef AUDIO_KERNELS_AVX2
+
+/* _mm256_packs_epi32 works on each 128 bits lane: put the 64 bits blocks back in order */
+#define AVX2_PACK(lo,hi) _mm256_permute4x64_epi64(_mm256_packs_epi32(lo,hi),0xD8)
+
+AVX2_FUNC static void accumulate_avx2(int32_t *sum, const int16_t *samples, int nsamples){
+	int i;
+	for(i=0;i+16<=nsamples;i+=16){
+		__m256i lo=_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(samples+i)));
+		__m256i hi=_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(samples+i+8)));
+		__m256i *d=(__m256i*)(sum+i);
+		_mm256_storeu_si256(d,_mm256_add_epi32(_mm256_loadu_si256(d),lo));
+		_mm256_storeu_si256(d+1,_mm256_add_epi32(_mm256_loadu_si256(d+1),hi));
+	}
+	accumulate_c(sum+i,samples+i,nsamples-i);
+}
+
+AVX2_FUNC static void saturate_avx2(int16_t *out, const int32_t *sum, const int16_t *sub, int nsamples, int16_t limit){
+	__m256i max=_mm256_set1_epi16(limit);
+	__m256i min=_mm256_set1_epi16(-limit);
+	int i;
+	for(i=0;i+16<=nsamples;i+=16){
+		__m256i lo=_mm256_loadu_si256((const __m256i*)(sum+i));
+		__m256i hi=_mm256_loadu_si256((const __m256i*)(sum+i+8));
+		__m256i r;
+		if (sub){
+			lo=_mm256_sub_epi32(lo,_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(sub+i))));
+			hi=_mm256_sub_epi32(hi,_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(sub+i+8))));
+		}
+		r=AVX2_PACK(lo,hi);
+		r=_mm256_min_epi16(_mm256_max_epi16(r,min),max);
+		_mm256_storeu_si256((__m256i*)(out+i),r);
+	}
+	saturate_c(out+i,sum+i,sub ? sub+i : NULL,nsamples-i,limit);
+}
+
+AVX2_FUNC static void apply_gain_avx2(int16_t *samples, int nsamples, float gain){
+	__m256 g=_mm256_set1_ps(gain);
+	__m256i min=_mm256_set1_epi16(-32767);
+	int i;
+	for(i=0;i+16<=nsamples;i+=16){
+		__m256i lo=_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(samples+i)));
+		__m256i hi=_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(samples+i+8)));
+		lo=_mm256_cvttps_epi32(_mm256_mul_ps(g,_mm256_cvtepi32_ps(lo)));
+		hi=_mm256_cvttps_epi32(_mm256_mul_ps(g,_mm256_cvtepi32_ps(hi)));
+		_mm256_storeu_si256((__m256i*)(samples+i),_mm256_max_epi16(AVX2_PACK(lo,hi),min));
+	}
+	apply_gain_c(samples+i,nsamples-i,gain);
+}
+
+AVX2_FUNC static uint64_t energy_avx2(const int16_t *samples, int nsamples, int *peak){
+	__m256i zero=_mm256_setzero_si256();
+	__m256i acc=zero;
+	__m256i max=zero;
+	__m256i min=zero;
+	int16_t vmax[16],vmin[16];
+	uint64_t en[4];
+	int pk;
+	int i,j;
+	for(i=0;i+16<=nsamples;i+=16){
+		__m256i s=_mm256_loadu_si256((const __m256i*)(samples+i));
+		__m256i p=_mm256_madd_epi16(s,s);
+		acc=_mm256_add_epi64(acc,_mm256_unpacklo_epi32(p,zero));
+		acc=_mm256_add_epi64(acc,_mm256_unpackhi_epi32(p,zero));
+		max=_mm256_max_epi16(max,s);
+		min=_mm256_min_epi16(min,s);
+	}
+	_mm256_storeu_si256((__m256i*)en,acc);
+	_mm256_storeu_si256((__m256i*)vmax,max);
+	_mm256_storeu_si256((__m256i*)vmin,min);
+	pk=0;
+	for(j=0;j<16;++j){
+		if (vmax[j]>pk) pk=vmax[j];
+		if (-vmin[j]>pk) pk=-vmin[j];
+	}
+	en[0]+=en[1]+en[2]+en[3]+energy_c(samples+i,nsamples-i,peak);
+	if (peak && pk>*peak) *peak=pk;
+	return en[0];
+}
+
+AVX2_FUNC static void correlate_avx2(const int16_t *samples, const float *t1, const float *t2, int nsamples, float *r1, float *r2){
+	__m256 a1=_mm256_setzero_ps();
+	__m256 a2=_mm256_setzero_ps();
+	float v1[8],v2[8];
+	float c1,c2;
+	int i,j;
+	for(i=0;i+8<=nsamples;i+=8){
+		__m256 s=_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(samples+i))));
+		a1=_mm256_add_ps(a1,_mm256_mul_ps(s,_mm256_loadu_ps(t1+i)));
+		a2=_mm256_add_ps(a2,_mm256_mul_ps(s,_mm256_loadu_ps(t2+i)));
+	}
+	_mm256_storeu_ps(v1,a1);
+	_mm256_storeu_ps(v2,a2);
+	correlate_c(samples+i,t1+i,t2+i,nsamples-i,&c1,&c2);
+	for(j=0;j<8;++j){
+		c1+=v1[j];
+		c2+=v2[j];
+	}
+	*r1=c1;
+	*r2=c2;
+}
+
+static MSAudioKernels kernels_avx2={
+	"avx2",
+	accumulate_avx2,
+	saturate_avx2,
+	apply_gain_avx2,
+	energy_avx2,
+	correlate_avx2
+};
+
+#endif
+
+
+#ifdef AUDIO_KERNELS_NEON
+
+static void accumulate_neon(int32_t *sum, const int16_t *samples, int nsamples){
+	int i;
+	for(i=0;i+8<=nsamples;i+=8){
+		int16x8_t s=vld1q_s16(samples+i);
+		vst1q_s32(sum+i,vaddw_s16(vld1q_s32(sum+i),vget_low_s16(s)));
+		vst1q_s32(sum+i+4,vaddw_s16(vld1q_s32(sum+i+4),vget_high_s16(s)));
+	}
+	accumulate_c(sum+i,samples+i,nsamples-i);
+}
+
+static void saturate_neon(int16_t *out, const int32_t *sum, const int16_t *sub, int nsamples, int16_t limit){
+	int16x8_t max=vdupq_n_s16(limit);
+	int16x8_t min=vdupq_n_s16(-limit);
+	int i;
+	for(i=0;i+8<=nsamples;i+=8){
+		int32x4_t lo=vld1q_s32(sum+i);
+		int32x4_t hi=vld1q_s32(sum+i+4);
+		int16x8_t r;
+		if (sub){
+			int16x8_t s=vld1q_s16(sub+i);
+			lo=vsubw_s16(lo,vget_low_s16(s));
+			hi=vsubw_s16(hi,vget_high_s16(s));
+		}
+		r=vcombine_s16(vqmovn_s32(lo),vqmovn_s32(hi));
+		vst1q_s16(out+i,vminq_s16(vmaxq_s16(r,min),max));
+	}
+	saturate_c(out+i,sum+i,sub ? sub+i : NULL,nsamples-i,limit);
+}
+
+static void apply_gain_neon(int16_t *samples, int nsamples, float gain){
+	int16x8_t min=vdupq_n_s16(-32767);
+	int i;
+	for(i=0;i+8<=nsamples;i+=8){
+		int16x8_t s=vld1q_s16(samples+i);
+		/*vcvtq_s32_f32 truncates, as the (int) cast of the C version*/
+		int32x4_t lo=vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))),gain));
+		int32x4_t hi=vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))),gain));
+		vst1q_s16(samples+i,vmaxq_s16(vcombine_s16(vqmovn_s32(lo),vqmovn_s32(hi)),min));
+	}
+	apply_gain_c(samples+i,nsamples-i,gain);
+}
+
+static uint64_t energy_neon(const int16_t *samples, int nsamples, int *peak){
+	uint64x2_t acc=vdupq_n_u64(0);
+	int16x8_t max=vdupq_n_s16(0);
+	int16x8_t min=vdupq_n_s16(0);
+	int16_t vmax[8],vmin[8];
+	uint64_t en[2];
+	int pk;
+	int i,j;
+	for(i=0;i+8<=nsamples;i+=8){
+		int16x8_t s=vld1q_s16(samples+i);
+		/*squares are at most 2^30: they fit in unsigned 32 bits*/
+		acc=vpadalq_u32(acc,vreinterpretq_u32_s32(vmull_s16(vget_low_s16(s),vget_low_s16(s))));
+		acc=vpadalq_u32(acc,vreinterpretq_u32_s32(vmull_s16(vget_high_s16(s),vget_high_s16(s))));
+		max=vmaxq_s16(max,s);
+		min=vminq_s16(min,s);
+	}
+	vst1q_u64(en,acc);
+	vst1q_s16(vmax,max);
+	vst1q_s16(vmin,min);
+	pk=0;
+	for(j=0;j<8;++j){
+		if (vmax[j]>pk) pk=vmax[j];
+		if (-vmin[j]>pk) pk=-vmin[j];
+	}
+	en[0]+=en[1]+energy_c(samples+i,nsamples-i,peak);
+	if (peak && pk>*peak) *peak=pk;
+	return en[0];
+}
+
+static void correlate_neon(const int16_t *samples, const float *t1, const float *t2, int nsamples, float *r1, float *r2){
+	float32x4_t a1=vdupq_n_f32(0);
+	float32x4_t a2=vdupq_n_f32(0);
+	float v1[4],v2[4];
+	float c1,c2;
+	int i;
+	for(i=0;i+8<=nsamples;i+=8){
+		int16x8_t s=vld1q_s16(samples+i);
+		float32x4_t flo=vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+		float32x4_t fhi=vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+		a1=vmlaq_f32(a1,flo,vld1q_f32(t1+i));
+		a1=vmlaq_f32(a1,fhi,vld1q_f32(t1+i+4));
+		a2=vmlaq_f32(a2,flo,vld1q_f32(t2+i));
+		a2=vmlaq_f32(a2,fhi,vld1q_f32(t2+i+4));
+	}
+	vst1q_f32(v1,a1);
+	vst1q_f32(v2,a2);
+	correlate_c(samples+i,t1+i,t2+i,nsamples-i,&c1,&c2);
+	*r1=v1[0]+v1[1]+v1[2]+v1[3]+c1;
+	*r2=v2[0]+v2[1]+v2[2]+v2[3]+c2;
+}
+
+static MSAudioKernels kernels_neon={
+	"neon",
+	accumulate_neon,
+	saturate_neon,
+	apply_gain_neon,
+	energy_neon,
+	correlate_neon
+};
+
+#endif
+
+
+/* the implementations usable without checking the processor, best last */
+static MSAudioKernels *builtin_kernels[]={
+	&kernels_c,
+#ifdef AUDIO_KERNELS_SSE2
+	&kernels_sse2,
+#endif
+#ifdef AUDIO_KERNELS_NEON
+	&kernels_neon,
+#endif
+};
+
+#define NBUILTIN_KERNELS (int)(sizeof(builtin_kernels)/sizeof(builtin_kernels[0]))
+
+static MSAudioKernels *kernels=NULL;
+
+static bool_t kernels_supported(MSAudioKernels *k){
+#ifdef AUDIO_KERNELS_AVX2
+	if (k==&kernels_avx2){
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2")!=0;
+	}
+#endif
+	return TRUE;
+}
+
+static MSAudioKernels *get_kernels(void){
+	if (kernels==NULL) kernels=builtin_kernels[NBUILTIN_KERNELS-1];
+	return kernels;
+}
+
+void ms_audio_kernels_init(void){
+	kernels=builtin_kernels[NBUILTIN_KERNELS-1];
+#ifdef AUDIO_KERNELS_AVX2
+	if (kernels_supported(&kernels_avx2))
+		kernels=&kernels_avx2;
+#endif
+	ms_message("Using %s audio kernels.",kernels->name);
+}
+
+const char *ms_audio_kernels_get_implementation(void){
+	return get_kernels()->name;
+}
+
+int ms_audio_kernels_set_implementation(const char *name){
+	int i;
+#ifdef AUDIO_KERNELS_AVX2
+	if (strcmp(name,kernels_avx2.name)==0){
+		if (!kernels_supported(&kernels_avx2)) return -1;
+		kernels=&kernels_avx2;
+		return 0;
+	}
+#endif
+	for(i=0;i<NBUILTIN_KERNELS;++i){
+		if (strcmp(name,builtin_kernels[i]->name)==0){
+			kernels=builtin_kernels[i];
+			return 0;
+		}
+	}
+	return -1;
+}
+
+void ms_audio_accumulate(int32_t *sum, const int16_t *samples, int nsamples){
+	get_kernels()->accumulate(sum,samples,nsamples);
+}
+
+void ms_audio_saturate(int16_t *out, const int32_t *sum, const int16_t *sub, int nsamples, int16_t limit){
+	get_kernels()->saturate(out,sum,sub,nsamples,limit);
+}
+
+void ms_audio_apply_gain(int16_t *samples, int nsamples, float gain){
+	get_kernels()->apply_gain(samples,nsamples,gain);
+}
+
+uint64_t ms_audio_energy(const int16_t *samples, int nsamples, int *peak){
+	return get_kernels()->energy(samples,nsamples,peak);
+}
+
+void ms_goertzel_init(MSGoertzel *g, float frequency, int rate, int nsamples){
+	double w=2*M_PI*((double)frequency/(double)rate);
+	float *cos_table=(float*)ms_new(float,nsamples);
+	float *sin_table=(float*)ms_new(float,nsamples);
+	int i;
+	for(i=0;i<nsamples;++i){
+		cos_table[i]=(float)cos(w*i);
+		sin_table[i]=(float)sin(w*i);
+	}
+	g->cos_table=cos_table;
+	g->sin_table=sin_table;
+	/*set last, the tables must be there when nsamples is not 0*/
+	g->nsamples=nsamples;
+}
+
+float ms_goertzel_run(const MSGoertzel *g, const int16_t *samples){
+	float re,im;
+	get_kernels()->correlate(samples,g->cos_table,g->sin_table,g->nsamples,&re,&im);
+	return (re*re)+(im*im);
+}
+
+void ms_goertzel_uninit(MSGoertzel *g){
+	if (g->cos_table) ms_free(g->cos_table);
+	if (g->sin_table) ms_free(g->sin_table);
+	g->cos_table=NULL;
+	g->sin_table=NULL;
+	g->nsamples=0;
+}
@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/msaudiomixer.h"
 #include "mediastreamer2/msticker.h"
+#include "mediastreamer2/dsptools.h"
 
 #ifdef _MSC_VER
 #include <malloc.h>
@@ -30,26 +31,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define MAX_LATENCY 0.08
 #define ALWAYS_STREAMOUT 1
 
-static void accumulate(int32_t *sum, int16_t* contrib, int nwords){
-	int i;
-	for(i=0;i<nwords;++i){
-		sum[i]+=contrib[i];
-	}
-}
-
-static inline int16_t saturate(int32_t s){
-	if (s>32767) return 32767;
-	if (s<-32767) return -32767;
-	return (int16_t)s;
-}
-
-static void apply_gain(int16_t *samples, int nsamples, float gain){
-	int i;
-	for(i=0;i<nsamples;++i){
-		samples[i]=saturate((int)(gain*(float)samples[i]));
-	}
-}
-
 typedef struct Channel{
 	MSBufferizer bufferizer;
 	int16_t *input;	/*the channel contribution, for removal at output*/
@@ -73,9 +54,9 @@ static int channel_process_in(Channel *chan, MSQueue *q, int32_t *sum, int nsamp
 	if (ms_bufferizer_read(&chan->bufferizer,(uint8_t*)chan->input,nsamples*2)!=0){
 		if (chan->active){
 			if (chan->gain!=1.0){
-				apply_gain(chan->input,nsamples,chan->gain);
+				ms_audio_apply_gain(chan->input,nsamples,chan->gain);
 			}
-			accumulate(sum,chan->input,nsamples);
+			ms_audio_accumulate(sum,chan->input,nsamples);
 		}
 		return nsamples;
 	}else memset(chan->input,0,nsamples*2);
@@ -83,20 +64,11 @@ static int channel_process_in(Channel *chan, MSQueue *q, int32_t *sum, int nsamp
 }
 
 static mblk_t *channel_process_out(Channel *chan, int32_t *sum, int nsamples){
-	int i;
 	mblk_t *om=allocb(nsamples*2,0);
 	int16_t *out=(int16_t*)om->b_wptr;
 
-	if (chan->active){
-		/*remove own contribution from sum*/
-		for(i=0;i<nsamples;++i){
-			out[i]=saturate(sum[i]-(int32_t)chan->input[i]);
-		}
-	}else{
-		for(i=0;i<nsamples;++i){
-			out[i]=saturate(sum[i]);
-		}
-	}
+	/*remove own contribution from sum*/
+	ms_audio_saturate(out,sum,chan->active ? chan->input : NULL,nsamples,32767);
 	om->b_wptr+=nsamples*2;
 	return om;
 }
@@ -168,10 +140,8 @@ static void mixer_postprocess(MSFilter *f){
 
 static mblk_t *make_output(int32_t *sum, int nwords){
 	mblk_t *om=allocb(nwords*2,0);
-	int i;
-	for(i=0;i<nwords;++i,om->b_wptr+=2){
-		*(int16_t*)om->b_wptr=saturate(sum[i]);
-	}
+	ms_audio_saturate((int16_t*)om->b_wptr,sum,NULL,nwords,32767);
+	om->b_wptr+=nwords*2;
 	return om;
 }
 
@@ -84,7 +84,7 @@ static void enc_process(MSFilter *f){
 	ms_bufferizer_put_from_queue(s->input,f->inputs[0]);
 	
 	while(ms_bufferizer_read(s->input,(uint8_t*)pcmbuf,s->nsamples*2)!=0){
-		mblk_t *om=allocb(encoded_bytes,0);
+		mblk_t *om=rtp_payload_allocb(encoded_bytes);
 		om->b_wptr+=g726_encode(s->impl,om->b_wptr,pcmbuf,s->nsamples);
 		mblk_set_timestamp_info(om,s->ts);
 		s->ts+=s->nsamples;
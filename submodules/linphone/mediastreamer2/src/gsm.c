@@ -93,7 +93,7 @@ static void enc_process(MSFilter *f){
 		ms_bufferizer_put(s->bufferizer,im);
 	}
 	while(ms_bufferizer_get_avail(s->bufferizer) >= buff_size) {
-		mblk_t *om=allocb(33*s->ptime/20,0);
+		mblk_t *om=rtp_payload_allocb(33*s->ptime/20);
 		buff = (int16_t *)alloca(buff_size);
 		ms_bufferizer_read(s->bufferizer,(uint8_t*)buff,buff_size);
 		
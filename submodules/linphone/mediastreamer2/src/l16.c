@@ -58,7 +58,7 @@ static void enc_process(MSFilter *f)
 	ms_bufferizer_put_from_queue(s->bufferizer,f->inputs[0]);
 	
 	while(ms_bufferizer_get_avail(s->bufferizer)>=s->nbytes) {
-		mblk_t *om=allocb(s->nbytes,0);
+		mblk_t *om=rtp_payload_allocb(s->nbytes);
 		om->b_wptr+=ms_bufferizer_read(s->bufferizer,om->b_wptr,s->nbytes);
 		mblk_set_timestamp_info(om,s->ts);		
 		ms_queue_put(f->outputs[0],om);
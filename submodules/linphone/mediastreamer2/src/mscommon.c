@@ -31,6 +31,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/mscommon.h"
 #include "mediastreamer2/mscodecutils.h"
+#include "mediastreamer2/dsptools.h"
 #include "mediastreamer2/msfilter.h"
 #include <ortp/ortp_srtp.h>
 
@@ -625,6 +626,7 @@ void ms_init(){
 	ortp_set_log_handler(ms_android_log_handler);
 #endif
 	ms_message("Mediastreamer2 " MEDIASTREAMER_VERSION " (git: " GIT_VERSION ") starting.");
+	ms_audio_kernels_init();
 	/* register builtin MSFilter's */
 	for (i=0;ms_filter_descs[i]!=NULL;i++){
 		ms_filter_register(ms_filter_descs[i]);
@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 
 #include "mediastreamer2/msfilter.h"
+#include "mediastreamer2/dsptools.h"
 #include <math.h>
 
 #if defined(_WIN32_WCE)
@@ -377,9 +378,7 @@ static void conf_sum(MSFilter *f, ConfState *s){
 				chan->stat_discarded++;
 			}
 
-			for(j=0;j<s->conf_nsamples;++j){
-				s->sum[j]+=chan->input[j];
-			}
+			ms_audio_accumulate((int32_t*)s->sum,chan->input,s->conf_nsamples);
 			chan->has_contributed=TRUE;
 
 			chan->stat_processed++;
@@ -458,9 +457,7 @@ static void conf_sum(MSFilter *f, ConfState *s){
 			}
 #endif
 
-			for(j=0;j<s->conf_nsamples;++j){
-				s->sum[j]+=chan->input[j];
-			}
+			ms_audio_accumulate((int32_t*)s->sum,chan->input,s->conf_nsamples);
 			chan->has_contributed=TRUE;
 
 			chan->stat_processed++;
@@ -483,31 +480,17 @@ static void conf_sum(MSFilter *f, ConfState *s){
 	return;
 }
 
-static inline int16_t saturate(int sample){
-	if (sample>32000)
-		sample=32000;
-	else if (sample<-32000)
-		sample=-32000;
-	return (int16_t)sample;
-}
-
 static mblk_t * conf_output(ConfState *s, Channel *chan, int16_t attenuation){
 	mblk_t *m=allocb(s->conf_gran,0);
+	int16_t *out=(int16_t*)m->b_wptr;
 	int i;
-	int tmp;
-	if (chan->has_contributed==TRUE){
-		for (i=0;i<s->conf_nsamples;++i){
-			tmp=s->sum[i]-(int)chan->input[i];
-			*((int16_t*)m->b_wptr)=saturate(tmp)/attenuation;
-			m->b_wptr+=2;
-		}
-	}else{
+	ms_audio_saturate(out,(int32_t*)s->sum,(chan->has_contributed==TRUE) ? chan->input : NULL,s->conf_nsamples,32000);
+	if (attenuation!=1){
 		for (i=0;i<s->conf_nsamples;++i){
-			tmp=s->sum[i];
-			*((int16_t*)m->b_wptr)=saturate(tmp)/attenuation;
-			m->b_wptr+=2;
+			out[i]=out[i]/attenuation;
 		}
 	}
+	m->b_wptr+=s->conf_nsamples*2;
 	return m;
 }
 
@@ -18,10 +18,38 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "mediastreamer2/msfilter.h"
+#include "mediastreamer2/msticker.h"
 
 static MSList *desc_list=NULL;
+static MSList *method_tables=NULL;
+/*filters are created and destroyed from any thread, sharing the method tables. The
+filters of plugins may be registered before ms_init(), and destroyed after ms_exit():
+the locks are initialized statically, or on first use on windows, and never destroyed*/
+#ifndef WIN32
+static ms_mutex_t tables_lock=PTHREAD_MUTEX_INITIALIZER;
+#else
+static ms_mutex_t tables_lock=NULL;
+#endif
 static bool_t statistics_enabled=FALSE;
 static MSList *stats_list=NULL;
+/*filters of the same type may be processed concurrently by a multi-threaded ticker*/
+#ifndef WIN32
+static ms_mutex_t stats_lock=PTHREAD_MUTEX_INITIALIZER;
+#else
+static ms_mutex_t stats_lock=NULL;
+#endif
+
+static ms_mutex_t *static_lock(ms_mutex_t *lock){
+#ifdef WIN32
+	if (*lock==NULL){
+		HANDLE m=CreateMutex(NULL,FALSE,NULL);
+		/*another thread may have created it meanwhile*/
+		if (InterlockedCompareExchangePointer((PVOID volatile*)lock,m,NULL)!=NULL)
+			CloseHandle(m);
+	}
+#endif
+	return lock;
+}
 
 static int compare_stats_with_name(const MSFilterStats *stat, const char *name){
 	return strcmp(stat->name,name);
@@ -38,24 +66,150 @@ static MSFilterStats *find_or_create_stats(MSFilterDesc *desc){
 	return ret;
 }
 
+#define MS_FILTER_METHOD_GET_FID(id)	(((id)>>16) & 0xFFFF)
+#define MS_FILTER_METHOD_GET_INDEX(id) ( ((id)>>8) & 0XFF) 
+
+static inline bool_t is_interface_method(unsigned int magic){
+	return magic==MS_FILTER_BASE_ID || magic>MSFilterInterfaceBegin;
+}
+
+/*the methods of a filter having the same fid (the filter's own id, the base
+id or an interface id), indexed by their method index*/
+typedef struct _MSFilterMethodSet{
+	unsigned int fid;
+	int count;
+	MSFilterMethod **methods;
+	bool_t collisions; /*some methods share the same index with different argument sizes*/
+}MSFilterMethodSet;
+
+struct _MSFilterMethodTable{
+	MSFilterDesc *desc;
+	MSFilterMethodSet *sets;
+	int nsets;
+	int refcnt; /*one for the method_tables list, one per living filter*/
+};
+
+static MSFilterMethodSet *get_method_set(MSFilterMethodTable *t, unsigned int fid){
+	int i;
+	for(i=0;i<t->nsets;i++){
+		if (t->sets[i].fid==fid) return &t->sets[i];
+	}
+	t->sets=(MSFilterMethodSet*)ms_realloc(t->sets,(t->nsets+1)*sizeof(MSFilterMethodSet));
+	memset(&t->sets[t->nsets],0,sizeof(MSFilterMethodSet));
+	t->sets[t->nsets].fid=fid;
+	return &t->sets[t->nsets++];
+}
+
+/*checks the method definitions of the filter once for all, and indexes them*/
+static MSFilterMethodTable *method_table_new(MSFilterDesc *desc){
+	MSFilterMethodTable *t=(MSFilterMethodTable*)ms_new0(MSFilterMethodTable,1);
+	MSFilterMethod *methods=desc->methods;
+	int i;
+	t->desc=desc;
+	t->refcnt=1;
+	for(i=0;methods!=NULL && methods[i].method!=NULL; i++){
+		unsigned int mm=MS_FILTER_METHOD_GET_FID(methods[i].id);
+		int index=MS_FILTER_METHOD_GET_INDEX(methods[i].id);
+		MSFilterMethodSet *set;
+		if (mm!=desc->id && !is_interface_method(mm)) {
+			ms_fatal("Bad method definition on filter %s. fid=%u , mm=%u",desc->name,desc->id,mm);
+			continue;
+		}
+		set=get_method_set(t,mm);
+		if (index>=set->count){
+			set->methods=(MSFilterMethod**)ms_realloc(set->methods,(index+1)*sizeof(MSFilterMethod*));
+			memset(set->methods+set->count,0,(index+1-set->count)*sizeof(MSFilterMethod*));
+			set->count=index+1;
+		}
+		/*as with a linear search, the first definition of a method wins*/
+		if (set->methods[index]==NULL) set->methods[index]=&methods[i];
+		else if (set->methods[index]->id!=methods[i].id) set->collisions=TRUE;
+	}
+	return t;
+}
+
+static void method_table_destroy(MSFilterMethodTable *t){
+	int i;
+	for(i=0;i<t->nsets;i++)
+		if (t->sets[i].methods) ms_free(t->sets[i].methods);
+	if (t->sets) ms_free(t->sets);
+	ms_free(t);
+}
+
+/*the filters still alive when the tables are unregistered keep theirs until destroyed*/
+static void method_table_unref(MSFilterMethodTable *t){
+	int refcnt;
+	ms_mutex_lock(static_lock(&tables_lock));
+	refcnt=--t->refcnt;
+	ms_mutex_unlock(&tables_lock);
+	if (refcnt==0) method_table_destroy(t);
+}
+
+static int compare_table_desc(const MSFilterMethodTable *t, const MSFilterDesc *desc){
+	return t->desc==desc ? 0 : -1;
+}
+
+/*must be called with the tables lock held*/
+static MSFilterMethodTable *get_method_table(MSFilterDesc *desc){
+	MSList *elem=ms_list_find_custom(method_tables,(MSCompareFunc)compare_table_desc,desc);
+	MSFilterMethodTable *t;
+	if (elem!=NULL) return (MSFilterMethodTable*)elem->data;
+	/*filters may be created from a description that has not been registered*/
+	t=method_table_new(desc);
+	method_tables=ms_list_prepend(method_tables,t);
+	return t;
+}
+
+static MSFilterMethod *find_method(MSFilter *f, unsigned int id){
+	MSFilterMethodTable *t=f->method_table;
+	unsigned int fid=MS_FILTER_METHOD_GET_FID(id);
+	int index=MS_FILTER_METHOD_GET_INDEX(id);
+	int i;
+	for(i=0;i<t->nsets;i++){
+		MSFilterMethodSet *set=&t->sets[i];
+		if (set->fid==fid){
+			MSFilterMethod *m=(index<set->count) ? set->methods[index] : NULL;
+			if (m!=NULL && m->id==id) return m;
+			if (m!=NULL && set->collisions){
+				MSFilterMethod *methods=f->desc->methods;
+				int j;
+				for(j=0;methods[j].method!=NULL;j++)
+					if (methods[j].id==id) return &methods[j];
+			}
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
 void ms_filter_register(MSFilterDesc *desc){
 	if (desc->id==MS_FILTER_NOT_SET_ID){
 		ms_fatal("MSFilterId for %s not set !",desc->name);
 	}
 	/*lastly registered encoder/decoders may replace older ones*/
 	desc_list=ms_list_prepend(desc_list,desc);
+	ms_mutex_lock(static_lock(&tables_lock));
+	get_method_table(desc);
+	ms_mutex_unlock(&tables_lock);
 }
 
 void ms_filter_unregister_all(){
+	MSList *tables;
 	if (desc_list!=NULL) {
 		ms_list_free(desc_list);
 		desc_list=NULL;
 	}
-	if (stats_list!=NULL){
-		ms_list_for_each(stats_list,ms_free);
-		ms_list_free(stats_list);
-		stats_list=NULL;
-	}
+	ms_mutex_lock(static_lock(&tables_lock));
+	tables=method_tables;
+	method_tables=NULL;
+	ms_mutex_unlock(&tables_lock);
+	ms_list_for_each(tables,(void (*)(void*))method_table_unref);
+	ms_list_free(tables);
+	ms_mutex_lock(static_lock(&stats_lock));
+	ms_list_for_each(stats_list,ms_free);
+	ms_list_free(stats_list);
+	stats_list=NULL;
+	ms_mutex_unlock(&stats_lock);
 }
 
 bool_t ms_filter_codec_supported(const char *mime){
@@ -105,11 +259,17 @@ MSFilter *ms_filter_new_from_desc(MSFilterDesc *desc){
 	obj=(MSFilter *)ms_new0(MSFilter,1);
 	ms_mutex_init(&obj->lock,NULL);
 	obj->desc=desc;
+	ms_mutex_lock(static_lock(&tables_lock));
+	obj->method_table=get_method_table(desc);
+	obj->method_table->refcnt++;
+	ms_mutex_unlock(&tables_lock);
 	if (desc->ninputs>0)	obj->inputs=(MSQueue**)ms_new0(MSQueue*,desc->ninputs);
 	if (desc->noutputs>0)	obj->outputs=(MSQueue**)ms_new0(MSQueue*,desc->noutputs);
 
 	if (statistics_enabled){
+		ms_mutex_lock(static_lock(&stats_lock));
 		obj->stats=find_or_create_stats(desc);
+		ms_mutex_unlock(&stats_lock);
 	}
 	if (obj->desc->init!=NULL)
 		obj->desc->init(obj);
@@ -155,19 +315,24 @@ MSFilterId ms_filter_get_id(MSFilter *f){
 }
 
 int ms_filter_link(MSFilter *f1, int pin1, MSFilter *f2, int pin2){
+	MSTicker *ticker;
 	MSQueue *q;
 	ms_message("ms_filter_link: %s:%p,%i-->%s:%p,%i",f1->desc->name,f1,pin1,f2->desc->name,f2,pin2);
 	ms_return_val_if_fail(pin1<f1->desc->noutputs, -1);
 	ms_return_val_if_fail(pin2<f2->desc->ninputs, -1);
 	ms_return_val_if_fail(f1->outputs[pin1]==NULL,-1);
 	ms_return_val_if_fail(f2->inputs[pin2]==NULL,-1);
+	ticker=f1->ticker ? f1->ticker : f2->ticker;
+	if (ticker) ms_ticker_begin_graph_change(ticker);
 	q=ms_queue_new(f1,pin1,f2,pin2);
 	f1->outputs[pin1]=q;
 	f2->inputs[pin2]=q;
+	if (ticker) ms_ticker_end_graph_change(ticker);
 	return 0;
 }
 
 int ms_filter_unlink(MSFilter *f1, int pin1, MSFilter *f2, int pin2){
+	MSTicker *ticker;
 	MSQueue *q;
 	ms_message("ms_filter_unlink: %s:%p,%i-->%s:%p,%i",f1 ? f1->desc->name : "!NULL!",f1,pin1,f2 ? f2->desc->name : "!NULL!",f2,pin2);
 	ms_return_val_if_fail(pin1<f1->desc->noutputs, -1);
@@ -175,48 +340,49 @@ int ms_filter_unlink(MSFilter *f1, int pin1, MSFilter *f2, int pin2){
 	ms_return_val_if_fail(f1->outputs[pin1]!=NULL,-1);
 	ms_return_val_if_fail(f2->inputs[pin2]!=NULL,-1);
 	ms_return_val_if_fail(f1->outputs[pin1]==f2->inputs[pin2],-1);
+	ticker=f1->ticker ? f1->ticker : f2->ticker;
+	if (ticker) ms_ticker_begin_graph_change(ticker);
 	q=f1->outputs[pin1];
 	f1->outputs[pin1]=f2->inputs[pin2]=0;
 	ms_queue_destroy(q);
+	if (ticker) ms_ticker_end_graph_change(ticker);
 	return 0;
 }
 
-#define MS_FILTER_METHOD_GET_FID(id)	(((id)>>16) & 0xFFFF)
-#define MS_FILTER_METHOD_GET_INDEX(id) ( ((id)>>8) & 0XFF) 
-
-static inline bool_t is_interface_method(unsigned int magic){
-	return magic==MS_FILTER_BASE_ID || magic>MSFilterInterfaceBegin;
-}
-
 int ms_filter_call_method(MSFilter *f, unsigned int id, void *arg){
-	MSFilterMethod *methods=f->desc->methods;
-	int i;
+	MSFilterMethod *m;
 	unsigned int magic=MS_FILTER_METHOD_GET_FID(id);
 	if (!is_interface_method(magic) && magic!=f->desc->id) {
 		ms_fatal("Method type checking failed when calling %u on filter %s",id,f->desc->name);
 		return -1;
 	}
-	for(i=0;methods!=NULL && methods[i].method!=NULL; i++){
-		unsigned int mm=MS_FILTER_METHOD_GET_FID(methods[i].id);
-		if (mm!=f->desc->id && !is_interface_method(mm)) {
-			ms_fatal("Bad method definition on filter %s. fid=%u , mm=%u",f->desc->name,f->desc->id,mm);
-			return -1;
-		}
-		if (methods[i].id==id){
-			return methods[i].method(f,arg);
-		}
+	m=find_method(f,id);
+	if (m!=NULL){
+		return m->method(f,arg);
 	}
 	if (magic!=MS_FILTER_BASE_ID) ms_error("no such method on filter %s, fid=%i method index=%i",f->desc->name,magic,
 	                           MS_FILTER_METHOD_GET_INDEX(id) );
 	return -1;
 }
 
+int ms_filter_call_methods(MSFilter *f, const MSFilterMethodCall *calls, int ncalls){
+	MSTicker *ticker=f->ticker;
+	int i,err=0;
+	/*the ticker lock is held while the filters are processed: the settings are
+	all applied between two ticks. The threads of the ticker already hold it (from a
+	notify callback for example), and it is not recursive*/
+	if (ticker!=NULL && ms_ticker_is_current_thread(ticker)) ticker=NULL;
+	if (ticker!=NULL) ms_mutex_lock(&ticker->lock);
+	for(i=0;i<ncalls;i++){
+		if (ms_filter_call_method(f,calls[i].id,calls[i].arg)!=0)
+			err=-1;
+	}
+	if (ticker!=NULL) ms_mutex_unlock(&ticker->lock);
+	return err;
+}
+
 bool_t ms_filter_has_method(MSFilter *f, unsigned int id){
-	MSFilterMethod *methods=f->desc->methods;
-	int i;
-	for(i=0;methods!=NULL && methods[i].method!=NULL; i++)
-		if (methods[i].id==id) return TRUE;
-	return FALSE;
+	return find_method(f,id)!=NULL;
 }
 
 int ms_filter_call_method_noarg(MSFilter *f, unsigned int id){
@@ -229,10 +395,12 @@ void ms_filter_set_notify_callback(MSFilter *f, MSFilterNotifyFunc fn, void *ud)
 }
 
 void ms_filter_destroy(MSFilter *f){
+	if (ms_ticker_defer_destroy(f)) return;
 	if (f->desc->uninit!=NULL)
 		f->desc->uninit(f);
 	if (f->inputs!=NULL)	ms_free(f->inputs);
 	if (f->outputs!=NULL)	ms_free(f->outputs);
+	method_table_unref(f->method_table);
 	ms_mutex_destroy(&f->lock);
 	ms_free(f);
 }
@@ -247,8 +415,10 @@ void ms_filter_process(MSFilter *f){
 	f->desc->process(f);
 	if (f->stats){
 		ms_get_cur_time(&stop);
+		ms_mutex_lock(static_lock(&stats_lock));
 		f->stats->count++;
 		f->stats->elapsed+=(stop.tv_sec-start.tv_sec)*1000000000LL + (stop.tv_nsec-start.tv_nsec);
+		ms_mutex_unlock(&stats_lock);
 	}
 
 }
@@ -363,11 +533,13 @@ const MSList * ms_filter_get_statistics(void){
 void ms_filter_reset_statistics(void){
 	MSList *elem;
 	
+	ms_mutex_lock(static_lock(&stats_lock));
 	for(elem=stats_list;elem!=NULL;elem=elem->next){
 		MSFilterStats *stats=(MSFilterStats *)elem->data;
 		stats->elapsed=0;
 		stats->count=0;
 	}
+	ms_mutex_unlock(&stats_lock);
 }
 
 static int usage_compare(const MSFilterStats *s1, const MSFilterStats *s2){
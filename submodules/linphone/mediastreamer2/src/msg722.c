@@ -81,7 +81,7 @@ static void enc_process(MSFilter *f)
 
 	chunksize = nbytes*frame_per_packet;
 	while(ms_bufferizer_read(s->bufferizer,buf, chunksize) == chunksize) {
-		mblk_t *om=allocb(nbytes*frame_per_packet,0);//too large...
+		mblk_t *om=rtp_payload_allocb(nbytes*frame_per_packet);//too large...
 		int k;
 		
 		k = g722_encode(s->state, om->b_wptr, (int16_t *)buf, chunksize/2);		
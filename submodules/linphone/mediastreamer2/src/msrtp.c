@@ -298,6 +298,13 @@ static int send_dtmf(MSFilter * f, uint32_t timestamp_start, uint32_t current_ti
 	return 0;
 }
 
+/*sends the packets prepared for a same timestamp, with as few system calls as the session allows*/
+static void sender_flush(RtpSession *s, mblk_t **packets, int *count, uint32_t timestamp){
+	if (*count==1) rtp_session_sendm_with_ts(s, packets[0], timestamp);
+	else if (*count>1) rtp_session_sendm_batch_with_ts(s, packets, *count, timestamp);
+	*count=0;
+}
+
 static void sender_process(MSFilter * f)
 {
 	SenderData *d = (SenderData *) f->data;
@@ -305,6 +312,9 @@ static void sender_process(MSFilter * f)
 
 	mblk_t *im;
 	uint32_t timestamp;
+	mblk_t *pending[RTP_IO_BATCH_MAX];
+	int npending=0;
+	uint32_t pending_ts=0;
 
 	if (s == NULL){
 		ms_queue_flush(f->inputs[0]);
@@ -331,6 +341,9 @@ static void sender_process(MSFilter * f)
 			d->skip = TRUE;
 			d->dtmf_start = TRUE;
 		}
+		/*the packets of a video frame share their timestamp and are sent together*/
+		if (npending>0 && (d->skip || timestamp!=pending_ts || npending==RTP_IO_BATCH_MAX))
+			sender_flush(s, pending, &npending, pending_ts);
 		if (d->skip) {
 			uint32_t origin_ts=d->skip_until-d->dtmf_duration;
 			if (d->dtmf_start || ((timestamp-d->dtmf_ts_cur) >= d->dtmf_ts_step)){
@@ -346,15 +359,17 @@ static void sender_process(MSFilter * f)
 		}
 		if (im){
 			if (d->skip == FALSE && d->mute_mic==FALSE){
-				header = rtp_session_create_packet(s, 12, NULL, 0);
-				rtp_set_markbit(header, mblk_get_marker_info(im));
-				header->b_cont = im;
-				rtp_session_sendm_with_ts(s, header, timestamp);
+				bool_t marker=mblk_get_marker_info(im);
+				header = rtp_session_prepend_header(s, im);
+				rtp_set_markbit(header, marker);
+				pending[npending++]=header;
+				pending_ts=timestamp;
 			}else{
 				freemsg(im);
 			}
 		}
 	}while ((im = ms_queue_get(f->inputs[0])) != NULL);
+	sender_flush(s, pending, &npending, pending_ts);
 	ms_filter_unlock(f);
 }
 
@@ -257,7 +257,7 @@ static void enc_process(MSFilter *f){
 		ms_bufferizer_put(s->bufferizer,im);
 	}
 	while(ms_bufferizer_read(s->bufferizer,buf,nbytes*frame_per_packet)==nbytes*frame_per_packet){
-		mblk_t *om=allocb(nbytes*frame_per_packet,0);//too large...
+		mblk_t *om=rtp_payload_allocb(nbytes*frame_per_packet);//too large...
 		int k;
 		SpeexBits bits;
 		speex_bits_init(&bits);
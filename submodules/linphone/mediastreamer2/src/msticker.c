@@ -42,6 +42,55 @@ static const double smooth_coef=0.9;
 
 void * ms_ticker_run(void *s);
 static uint64_t get_cur_time_ms(void *);
+static void update_plan(MSTicker *ticker);
+static void plan_destroy(struct _MSTickerPlan *plan);
+static void destroy_pool(MSTicker *ticker);
+static void destroy_profiler(MSTicker *ticker);
+
+/*the ticker whose filters the calling thread runs, set once for all by the ticker
+thread and the worker threads of its pool*/
+#ifndef WIN32
+static pthread_key_t current_ticker_key;
+static pthread_once_t current_ticker_once=PTHREAD_ONCE_INIT;
+
+static void current_ticker_key_init(void){
+	pthread_key_create(&current_ticker_key,NULL);
+}
+
+static void set_current_ticker(MSTicker *ticker){
+	pthread_once(&current_ticker_once,current_ticker_key_init);
+	pthread_setspecific(current_ticker_key,ticker);
+}
+
+static MSTicker *get_current_ticker(void){
+	pthread_once(&current_ticker_once,current_ticker_key_init);
+	return (MSTicker*)pthread_getspecific(current_ticker_key);
+}
+#else
+static DWORD current_ticker_key=TLS_OUT_OF_INDEXES;
+
+static DWORD current_ticker_key_get(void){
+	if (current_ticker_key==TLS_OUT_OF_INDEXES){
+		DWORD key=TlsAlloc();
+		/*another thread may have allocated it meanwhile*/
+		if (InterlockedCompareExchange((LONG volatile*)&current_ticker_key,(LONG)key,(LONG)TLS_OUT_OF_INDEXES)!=(LONG)TLS_OUT_OF_INDEXES)
+			TlsFree(key);
+	}
+	return current_ticker_key;
+}
+
+static void set_current_ticker(MSTicker *ticker){
+	TlsSetValue(current_ticker_key_get(),ticker);
+}
+
+static MSTicker *get_current_ticker(void){
+	return (MSTicker*)TlsGetValue(current_ticker_key_get());
+}
+#endif
+
+bool_t ms_ticker_is_current_thread(const MSTicker *ticker){
+	return ticker!=NULL && get_current_ticker()==ticker;
+}
 
 void ms_ticker_start(MSTicker *s){
 	s->run=TRUE;
@@ -62,6 +111,13 @@ void ms_ticker_init(MSTicker *ticker)
 	ticker->name=ms_strdup("MSTicker");
 	ticker->av_load=0;
 	ticker->prio=MS_TICKER_PRIO_NORMAL;
+	ticker->nthreads=1;
+	ticker->plan=NULL;
+	ticker->plan_dirty=FALSE;
+	ticker->in_pass=FALSE;
+	ticker->destroyed=NULL;
+	ticker->pool=NULL;
+	ticker->profiler=NULL;
 	ms_ticker_start(ticker);
 }
 
@@ -91,6 +147,13 @@ void ms_ticker_set_priority(MSTicker *ticker, MSTickerPrio prio){
 void ms_ticker_uninit(MSTicker *ticker)
 {
 	ms_ticker_stop(ticker);
+	destroy_pool(ticker);
+	destroy_profiler(ticker);
+	ticker->nthreads=1;
+	if (ticker->plan){
+		plan_destroy(ticker->plan);
+		ticker->plan=NULL;
+	}
 	ms_free(ticker->name);
 	ms_mutex_destroy(&ticker->lock);
 }
@@ -136,6 +199,7 @@ int ms_ticker_attach(MSTicker *ticker,MSFilter *f)
 		ms_filter_preprocess((MSFilter*)it->data,ticker);
 	ms_mutex_lock(&ticker->lock);
 	ticker->execution_list=ms_list_concat(ticker->execution_list,sources);
+	update_plan(ticker);
 	ms_mutex_unlock(&ticker->lock);
 	ms_list_free(filters);
 	return 0;
@@ -167,6 +231,7 @@ int ms_ticker_detach(MSTicker *ticker,MSFilter *f){
 	for(it=sources;it!=NULL;it=ms_list_next(it)){
 		ticker->execution_list=ms_list_remove(ticker->execution_list,it->data);
 	}
+	update_plan(ticker);
 	ms_mutex_unlock(&ticker->lock);
 	ms_list_for_each(filters,(void (*)(void*))ms_filter_postprocess);
 	ms_list_free(filters);
@@ -175,23 +240,12 @@ int ms_ticker_detach(MSTicker *ticker,MSFilter *f){
 }
 
 
-static bool_t filter_can_process(MSFilter *f, int tick){
-	/* look if filters before this one have run */
-	int i;
-	MSQueue *l;
-	for(i=0;i<f->desc->ninputs;i++){
-		l=f->inputs[i];
-		if (l!=NULL){
-			if (l->prev.filter->last_tick!=tick) return FALSE;
-		}
-	}
-	return TRUE;
-}
-
-static void call_process(MSFilter *f){
+/*returns TRUE if the filter has been processed*/
+static bool_t call_process(MSFilter *f){
 	bool_t process_done=FALSE;
 	if (f->desc->ninputs==0 || f->desc->flags & MS_FILTER_IS_PUMP){
 		ms_filter_process(f);
+		process_done=TRUE;
 	}else{
 		while (ms_filter_inputs_have_data(f)) {
 			if (process_done){
@@ -201,44 +255,7 @@ static void call_process(MSFilter *f){
 			process_done=TRUE;
 		}
 	}
-}
-
-static void run_graph(MSFilter *f, MSTicker *s, MSList **unschedulable, bool_t force_schedule){
-	int i;
-	MSQueue *l;
-	if (f->last_tick!=s->ticks ){
-		if (filter_can_process(f,s->ticks) || force_schedule) {
-			/* this is a candidate */
-			f->last_tick=s->ticks;
-			call_process(f);	
-			/* now recurse to next filters */		
-			for(i=0;i<f->desc->noutputs;i++){
-				l=f->outputs[i];
-				if (l!=NULL){
-					run_graph(l->next.filter,s,unschedulable, force_schedule);
-				}
-			}
-		}else{
-			/* this filter has not all inputs that have been filled by filters before it. */
-			*unschedulable=ms_list_prepend(*unschedulable,f);
-		}
-	}
-}
-
-static void run_graphs(MSTicker *s, MSList *execution_list, bool_t force_schedule){
-	MSList *it;
-	MSList *unschedulable=NULL;
-	for(it=execution_list;it!=NULL;it=it->next){
-		run_graph((MSFilter*)it->data,s,&unschedulable,force_schedule);
-	}
-	/* filters that are part of a loop haven't been called in process() because one of their input refers to a filter that could not be scheduled (because they could not be scheduled themselves)... Do you understand ?*/
-	/* we resolve this by simply assuming that they must be called anyway 
-	for the loop to run correctly*/
-	/* we just recall run_graphs on them, as if they were source filters */
-	if (unschedulable!=NULL) {
-		run_graphs(s,unschedulable,TRUE);
-		ms_list_free(unschedulable);
-	}
+	return process_done;
 }
 
 static uint64_t get_cur_time_ms(void *unused){
@@ -340,6 +357,569 @@ static void unset_high_prio(int precision){
 #endif
 }
 
+/*per filter measurements, see ms_ticker_enable_profiling()*/
+typedef struct _MSFilterProfileEntry{
+	MSFilterProfile profile;
+	MSQueueProfile *inputs;
+	uint64_t start;	/*start of the last process, in nanoseconds*/
+	uint64_t last;	/*time spent at the last tick, 0 if not processed*/
+	int thread;	/*0 for the ticker thread, else the worker thread that ran the filter*/
+}MSFilterProfileEntry;
+
+struct _MSTickerProfiler{
+	MSTickerProfile profile;
+	MSList *entries;
+	MSFilterProfileEntry **plan_entries;	/*the entries in the order of the plan's filters*/
+	FILE *trace;
+	bool_t trace_first;
+	uint64_t origin;	/*time origin of the trace*/
+};
+
+typedef struct _MSTickerProfiler MSTickerProfiler;
+
+static uint64_t get_cur_time_ns(void){
+	MSTimeSpec ts;
+	ms_get_cur_time(&ts);
+	return (ts.tv_sec*1000000000LL) + ts.tv_nsec;
+}
+
+static int histogram_index(uint64_t value){
+	int msb=0;
+	int index;
+	if (value<4) return (int)value;
+	while((value>>msb)>1) msb++;
+	index=(msb-1)*4 + (int)((value>>(msb-2)) & 3);
+	return (index<MS_TIME_HISTOGRAM_BUCKETS) ? index : MS_TIME_HISTOGRAM_BUCKETS-1;
+}
+
+static uint64_t histogram_lower_bound(int index){
+	if (index<4) return index;
+	return ((uint64_t)(4+(index%4)))<<(index/4-1);
+}
+
+void ms_time_histogram_add(MSTimeHistogram *h, uint64_t value){
+	h->buckets[histogram_index(value)]++;
+	h->count++;
+	h->total+=value;
+	if (value>h->max) h->max=value;
+}
+
+uint64_t ms_time_histogram_get_percentile(const MSTimeHistogram *h, float percent){
+	uint64_t rank,sum=0;
+	int i;
+	if (h->count==0) return 0;
+	rank=(uint64_t)((percent*(double)h->count)/100.0);
+	if (rank<1) rank=1;
+	for(i=0;i<MS_TIME_HISTOGRAM_BUCKETS-1;i++){
+		sum+=h->buckets[i];
+		if (sum>=rank) break;
+	}
+	if (i==MS_TIME_HISTOGRAM_BUCKETS-1) return h->max;
+	return MIN(histogram_lower_bound(i+1)-1,h->max);
+}
+
+static void run_filter(MSTicker *s, MSFilter *f, MSFilterProfileEntry *e, int thread){
+	uint64_t start;
+	int i;
+	f->last_tick=s->ticks;
+	if (e==NULL){
+		call_process(f);
+		return;
+	}
+	for(i=0;i<f->desc->ninputs;i++){
+		MSQueue *q=f->inputs[i];
+		if (q!=NULL){
+			MSQueueProfile *qp=&e->inputs[i];
+			qp->depth=q->q.q_mcount;
+			if (qp->depth>qp->max_depth) qp->max_depth=qp->depth;
+			qp->total_depth+=qp->depth;
+		}
+	}
+	start=get_cur_time_ns();
+	if (call_process(f)){
+		e->start=start;
+		e->last=get_cur_time_ns()-start;
+		if (e->last==0) e->last=1;
+		e->thread=thread;
+		ms_time_histogram_add(&e->profile.process_time,e->last);
+	}else e->last=0;
+}
+
+/* the execution plan of the ticker: the filters reachable from the sources,
+sorted by level so that a filter only depends on filters of lower levels.
+It is computed when filters are attached or detached, loops being broken once
+for all, so that a tick just runs through the filters array. All the filters
+of a level may also run concurrently */
+struct _MSTickerPlan{
+	MSFilter **filters;
+	int *level_end; /* index in filters following the last filter of each level*/
+	int nfilters;
+	int nlevels;
+};
+
+typedef struct _MSTickerPlan MSTickerPlan;
+
+static void collect_filters(MSFilter *f, MSFilter ***filters, int *nfilters, int *size){
+	int i;
+	MSQueue *l;
+	if (f->seen) return;
+	f->seen=TRUE;
+	if (*nfilters==*size){
+		*size=(*size==0) ? 16 : (*size)*2;
+		*filters=(MSFilter**)ms_realloc(*filters,(*size)*sizeof(MSFilter*));
+	}
+	(*filters)[(*nfilters)++]=f;
+	for(i=0;i<f->desc->noutputs;i++){
+		l=f->outputs[i];
+		if (l!=NULL) collect_filters(l->next.filter,filters,nfilters,size);
+	}
+}
+
+static int find_filter(MSFilter **filters, int nfilters, MSFilter *f){
+	int i;
+	for(i=0;i<nfilters;i++){
+		if (filters[i]==f) return i;
+	}
+	return -1;
+}
+
+static MSTickerPlan *plan_new(MSList *sources){
+	MSTickerPlan *plan;
+	MSFilter **all=NULL;
+	int size=0,n=0,count=0;
+	int *pending,*ninputs;
+	int i,j,k;
+	MSList *it;
+
+	for(it=sources;it!=NULL;it=it->next)
+		collect_filters((MSFilter*)it->data,&all,&n,&size);
+	if (n==0) return NULL;
+
+	/* count the inputs coming from the scheduled filters (the seen ones) */
+	pending=(int*)ms_new0(int,n);
+	ninputs=(int*)ms_new0(int,n);
+	for(i=0;i<n;i++){
+		MSFilter *f=all[i];
+		for(j=0;j<f->desc->ninputs;j++){
+			MSQueue *l=f->inputs[j];
+			if (l!=NULL && l->prev.filter->seen) pending[i]++;
+		}
+		ninputs[i]=pending[i];
+	}
+
+	plan=(MSTickerPlan*)ms_new0(MSTickerPlan,1);
+	plan->filters=(MSFilter**)ms_new(MSFilter*,n);
+	plan->level_end=(int*)ms_new(int,n);
+	plan->nfilters=n;
+	while(count<n){
+		int begin=count;
+		for(i=0;i<n;i++){
+			if (pending[i]==0){
+				plan->filters[count++]=all[i];
+				pending[i]=-1;
+			}
+		}
+		if (count==begin){
+			/* the remaining filters are all part of loops (echo cancellers,
+			conferences...): force one of them to run as if all its inputs were
+			ready, preferably one that is already fed by a previous level */
+			int forced=-1;
+			for(i=0;i<n;i++){
+				if (pending[i]>0){
+					if (forced==-1) forced=i;
+					if (pending[i]<ninputs[i]){
+						forced=i;
+						break;
+					}
+				}
+			}
+			plan->filters[count++]=all[forced];
+			pending[forced]=-1;
+		}
+		for(i=begin;i<count;i++){
+			MSFilter *f=plan->filters[i];
+			for(j=0;j<f->desc->noutputs;j++){
+				MSQueue *l=f->outputs[j];
+				if (l==NULL) continue;
+				k=find_filter(all,n,l->next.filter);
+				if (k>=0 && pending[k]>0) pending[k]--;
+			}
+		}
+		plan->level_end[plan->nlevels++]=count;
+	}
+
+	for(i=0;i<n;i++) all[i]->seen=FALSE;
+	ms_free(all);
+	ms_free(pending);
+	ms_free(ninputs);
+	return plan;
+}
+
+static void plan_destroy(MSTickerPlan *plan){
+	ms_free(plan->filters);
+	ms_free(plan->level_end);
+	ms_free(plan);
+}
+
+/*worker threads sharing out the filters of a level with the ticker thread*/
+struct _MSTickerPool{
+	MSTicker *ticker;
+	ms_thread_t *threads;
+	int nthreads;
+	ms_mutex_t lock;
+	ms_cond_t cond;	/*signaled when there are filters to run*/
+	ms_cond_t done_cond;	/*signaled when the filters being run are done or wait to change the graph*/
+	MSFilter **filters;
+	MSFilterProfileEntry **entries;	/*NULL unless profiling*/
+	int nfilters;
+	int next;	/*next filter to be picked*/
+	int running;	/*number of filters being run*/
+	int blocked;	/*number of them waiting to change the graph*/
+	int started;	/*number of worker threads started*/
+	bool_t run;
+	bool_t stop;	/*the graph changed, the remaining filters of the level are left out*/
+	bool_t changing;	/*a filter being run is changing the graph*/
+};
+
+typedef struct _MSTickerPool MSTickerPool;
+
+/*called with pool->lock held, returns with it held*/
+static void pool_run_one(MSTickerPool *pool, int thread){
+	int i=pool->next++;
+	pool->running++;
+	ms_mutex_unlock(&pool->lock);
+	run_filter(pool->ticker,pool->filters[i],pool->entries ? pool->entries[i] : NULL,thread);
+	ms_mutex_lock(&pool->lock);
+	pool->running--;
+	if (pool->running==pool->blocked)
+		ms_cond_broadcast(&pool->done_cond);
+}
+
+/*called by a thread running a filter of the level, which links or unlinks filters:
+the graph is changed once the other filters being run are done, or wait to change
+it too, and no other filter of the level is started. Returns FALSE if no level is
+being run by the pool*/
+static bool_t pool_begin_change(MSTickerPool *pool){
+	ms_mutex_lock(&pool->lock);
+	if (pool->nfilters==0){
+		ms_mutex_unlock(&pool->lock);
+		return FALSE;
+	}
+	pool->stop=TRUE;
+	pool->blocked++;
+	while(pool->changing || pool->running>pool->blocked)
+		ms_cond_wait(&pool->done_cond,&pool->lock);
+	pool->blocked--;
+	pool->changing=TRUE;
+	pool->ticker->plan_dirty=TRUE;
+	ms_mutex_unlock(&pool->lock);
+	return TRUE;
+}
+
+static void pool_end_change(MSTickerPool *pool){
+	ms_mutex_lock(&pool->lock);
+	if (pool->nfilters>0){
+		pool->changing=FALSE;
+		ms_cond_broadcast(&pool->done_cond);
+	}
+	ms_mutex_unlock(&pool->lock);
+}
+
+static void *pool_thread(void *arg){
+	MSTickerPool *pool=(MSTickerPool*)arg;
+	int precision=set_high_prio(pool->ticker);
+	int thread;
+
+	set_current_ticker(pool->ticker);
+	ms_mutex_lock(&pool->lock);
+	thread=++pool->started;
+	while(pool->run){
+		if (pool->next<pool->nfilters && !pool->stop)
+			pool_run_one(pool,thread);
+		else ms_cond_wait(&pool->cond,&pool->lock);
+	}
+	ms_mutex_unlock(&pool->lock);
+	set_current_ticker(NULL);
+	unset_high_prio(precision);
+	ms_thread_exit(NULL);
+	return NULL;
+}
+
+static void pool_run(MSTickerPool *pool, MSFilter **filters, MSFilterProfileEntry **entries, int nfilters){
+	ms_mutex_lock(&pool->lock);
+	pool->filters=filters;
+	pool->entries=entries;
+	pool->nfilters=nfilters;
+	pool->next=0;
+	pool->stop=FALSE;
+	ms_cond_broadcast(&pool->cond);
+	/*the ticker thread takes its share*/
+	while(pool->next<pool->nfilters && !pool->stop)
+		pool_run_one(pool,0);
+	while(pool->running>0)
+		ms_cond_wait(&pool->done_cond,&pool->lock);
+	pool->filters=NULL;
+	pool->entries=NULL;
+	pool->nfilters=0;
+	pool->next=0;
+	ms_mutex_unlock(&pool->lock);
+}
+
+static MSTickerPool *pool_new(MSTicker *ticker, int nthreads){
+	MSTickerPool *pool=(MSTickerPool*)ms_new0(MSTickerPool,1);
+	int i;
+	pool->ticker=ticker;
+	ms_mutex_init(&pool->lock,NULL);
+	ms_cond_init(&pool->cond,NULL);
+	ms_cond_init(&pool->done_cond,NULL);
+	pool->run=TRUE;
+	pool->threads=(ms_thread_t*)ms_new0(ms_thread_t,nthreads);
+	for(i=0;i<nthreads;i++){
+		if (ms_thread_create(&pool->threads[i],NULL,pool_thread,pool)!=0){
+			ms_error("%s: could not create worker thread.",ticker->name);
+			break;
+		}
+	}
+	pool->nthreads=i;
+	return pool;
+}
+
+static void pool_destroy(MSTickerPool *pool){
+	int i;
+	ms_mutex_lock(&pool->lock);
+	pool->run=FALSE;
+	ms_cond_broadcast(&pool->cond);
+	ms_mutex_unlock(&pool->lock);
+	for(i=0;i<pool->nthreads;i++)
+		ms_thread_join(pool->threads[i],NULL);
+	ms_free(pool->threads);
+	ms_cond_destroy(&pool->cond);
+	ms_cond_destroy(&pool->done_cond);
+	ms_mutex_destroy(&pool->lock);
+	ms_free(pool);
+}
+
+static void destroy_pool(MSTicker *ticker){
+	if (ticker->pool){
+		pool_destroy(ticker->pool);
+		ticker->pool=NULL;
+	}
+}
+
+static MSFilterProfileEntry *profile_entry_new(MSFilter *f){
+	MSFilterProfileEntry *e=(MSFilterProfileEntry*)ms_new0(MSFilterProfileEntry,1);
+	e->profile.filter=f;
+	if (f->desc->ninputs>0)
+		e->inputs=(MSQueueProfile*)ms_new0(MSQueueProfile,f->desc->ninputs);
+	return e;
+}
+
+static void profile_entry_destroy(MSFilterProfileEntry *e){
+	if (e->inputs) ms_free(e->inputs);
+	ms_free(e);
+}
+
+static void profile_entry_reset(MSFilterProfileEntry *e){
+	memset(&e->profile.process_time,0,sizeof(e->profile.process_time));
+	e->profile.late_ticks=0;
+	if (e->inputs) memset(e->inputs,0,e->profile.filter->desc->ninputs*sizeof(MSQueueProfile));
+	e->last=0;
+}
+
+static int compare_entry_filter(const MSFilterProfileEntry *e, const MSFilter *f){
+	return e->profile.filter==f ? 0 : -1;
+}
+
+static MSFilterProfileEntry *find_entry(MSTickerProfiler *p, MSFilter *f){
+	MSList *elem=ms_list_find_custom(p->entries,(MSCompareFunc)compare_entry_filter,f);
+	return elem ? (MSFilterProfileEntry*)elem->data : NULL;
+}
+
+/*match the entries with the filters of the plan: the measurements of filters
+that stay attached are kept, those of detached filters are dropped*/
+static void update_profiler(MSTicker *ticker){
+	MSTickerProfiler *p=ticker->profiler;
+	MSTickerPlan *plan=ticker->plan;
+	MSList *entries=NULL;
+	int i;
+
+	if (p->plan_entries){
+		ms_free(p->plan_entries);
+		p->plan_entries=NULL;
+	}
+	if (plan!=NULL){
+		p->plan_entries=(MSFilterProfileEntry**)ms_new(MSFilterProfileEntry*,plan->nfilters);
+		for(i=0;i<plan->nfilters;i++){
+			MSFilterProfileEntry *e=find_entry(p,plan->filters[i]);
+			if (e!=NULL) p->entries=ms_list_remove(p->entries,e);
+			else e=profile_entry_new(plan->filters[i]);
+			entries=ms_list_append(entries,e);
+			p->plan_entries[i]=e;
+		}
+	}
+	ms_list_for_each(p->entries,(void (*)(void*))profile_entry_destroy);
+	ms_list_free(p->entries);
+	p->entries=entries;
+}
+
+static void write_trace_event(MSTickerProfiler *p, const char *fmt, ...){
+	va_list args;
+	fputs(p->trace_first ? "\n" : ",\n",p->trace);
+	p->trace_first=FALSE;
+	va_start(args,fmt);
+	vfprintf(p->trace,fmt,args);
+	va_end(args);
+}
+
+static void trace_filter(MSTickerProfiler *p, MSFilterProfileEntry *e, uint32_t tick){
+	write_trace_event(p,"{\"name\":\"%s\",\"cat\":\"filter\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,"
+		"\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"filter\":\"%p\",\"tick\":%u}}",
+		e->profile.filter->desc->name,e->thread,(e->start-p->origin)/1000.0,e->last/1000.0,
+		e->profile.filter,tick);
+}
+
+/*called by the ticker thread at the end of each tick, with the ticker lock held*/
+static void end_tick_profiling(MSTicker *s, uint64_t start){
+	MSTickerProfiler *p=s->profiler;
+	MSTickerPlan *plan=s->plan;
+	MSFilterProfileEntry *slowest=NULL;
+	uint64_t end=get_cur_time_ns();
+	int late,i;
+
+	p->profile.ticks++;
+	ms_time_histogram_add(&p->profile.tick_time,end-start);
+	if (plan!=NULL){
+		for(i=0;i<plan->nfilters;i++){
+			MSFilterProfileEntry *e=p->plan_entries[i];
+			if (e->last==0) continue;
+			if (slowest==NULL || e->last>slowest->last) slowest=e;
+			if (p->trace) trace_filter(p,e,s->ticks);
+		}
+	}
+	if (p->trace){
+		write_trace_event(p,"{\"name\":\"tick\",\"cat\":\"ticker\",\"ph\":\"X\",\"pid\":1,\"tid\":0,"
+			"\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"tick\":%u}}",
+			(start-p->origin)/1000.0,(end-start)/1000.0,s->ticks);
+	}
+	/*the tick is late if it ends after the time of the next one*/
+	late=(int)((int64_t)(s->get_cur_time_ptr(s->get_cur_time_data)-s->orig)-(int64_t)(s->time+s->interval));
+	if (late>0){
+		p->profile.late_ticks++;
+		if (late>p->profile.max_late) p->profile.max_late=late;
+		if (slowest!=NULL) slowest->profile.late_ticks++;
+		if (p->trace){
+			write_trace_event(p,"{\"name\":\"late\",\"cat\":\"ticker\",\"ph\":\"i\",\"s\":\"p\",\"pid\":1,\"tid\":0,"
+				"\"ts\":%.3f,\"args\":{\"late_ms\":%i,\"slowest\":\"%s\"}}",
+				(end-p->origin)/1000.0,late,slowest ? slowest->profile.filter->desc->name : "");
+		}
+	}
+}
+
+static void stop_trace(MSTickerProfiler *p){
+	if (p->trace){
+		fputs("\n]\n",p->trace);
+		fclose(p->trace);
+		p->trace=NULL;
+	}
+}
+
+static void destroy_profiler(MSTicker *ticker){
+	MSTickerProfiler *p=ticker->profiler;
+	if (p==NULL) return;
+	stop_trace(p);
+	ms_list_for_each(p->entries,(void (*)(void*))profile_entry_destroy);
+	ms_list_free(p->entries);
+	if (p->plan_entries) ms_free(p->plan_entries);
+	ms_free(p);
+	ticker->profiler=NULL;
+}
+
+/*must be called with the ticker lock held*/
+static void update_plan(MSTicker *ticker){
+	if (ticker->plan){
+		plan_destroy(ticker->plan);
+		ticker->plan=NULL;
+	}
+	ticker->plan=plan_new(ticker->execution_list);
+	ticker->plan_dirty=FALSE;
+	if (ticker->profiler)
+		update_profiler(ticker);
+}
+
+/*a filter of the graph may replace another one while the graph runs (the decoder
+of a stream when the payload type changes for example): the plan may then refer to
+filters that are destroyed and miss the new ones. The current pass stops at once and
+the plan is computed again before the next one. When the worker threads run a level,
+the change waits for the other filters being run. Other threads change the graph
+between two ticks, with the ticker locked.*/
+void ms_ticker_begin_graph_change(MSTicker *ticker){
+	if (!ms_ticker_is_current_thread(ticker)){
+		ms_mutex_lock(&ticker->lock);
+		ticker->plan_dirty=TRUE;
+	}else if (ticker->pool==NULL || !pool_begin_change(ticker->pool))
+		ticker->plan_dirty=TRUE;
+}
+
+void ms_ticker_end_graph_change(MSTicker *ticker){
+	if (!ms_ticker_is_current_thread(ticker))
+		ms_mutex_unlock(&ticker->lock);
+	else if (ticker->pool!=NULL)
+		pool_end_change(ticker->pool);
+}
+
+bool_t ms_ticker_defer_destroy(MSFilter *f){
+	MSTicker *ticker=get_current_ticker();
+	if (ticker==NULL || !ticker->in_pass) return FALSE;
+	if (ticker->pool){
+		ms_mutex_lock(&ticker->pool->lock);
+		ticker->destroyed=ms_list_append(ticker->destroyed,f);
+		ms_mutex_unlock(&ticker->pool->lock);
+	}else ticker->destroyed=ms_list_append(ticker->destroyed,f);
+	return TRUE;
+}
+
+/*called by the ticker thread at the end of the tick, with the ticker lock held*/
+static void destroy_deferred(MSTicker *ticker){
+	MSList *destroyed=ticker->destroyed;
+	ticker->destroyed=NULL;
+	ms_list_for_each(destroyed,(void (*)(void*))ms_filter_destroy);
+	ms_list_free(destroyed);
+}
+
+static void run_plan(MSTicker *s, MSTickerPlan *plan){
+	MSFilterProfileEntry **entries=s->profiler ? s->profiler->plan_entries : NULL;
+	int l,i,begin=0;
+	if (s->pool==NULL){
+		for(i=0;i<plan->nfilters && !s->plan_dirty;i++)
+			run_filter(s,plan->filters[i],entries ? entries[i] : NULL,0);
+		return;
+	}
+	for(l=0;l<plan->nlevels && !s->plan_dirty;l++){
+		int end=plan->level_end[l];
+		if (end-begin>1){
+			pool_run(s->pool,plan->filters+begin,entries ? entries+begin : NULL,end-begin);
+		}else{
+			for(i=begin;i<end && !s->plan_dirty;i++)
+				run_filter(s,plan->filters[i],entries ? entries[i] : NULL,0);
+		}
+		begin=end;
+	}
+}
+
+void ms_ticker_set_thread_count(MSTicker *ticker, int nthreads){
+	if (nthreads<1) nthreads=1;
+	ms_mutex_lock(&ticker->lock);
+	if (nthreads!=ticker->nthreads){
+		destroy_pool(ticker);
+		ticker->nthreads=nthreads;
+		if (nthreads>1)
+			ticker->pool=pool_new(ticker,nthreads-1);
+		update_plan(ticker);
+		ms_message("%s: running filters with %i thread(s).",ticker->name,nthreads);
+	}
+	ms_mutex_unlock(&ticker->lock);
+}
+
 /*the ticker thread function that executes the filters */
 void * ms_ticker_run(void *arg)
 {
@@ -351,6 +931,7 @@ void * ms_ticker_run(void *arg)
 	int late;
 	
 	precision = set_high_prio(s);
+	set_current_ticker(s);
 
 
 	s->ticks=1;
@@ -360,13 +941,28 @@ void * ms_ticker_run(void *arg)
 	while(s->run){
 		s->ticks++;
 		{
+			uint64_t profile_start=0;
 #if TICKER_MEASUREMENTS
 			MSTimeSpec begin,end;/*used to measure time spent in processing one tick*/
 			double iload;
 
 			ms_get_cur_time(&begin);
 #endif
-			run_graphs(s,s->execution_list,FALSE);
+			if (s->profiler)
+				profile_start=get_cur_time_ns();
+			if (s->plan_dirty)
+				update_plan(s);
+			s->in_pass=TRUE;
+			if (s->plan)
+				run_plan(s,s->plan);
+			s->in_pass=FALSE;
+			/*the graph changed during the pass*/
+			if (s->plan_dirty)
+				update_plan(s);
+			if (s->profiler)
+				end_tick_profiling(s,profile_start);
+			if (s->destroyed)
+				destroy_deferred(s);
 #if TICKER_MEASUREMENTS
 			ms_get_cur_time(&end);
 			iload=100*((end.tv_sec-begin.tv_sec)*1000.0 + (end.tv_nsec-begin.tv_nsec)/1000000.0)/(double)s->interval;
@@ -395,6 +991,7 @@ void * ms_ticker_run(void *arg)
 		ms_mutex_lock(&s->lock);
 	}
 	ms_mutex_unlock(&s->lock);
+	set_current_ticker(NULL);
 	unset_high_prio(precision);
 	ms_message("%s thread exiting",s->name);
 
@@ -414,46 +1011,161 @@ void ms_ticker_set_time_func(MSTicker *ticker, MSTickerTimeFunc func, void *user
 	ms_message("ms_ticker_set_time_func: ticker updated.");
 }
 
-static void print_graph(MSFilter *f, MSTicker *s, MSList **unschedulable, bool_t force_schedule){
-	int i;
-	MSQueue *l;
-	if (f->last_tick!=s->ticks ){
-		if (filter_can_process(f,s->ticks) || force_schedule) {
-			/* this is a candidate */
-			f->last_tick=s->ticks;
-			ms_message("print_graphs: %s", f->desc->name);
-			/* now recurse to next filters */		
-			for(i=0;i<f->desc->noutputs;i++){
-				l=f->outputs[i];
-				if (l!=NULL){
-					print_graph(l->next.filter,s,unschedulable, force_schedule);
-				}
-			}
-		}else{
-			/* this filter has not all inputs that have been filled by filters before it. */
-			*unschedulable=ms_list_prepend(*unschedulable,f);
+void ms_ticker_print_graphs(MSTicker *ticker){
+	MSTickerPlan *plan;
+	int l,i,begin=0;
+	ms_mutex_lock(&ticker->lock);
+	plan=ticker->plan;
+	if (plan!=NULL){
+		for(l=0;l<plan->nlevels;l++){
+			for(i=begin;i<plan->level_end[l];i++)
+				ms_message("print_graphs: level %i: %s",l,plan->filters[i]->desc->name);
+			begin=plan->level_end[l];
 		}
 	}
+	ms_mutex_unlock(&ticker->lock);
 }
 
-static void print_graphs(MSTicker *s, MSList *execution_list, bool_t force_schedule){
-	MSList *it;
-	MSList *unschedulable=NULL;
-	for(it=execution_list;it!=NULL;it=it->next){
-		print_graph((MSFilter*)it->data,s,&unschedulable,force_schedule);
+void ms_ticker_enable_profiling(MSTicker *ticker, bool_t enabled){
+	ms_mutex_lock(&ticker->lock);
+	if (enabled && ticker->profiler==NULL){
+		ticker->profiler=(MSTickerProfiler*)ms_new0(MSTickerProfiler,1);
+		update_profiler(ticker);
+	}else if (!enabled){
+		destroy_profiler(ticker);
 	}
-	/* filters that are part of a loop haven't been called in process() because one of their input refers to a filter that could not be scheduled (because they could not be scheduled themselves)... Do you understand ?*/
-	/* we resolve this by simply assuming that they must be called anyway 
-	for the loop to run correctly*/
-	/* we just recall run_graphs on them, as if they were source filters */
-	if (unschedulable!=NULL) {
-		print_graphs(s,unschedulable,TRUE);
-		ms_list_free(unschedulable);
+	ms_mutex_unlock(&ticker->lock);
+}
+
+void ms_ticker_reset_profiling(MSTicker *ticker){
+	ms_mutex_lock(&ticker->lock);
+	if (ticker->profiler){
+		MSTickerProfiler *p=ticker->profiler;
+		memset(&p->profile,0,sizeof(p->profile));
+		ms_list_for_each(p->entries,(void (*)(void*))profile_entry_reset);
 	}
+	ms_mutex_unlock(&ticker->lock);
 }
 
-void ms_ticker_print_graphs(MSTicker *ticker){
-	print_graphs(ticker,ticker->execution_list,FALSE);
+int ms_ticker_get_profile(MSTicker *ticker, MSTickerProfile *profile){
+	int err=-1;
+	ms_mutex_lock(&ticker->lock);
+	if (ticker->profiler){
+		*profile=ticker->profiler->profile;
+		err=0;
+	}
+	ms_mutex_unlock(&ticker->lock);
+	return err;
+}
+
+int ms_ticker_get_filter_profile(MSTicker *ticker, MSFilter *f, MSFilterProfile *profile){
+	MSFilterProfileEntry *e;
+	int err=-1;
+	ms_mutex_lock(&ticker->lock);
+	if (ticker->profiler && (e=find_entry(ticker->profiler,f))!=NULL){
+		*profile=e->profile;
+		err=0;
+	}
+	ms_mutex_unlock(&ticker->lock);
+	return err;
+}
+
+MSList *ms_ticker_get_filter_profiles(MSTicker *ticker){
+	MSList *ret=NULL;
+	MSList *elem;
+	ms_mutex_lock(&ticker->lock);
+	if (ticker->profiler){
+		for(elem=ticker->profiler->entries;elem!=NULL;elem=elem->next){
+			MSFilterProfile *profile=ms_new(MSFilterProfile,1);
+			*profile=((MSFilterProfileEntry*)elem->data)->profile;
+			ret=ms_list_append(ret,profile);
+		}
+	}
+	ms_mutex_unlock(&ticker->lock);
+	return ret;
+}
+
+int ms_ticker_get_queue_profile(MSTicker *ticker, MSFilter *f, int pin, MSQueueProfile *profile){
+	MSFilterProfileEntry *e;
+	int err=-1;
+	if (pin<0 || pin>=f->desc->ninputs || f->inputs[pin]==NULL) return -1;
+	ms_mutex_lock(&ticker->lock);
+	if (ticker->profiler && (e=find_entry(ticker->profiler,f))!=NULL){
+		*profile=e->inputs[pin];
+		err=0;
+	}
+	ms_mutex_unlock(&ticker->lock);
+	return err;
+}
+
+static int compare_process_time(const MSFilterProfileEntry *e1, const MSFilterProfileEntry *e2){
+	if (e1->profile.process_time.total<e2->profile.process_time.total) return 1;
+	return -1;
+}
+
+void ms_ticker_log_profile(MSTicker *ticker){
+	MSTickerProfiler *p;
+	MSList *sorted=NULL;
+	MSList *elem;
+	int i;
+
+	ms_mutex_lock(&ticker->lock);
+	p=ticker->profiler;
+	if (p==NULL){
+		ms_mutex_unlock(&ticker->lock);
+		ms_warning("%s: profiling is not enabled.",ticker->name);
+		return;
+	}
+	ms_message("%s profile: %u ticks, %u late (max %i ms), tick time p50 %g ms, p99 %g ms, max %g ms",
+		ticker->name,p->profile.ticks,p->profile.late_ticks,p->profile.max_late,
+		ms_time_histogram_get_percentile(&p->profile.tick_time,50)*1e-6,
+		ms_time_histogram_get_percentile(&p->profile.tick_time,99)*1e-6,
+		p->profile.tick_time.max*1e-6);
+	for(elem=p->entries;elem!=NULL;elem=elem->next)
+		sorted=ms_list_insert_sorted(sorted,elem->data,(MSCompareFunc)compare_process_time);
+	ms_message("filter [instance] calls p50(ms) p99(ms) max(ms) late-ticks max-queue-depth");
+	for(elem=sorted;elem!=NULL;elem=elem->next){
+		MSFilterProfileEntry *e=(MSFilterProfileEntry*)elem->data;
+		const MSTimeHistogram *h=&e->profile.process_time;
+		int depth=0;
+		for(i=0;i<e->profile.filter->desc->ninputs;i++)
+			depth=MAX(depth,e->inputs[i].max_depth);
+		ms_message("%s [%p] %llu %g %g %g %u %i",e->profile.filter->desc->name,e->profile.filter,
+			(unsigned long long)h->count,ms_time_histogram_get_percentile(h,50)*1e-6,
+			ms_time_histogram_get_percentile(h,99)*1e-6,h->max*1e-6,e->profile.late_ticks,depth);
+	}
+	ms_mutex_unlock(&ticker->lock);
+	ms_list_free(sorted);
+}
+
+int ms_ticker_start_trace(MSTicker *ticker, const char *filename){
+	FILE *f;
+	MSTickerProfiler *p;
+	ms_ticker_enable_profiling(ticker,TRUE);
+	ms_mutex_lock(&ticker->lock);
+	p=ticker->profiler;
+	stop_trace(p);
+	f=fopen(filename,"w");
+	if (f==NULL){
+		ms_mutex_unlock(&ticker->lock);
+		ms_error("%s: cannot open trace file %s",ticker->name,filename);
+		return -1;
+	}
+	p->trace=f;
+	p->origin=get_cur_time_ns();
+	fputs("[",f);
+	p->trace_first=TRUE;
+	write_trace_event(p,"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"%s\"}}",ticker->name);
+	ms_mutex_unlock(&ticker->lock);
+	ms_message("%s: tracing filters execution into %s",ticker->name,filename);
+	return 0;
+}
+
+void ms_ticker_stop_trace(MSTicker *ticker){
+	ms_mutex_lock(&ticker->lock);
+	if (ticker->profiler)
+		stop_trace(ticker->profiler);
+	ms_mutex_unlock(&ticker->lock);
 }
 
 float ms_ticker_get_average_load(MSTicker *ticker){
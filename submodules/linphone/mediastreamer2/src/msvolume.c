@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/msvolume.h"
 #include "mediastreamer2/msticker.h"
+#include "mediastreamer2/dsptools.h"
 #include <math.h>
 
 #ifdef HAVE_SPEEXDSP
@@ -365,19 +366,11 @@ static inline int16_t saturate(int val) {
 // note: number of samples should not vary much
 // with filtered peak detection, variable buffer size from volume_process call is not optimal
 static void update_energy(int16_t *signal, int numsamples, Volume *v) {
-	int i;
-	float acc = 0;
+	float acc;
 	float en;
-	int lp = 0, pk = 0;
-		
-	for (i=0;i<numsamples;++i){
-		int s=signal[i];
-		acc += s * s;
-
-		lp = abs(s);
-		if (lp > pk)
-			pk = lp;
-	}
+	int pk = 0;
+
+	acc = (float)ms_audio_energy(signal, numsamples, &pk);
 	en = (sqrt(acc / numsamples)+1) / max_e;
 	v->energy = (en * coef) + v->energy * (1.0 - coef);
 	v->level_pk = (float)pk / max_e;
@@ -421,11 +414,7 @@ static void apply_gain(Volume *v, mblk_t *m, float tgain) {
 		/* offset smoothing */
 		v->dc_offset = (v->dc_offset*7 + dc_offset*2/(m->b_wptr - m->b_rptr)) / 8;
 	}else if (gain!=1){
-		for (	sample=(int16_t*)m->b_rptr;
-					sample<(int16_t*)m->b_wptr;
-					++sample){
-			*sample = saturate(((*sample) * intgain) / 4096);
-		}
+		ms_audio_apply_gain((int16_t*)m->b_rptr, (m->b_wptr - m->b_rptr) / 2, gain);
 	}
 }
 
@@ -73,36 +73,49 @@ static void put_nal_size(mblk_t *m, uint16_t sz){
 	m->b_wptr+=2;
 }
 
-static mblk_t * prepend_stapa(mblk_t *m){
-	mblk_t *hm=allocb(3,0);
+/*copies the data of m at the end of the block d*/
+static void append_data(mblk_t *d, mblk_t *m){
+	for(;m!=NULL;m=m->b_cont){
+		int len=m->b_wptr-m->b_rptr;
+		memcpy(d->b_wptr,m->b_rptr,len);
+		d->b_wptr+=len;
+	}
+}
+
+/*the rtp payloads are built in a single block allocated with rtp_payload_allocb(), so that the rtp
+sender can prepend the rtp header in place and srtp can process the packet without msgpullup()*/
+static mblk_t * prepend_stapa(mblk_t *m, int maxsize){
+	mblk_t *hm=rtp_payload_allocb(maxsize);
 	nal_header_init(hm->b_wptr,nal_header_get_nri(m->b_rptr),TYPE_STAP_A);
 	hm->b_wptr+=1;
 	put_nal_size(hm,msgdsize(m));
-	hm->b_cont=m;
+	append_data(hm,m);
+	freemsg(m);
 	return hm;
 }
 
-static mblk_t * concat_nalus(mblk_t *m1, mblk_t *m2){
-	mblk_t *l=allocb(2,0);
+/*m1 has room for maxsize bytes once it is a STAP-A*/
+static mblk_t * concat_nalus(mblk_t *m1, mblk_t *m2, int maxsize){
 	/*eventually append a stap-A header to m1, if not already done*/
 	if (nal_header_get_type(m1->b_rptr)!=TYPE_STAP_A){
-		m1=prepend_stapa(m1);
+		m1=prepend_stapa(m1,maxsize);
 	}
-	put_nal_size(l,msgdsize(m2));
-	l->b_cont=m2;
-	concatb(m1,l);
+	put_nal_size(m1,msgdsize(m2));
+	append_data(m1,m2);
+	freemsg(m2);
 	return m1;
 }
 
-static mblk_t *prepend_fu_indicator_and_header(mblk_t *m, uint8_t indicator,
+/*makes a FU-A packet with the FU indicator and header and the size bytes of the nalu at data*/
+static mblk_t *make_fu_a(const uint8_t *data, int size, uint8_t indicator,
 	bool_t start, bool_t end, uint8_t type){
-	mblk_t *h=allocb(2,0);
-	h->b_wptr[0]=indicator;
-	h->b_wptr[1]=((start&0x1)<<7)|((end&0x1)<<6)|type;
-	h->b_wptr+=2;
-	h->b_cont=m;
-	if (start) m->b_rptr++;/*skip original nalu header */
-	return h;
+	mblk_t *m=rtp_payload_allocb(size+2);
+	m->b_wptr[0]=indicator;
+	m->b_wptr[1]=((start&0x1)<<7)|((end&0x1)<<6)|type;
+	m->b_wptr+=2;
+	memcpy(m->b_wptr,data,size);
+	m->b_wptr+=size;
+	return m;
 }
 
 static void frag_nalu_and_send(MSQueue *rtpq, uint32_t ts, mblk_t *nalu, bool_t marker, int maxsize){
@@ -113,17 +126,18 @@ static void frag_nalu_and_send(MSQueue *rtpq, uint32_t ts, mblk_t *nalu, bool_t
 	uint8_t nri=nal_header_get_nri(nalu->b_rptr);
 	bool_t start=TRUE;
 
+	if (nalu->b_cont!=NULL) msgpullup(nalu,-1);
 	nal_header_init(&fu_indicator,nri,TYPE_FU_A);
+	nalu->b_rptr++;/*skip original nalu header */
 	while(nalu->b_wptr-nalu->b_rptr>payload_max_size){
-		m=dupb(nalu);
+		m=make_fu_a(nalu->b_rptr,payload_max_size,fu_indicator,start,FALSE,type);
 		nalu->b_rptr+=payload_max_size;
-		m->b_wptr=nalu->b_rptr;
-		m=prepend_fu_indicator_and_header(m,fu_indicator,start,FALSE,type);
 		send_packet(rtpq,ts,m,FALSE);
 		start=FALSE;
 	}
 	/*send last packet */
-	m=prepend_fu_indicator_and_header(nalu,fu_indicator,FALSE,TRUE,type);
+	m=make_fu_a(nalu->b_rptr,nalu->b_wptr-nalu->b_rptr,fu_indicator,FALSE,TRUE,type);
+	freemsg(nalu);
 	send_packet(rtpq,ts,m,marker);
 }
 
@@ -152,13 +166,13 @@ static void rfc3984_pack_mode_1(Rfc3984Context *ctx, MSQueue *naluq, MSQueue *rt
 		if (ctx->stap_a_allowed){
 			if (prevm!=NULL){
 				if ((prevsz+sz)<(ctx->maxsz-2)){
-					prevm=concat_nalus(prevm,m);
+					prevm=concat_nalus(prevm,m,ctx->maxsz);
 					m=NULL;
 					prevsz+=sz+2;/*+2 for the stapa size field*/
 					continue;
 				}else{
 					/*send prevm packet: either single nal or STAP-A*/
-					if (prevm->b_cont!=NULL){
+					if (nal_header_get_type(prevm->b_rptr)==TYPE_STAP_A){
 						ms_debug("Sending STAP-A");
 					}else
 						ms_debug("Sending previous msg as single NAL");
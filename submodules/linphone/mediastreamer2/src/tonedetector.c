@@ -24,57 +24,18 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "mediastreamer2/mstonedetector.h"
 #include "mediastreamer2/msticker.h"
+#include "mediastreamer2/dsptools.h"
 
 #include <math.h>
 #ifdef _MSC_VER
 #include <malloc.h>
 #endif
 
-#ifndef M_PI
-#define M_PI       3.14159265358979323846
-#endif
-
 static const float energy_min=500;
 
-typedef struct _GoertzelState{
-	float coef;
-}GoertzelState;
-
-static void goertzel_state_init(GoertzelState *gs, int frequency, int sampling_frequency){
-	gs->coef=(float)2*(float)cos(2*M_PI*((float)frequency/(float)sampling_frequency));
-}
-
-static float goertzel_state_run(GoertzelState *gs,int16_t  *samples, int nsamples, float total_energy){
-	int i;
-	float tmp;
-	float q1=0;
-	float q2=0;
-	float freq_en;
-
-	for(i=0;i<nsamples;++i){
-		tmp=q1;
-		q1=(gs->coef*q1) - q2 + (float)samples[i];
-		q2=tmp;
-	}
-	
-	freq_en= (q1*q1) + (q2*q2) - (q1*q2*gs->coef);
-	/*return a relative frequency energy compared over the total signal energy */
-	return freq_en/(total_energy*(float)nsamples*0.5);
-}
-
-static float compute_energy(int16_t *samples, int nsamples){
-	float en=0;
-	int i;
-	for(i=0;i<nsamples;++i){
-		float s=(float)samples[i];
-		en+=s*s;
-	}
-	return en;
-}
-
 typedef struct _DetectorState{
 	MSToneDetectorDef tone_def;
-	GoertzelState tone_gs;
+	MSGoertzel tone_gs;
 	uint64_t starttime;
 	MSBufferizer *buf;
 	int dur;
@@ -95,6 +56,7 @@ static void detector_init(MSFilter *f){
 
 static void detector_uninit(MSFilter *f){
 	DetectorState *s=(DetectorState *)f->data;
+	ms_goertzel_uninit(&s->tone_gs);
 	ms_bufferizer_destroy (s->buf);
 	ms_free(f->data);
 }
@@ -102,14 +64,27 @@ static void detector_uninit(MSFilter *f){
 static int detector_add_scan(MSFilter *f, void *arg){
 	DetectorState *s=(DetectorState *)f->data;
 	MSToneDetectorDef *def=(MSToneDetectorDef*)arg;
+	MSGoertzel gs,old;
+	/*the tables are built aside, the filter may be running*/
+	ms_goertzel_init(&gs,(float)def->frequency,s->rate,s->framesize/2);
+	ms_filter_lock(f);
+	old=s->tone_gs;
+	s->tone_gs=gs;
 	s->tone_def=*def;
-	goertzel_state_init(&s->tone_gs,def->frequency,s->rate);
+	ms_filter_unlock(f);
+	ms_goertzel_uninit(&old);
 	return 0;
 }
 
 static int detector_clear_scans(MSFilter *f, void *arg){
 	DetectorState *s=(DetectorState *)f->data;
+	MSGoertzel old;
+	ms_filter_lock(f);
 	memset(&s->tone_def,0,sizeof(s->tone_def));
+	old=s->tone_gs;
+	memset(&s->tone_gs,0,sizeof(s->tone_gs));
+	ms_filter_unlock(f);
+	ms_goertzel_uninit(&old);
 	return 0;
 }
 
@@ -128,6 +103,7 @@ static void detector_process(MSFilter *f){
 	DetectorState *s=(DetectorState *)f->data;
 	mblk_t *m;
 	
+	ms_filter_lock(f);
 	while ((m=ms_queue_get(f->inputs[0]))!=NULL){
 		ms_queue_put(f->outputs[0],m);
 		if (s->tone_def.frequency!=0){
@@ -137,10 +113,12 @@ static void detector_process(MSFilter *f){
 	if (s->tone_def.frequency!=0){
 		uint8_t *buf=alloca(s->framesize);
 
-		while(ms_bufferizer_read(s->buf,buf,s->framesize)!=0){
-			float en=compute_energy((int16_t*)buf,s->framesize/2);
+		while(s->tone_def.frequency!=0 && ms_bufferizer_read(s->buf,buf,s->framesize)!=0){
+			int nsamples=s->framesize/2;
+			float en=(float)ms_audio_energy((int16_t*)buf,nsamples,NULL);
 			if (en>energy_min){
-				float freq_en=goertzel_state_run(&s->tone_gs,(int16_t*)buf,s->framesize/2,en);
+				/*relative frequency energy compared over the total signal energy */
+				float freq_en=ms_goertzel_run(&s->tone_gs,(int16_t*)buf)/(en*(float)nsamples*0.5f);
 				if (freq_en>=s->tone_def.min_amplitude){
 					if (s->dur==0) s->starttime=f->ticker->time;
 					s->dur+=s->frame_ms;
@@ -149,13 +127,17 @@ static void detector_process(MSFilter *f){
 					
 						strncpy(event.tone_name,s->tone_def.tone_name,sizeof(event.tone_name));
 						event.tone_start_time=s->starttime;
-						ms_filter_notify(f,MS_TONE_DETECTOR_EVENT,&event);
 						s->event_sent=TRUE;
+						/*the listener may add or clear scans*/
+						ms_filter_unlock(f);
+						ms_filter_notify(f,MS_TONE_DETECTOR_EVENT,&event);
+						ms_filter_lock(f);
 					}
 				}else end_tone(s);
 			}else end_tone(s);
 		}
 	}
+	ms_filter_unlock(f);
 }
 
 static MSFilterMethod detector_methods[]={
@@ -74,7 +74,7 @@ static void ulaw_enc_process(MSFilter *obj){
 	}
 
 	while (ms_bufferizer_read(bz,buffer,size_of_pcm)==size_of_pcm){
-		mblk_t *o=allocb(size_of_pcm/2,0);
+		mblk_t *o=rtp_payload_allocb(size_of_pcm/2);
 		int i;
 		for (i=0;i<size_of_pcm/2;i++){
 			*o->b_wptr=s16_to_ulaw(((int16_t*)buffer)[i]);
@@ -35,6 +35,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 extern RtpSession * create_duplex_rtpsession( int locport, bool_t ipv6);
 
 #define MAX_RTP_SIZE	UDP_MAX_SIZE
+/*a video frame is sent as a burst of packets: read and write them by groups*/
+#define VIDEO_RTP_IO_BATCH	8
 
 /* this code is not part of the library itself, it is part of the mediastream program */
 void video_stream_free (VideoStream * stream)
@@ -199,6 +201,7 @@ static void choose_display_name(VideoStream *stream){
 VideoStream *video_stream_new(int locport, bool_t use_ipv6){
 	VideoStream *stream = (VideoStream *)ms_new0 (VideoStream, 1);
 	stream->session=create_duplex_rtpsession(locport,use_ipv6);
+	rtp_session_set_io_batch_size(stream->session,VIDEO_RTP_IO_BATCH);
 	stream->evq=ortp_ev_queue_new();
 	stream->rtpsend=ms_filter_new(MS_RTP_SEND_ID);
 	rtp_session_register_event_queue(stream->session,stream->evq);
@@ -743,6 +746,8 @@ void video_stream_enable_zrtp(VideoStream *vstream, AudioStream *astream, OrtpZr
 bool_t video_stream_enable_strp(VideoStream* stream, enum ortp_srtp_crypto_suite_t suite, const char* snd_key, const char* rcv_key) {
 	// assign new srtp transport to stream->session
 	// with 2 Master Keys
+	// the session reads and writes by batches (see video_stream_new()), so the
+	// packets of a frame are protected and unprotected in groups by the transport
 	RtpTransport *rtp_tpt, *rtcp_tpt;	
 	
 	if (!ortp_srtp_supported()) {
@@ -27,8 +27,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "mediastreamer2/msrtp.h"
 #include "mediastreamer2/msfileplayer.h"
 #include "mediastreamer2/msfilerec.h"
+#include "mediastreamer2/dsptools.h"
 
 #include <signal.h>
+#include <math.h>
 
 #define MAX_RTP_SIZE	1500
 
@@ -332,6 +334,105 @@ static int uninit_bench(struct bench_config *bench)
 	return 0;
 }
 
+#define KERNELS_NSAMPLES 317 /* not a multiple of the vector sizes, to exercise the remaining samples*/
+#define KERNELS_LOOPS 100000
+/* the sums are reset before 2^16 samples of at most 2^15 are accumulated, so that they
+never overflow*/
+#define KERNELS_SUM_RESET 0xFFFF
+
+static uint64_t bench_time_us(void){
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return (uint64_t)tv.tv_sec*1000000LL+(uint64_t)tv.tv_usec;
+}
+
+struct kernels_results{
+	int32_t sum[KERNELS_NSAMPLES];
+	int16_t mix[KERNELS_NSAMPLES];
+	int16_t gain[KERNELS_NSAMPLES];
+	uint64_t energy;
+	int peak;
+	float goertzel;
+};
+
+static void run_kernels(const int16_t *samples, const int16_t *other, MSGoertzel *g, struct kernels_results *r){
+	memset(r->sum,0,sizeof(r->sum));
+	ms_audio_accumulate(r->sum,samples,KERNELS_NSAMPLES);
+	ms_audio_accumulate(r->sum,other,KERNELS_NSAMPLES);
+	ms_audio_accumulate(r->sum,other,KERNELS_NSAMPLES);
+	ms_audio_saturate(r->mix,r->sum,samples,KERNELS_NSAMPLES,32000);
+	memcpy(r->gain,samples,sizeof(r->gain));
+	ms_audio_apply_gain(r->gain,KERNELS_NSAMPLES,1.7f);
+	r->energy=ms_audio_energy(samples,KERNELS_NSAMPLES,&r->peak);
+	r->goertzel=ms_goertzel_run(g,samples);
+}
+
+/* compare the implementations of the audio kernels supported by this processor with the C one,
+and measure them*/
+static int bench_kernels(void){
+	static const char *names[]={"c","sse2","avx2","neon",NULL};
+	const char *def=ms_audio_kernels_get_implementation();
+	int16_t samples[KERNELS_NSAMPLES];
+	int16_t other[KERNELS_NSAMPLES];
+	int16_t work[KERNELS_NSAMPLES];
+	struct kernels_results ref,res;
+	MSGoertzel g;
+	int errors=0;
+	int i,j;
+
+	for(i=0;i<KERNELS_NSAMPLES;++i){
+		samples[i]=(int16_t)((rand()%65535)-32767);
+		other[i]=(int16_t)((rand()%65535)-32767);
+	}
+	samples[KERNELS_NSAMPLES-1]=-32768;
+	ms_goertzel_init(&g,1000,8000,KERNELS_NSAMPLES);
+	ms_audio_kernels_set_implementation("c");
+	run_kernels(samples,other,&g,&ref);
+
+	for(j=0;names[j]!=NULL;++j){
+		volatile uint64_t en=0;
+		volatile float fen=0;
+		uint64_t start;
+		bool_t ok;
+
+		if (ms_audio_kernels_set_implementation(names[j])!=0){
+			ms_message("%s audio kernels: not supported.",names[j]);
+			continue;
+		}
+		run_kernels(samples,other,&g,&res);
+		ok=memcmp(res.sum,ref.sum,sizeof(ref.sum))==0 && memcmp(res.mix,ref.mix,sizeof(ref.mix))==0
+			&& memcmp(res.gain,ref.gain,sizeof(ref.gain))==0 && res.energy==ref.energy && res.peak==ref.peak
+			&& fabs(res.goertzel-ref.goertzel)<=ref.goertzel*1e-4;
+		if (!ok){
+			ms_error("%s audio kernels: results differ from the C implementation.",names[j]);
+			errors++;
+		}
+
+		start=bench_time_us();
+		for(i=0;i<KERNELS_LOOPS;++i){
+			if ((i & KERNELS_SUM_RESET)==0) memset(res.sum,0,sizeof(res.sum));
+			ms_audio_accumulate(res.sum,samples,KERNELS_NSAMPLES);
+		}
+		ms_message("%s audio kernels: accumulate %.1f ns",names[j],(bench_time_us()-start)*1000.0/KERNELS_LOOPS);
+		start=bench_time_us();
+		for(i=0;i<KERNELS_LOOPS;++i) ms_audio_saturate(res.mix,ref.sum,samples,KERNELS_NSAMPLES,32767);
+		ms_message("%s audio kernels: saturate %.1f ns",names[j],(bench_time_us()-start)*1000.0/KERNELS_LOOPS);
+		memcpy(work,samples,sizeof(work));
+		start=bench_time_us();
+		for(i=0;i<KERNELS_LOOPS;++i) ms_audio_apply_gain(work,KERNELS_NSAMPLES,0.9f);
+		ms_message("%s audio kernels: apply_gain %.1f ns",names[j],(bench_time_us()-start)*1000.0/KERNELS_LOOPS);
+		start=bench_time_us();
+		for(i=0;i<KERNELS_LOOPS;++i) en+=ms_audio_energy(samples,KERNELS_NSAMPLES,NULL);
+		ms_message("%s audio kernels: energy %.1f ns",names[j],(bench_time_us()-start)*1000.0/KERNELS_LOOPS);
+		start=bench_time_us();
+		for(i=0;i<KERNELS_LOOPS;++i) fen+=ms_goertzel_run(&g,samples);
+		ms_message("%s audio kernels: goertzel %.1f ns",names[j],(bench_time_us()-start)*1000.0/KERNELS_LOOPS);
+	}
+	ms_goertzel_uninit(&g);
+	ms_audio_kernels_set_implementation(def);
+	ms_message("Audio kernels on %i samples, %i error(s).",KERNELS_NSAMPLES,errors);
+	return errors ? -1 : 0;
+}
 
 int main(int argc, char *argv[]){
 	int pos;
@@ -339,6 +440,9 @@ int main(int argc, char *argv[]){
 	ortp_init();
 	ortp_set_log_level_mask(ORTP_MESSAGE|ORTP_WARNING|ORTP_ERROR|ORTP_FATAL);
 	ms_init();
+	if (argc>1 && strcmp(argv[1],"--kernels")==0){
+		return bench_kernels()==0 ? 0 : 1;
+	}
 	rtp_profile_set_payload(&av_profile,115,&payload_type_lpc1015);
 	rtp_profile_set_payload(&av_profile,110,&payload_type_speex_nb);
 	rtp_profile_set_payload(&av_profile,111,&payload_type_speex_wb);
@@ -0,0 +1,242 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2011  Belledonne Communications SARL.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+/* calls ms_filter_call_methods() on filters attached to a running ticker, from the
+main thread and from the notify callbacks run by the threads of the ticker, and checks
+the dispatch of methods sharing the same index */
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "mediastreamer2/mstonedetector.h"
+#include "mediastreamer2/msticker.h"
+
+#include <math.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define NCHAINS 2
+#define TONE_FREQ 1000
+#define RUN_TIME 2000 /*ms*/
+#define NCREATORS 4
+
+typedef struct _SourceState{
+	int phase;
+	int ticks;
+}SourceState;
+
+/*a 1000Hz tone during 200ms every 400ms, so that it is detected several times*/
+static void source_init(MSFilter *f){
+	f->data=ms_new0(SourceState,1);
+}
+
+static void source_uninit(MSFilter *f){
+	ms_free(f->data);
+}
+
+static void source_process(MSFilter *f){
+	SourceState *s=(SourceState*)f->data;
+	int nsamples=(8000*f->ticker->interval)/1000;
+	mblk_t *m=allocb(nsamples*2,0);
+	int16_t *samples=(int16_t*)m->b_wptr;
+	int i;
+	bool_t on=(s->ticks++ % 40)<20;
+	for(i=0;i<nsamples;i++,s->phase++)
+		samples[i]=on ? (int16_t)(10000*sin(2*M_PI*TONE_FREQ*s->phase/8000.0)) : 0;
+	m->b_wptr+=nsamples*2;
+	ms_queue_put(f->outputs[0],m);
+}
+
+static MSFilterDesc source_desc={
+	MS_FILTER_PLUGIN_ID,
+	"TestToneSource",
+	"A periodic tone",
+	MS_FILTER_OTHER,
+	NULL,
+	0,
+	1,
+	source_init,
+	NULL,
+	source_process,
+	NULL,
+	source_uninit,
+	NULL
+};
+
+static MSToneDetectorDef expected_tone={"test",TONE_FREQ,40,0.5f};
+
+static MSFilterMethodCall reset_scans[]={
+	{	MS_TONE_DETECTOR_CLEAR_SCANS,	NULL	},
+	{	MS_TONE_DETECTOR_ADD_SCAN,	&expected_tone	}
+};
+
+/*runs in the ticker thread or in one of its worker threads, with the ticker locked*/
+static void tone_detected_cb(void *data, MSFilter *f, unsigned int event_id, MSToneDetectorEvent *ev){
+	int *detected=(int*)data;
+	if (ms_filter_call_methods(f,reset_scans,2)!=0)
+		ms_error("ms_filter_call_methods() failed in the notify callback.");
+	else (*detected)++;
+}
+
+static int run_chains(int nthreads){
+	MSFilter *src[NCHAINS], *det[NCHAINS], *sink[NCHAINS];
+	int detected[NCHAINS];
+	MSTicker *ticker;
+	int i,elapsed,errors=0;
+
+	ticker=ms_ticker_new();
+	ms_ticker_set_thread_count(ticker,nthreads);
+	for(i=0;i<NCHAINS;i++){
+		detected[i]=0;
+		src[i]=ms_filter_new_from_desc(&source_desc);
+		det[i]=ms_filter_new(MS_TONE_DETECTOR_ID);
+		sink[i]=ms_filter_new(MS_VOID_SINK_ID);
+		ms_filter_set_notify_callback(det[i],(MSFilterNotifyFunc)tone_detected_cb,&detected[i]);
+		ms_filter_call_methods(det[i],reset_scans,2);
+		ms_filter_link(src[i],0,det[i],0);
+		ms_filter_link(det[i],0,sink[i],0);
+		ms_ticker_attach(ticker,src[i]);
+	}
+	/*the scans are reset while the detectors run: they must never be seen cleared*/
+	for(elapsed=0;elapsed<RUN_TIME;elapsed+=10){
+		for(i=0;i<NCHAINS;i++){
+			if (ms_filter_call_methods(det[i],reset_scans,2)!=0) errors++;
+		}
+		ms_usleep(10000);
+	}
+	for(i=0;i<NCHAINS;i++){
+		ms_ticker_detach(ticker,src[i]);
+		ms_filter_unlink(src[i],0,det[i],0);
+		ms_filter_unlink(det[i],0,sink[i],0);
+		ms_filter_destroy(src[i]);
+		ms_filter_destroy(det[i]);
+		ms_filter_destroy(sink[i]);
+		ms_message("%i thread(s), chain %i: tone detected %i time(s).",nthreads,i,detected[i]);
+		if (detected[i]==0) errors++;
+	}
+	ms_ticker_destroy(ticker);
+	return errors;
+}
+
+/*the methods of index 0 only differ by the size of their argument*/
+#define TEST_SET_INT	MS_FILTER_METHOD(MS_FILTER_PLUGIN_ID,0,int)
+#define TEST_SET_INT64	MS_FILTER_METHOD(MS_FILTER_PLUGIN_ID,0,int64_t)
+#define TEST_SET_SHORT	MS_FILTER_METHOD(MS_FILTER_PLUGIN_ID,0,short)
+#define TEST_GET	MS_FILTER_METHOD(MS_FILTER_PLUGIN_ID,1,int)
+
+static int set_int(MSFilter *f, void *arg){
+	return 1;
+}
+
+static int set_int64(MSFilter *f, void *arg){
+	return 2;
+}
+
+static int set_int_again(MSFilter *f, void *arg){
+	return 3;
+}
+
+static int get(MSFilter *f, void *arg){
+	return 4;
+}
+
+static MSFilterMethod collision_methods[]={
+	{	TEST_SET_INT,	set_int	},
+	{	TEST_GET,	get	},
+	{	TEST_SET_INT64,	set_int64	},
+	{	TEST_SET_INT,	set_int_again	},
+	{	0,	NULL	}
+};
+
+static MSFilterDesc collision_desc={
+	MS_FILTER_PLUGIN_ID,
+	"TestCollisions",
+	"Methods sharing the same index",
+	MS_FILTER_OTHER,
+	NULL,
+	0,
+	0,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	collision_methods
+};
+
+static int check_collisions(void){
+	MSFilter *f=ms_filter_new_from_desc(&collision_desc);
+	int errors=0;
+	/*the first definition of a method wins*/
+	if (ms_filter_call_method(f,TEST_SET_INT,NULL)!=1) errors++;
+	if (ms_filter_call_method(f,TEST_SET_INT64,NULL)!=2) errors++;
+	if (ms_filter_call_method(f,TEST_GET,NULL)!=4) errors++;
+	/*same index, no definition with this argument size*/
+	if (ms_filter_call_method(f,TEST_SET_SHORT,NULL)!=-1) errors++;
+	if (ms_filter_call_method(f,MS_FILTER_SET_SAMPLE_RATE,NULL)!=-1) errors++;
+	ms_filter_destroy(f);
+	ms_message("methods sharing the same index: %i error(s).",errors);
+	return errors;
+}
+
+/*the filters of an unregistered description share a method table created on demand*/
+static void *creator_run(void *arg){
+	int i;
+	for(i=0;i<1000;i++)
+		ms_filter_destroy(ms_filter_new_from_desc(&collision_desc));
+	return NULL;
+}
+
+static void create_concurrently(void){
+	ms_thread_t threads[NCREATORS];
+	int i;
+	for(i=0;i<NCREATORS;i++)
+		ms_thread_create(&threads[i],NULL,creator_run,NULL);
+	for(i=0;i<NCREATORS;i++)
+		ms_thread_join(threads[i],NULL);
+}
+
+int main(int argc, char *argv[]){
+	MSFilter *early;
+	int errors;
+
+	/*as the plugins of the application, created before ms_init() and destroyed after ms_exit()*/
+	ms_filter_register(&collision_desc);
+	early=ms_filter_new_from_desc(&collision_desc);
+	ms_init();
+	ortp_set_log_level_mask(ORTP_MESSAGE|ORTP_WARNING|ORTP_ERROR|ORTP_FATAL);
+#ifndef WIN32
+	/*a deadlock would otherwise hang the test*/
+	alarm(30);
+#endif
+	create_concurrently();
+	errors=check_collisions();
+	errors+=run_chains(1);
+	errors+=run_chains(NCHAINS);
+	ms_message("ms_filter_call_methods() on running filters: %i error(s).",errors);
+	ms_exit();
+	ms_filter_destroy(early);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,261 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2011  Belledonne Communications SARL.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+/* replaces a filter in the middle of graphs attached to a running ticker, from the
+process function of their source, like audio_stream_change_decoder() does when the
+payload type changes: the removed filters must never run again, and be destroyed at
+the end of the tick, and the new ones must run from the next tick. With several
+threads, each relay replaces the relay of the next chain, which is in the same level
+and may be running, or replacing another relay, at the same time */
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "mediastreamer2/msfilter.h"
+#include "mediastreamer2/msticker.h"
+
+#include <string.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#define NCHAINS 4
+#define SWAP_PERIOD 7 /*ticks*/
+#define RUN_TIME 1000 /*ms*/
+
+typedef struct _Chain{
+	struct _Chain *next;
+	MSFilter *src;
+	MSFilter *relay;
+	MSFilter *sink;
+	int swaps;
+	int sent;
+	int relayed;
+	int received;
+}Chain;
+
+static void swap_relay(Chain *c);
+
+/*the relays removed while the graph was running: they must not be run anymore*/
+static MSList *removed=NULL;
+static int removed_runs=0;
+static int relays=0;
+static ms_mutex_t removed_lock;
+/*set while all the chains are attached, with the ticker locked*/
+static bool_t swapping=FALSE;
+/*the relays replace the relay of the next chain, rather than the sources their own*/
+static bool_t swap_neighbours=FALSE;
+
+static void relay_process(MSFilter *f);
+static void relay_uninit(MSFilter *f);
+
+static MSFilterDesc relay_desc={
+	MS_FILTER_PLUGIN_ID,
+	"TestRelay",
+	"Forwards its input",
+	MS_FILTER_OTHER,
+	NULL,
+	1,
+	1,
+	NULL,
+	NULL,
+	relay_process,
+	NULL,
+	relay_uninit,
+	NULL
+};
+
+static void relay_uninit(MSFilter *f){
+	ms_mutex_lock(&removed_lock);
+	relays--;
+	ms_mutex_unlock(&removed_lock);
+}
+
+static void relay_process(MSFilter *f){
+	Chain *c=(Chain*)f->data;
+	mblk_t *m;
+	bool_t is_removed;
+	ms_mutex_lock(&removed_lock);
+	is_removed=ms_list_find(removed,f)!=NULL;
+	if (is_removed) removed_runs++;
+	ms_mutex_unlock(&removed_lock);
+	if (is_removed){
+		ms_error("A removed relay is run.");
+		return;
+	}
+	while((m=ms_queue_get(f->inputs[0]))!=NULL){
+		ms_queue_put(f->outputs[0],m);
+		c->relayed++;
+	}
+	/*this relay may be replaced by its own neighbour during the swap: its queues are
+	not used afterwards*/
+	if (swapping && swap_neighbours && c->relayed%SWAP_PERIOD==0)
+		swap_relay(c->next);
+}
+
+static MSFilter *relay_new(Chain *c){
+	MSFilter *f=ms_filter_new_from_desc(&relay_desc);
+	f->data=c;
+	/*the memory of a destroyed relay may be reused*/
+	ms_mutex_lock(&removed_lock);
+	removed=ms_list_remove(removed,f);
+	relays++;
+	ms_mutex_unlock(&removed_lock);
+	return f;
+}
+
+/*the same steps as audio_stream_change_decoder()*/
+static void swap_relay(Chain *c){
+	MSFilter *relay=relay_new(c);
+	ms_filter_unlink(c->src,0,c->relay,0);
+	ms_filter_unlink(c->relay,0,c->sink,0);
+	ms_filter_postprocess(c->relay);
+	ms_mutex_lock(&removed_lock);
+	removed=ms_list_append(removed,c->relay);
+	ms_mutex_unlock(&removed_lock);
+	ms_filter_destroy(c->relay);
+	c->relay=relay;
+	ms_filter_link(c->src,0,c->relay,0);
+	ms_filter_link(c->relay,0,c->sink,0);
+	ms_filter_preprocess(c->relay,c->src->ticker);
+	c->swaps++;
+}
+
+static void source_process(MSFilter *f){
+	Chain *c=(Chain*)f->data;
+	mblk_t *m=allocb(4,0);
+	m->b_wptr+=4;
+	ms_queue_put(f->outputs[0],m);
+	c->sent++;
+	if (swapping && !swap_neighbours && c->sent%SWAP_PERIOD==0)
+		swap_relay(c);
+}
+
+static MSFilterDesc source_desc={
+	MS_FILTER_PLUGIN_ID,
+	"TestSource",
+	"Sends a message at each tick",
+	MS_FILTER_OTHER,
+	NULL,
+	0,
+	1,
+	NULL,
+	NULL,
+	source_process,
+	NULL,
+	NULL,
+	NULL
+};
+
+static void sink_process(MSFilter *f){
+	Chain *c=(Chain*)f->data;
+	mblk_t *m;
+	while((m=ms_queue_get(f->inputs[0]))!=NULL){
+		c->received++;
+		freemsg(m);
+	}
+}
+
+static MSFilterDesc sink_desc={
+	MS_FILTER_PLUGIN_ID,
+	"TestSink",
+	"Counts its input",
+	MS_FILTER_OTHER,
+	NULL,
+	1,
+	0,
+	NULL,
+	NULL,
+	sink_process,
+	NULL,
+	NULL,
+	NULL
+};
+
+static int run_chains(int nthreads, int nchains){
+	Chain chains[NCHAINS];
+	MSTicker *ticker;
+	int i,errors=0;
+
+	ticker=ms_ticker_new();
+	ms_ticker_set_thread_count(ticker,nthreads);
+	for(i=0;i<nchains;i++){
+		Chain *c=&chains[i];
+		memset(c,0,sizeof(*c));
+		c->next=&chains[(i+1)%nchains];
+		c->src=ms_filter_new_from_desc(&source_desc);
+		c->src->data=c;
+		c->relay=relay_new(c);
+		c->sink=ms_filter_new_from_desc(&sink_desc);
+		c->sink->data=c;
+		ms_filter_link(c->src,0,c->relay,0);
+		ms_filter_link(c->relay,0,c->sink,0);
+	}
+	for(i=0;i<nchains;i++)
+		ms_ticker_attach(ticker,chains[i].src);
+	ms_mutex_lock(&ticker->lock);
+	swapping=TRUE;
+	swap_neighbours=(nchains>1);
+	ms_mutex_unlock(&ticker->lock);
+	ms_usleep(RUN_TIME*1000);
+	ms_mutex_lock(&ticker->lock);
+	swapping=FALSE;
+	ms_mutex_unlock(&ticker->lock);
+	for(i=0;i<nchains;i++){
+		Chain *c=&chains[i];
+		ms_ticker_detach(ticker,c->src);
+		ms_filter_unlink(c->src,0,c->relay,0);
+		ms_filter_unlink(c->relay,0,c->sink,0);
+		ms_filter_destroy(c->src);
+		ms_filter_destroy(c->relay);
+		ms_filter_destroy(c->sink);
+		ms_message("%i thread(s), chain %i: %i swaps, %i messages sent, %i received.",
+			nthreads,i,c->swaps,c->sent,c->received);
+		/*the messages queued for a removed relay are lost, more of them when the
+		ticks are cut short by the changes of the other graphs*/
+		if (c->swaps==0 || c->received<c->sent/2) errors++;
+	}
+	ms_ticker_destroy(ticker);
+	return errors;
+}
+
+int main(int argc, char *argv[]){
+	int errors;
+
+	ms_init();
+	ms_mutex_init(&removed_lock,NULL);
+	ortp_set_log_level_mask(ORTP_MESSAGE|ORTP_WARNING|ORTP_ERROR|ORTP_FATAL);
+#ifndef WIN32
+	/*a deadlock would otherwise hang the test*/
+	alarm(30);
+#endif
+	errors=run_chains(1,1);
+	errors+=run_chains(NCHAINS,NCHAINS);
+	ms_list_free(removed);
+	if (relays!=0){
+		ms_error("%i relay(s) not destroyed.",relays);
+		errors++;
+	}
+	errors+=removed_runs;
+	ms_mutex_destroy(&removed_lock);
+	ms_message("filters replaced while running: %i error(s).",errors);
+	ms_exit();
+	return errors ? 1 : 0;
+}
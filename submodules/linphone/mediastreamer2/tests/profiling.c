@@ -0,0 +1,282 @@
+/*
+mediastreamer2 library - modular sound and video processing and streaming
+Copyright (C) 2011  Belledonne Communications SARL.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+/* checks the ticker profiling: the percentiles of a histogram fed with known durations,
+the late ticks counted for a graph with a filter slower than the tick interval, and the
+Chrome trace written meanwhile, which must be valid JSON */
+
+#ifdef HAVE_CONFIG_H
+#include "mediastreamer-config.h"
+#endif
+
+#include "mediastreamer2/msfilter.h"
+#include "mediastreamer2/msticker.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#define SLOW_PROCESS_TIME 25 /*ms, the ticks are 10 ms apart*/
+#define RUN_TIME 500 /*ms*/
+#define TRACE_FILE "profiling-trace.json"
+
+#define MS (1000000ULL) /*ns*/
+
+/*a percentile is the upper bound of its bucket: within 25% above the sample*/
+static int check_bucket(const char *what, uint64_t value, uint64_t sample){
+	if (value<sample || value>=sample+sample/4){
+		ms_error("%s is %llu ns, not in the bucket of %llu ns.",what,
+			(unsigned long long)value,(unsigned long long)sample);
+		return 1;
+	}
+	return 0;
+}
+
+static int test_histogram(void){
+	MSTimeHistogram h;
+	int i,errors=0;
+
+	memset(&h,0,sizeof(h));
+	if (ms_time_histogram_get_percentile(&h,50)!=0){
+		ms_error("The percentile of an empty histogram is not 0.");
+		errors++;
+	}
+	/*98 samples of 1 ms, one of 10 ms and one of 50 ms*/
+	for(i=0;i<98;i++) ms_time_histogram_add(&h,1*MS);
+	ms_time_histogram_add(&h,10*MS);
+	ms_time_histogram_add(&h,50*MS);
+	errors+=check_bucket("p50",ms_time_histogram_get_percentile(&h,50),1*MS);
+	errors+=check_bucket("p98",ms_time_histogram_get_percentile(&h,98),1*MS);
+	errors+=check_bucket("p99",ms_time_histogram_get_percentile(&h,99),10*MS);
+	if (ms_time_histogram_get_percentile(&h,100)!=50*MS || h.max!=50*MS){
+		ms_error("The 100th percentile or the max is not the largest sample.");
+		errors++;
+	}
+	if (h.count!=100 || h.total!=158*MS){
+		ms_error("The histogram has %llu samples totalling %llu ns.",
+			(unsigned long long)h.count,(unsigned long long)h.total);
+		errors++;
+	}
+	ms_message("histogram percentiles: %i error(s).",errors);
+	return errors;
+}
+
+static void slow_process(MSFilter *f){
+	ms_usleep(SLOW_PROCESS_TIME*1000);
+}
+
+static MSFilterDesc slow_desc={
+	MS_FILTER_PLUGIN_ID,
+	"TestSlow",
+	"Takes longer than a tick",
+	MS_FILTER_OTHER,
+	NULL,
+	0,
+	0,
+	NULL,
+	NULL,
+	slow_process,
+	NULL,
+	NULL,
+	NULL
+};
+
+/*a minimal JSON parser, which only checks the syntax*/
+static void skip_spaces(const char **p){
+	while(**p==' ' || **p=='\n' || **p=='\r' || **p=='\t') (*p)++;
+}
+
+static int parse_value(const char **p);
+
+static int parse_string(const char **p){
+	if (**p!='"') return -1;
+	for((*p)++;**p!='"';(*p)++){
+		if (**p=='\0' || (unsigned char)**p<0x20) return -1;
+		if (**p=='\\'){
+			(*p)++;
+			if (**p=='\0' || strchr("\"\\/bfnrtu",**p)==NULL) return -1;
+		}
+	}
+	(*p)++;
+	return 0;
+}
+
+static int parse_number(const char **p){
+	char *end;
+	strtod(*p,&end);
+	if (end==*p) return -1;
+	*p=end;
+	return 0;
+}
+
+static int parse_members(const char **p, char close, int with_names){
+	(*p)++;
+	skip_spaces(p);
+	if (**p==close){
+		(*p)++;
+		return 0;
+	}
+	while(1){
+		if (with_names){
+			if (parse_string(p)!=0) return -1;
+			skip_spaces(p);
+			if (**p!=':') return -1;
+			(*p)++;
+		}
+		if (parse_value(p)!=0) return -1;
+		skip_spaces(p);
+		if (**p==close){
+			(*p)++;
+			return 0;
+		}
+		if (**p!=',') return -1;
+		(*p)++;
+		skip_spaces(p);
+	}
+}
+
+static int parse_value(const char **p){
+	skip_spaces(p);
+	switch(**p){
+		case '{': return parse_members(p,'}',TRUE);
+		case '[': return parse_members(p,']',FALSE);
+		case '"': return parse_string(p);
+		case 't': if (strncmp(*p,"true",4)==0){ *p+=4; return 0; } return -1;
+		case 'f': if (strncmp(*p,"false",5)==0){ *p+=5; return 0; } return -1;
+		case 'n': if (strncmp(*p,"null",4)==0){ *p+=4; return 0; } return -1;
+		default: return parse_number(p);
+	}
+}
+
+static char *read_file(const char *filename){
+	FILE *f=fopen(filename,"rb");
+	char *buf;
+	long size;
+	if (f==NULL) return NULL;
+	fseek(f,0,SEEK_END);
+	size=ftell(f);
+	fseek(f,0,SEEK_SET);
+	buf=ms_malloc(size+1);
+	size=fread(buf,1,size,f);
+	buf[size]='\0';
+	fclose(f);
+	return buf;
+}
+
+static int check_trace(const char *filename){
+	char *trace=read_file(filename);
+	const char *p=trace;
+	int errors=0;
+
+	if (trace==NULL){
+		ms_error("Cannot read the trace %s.",filename);
+		return 1;
+	}
+	skip_spaces(&p);
+	if (*p!='[' || parse_value(&p)!=0){
+		ms_error("The trace is not valid JSON, at offset %i.",(int)(p-trace));
+		errors++;
+	}else{
+		skip_spaces(&p);
+		if (*p!='\0'){
+			ms_error("The trace has trailing data at offset %i.",(int)(p-trace));
+			errors++;
+		}
+	}
+	if (strstr(trace,"\"name\":\"TestSlow\"")==NULL || strstr(trace,"\"name\":\"late\"")==NULL){
+		ms_error("The trace has no event for the slow filter or no late tick.");
+		errors++;
+	}
+	ms_free(trace);
+	return errors;
+}
+
+static int test_late_ticks(void){
+	MSTicker *ticker;
+	MSFilter *slow;
+	MSTickerProfile profile;
+	MSFilterProfile fprofile;
+	int errors=0;
+
+	ticker=ms_ticker_new();
+	ms_ticker_set_name(ticker,"TestTicker");
+	slow=ms_filter_new_from_desc(&slow_desc);
+	if (ms_ticker_get_profile(ticker,&profile)==0){
+		ms_error("The profile is available before profiling is enabled.");
+		errors++;
+	}
+	if (ms_ticker_start_trace(ticker,TRACE_FILE)!=0){
+		ms_ticker_destroy(ticker);
+		ms_filter_destroy(slow);
+		return 1;
+	}
+	ms_ticker_attach(ticker,slow);
+	ms_usleep(RUN_TIME*1000);
+	ms_ticker_stop_trace(ticker);
+
+	/*the filter profile is only kept while the filter is attached*/
+	if (ms_ticker_get_profile(ticker,&profile)!=0 || ms_ticker_get_filter_profile(ticker,slow,&fprofile)!=0){
+		ms_error("The profiles are not available.");
+		errors++;
+	}else{
+		ms_message("%u ticks, %u late (max %i ms), the slow filter ran %llu times, late during %u ticks.",
+			profile.ticks,profile.late_ticks,profile.max_late,
+			(unsigned long long)fprofile.process_time.count,fprofile.late_ticks);
+		/*every tick but the first ones is late*/
+		if (profile.ticks<2 || profile.late_ticks<profile.ticks/2 || profile.max_late<=0){
+			ms_error("The late ticks are not counted.");
+			errors++;
+		}
+		if (fprofile.late_ticks==0 || fprofile.late_ticks>profile.late_ticks){
+			ms_error("The slow filter is not blamed for the late ticks.");
+			errors++;
+		}
+		if (fprofile.process_time.count==0
+			|| ms_time_histogram_get_percentile(&fprofile.process_time,50)<SLOW_PROCESS_TIME*MS){
+			ms_error("The process time of the slow filter is too short.");
+			errors++;
+		}
+	}
+	ms_ticker_detach(ticker,slow);
+	ms_ticker_destroy(ticker);
+	ms_filter_destroy(slow);
+	errors+=check_trace(TRACE_FILE);
+	unlink(TRACE_FILE);
+	ms_message("late ticks and trace: %i error(s).",errors);
+	return errors;
+}
+
+int main(int argc, char *argv[]){
+	int errors;
+
+	ms_init();
+	ortp_set_log_level_mask(ORTP_MESSAGE|ORTP_WARNING|ORTP_ERROR|ORTP_FATAL);
+#ifndef WIN32
+	/*a deadlock would otherwise hang the test*/
+	alarm(30);
+#endif
+	errors=test_histogram();
+	errors+=test_late_ticks();
+	ms_message("profiling: %i error(s).",errors);
+	ms_exit();
+	return errors ? 1 : 0;
+}
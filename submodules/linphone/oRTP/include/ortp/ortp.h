@@ -75,6 +75,7 @@ extern "C"
 bool_t ortp_min_version_required(int major, int minor, int micro);
 void ortp_init(void);
 void ortp_scheduler_init(void);
+void ortp_scheduler_init_shards(int count);
 void ortp_exit(void);
 
 /***************/
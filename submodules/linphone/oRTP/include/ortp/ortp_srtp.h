@@ -52,7 +52,9 @@ enum ortp_srtp_crypto_suite_t {
 	AES_128_SHA1_80 = 1,
 	AES_128_SHA1_32,
 	AES_128_NO_AUTH,
-	NO_CIPHER_SHA1_80
+	NO_CIPHER_SHA1_80,
+	AEAD_AES_128_GCM, /*RFC 7714, 16 bytes key and 12 bytes salt*/
+	AEAD_AES_256_GCM  /*RFC 7714, 32 bytes key and 12 bytes salt*/
 };
 
 err_status_t ortp_srtp_init(void);
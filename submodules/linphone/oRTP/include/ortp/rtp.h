@@ -80,6 +80,8 @@ typedef struct jitter_stats
 	uint32_t max_jitter;		/* biggest interarrival jitter (value in stream clock unit) */
 	uint64_t sum_jitter;		/* sum of all interarrival jitter (value in stream clock unit) */
 	uint64_t max_jitter_ts;		/* date (in ms since Epoch) of the biggest interarrival jitter */
+	uint32_t jitter_buffer_size_ms;	/* current jitter compensation of the jitter buffer */
+	uint32_t target_jitter_buffer_size_ms;	/* jitter compensation the adaptive jitter buffer is converging to */
 } jitter_stats_t;
 
 #define RTP_TIMESTAMP_IS_NEWER_THAN(ts1,ts2) \
@@ -58,8 +58,12 @@ typedef struct _JBParameters{
 	bool_t adaptive;
 	bool_t pad[3];
 	int max_packets; /**< max number of packets allowed to be queued in the jitter buffer */
+	float late_loss_rate; /**< in percent. When adaptive and non zero, the jitter compensation is chosen between
+		min_size and max_size so that this percentage of packets arrive too late to be played. */
 } JBParameters;
 
+#define RTP_JITTER_HISTOGRAM_SIZE 100
+
 typedef struct _JitterControl
 {
 	int count;
@@ -73,10 +77,33 @@ typedef struct _JitterControl
 	float inter_jitter;	/* interarrival jitter as defined in the RFC */
 	int corrective_step;
 	int corrective_slide;
+	int clock_rate;
+	int min_size;	/* bounds of the jitter compensation in milliseconds, -1 if unbounded */
+	int max_size;
+	int min_jitt_comp_ts;
+	int max_jitt_comp_ts;
+	float late_loss_rate;	/* in percent, 0 to adapt on the average jitter */
+	int target_jitt_comp_ts;	/* the jitter compensation the histogram mode converges to */
+	uint32_t last_arrival_ts;
+	uint32_t last_packet_ts;
+	float histogram_total;
+	float histogram[RTP_JITTER_HISTOGRAM_SIZE];	/* lateness of the packets, by steps of 5 ms */
 	bool_t adaptive;
 	bool_t enabled;
 } JitterControl;
 
+/* The queue of received packets, indexed by their sequence numbers:
+ each packet is stored in slots[seq & (size-1)], so that a late packet is inserted without
+ walking the queue. Dequeuing skips the slots of the lost packets. */
+typedef struct _RtpJitterQueue
+{
+	mblk_t **slots;
+	int size;	/* number of slots, a power of two from 2*max_packets, 0 until the first packet */
+	int count;	/* number of packets in the queue */
+	uint16_t head;	/* sequence number of the oldest slot */
+	uint16_t tail;	/* sequence number following the newest slot */
+} RtpJitterQueue;
+
 typedef struct _WaitPoint
 {
 	ortp_mutex_t lock;
@@ -93,22 +120,74 @@ typedef struct _RtpTransport
 	int  (*t_recvfrom)(struct _RtpTransport *t, mblk_t *msg, int flags, struct sockaddr *from, socklen_t *fromlen);
 	struct _RtpSession *session;//<back pointer to the owning session, set by oRTP
 	void  (*t_close)(struct _RtpTransport *transport, void *userData);
+	/*optional, used for batched io (see rtp_session_set_io_batch_size()): sends count packets, results[i] being set
+	to what t_sendto() would have returned for msgs[i]*/
+	void  (*t_sendto_batch)(struct _RtpTransport *t, mblk_t **msgs, int *results, int count, int flags, const struct sockaddr *to, socklen_t tolen);
+	/*optional, used for batched io: reads up to count datagrams into msgs, results[i] and from[i] being set as t_recvfrom()
+	would have done for msgs[i]. Returns the number of datagrams read, or -1 like t_recvfrom() if none could be.*/
+	int  (*t_recvfrom_batch)(struct _RtpTransport *t, mblk_t **msgs, int *results, int count, int flags, struct sockaddr **from, socklen_t *fromlen);
 }  RtpTransport;
 
+typedef enum _OrtpJitterDistribution{
+	ORTP_JITTER_UNIFORM,	/*delays evenly spread between 0 and jitter*/
+	ORTP_JITTER_NORMAL,	/*gaussian delays of mean and standard deviation jitter, negative values being clipped*/
+	ORTP_JITTER_PARETO	/*long tailed delays, with a mean of jitter*/
+}OrtpJitterDistribution;
+
 typedef struct _OrtpNetworkSimulatorParams{
 	int enabled;
 	float max_bandwidth; /*IP bandwidth, in bit/s*/
-	float loss_rate;
+	float loss_rate; /*percentage of randomly lost packets*/
+	/*Gilbert-Elliott burst losses, used instead of loss_rate when ge_good_to_bad is not zero.
+	The probabilities are percentages, like loss_rate, and evaluated for each packet*/
+	float ge_good_to_bad;
+	float ge_bad_to_good;
+	float ge_good_loss;
+	float ge_bad_loss;
+	int latency; /*fixed delay added to all packets, in milliseconds*/
+	int jitter; /*variable delay added to the packets, in milliseconds*/
+	OrtpJitterDistribution jitter_distribution;
+	float reorder_rate; /*percentage of packets delayed by reorder_delay, so that they arrive after the next ones*/
+	int reorder_delay; /*in milliseconds*/
+	float duplicate_rate; /*percentage of duplicated packets*/
+	const char *trace_file; /*if set, losses and delays are replayed from this file instead of the models above,
+				one entry per packet so that a run can be reproduced*/
+	int trace_by_time; /*if set, the trace entry of a packet is the one of its arrival time since the first packet*/
+	unsigned int seed; /*seed of the random generator, for runs that can be reproduced. 0 to use the time*/
 }OrtpNetworkSimulatorParams;
 
+typedef struct _OrtpNetworkSimulatorTraceEntry{
+	uint32_t time; /*in milliseconds since the start of the trace, only used with trace_by_time*/
+	int delay; /*in milliseconds, -1 for a lost packet*/
+}OrtpNetworkSimulatorTraceEntry;
+
 typedef struct _OrtpNetworkSimulatorCtx{
 	OrtpNetworkSimulatorParams params;
 	int bit_budget;
 	int qsize;
 	queue_t q;
 	struct timeval last_check;
+	queue_t latency_q; /*packets waiting for their delay to expire, by increasing due time*/
+	struct timeval start;
+	uint32_t last_due; /*due time of the last packet not reordered*/
+	uint32_t rand_state;
+	bool_t ge_bad_state;
+	OrtpNetworkSimulatorTraceEntry *trace;
+	int trace_count;
+	int trace_pos;
 }OrtpNetworkSimulatorCtx;
 
+#define RTP_IO_BATCH_MAX 16
+
+/* room kept before a payload for the rtp header and the payload format headers,
+ and after it for the srtp authentication tag */
+#define RTP_PACKET_HEADROOM 64
+#define RTP_PACKET_TAILROOM 32
+
+/* allocates a block for a payload of size bytes, to which rtp_session_prepend_header() can add the
+ rtp header without copy */
+#define rtp_payload_allocb(size)	allocb_with_headroom((size)+RTP_PACKET_TAILROOM,RTP_PACKET_HEADROOM,0)
+
 typedef struct _RtpStream
 {
 	ortp_socket_t socket;
@@ -117,9 +196,11 @@ typedef struct _RtpStream
 	int max_rq_size;
 	int time_jump;
 	uint32_t ts_jump;
-	queue_t rq;
-	queue_t tev_rq;
+	RtpJitterQueue rq;
+	RtpJitterQueue tev_rq;
 	mblk_t *cached_mp;
+	mblk_t *batch_mp[RTP_IO_BATCH_MAX]; /*receive buffers for batched reads*/
+	int io_batch_size; /*max number of datagrams per system call*/
 	int loc_port;
 #ifdef ORTP_INET6
 	struct sockaddr_storage rem_addr;
@@ -221,6 +302,8 @@ struct _RtpSession
 	RtcpStream rtcp;
 	RtpSessionMode mode;
 	struct _RtpScheduler *sched;
+	ortp_socket_t sched_fd;	/* the socket registered in the scheduler's epoll set, or -1 */
+	int sched_wakeup;	/* index of the entry of the session in the wake up heap of its scheduler, or -1 */
 	uint32_t flags;
 	int dscp;
 	int multicast_ttl;
@@ -256,6 +339,7 @@ extern "C"
 RtpSession *rtp_session_new(int mode);
 void rtp_session_set_scheduling_mode(RtpSession *session, int yesno);
 void rtp_session_set_blocking_mode(RtpSession *session, int yesno);
+void rtp_session_enable_wakeup_on_data(RtpSession *session, bool_t yesno);
 void rtp_session_set_profile(RtpSession *session, RtpProfile *profile);
 void rtp_session_set_send_profile(RtpSession *session,RtpProfile *profile);
 void rtp_session_set_recv_profile(RtpSession *session,RtpProfile *profile);
@@ -335,7 +419,9 @@ mblk_t * rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts);
 mblk_t * rtp_session_create_packet(RtpSession *session,int header_size, const uint8_t *payload, int payload_size);
 mblk_t * rtp_session_create_packet_with_data(RtpSession *session, uint8_t *payload, int payload_size, void (*freefn)(void*));
 mblk_t * rtp_session_create_packet_in_place(RtpSession *session,uint8_t *buffer, int size, void (*freefn)(void*) );
+mblk_t * rtp_session_prepend_header(RtpSession *session, mblk_t *payload);
 int rtp_session_sendm_with_ts (RtpSession * session, mblk_t *mp, uint32_t userts);
+int rtp_session_sendm_batch_with_ts(RtpSession *session, mblk_t **packets, int count, uint32_t userts);
 /* high level recv and send functions */
 int rtp_session_recv_with_ts(RtpSession *session, uint8_t *buffer, int len, uint32_t ts, int *have_more);
 int rtp_session_send_with_ts(RtpSession *session, const uint8_t *buffer, int len, uint32_t userts);
@@ -367,6 +453,7 @@ void rtp_session_set_data(RtpSession *session, void *data);
 void *rtp_session_get_data(const RtpSession *session);
 
 void rtp_session_set_recv_buf_size(RtpSession *session, int bufsize);
+void rtp_session_set_io_batch_size(RtpSession *session, int count);
 void rtp_session_set_rtp_socket_send_buffer_size(RtpSession * session, unsigned int size);
 void rtp_session_set_rtp_socket_recv_buffer_size(RtpSession * session, unsigned int size);
 
@@ -405,6 +492,19 @@ void rtp_session_rtcp_set_lost_packet_value( RtpSession *session, const unsigned
 void rtp_session_rtcp_set_jitter_value(RtpSession *session, const unsigned int value );
 void rtp_session_rtcp_set_delay_value(RtpSession *session, const unsigned int value );
 mblk_t * rtp_session_pick_with_cseq (RtpSession * session, const uint16_t sequence_number);
+
+/*jitter queue functions, used by the session for its incoming packets*/
+void rtp_jitter_queue_init(RtpJitterQueue *q);
+void rtp_jitter_queue_uninit(RtpJitterQueue *q);
+void rtp_jitter_queue_flush(RtpJitterQueue *q);
+int rtp_jitter_queue_put(RtpJitterQueue *q, mblk_t *mp, int max_packets);
+mblk_t *rtp_jitter_queue_peek(RtpJitterQueue *q);
+mblk_t *rtp_jitter_queue_pop(RtpJitterQueue *q);
+mblk_t *rtp_jitter_queue_find(RtpJitterQueue *q, uint16_t seq);
+mblk_t *rtp_jitter_queue_get(RtpJitterQueue *q, uint32_t timestamp, int *rejected);
+mblk_t *rtp_jitter_queue_get_permissive(RtpJitterQueue *q, uint32_t timestamp, int *rejected);
+#define rtp_jitter_queue_empty(q)	((q)->count==0)
+
 /*private */
 void rtp_session_init(RtpSession *session, int mode);
 #define rtp_session_set_flag(session,flag) (session)->flags|=(flag)
@@ -76,6 +76,18 @@ void mblk_init(mblk_t *mp);
 mblk_t *allocb(int size, int unused);
 #define BPRI_MED 0
 
+/* allocates a mblk_t like allocb(), but with b_rptr headroom bytes after the beginning of the buffer,
+ so that headers can be later prepended in place with msgb_prepend(). size does not include headroom.*/
+mblk_t *allocb_with_headroom(int size, int headroom, int pri);
+
+/* free space before b_rptr and after b_wptr */
+#define msgb_headroom(mp)	((int)((mp)->b_rptr-(mp)->b_datap->db_base))
+#define msgb_tailroom(mp)	((int)((mp)->b_datap->db_lim-(mp)->b_wptr))
+
+/* moves b_rptr len bytes backward and returns it, or returns NULL if there is not enough headroom
+ or if the buffer is shared with another mblk_t */
+uint8_t *msgb_prepend(mblk_t *mp, int len);
+
 /* allocates a mblk_t, that points to a datab_t, that points to buf; buf will be freed using freefn */
 mblk_t *esballoc(uint8_t *buf, int size, int pri, void (*freefn)(void*) );
 
@@ -95,7 +107,8 @@ mblk_t	*dupmsg(mblk_t* m);
 /* returns the size of data of a message */
 int msgdsize(const mblk_t *mp);
 
-/* concatenates all fragment of a complex message*/
+/* concatenates all fragment of a complex message, in a buffer of at least len bytes.
+ The data is not copied if the message has a single fragment whose buffer is not shared and large enough*/
 void msgpullup(mblk_t *mp,int len);
 
 /* duplicates a single message, but with buffer included */
@@ -109,6 +122,19 @@ void msgappend(mblk_t *mp, const char *data, int size, bool_t pad);
 
 mblk_t *concatb(mblk_t *mp, mblk_t *newm);
 
+typedef struct _msgb_pool_stats{
+	uint64_t hits;	/*allocations served from a free list*/
+	uint64_t misses;	/*allocations that had to call ortp_malloc()*/
+	uint64_t releases;	/*blocks given back to a free list*/
+	uint64_t drops;	/*blocks freed because the retained memory limit was reached*/
+	size_t retained;	/*bytes currently kept in free lists*/
+}msgb_pool_stats_t;
+
+/* allocb(), esballoc(), dupb() and freeb() recycle their blocks through a pool of free lists */
+void msgb_pool_set_max_retained(size_t bytes);
+void msgb_pool_get_stats(msgb_pool_stats_t *stats);
+void msgb_pool_flush(void);
+
 #define qempty(q) (&(q)->_q_stopper==(q)->_q_stopper.b_next)
 #define qfirst(q) ((q)->_q_stopper.b_next!=&(q)->_q_stopper ? (q)->_q_stopper.b_next : NULL)
 #define qbegin(q) ((q)->_q_stopper.b_next)
@@ -116,12 +142,26 @@ mblk_t *concatb(mblk_t *mp, mblk_t *newm);
 #define qend(q,mp)	((mp)==&(q)->_q_stopper)
 #define qnext(q,mp) ((mp)->b_next)
 
+/* number of size classes of a msgb_allocator_t: 256, 512, ... 32768 bytes */
+#define MSGB_ALLOCATOR_CLASSES 8
+
+typedef struct _msgb_allocator_stats{
+	uint64_t hits;	/*allocations served from a free list*/
+	uint64_t misses;	/*allocations that needed a new buffer*/
+	int in_use;	/*buffers still referenced by messages*/
+	int free_count;	/*buffers waiting in the free lists*/
+	size_t retained;	/*total size of the buffers owned by the allocator*/
+}msgb_allocator_stats_t;
+
+typedef struct _msgb_allocator_pool msgb_allocator_pool_t;
+
 typedef struct _msgb_allocator{
-	queue_t q;
+	msgb_allocator_pool_t *pool;
 }msgb_allocator_t;
 
 void msgb_allocator_init(msgb_allocator_t *pa);
 mblk_t *msgb_allocator_alloc(msgb_allocator_t *pa, int size);
+void msgb_allocator_get_stats(msgb_allocator_t *pa, msgb_allocator_stats_t *stats);
 void msgb_allocator_uninit(msgb_allocator_t *pa);
 
 #ifdef __cplusplus
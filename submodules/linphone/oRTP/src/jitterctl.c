@@ -33,6 +33,11 @@
 
 #define JC_BETA 0.01
 #define JC_GAMMA (JC_BETA)
+/*the histogram buckets are 5ms wide*/
+#define JC_HISTOGRAM_STEP_MS 5
+/*the histogram counts are multiplied by this factor every 50 packets, so that it reflects
+the last five hundred packets or so*/
+#define JC_HISTOGRAM_FORGET 0.9f
 
 #include "jitterctl.h"
 
@@ -49,19 +54,49 @@ void jitter_control_init(JitterControl *ctl, int base_jiitt_time, PayloadType *p
 		jitter_control_set_payload(ctl,payload);
 	}
 	ctl->adapt_jitt_comp_ts=ctl->jitt_comp_ts;
+	ctl->target_jitt_comp_ts=ctl->jitt_comp_ts;
 	ctl->corrective_slide=0;
+	ctl->last_arrival_ts=0;
+	ctl->last_packet_ts=0;
+	ctl->histogram_total=0;
+	memset(ctl->histogram,0,sizeof(ctl->histogram));
 }
 
 void jitter_control_enable_adaptive(JitterControl *ctl, bool_t val){
 	ctl->adaptive=val;
 }
 
+static int jitter_control_ms_to_ts(JitterControl *ctl, int ms){
+	return (int) (((double) ms / 1000.0) * (ctl->clock_rate));
+}
+
+static void jitter_control_update_bounds(JitterControl *ctl){
+	ctl->min_jitt_comp_ts=ctl->min_size>0 ? jitter_control_ms_to_ts(ctl,ctl->min_size) : 0;
+	ctl->max_jitt_comp_ts=ctl->max_size>0 ? jitter_control_ms_to_ts(ctl,ctl->max_size) : -1;
+}
+
 void jitter_control_set_payload(JitterControl *ctl, PayloadType *pt){
-	ctl->jitt_comp_ts =
-			(int) (((double) ctl->jitt_comp / 1000.0) * (pt->clock_rate));
+	ctl->clock_rate=pt->clock_rate;
+	ctl->jitt_comp_ts = jitter_control_ms_to_ts(ctl,ctl->jitt_comp);
 	/*make correction by not less than 10ms */
 	ctl->corrective_step=(int) (0.01 * (float)pt->clock_rate);
 	ctl->adapt_jitt_comp_ts=ctl->jitt_comp_ts;
+	ctl->target_jitt_comp_ts=ctl->jitt_comp_ts;
+	jitter_control_update_bounds(ctl);
+}
+
+/*set the bounds and late loss rate of the histogram mode*/
+void jitter_control_set_histogram_params(JitterControl *ctl, int min_size, int max_size, float late_loss_rate){
+	ctl->min_size=min_size;
+	ctl->max_size=max_size;
+	ctl->late_loss_rate=late_loss_rate;
+	jitter_control_update_bounds(ctl);
+}
+
+void jitter_control_update_stats(JitterControl *ctl, jitter_stats_t *stats){
+	if (ctl->clock_rate==0) return;
+	stats->jitter_buffer_size_ms=(uint32_t)(((int64_t)ctl->adapt_jitt_comp_ts*1000)/ctl->clock_rate);
+	stats->target_jitter_buffer_size_ms=(uint32_t)(((int64_t)ctl->target_jitt_comp_ts*1000)/ctl->clock_rate);
 }
 
 
@@ -85,6 +120,49 @@ void jitter_control_update_corrective_slide(JitterControl *ctl){
 	}
 }
 
+/*
+ Counts a packet arriving late by the given amount (in timestamp units) in the histogram,
+ and every 50 packets, chooses the jitter compensation that leaves late_loss_rate percent of
+ the packets out, and moves adapt_jitt_comp_ts toward it by corrective_step.
+*/
+static void jitter_control_update_histogram(JitterControl *ctl, double late, bool_t silence){
+	int step_ts=jitter_control_ms_to_ts(ctl,JC_HISTOGRAM_STEP_MS);
+	int i,target;
+	float late_count,max_late_count;
+
+	if (step_ts<=0) return;
+	i=(int)(late/step_ts);
+	if (i>=RTP_JITTER_HISTOGRAM_SIZE) i=RTP_JITTER_HISTOGRAM_SIZE-1;
+	ctl->histogram[i]+=1;
+	ctl->histogram_total+=1;
+
+	if (ctl->count%50==0){
+		/* look for the smallest compensation with at most late_loss_rate packets later than it*/
+		max_late_count=ctl->histogram_total*ctl->late_loss_rate/100.0f;
+		late_count=0;
+		for(i=RTP_JITTER_HISTOGRAM_SIZE-1;i>0;i--){
+			late_count+=ctl->histogram[i];
+			if (late_count>max_late_count) break;
+		}
+		target=(i+1)*step_ts;
+		if (target<ctl->min_jitt_comp_ts) target=ctl->min_jitt_comp_ts;
+		if (ctl->max_jitt_comp_ts>=0 && target>ctl->max_jitt_comp_ts) target=ctl->max_jitt_comp_ts;
+		ctl->target_jitt_comp_ts=target;
+		for(i=0;i<RTP_JITTER_HISTOGRAM_SIZE;i++) ctl->histogram[i]*=JC_HISTOGRAM_FORGET;
+		ctl->histogram_total*=JC_HISTOGRAM_FORGET;
+		/* while packets flow, changes are made by small steps to be less audible */
+		if (!silence){
+			if (ctl->adapt_jitt_comp_ts<target)
+				ctl->adapt_jitt_comp_ts=MIN(target,ctl->adapt_jitt_comp_ts+ctl->corrective_step);
+			else
+				ctl->adapt_jitt_comp_ts=MAX(target,ctl->adapt_jitt_comp_ts-ctl->corrective_step);
+		}
+	}
+	/* the sender paused before this packet and the jitter buffer has drained: the new
+	compensation can be applied at once, nothing is being played */
+	if (silence) ctl->adapt_jitt_comp_ts=ctl->target_jitt_comp_ts;
+}
+
 /*
  The algorithm computes two values:
 	slide: an average of difference between the expected and the socket-received timestamp
@@ -92,11 +170,16 @@ void jitter_control_update_corrective_slide(JitterControl *ctl){
 	slide is used to make clock-slide detection and correction.
 	jitter is added to the initial jitt_comp_time value. It compensates bursty packets arrival (packets
 	not arriving at regular interval ).
+	It never goes beyond max_size when one is set.
+	When a late_loss_rate is set, the jitter compensation is instead taken from the histogram of
+	the lateness of the packets, see jitter_control_update_histogram().
+	marker is the marker bit of the packet, which is set on the first packet of a talkspurt.
 */
-void jitter_control_new_packet(JitterControl *ctl, uint32_t packet_ts, uint32_t cur_str_ts){
+void jitter_control_new_packet(JitterControl *ctl, uint32_t packet_ts, uint32_t cur_str_ts, bool_t marker){
 	int64_t diff=(int64_t)packet_ts - (int64_t)cur_str_ts;
 	double gap,slide;
 	int d;
+	bool_t silence;
 	//printf("diff=%g\n",diff);
 	if (ctl->count==0){
 		slide=ctl->slide=ctl->prev_slide=diff;
@@ -107,14 +190,26 @@ void jitter_control_new_packet(JitterControl *ctl, uint32_t packet_ts, uint32_t
 	}
 	gap=(double)diff - slide;
 	gap=gap<0 ? -gap : 0; /*compute only for late packets*/
+	/* no packet arrived for longer than the jitter buffer could play. This is a silence (DTX)
+	only if the sender stopped sending too: the packet starts a talkspurt or its timestamp jumps
+	over the gap. Otherwise the network stalled, and the packets are still to be played. */
+	silence=ctl->count>0 && (int32_t)(cur_str_ts-ctl->last_arrival_ts)>ctl->adapt_jitt_comp_ts+ctl->corrective_step
+		&& (marker || (int32_t)(packet_ts-ctl->last_packet_ts)>ctl->adapt_jitt_comp_ts+ctl->corrective_step);
+	ctl->last_arrival_ts=cur_str_ts;
+	ctl->last_packet_ts=packet_ts;
 	ctl->jitter=(float) ((ctl->jitter*(1-JC_GAMMA)) + (gap*JC_GAMMA));
 	d=diff-ctl->olddiff;
 	ctl->inter_jitter=(float) (ctl->inter_jitter+ (( (float)abs(d) - ctl->inter_jitter)*(1/16.0)));
 	ctl->olddiff=diff;
 	ctl->count++;
 	if (ctl->adaptive){
-		if (ctl->count%50==0) {
+		if (ctl->late_loss_rate>0){
+			jitter_control_update_histogram(ctl,gap,silence);
+		}else if (ctl->count%50==0) {
 			ctl->adapt_jitt_comp_ts=(int) MAX(ctl->jitt_comp_ts,2*ctl->jitter);
+			if (ctl->max_jitt_comp_ts>=0 && ctl->adapt_jitt_comp_ts>ctl->max_jitt_comp_ts)
+				ctl->adapt_jitt_comp_ts=MAX(ctl->jitt_comp_ts,ctl->max_jitt_comp_ts);
+			ctl->target_jitt_comp_ts=ctl->adapt_jitt_comp_ts;
 			//jitter_control_dump_stats(ctl);
 		}
 		
@@ -165,7 +260,9 @@ bool_t rtp_session_jitter_buffer_enabled(const RtpSession *session){
 }
 
 void rtp_session_set_jitter_buffer_params(RtpSession *session, const JBParameters *par){
-	/* FIXME min_size and max_size to be implemented */
+	/* max_size bounds both adaptation modes. When adapting on the average jitter, nom_size is
+	already the floor of the compensation, so min_size only matters to the histogram mode. */
+	jitter_control_set_histogram_params(&session->rtp.jittctl,par->min_size,par->max_size,par->late_loss_rate);
 	rtp_session_set_jitter_compensation(session,par->nom_size);
 	jitter_control_enable_adaptive(&session->rtp.jittctl,par->adaptive);
 	session->rtp.max_rq_size=par->max_packets;
@@ -173,10 +270,11 @@ void rtp_session_set_jitter_buffer_params(RtpSession *session, const JBParameter
 
 void rtp_session_get_jitter_buffer_params(RtpSession *session, JBParameters *par){
 	int nom_size=session->rtp.jittctl.jitt_comp;
-	par->min_size=nom_size;
+	par->min_size=session->rtp.jittctl.late_loss_rate>0 ? session->rtp.jittctl.min_size : nom_size;
 	par->nom_size=nom_size;
-	par->max_size=-1;
+	par->max_size=session->rtp.jittctl.max_size;
 	par->adaptive=session->rtp.jittctl.adaptive;
 	par->max_packets=session->rtp.max_rq_size;
+	par->late_loss_rate=session->rtp.jittctl.late_loss_rate;
 }
 
@@ -30,10 +30,12 @@
 
 void jitter_control_init(JitterControl *ctl, int base_jiitt_time, PayloadType *pt);
 void jitter_control_enable_adaptive(JitterControl *ctl, bool_t val);
-void jitter_control_new_packet(JitterControl *ctl, uint32_t packet_ts, uint32_t cur_str_ts);
+void jitter_control_new_packet(JitterControl *ctl, uint32_t packet_ts, uint32_t cur_str_ts, bool_t marker);
 #define jitter_control_adaptive_enabled(ctl) ((ctl)->adaptive)
 void jitter_control_set_payload(JitterControl *ctl, PayloadType *pt);
 void jitter_control_update_corrective_slide(JitterControl *ctl);
+void jitter_control_set_histogram_params(JitterControl *ctl, int min_size, int max_size, float late_loss_rate);
+void jitter_control_update_stats(JitterControl *ctl, jitter_stats_t *stats);
 
 static inline uint32_t jitter_control_get_compensated_timestamp(JitterControl *obj , uint32_t user_ts){
 	return (uint32_t)( (int64_t)user_ts+obj->slide-(int64_t)obj->adapt_jitt_comp_ts);
@@ -22,23 +22,79 @@
 #include "utils.h"
 #include "ortp/rtpsession.h"
 #include "rtpsession_priv.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
 static OrtpNetworkSimulatorCtx* simulator_ctx_new(void){
 	OrtpNetworkSimulatorCtx *ctx=(OrtpNetworkSimulatorCtx*)ortp_malloc0(sizeof(OrtpNetworkSimulatorCtx));
 	qinit(&ctx->q);
+	qinit(&ctx->latency_q);
 	return ctx;
 }
 
 void ortp_network_simulator_destroy(OrtpNetworkSimulatorCtx *sim){
 	flushq(&sim->q,0);
+	flushq(&sim->latency_q,0);
+	if (sim->trace) ortp_free(sim->trace);
 	ortp_free(sim);
 }
 
+/*
+ * The trace file has one line per received packet: the time in milliseconds at which it was received,
+ * followed by its delay in milliseconds, or -1 if it was lost. Lines starting with # are ignored.
+ * The trace is replayed in a loop, an entry for each packet, or with trace_by_time the entry of the
+ * time at which each packet arrives, which depends on the scheduling of the receiver.
+ */
+static int simulator_load_trace(OrtpNetworkSimulatorCtx *sim, const char *path){
+	FILE *f=fopen(path,"r");
+	char line[256];
+	int size=0;
+	if (f==NULL){
+		ortp_error("Cannot open network simulator trace file %s: %s",path,strerror(errno));
+		return -1;
+	}
+	if (sim->trace) ortp_free(sim->trace);
+	sim->trace=NULL;
+	sim->trace_count=0;
+	sim->trace_pos=0;
+	while(fgets(line,sizeof(line),f)!=NULL){
+		unsigned int time;
+		int delay;
+		if (line[0]=='#' || sscanf(line,"%u %i",&time,&delay)!=2) continue;
+		if (sim->trace_count==size){
+			size=size ? size*2 : 256;
+			sim->trace=(OrtpNetworkSimulatorTraceEntry*)ortp_realloc(sim->trace,size*sizeof(OrtpNetworkSimulatorTraceEntry));
+		}
+		sim->trace[sim->trace_count].time=time;
+		sim->trace[sim->trace_count].delay=delay;
+		sim->trace_count++;
+	}
+	fclose(f);
+	if (sim->trace_count==0){
+		ortp_error("Network simulator trace file %s contains no entry.",path);
+		return -1;
+	}
+	ortp_message("Network simulator replaying %i entries from %s",sim->trace_count,path);
+	return 0;
+}
+
 void rtp_session_enable_network_simulation(RtpSession *session, const OrtpNetworkSimulatorParams *params){
 	OrtpNetworkSimulatorCtx *sim=session->net_sim_ctx;
 	if (params->enabled){
 		if (sim==NULL) sim=simulator_ctx_new();
 		sim->params=*params;
+		/*the trace is loaded now, the path is not kept*/
+		sim->params.trace_file=NULL;
+		if (params->trace_file==NULL || simulator_load_trace(sim,params->trace_file)!=0){
+			if (sim->trace) ortp_free(sim->trace);
+			sim->trace=NULL;
+			sim->trace_count=0;
+		}
+		sim->rand_state=params->seed ? params->seed : (uint32_t)time(NULL);
+		sim->start.tv_sec=0;
 		session->net_sim_ctx=sim;
 	}else{
 		if (sim!=NULL) ortp_network_simulator_destroy(sim);
@@ -109,12 +165,167 @@ static mblk_t *simulate_bandwidth_limit(RtpSession *session, mblk_t *input){
 	return output;
 }
 
-mblk_t * rtp_session_network_simulate(RtpSession *session, mblk_t *input){
+/*xorshift generator, so that runs with the same seed are identical. Returns a number in [0,1[ */
+static float simulator_random(OrtpNetworkSimulatorCtx *sim){
+	uint32_t x=sim->rand_state;
+	x^=x<<13;
+	x^=x>>17;
+	x^=x<<5;
+	sim->rand_state=x;
+	return (float)((double)(x>>8)/(double)(1<<24));
+}
+
+/*returns TRUE with the given probability, in percent*/
+static bool_t simulator_chance(OrtpNetworkSimulatorCtx *sim, float percent){
+	return percent>0 && simulator_random(sim)*100<percent;
+}
+
+static bool_t simulate_loss(OrtpNetworkSimulatorCtx *sim){
+	OrtpNetworkSimulatorParams *p=&sim->params;
+	if (p->ge_good_to_bad>0){
+		/*Gilbert-Elliott: two states with their own loss probability*/
+		if (sim->ge_bad_state){
+			if (simulator_chance(sim,p->ge_bad_to_good)) sim->ge_bad_state=FALSE;
+		}else{
+			if (simulator_chance(sim,p->ge_good_to_bad)) sim->ge_bad_state=TRUE;
+		}
+		return simulator_chance(sim,sim->ge_bad_state ? p->ge_bad_loss : p->ge_good_loss);
+	}
+	return simulator_chance(sim,p->loss_rate);
+}
+
+/*returns the random part of the delay, in milliseconds*/
+static int simulate_jitter(OrtpNetworkSimulatorCtx *sim){
+	OrtpNetworkSimulatorParams *p=&sim->params;
+	double u,v,d;
+	if (p->jitter<=0) return 0;
+	switch(p->jitter_distribution){
+		case ORTP_JITTER_NORMAL:
+			/*Box-Muller*/
+			u=1.0-simulator_random(sim);
+			v=simulator_random(sim);
+			d=p->jitter+p->jitter*sqrt(-2*log(u))*cos(2*M_PI*v);
+		break;
+		case ORTP_JITTER_PARETO:
+			/*Lomax distribution of shape 3: its mean is scale/2*/
+			u=1.0-simulator_random(sim);
+			d=2*p->jitter*(pow(u,-1.0/3)-1);
+			if (d>10000) d=10000;
+		break;
+		default:
+			d=simulator_random(sim)*p->jitter;
+		break;
+	}
+	return d>0 ? (int)d : 0;
+}
+
+/*returns the delay of the next trace entry, or of the entry for the given time with trace_by_time,
+-1 if the packet is lost*/
+static int simulate_trace_delay(OrtpNetworkSimulatorCtx *sim, uint32_t now){
+	uint32_t duration,t;
+	if (!sim->params.trace_by_time){
+		int delay=sim->trace[sim->trace_pos].delay;
+		sim->trace_pos=(sim->trace_pos+1)%sim->trace_count;
+		return delay;
+	}
+	duration=sim->trace[sim->trace_count-1].time+1;
+	t=now%duration;
+	if (t<sim->trace[sim->trace_pos].time) sim->trace_pos=0; /*looped*/
+	while(sim->trace_pos+1<sim->trace_count && sim->trace[sim->trace_pos+1].time<=t)
+		sim->trace_pos++;
+	return sim->trace[sim->trace_pos].delay;
+}
+
+/*puts a packet in the latency queue, sorted by due time stored in reserved1*/
+static void latency_queue_put(OrtpNetworkSimulatorCtx *sim, mblk_t *mp, uint32_t due){
+	mblk_t *tmp;
+	mp->reserved1=due;
+	if (qempty(&sim->latency_q)){
+		putq(&sim->latency_q,mp);
+		return;
+	}
+	for(tmp=qlast(&sim->latency_q);!qend(&sim->latency_q,tmp);tmp=tmp->b_prev){
+		if ((int32_t)(due-tmp->reserved1)>=0){
+			insq(&sim->latency_q,tmp->b_next,mp);
+			return;
+		}
+	}
+	insq(&sim->latency_q,qfirst(&sim->latency_q),mp);
+}
+
+/*appends to output all the packets whose delay has expired*/
+static void simulate_latency(RtpSession *session, mblk_t *input, queue_t *output){
 	OrtpNetworkSimulatorCtx *sim=session->net_sim_ctx;
-	mblk_t *om=NULL;
-	if (sim->params.max_bandwidth>0){
-		om=simulate_bandwidth_limit(session,input);
+	OrtpNetworkSimulatorParams *p=&sim->params;
+	struct timeval current;
+	uint32_t now;
+	mblk_t *mp;
+
+	gettimeofday(&current,NULL);
+	if (sim->start.tv_sec==0){
+		sim->start=current;
+		sim->last_due=0;
+	}
+	now=(uint32_t)(elapsed_us(&sim->start,&current)/1000);
+	if (input){
+		int delay;
+		if (sim->trace){
+			delay=simulate_trace_delay(sim,now);
+		}else{
+			delay=simulate_loss(sim) ? -1 : p->latency+simulate_jitter(sim);
+		}
+		if (delay<0){
+			freemsg(input);
+		}else{
+			uint32_t due=now+delay;
+			if (sim->trace==NULL && simulator_chance(sim,p->reorder_rate)){
+				due+=p->reorder_delay;
+			}else{
+				/*the jitter does not reorder packets by itself*/
+				if ((int32_t)(due-sim->last_due)<0) due=sim->last_due;
+				sim->last_due=due;
+			}
+			if (simulator_chance(sim,p->duplicate_rate)){
+				/*the packet is modified in place when parsed, so make a real copy*/
+				latency_queue_put(sim,copymsg(input),due);
+			}
+			latency_queue_put(sim,input,due);
+		}
+	}
+	while((mp=qfirst(&sim->latency_q))!=NULL && (int32_t)(now-mp->reserved1)>=0){
+		mp=getq(&sim->latency_q);
+		mp->reserved1=0;
+		putq(output,mp);
 	}
-	return om;
 }
 
+/**
+ * Processes a received packet through the network simulator.
+ * It appends to output all the packets that are to be received now, which may not include the input one.
+ * It can be called with a NULL input to get the packets it holds.
+**/
+void rtp_session_network_simulate(RtpSession *session, mblk_t *input, queue_t *output){
+	OrtpNetworkSimulatorCtx *sim=session->net_sim_ctx;
+	OrtpNetworkSimulatorParams *p=&sim->params;
+	queue_t delayed;
+	mblk_t *om;
+
+	qinit(&delayed);
+	if (sim->trace || p->loss_rate>0 || p->ge_good_to_bad>0 || p->latency>0 || p->jitter>0
+		|| p->reorder_rate>0 || p->duplicate_rate>0){
+		simulate_latency(session,input,&delayed);
+	}else if (input){
+		putq(&delayed,input);
+	}
+	if (p->max_bandwidth>0){
+		while((om=getq(&delayed))!=NULL){
+			om=simulate_bandwidth_limit(session,om);
+			if (om) putq(output,om);
+		}
+		while((om=simulate_bandwidth_limit(session,NULL))!=NULL)
+			putq(output,om);
+	}else{
+		while((om=getq(&delayed))!=NULL)
+			putq(output,om);
+	}
+}
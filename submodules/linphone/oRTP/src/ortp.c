@@ -42,6 +42,7 @@ int ortp_allocations=0;
 #endif
 
 RtpScheduler *__ortp_scheduler;
+static RtpSchedulerGroup *__ortp_schedulers;
 
 
 
@@ -105,6 +106,17 @@ void ortp_init()
  *	
 **/
 void ortp_scheduler_init()
+{
+	ortp_scheduler_init_shards(1);
+}
+
+/**
+ *	Initialize the oRTP scheduler with @count scheduler threads, each pinned to a cpu.
+ *	The scheduled sessions are spread over the threads, so that a large number of them
+ *	can be processed on a multi-core machine. If @count is 0, one thread per cpu is started.
+ *	Like ortp_scheduler_init(), this must be called once at the beginning of the application.
+**/
+void ortp_scheduler_init_shards(int count)
 {
 	static bool_t initialized=FALSE;
 	if (initialized) return;
@@ -119,8 +131,11 @@ void ortp_scheduler_init()
 	sigprocmask(SIG_BLOCK,&set,NULL);
 #endif /* __hpux */
 
-	__ortp_scheduler=rtp_scheduler_new();
-	rtp_scheduler_start(__ortp_scheduler);
+	__ortp_schedulers=rtp_scheduler_group_new(count);
+	rtp_scheduler_group_start(__ortp_schedulers);
+	__ortp_scheduler=__ortp_schedulers->shards[0];
+	if (__ortp_schedulers->count>1)
+		ortp_message("oRTP scheduler running with %i threads.",__ortp_schedulers->count);
 	//sleep(1);
 }
 
@@ -131,11 +146,13 @@ void ortp_scheduler_init()
 **/
 void ortp_exit()
 {
-	if (__ortp_scheduler!=NULL)
+	if (__ortp_schedulers!=NULL)
 	{
-		rtp_scheduler_destroy(__ortp_scheduler);
+		rtp_scheduler_group_destroy(__ortp_schedulers);
+		__ortp_schedulers=NULL;
 		__ortp_scheduler=NULL;
 	}
+	msgb_pool_flush();
 }
 
 RtpScheduler * ortp_get_scheduler()
@@ -145,6 +162,13 @@ RtpScheduler * ortp_get_scheduler()
 	return __ortp_scheduler;
 }
 
+RtpSchedulerGroup * ortp_get_scheduler_group()
+{
+	if (__ortp_schedulers==NULL) ortp_error("Cannot use the scheduled mode: the scheduler is not "
+									"started. Call ortp_scheduler_init() at the begginning of the application.");
+	return __ortp_schedulers;
+}
+
 
 static FILE *__log_file=0;
 
@@ -17,6 +17,10 @@
   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#if defined(__linux) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /*for recvmmsg() and sendmmsg()*/
+#endif
+
 #if defined(_MSC_VER)  && (defined(WIN32) || defined(_WIN32_WCE))
 #include "ortp-config-win32.h"
 #elif HAVE_CONFIG_H
@@ -24,6 +28,11 @@
 #endif
 #include "ortp/ortp.h"
 
+#if defined(HAVE_SYS_UIO_H) && defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+#include <sys/uio.h>
+#define USE_MMSG 1
+#endif
+
 #undef PACKAGE_NAME 
 #undef PACKAGE_STRING
 #undef PACKAGE_TARNAME 
@@ -34,13 +43,14 @@
 
 #include "ortp/b64.h"
 
-#define SRTP_PAD_BYTES 64 /*?? */
+/*room needed after the packet for srtp to append its authentication tag, and the index for srtcp*/
+#define SRTP_PAD_BYTES (SRTP_MAX_TRAILER_LEN+4)
 
 static int  srtp_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
 	srtp_t srtp=(srtp_t)t->data;
 	int slen;
 	err_status_t err;
-	/* enlarge the buffer for srtp to write its data */
+	/* enlarge the buffer for srtp to write its data, packets made with room for it are protected in place */
 	msgpullup(m,msgdsize(m)+SRTP_PAD_BYTES);
 	slen=m->b_wptr-m->b_rptr;
 	err=srtp_protect(srtp,m->b_rptr,&slen);
@@ -55,7 +65,8 @@ static int srtp_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr
 	srtp_t srtp=(srtp_t)t->data;
 	int err;
 	int slen;
-	err=recvfrom(t->session->rtp.socket,(void*)m->b_wptr,m->b_datap->db_lim-m->b_datap->db_base,flags,from,fromlen);
+	/* the packet is read and unprotected in place */
+	err=recvfrom(t->session->rtp.socket,(void*)m->b_wptr,m->b_datap->db_lim-m->b_wptr,flags,from,fromlen);
 	if (err>0){
 		err_status_t srtp_err;
 		/* keep NON-RTP data unencrypted */
@@ -81,11 +92,110 @@ static int srtp_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr
 	return err;
 }
 
+#ifdef USE_MMSG
+/*protects the packets with a single srtp_protect_batch() call, and sends them with as few sendmmsg() calls as possible.
+ Used when the session has an io batch size greater than one, as the video streams of mediastreamer2 do.*/
+static void srtp_sendto_batch(RtpTransport *t, mblk_t **msgs, int *results, int count, int flags, const struct sockaddr *to, socklen_t tolen){
+	srtp_t srtp=(srtp_t)t->data;
+	ortp_socket_t sockfd=t->session->rtp.socket;
+	struct mmsghdr hdrs[RTP_IO_BATCH_MAX];
+	struct iovec iov[RTP_IO_BATCH_MAX];
+	int index[RTP_IO_BATCH_MAX];
+	void *pkts[RTP_IO_BATCH_MAX];
+	int lens[RTP_IO_BATCH_MAX];
+	err_status_t status[RTP_IO_BATCH_MAX];
+	int i,n=0,done=0;
+
+	for(i=0;i<count;i++){
+		mblk_t *m=msgs[i];
+		msgpullup(m,msgdsize(m)+SRTP_PAD_BYTES);
+		pkts[i]=m->b_rptr;
+		lens[i]=m->b_wptr-m->b_rptr;
+	}
+	srtp_protect_batch(srtp,pkts,lens,status,count);
+	for(i=0;i<count;i++){
+		if (status[i]!=err_status_ok){
+			ortp_error("srtp_protect() failed (%d)", status[i]);
+			results[i]=-1;
+			continue;
+		}
+		iov[n].iov_base=pkts[i];
+		iov[n].iov_len=lens[i];
+		memset(&hdrs[n],0,sizeof(hdrs[n]));
+		hdrs[n].msg_hdr.msg_name=(void*)to;
+		hdrs[n].msg_hdr.msg_namelen=tolen;
+		hdrs[n].msg_hdr.msg_iov=&iov[n];
+		hdrs[n].msg_hdr.msg_iovlen=1;
+		index[n++]=i;
+	}
+	while(done<n){
+		int sent=sendmmsg(sockfd,hdrs+done,n-done,flags);
+		if (sent<=0){
+			/*the packet that could not be sent is skipped, as sendto() would have done*/
+			if (getSocketErrorCode()==ENOSYS)
+				sent=sendto(sockfd,iov[done].iov_base,iov[done].iov_len,flags,to,tolen);
+			results[index[done++]]=sent;
+			continue;
+		}
+		for(i=done;i<done+sent;i++) results[index[i]]=hdrs[i].msg_len;
+		done+=sent;
+	}
+}
+
+/*reads the datagrams with a single recvmmsg() call, and unprotects them with a single srtp_unprotect_batch() call*/
+static int srtp_recvfrom_batch(RtpTransport *t, mblk_t **msgs, int *results, int count, int flags, struct sockaddr **from, socklen_t *fromlen){
+	srtp_t srtp=(srtp_t)t->data;
+	struct mmsghdr hdrs[RTP_IO_BATCH_MAX];
+	struct iovec iov[RTP_IO_BATCH_MAX];
+	int index[RTP_IO_BATCH_MAX];
+	void *pkts[RTP_IO_BATCH_MAX];
+	int lens[RTP_IO_BATCH_MAX];
+	err_status_t status[RTP_IO_BATCH_MAX];
+	int i,n,nsrtp=0;
+
+	for(i=0;i<count;i++){
+		mblk_t *m=msgs[i];
+		iov[i].iov_base=m->b_wptr;
+		iov[i].iov_len=m->b_datap->db_lim-m->b_wptr;
+		memset(&hdrs[i],0,sizeof(hdrs[i]));
+		hdrs[i].msg_hdr.msg_name=from[i];
+		hdrs[i].msg_hdr.msg_namelen=fromlen[i];
+		hdrs[i].msg_hdr.msg_iov=&iov[i];
+		hdrs[i].msg_hdr.msg_iovlen=1;
+	}
+	n=recvmmsg(t->session->rtp.socket,hdrs,count,flags,NULL);
+	if (n<=0) return n;
+	for(i=0;i<n;i++){
+		rtp_header_t *rtp=(rtp_header_t*)msgs[i]->b_wptr;
+		results[i]=hdrs[i].msg_len;
+		fromlen[i]=hdrs[i].msg_hdr.msg_namelen;
+		/* keep NON-RTP data unencrypted */
+		if (results[i]>=RTP_FIXED_HEADER_SIZE && rtp->version!=2)
+			continue;
+		if (results[i]>0){
+			pkts[nsrtp]=msgs[i]->b_wptr;
+			lens[nsrtp]=results[i];
+			index[nsrtp++]=i;
+		}
+	}
+	srtp_unprotect_batch(srtp,pkts,lens,status,nsrtp);
+	for(i=0;i<nsrtp;i++){
+		if (status[i]==err_status_ok){
+			results[index[i]]=lens[i];
+		}else{
+			ortp_error("srtp_unprotect() failed (%d)", status[i]);
+			results[index[i]]=-1;
+		}
+	}
+	return n;
+}
+#endif
+
 static int  srtcp_sendto(RtpTransport *t, mblk_t *m, int flags, const struct sockaddr *to, socklen_t tolen){
 	srtp_t srtp=(srtp_t)t->data;
 	int slen;
 	err_status_t srtp_err;
-	/* enlarge the buffer for srtp to write its data */
+	/* enlarge the buffer for srtp to write its data, packets made with room for it are protected in place */
 	msgpullup(m,msgdsize(m)+SRTP_PAD_BYTES);
 	slen=m->b_wptr-m->b_rptr;
 	srtp_err=srtp_protect_rtcp(srtp,m->b_rptr,&slen);
@@ -100,7 +210,7 @@ static int srtcp_recvfrom(RtpTransport *t, mblk_t *m, int flags, struct sockaddr
 	srtp_t srtp=(srtp_t)t->data;
 	int err;
 	int slen;
-	err=recvfrom(t->session->rtcp.socket,(void*)m->b_wptr,m->b_datap->db_lim-m->b_datap->db_base,flags,from,fromlen);
+	err=recvfrom(t->session->rtcp.socket,(void*)m->b_wptr,m->b_datap->db_lim-m->b_wptr,flags,from,fromlen);
 	if (err>0){
 		err_status_t srtp_err;
 		slen=err;
@@ -142,6 +252,10 @@ int srtp_transport_new(srtp_t srtp, RtpTransport **rtpt, RtpTransport **rtcpt ){
 		(*rtpt)->t_getsocket=srtp_getsocket;
 		(*rtpt)->t_sendto=srtp_sendto;
 		(*rtpt)->t_recvfrom=srtp_recvfrom;
+#ifdef USE_MMSG
+		(*rtpt)->t_sendto_batch=srtp_sendto_batch;
+		(*rtpt)->t_recvfrom_batch=srtp_recvfrom_batch;
+#endif
 	}
 	if (rtcpt) {
 		(*rtcpt)=ortp_new0(RtpTransport,1);
@@ -202,6 +316,14 @@ static bool_t ortp_init_srtp_policy(srtp_t srtp, srtp_policy_t* policy, enum ort
 			crypto_policy_set_null_cipher_hmac_sha1_80(&policy->rtp);
 			crypto_policy_set_null_cipher_hmac_sha1_80(&policy->rtcp);
 			break;
+		case AEAD_AES_128_GCM:
+			crypto_policy_set_aes_gcm_128_16_auth(&policy->rtp);
+			crypto_policy_set_aes_gcm_128_16_auth(&policy->rtcp);
+			break;
+		case AEAD_AES_256_GCM:
+			crypto_policy_set_aes_gcm_256_16_auth(&policy->rtp);
+			crypto_policy_set_aes_gcm_256_16_auth(&policy->rtcp);
+			break;
 		case AES_128_SHA1_80: /*default mode*/
 		default:
 			crypto_policy_set_rtp_default(&policy->rtp);
@@ -37,43 +37,49 @@
 #include <unistd.h>
 
 
-static struct timeval orig,cur;
-static uint32_t posix_timer_time=0;		/*in milisecond */
+static PosixTimerClock posix_clock;
 
-void posix_timer_init()
+void posix_timer_clock_init(PosixTimerClock *clock, const struct timeval *orig)
 {
-	posix_timer.state=RTP_TIMER_RUNNING;
-	gettimeofday(&orig,NULL);
-	posix_timer_time=0;
+	clock->orig=*orig;
+	clock->time=0;
 }
 
-
-
-
-void posix_timer_do()
+/* sleeps until interval_ms after the previous tick of the clock */
+void posix_timer_clock_wait(PosixTimerClock *clock, uint32_t interval_ms)
 {
 	int diff,time;
-	struct timeval tv;
+	struct timeval tv,cur;
 	gettimeofday(&cur,NULL);
-	time=((cur.tv_usec-orig.tv_usec)/1000 ) + ((cur.tv_sec-orig.tv_sec)*1000 );
-	if ( (diff=time-posix_timer_time)>50){
+	time=((cur.tv_usec-clock->orig.tv_usec)/1000 ) + ((cur.tv_sec-clock->orig.tv_sec)*1000 );
+	if ( (diff=time-clock->time)>50){
 		ortp_warning("Must catchup %i miliseconds.",diff);
 	}
-	while((diff = posix_timer_time-time) > 0)
+	while((diff = clock->time-time) > 0)
 	{
 		tv.tv_sec = diff/1000;
 		tv.tv_usec = (diff%1000)*1000;
-#if	defined(_WIN32) || defined(_WIN32_WCE)
-        /* this kind of select is not supported on windows */
-		Sleep(tv.tv_usec/1000 + tv.tv_sec * 1000);
-#else
 		select(0,NULL,NULL,NULL,&tv);
-#endif
 		gettimeofday(&cur,NULL);
-		time=((cur.tv_usec-orig.tv_usec)/1000 ) + ((cur.tv_sec-orig.tv_sec)*1000 );
+		time=((cur.tv_usec-clock->orig.tv_usec)/1000 ) + ((cur.tv_sec-clock->orig.tv_sec)*1000 );
 	}
-	posix_timer_time+=POSIXTIMER_INTERVAL/1000;
-	
+	clock->time+=interval_ms;
+}
+
+void posix_timer_init()
+{
+	struct timeval orig;
+	posix_timer.state=RTP_TIMER_RUNNING;
+	gettimeofday(&orig,NULL);
+	posix_timer_clock_init(&posix_clock,&orig);
+}
+
+
+
+
+void posix_timer_do()
+{
+	posix_timer_clock_wait(&posix_clock,POSIXTIMER_INTERVAL/1000);
 }
 
 void posix_timer_uninit()
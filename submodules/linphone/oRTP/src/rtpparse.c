@@ -23,9 +23,8 @@
 #include "utils.h"
 #include "rtpsession_priv.h"
 
-static void queue_packet(queue_t *q, int maxrqsz, mblk_t *mp, rtp_header_t *rtp, int *discarded)
+static void queue_packet(RtpJitterQueue *q, int maxrqsz, mblk_t *mp, rtp_header_t *rtp, int *discarded)
 {
-	mblk_t *tmp;
 	int header_size;
 	*discarded=0;
 	header_size=RTP_FIXED_HEADER_SIZE+ (4*rtp->cc);
@@ -35,21 +34,9 @@ static void queue_packet(queue_t *q, int maxrqsz, mblk_t *mp, rtp_header_t *rtp,
 		freemsg(mp);
 		return;
 	}
-	/* and then add the packet to the queue */
-	
-	rtp_putq(q,mp);
-	/* make some checks: q size must not exceed RtpStream::max_rq_size */
-	while (q->q_mcount > maxrqsz)
-	{
-		/* remove the oldest mblk_t */
-		tmp=getq(q);
-		if (mp!=NULL)
-		{
-			ortp_debug("rtp_putq: Queue is full. Discarding message with ts=%i",((rtp_header_t*)mp->b_rptr)->timestamp);
-			freemsg(tmp);
-			(*discarded)++;
-		}
-	}
+	/* and then add the packet to the queue, the oldest packets are dropped if
+	it exceeds RtpStream::max_rq_size */
+	*discarded=rtp_jitter_queue_put(q,mp,maxrqsz);
 }
 
 void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_ts, struct sockaddr *addr, socklen_t addrlen)
@@ -204,7 +191,8 @@ void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_t
 		rtp_session_update_payload_type(session,rtp->paytype);
 	}
 	
-	jitter_control_new_packet(&session->rtp.jittctl,rtp->timestamp,local_str_ts);
+	jitter_control_new_packet(&session->rtp.jittctl,rtp->timestamp,local_str_ts,rtp->markbit);
+	jitter_control_update_stats(&session->rtp.jittctl,&session->rtp.jitter_stats);
 
 	if (session->flags & RTP_SESSION_FIRST_PACKET_DELIVERED) {
 		/* detect timestamp important jumps in the future, to workaround stupid rtp senders */
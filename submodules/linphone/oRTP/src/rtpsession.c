@@ -103,68 +103,179 @@ static uint32_t uint32_t_random(){
 #define RTP_SEQ_IS_GREATER(seq1,seq2)\
 	((uint16_t)((uint16_t)(seq1) - (uint16_t)(seq2))< (uint16_t)(1<<15))
 
-/* put an rtp packet in queue. It is called by rtp_parse()*/
-void rtp_putq(queue_t *q, mblk_t *mp)
+/* the ring never spans more than half of the sequence number space, so that
+ RTP_SEQ_IS_GREATER() is meaningful between any two packets of the queue */
+#define RTP_JITTER_QUEUE_MIN_SIZE 16
+#define RTP_JITTER_QUEUE_MAX_SIZE (1<<15)
+
+#define rtp_jitter_queue_slot(q,seq) ((q)->slots[(seq) & ((q)->size-1)])
+
+void rtp_jitter_queue_init(RtpJitterQueue *q)
 {
-	mblk_t *tmp;
-	rtp_header_t *rtp=(rtp_header_t*)mp->b_rptr,*tmprtp;
-	/* insert message block by increasing time stamp order : the last (at the bottom)
-		message of the queue is the newest*/
-	ortp_debug("rtp_putq(): Enqueuing packet with ts=%i and seq=%i",rtp->timestamp,rtp->seq_number);
-	
-	if (qempty(q)) {
-		putq(q,mp);
-		return;
+	memset(q,0,sizeof(RtpJitterQueue));
+}
+
+static void rtp_jitter_queue_drop_all(RtpJitterQueue *q)
+{
+	mblk_t *mp;
+	while((mp=rtp_jitter_queue_pop(q))!=NULL)
+		freemsg(mp);
+}
+
+/* empties the queue and releases the ring: the next packet allocates it again from
+the max_packets value of that time */
+void rtp_jitter_queue_flush(RtpJitterQueue *q)
+{
+	rtp_jitter_queue_drop_all(q);
+	if (q->slots!=NULL) ortp_free(q->slots);
+	rtp_jitter_queue_init(q);
+}
+
+void rtp_jitter_queue_uninit(RtpJitterQueue *q)
+{
+	rtp_jitter_queue_flush(q);
+}
+
+/* the ring has room for max_packets and as many losses between them */
+static int rtp_jitter_queue_size_for(int max_packets)
+{
+	int size=RTP_JITTER_QUEUE_MIN_SIZE;
+	while(size<2*max_packets && size<RTP_JITTER_QUEUE_MAX_SIZE) size*=2;
+	return size;
+}
+
+/* grows the ring to size slots, keeping the queued packets */
+static void rtp_jitter_queue_resize(RtpJitterQueue *q, int size)
+{
+	mblk_t **slots;
+	uint16_t seq;
+	slots=ortp_new0(mblk_t*,size);
+	for(seq=q->head;q->count>0 && seq!=q->tail;seq++){
+		slots[seq & (size-1)]=rtp_jitter_queue_slot(q,seq);
 	}
-	tmp=qlast(q);
-	/* we look at the queue from bottom to top, because enqueued packets have a better chance
-	to be enqueued at the bottom, since there are surely newer */
-	while (!qend(q,tmp))
-	{
-		tmprtp=(rtp_header_t*)tmp->b_rptr;
-		ortp_debug("rtp_putq(): Seeing packet with seq=%i",tmprtp->seq_number);
-		
- 		if (rtp->seq_number == tmprtp->seq_number)
- 		{
- 			/* this is a duplicated packet. Don't queue it */
- 			ortp_debug("rtp_putq: duplicated message.");
- 			freemsg(mp);
- 			return;
-		}else if (RTP_SEQ_IS_GREATER(rtp->seq_number,tmprtp->seq_number)){
-			
-			insq(q,tmp->b_next,mp);
-			return;
- 		}
-		tmp=tmp->b_prev;
+	if (q->slots!=NULL) ortp_free(q->slots);
+	q->slots=slots;
+	q->size=size;
+}
+
+/**
+ * Returns the oldest packet of the queue without removing it, or NULL if it is empty.
+**/
+mblk_t *rtp_jitter_queue_peek(RtpJitterQueue *q)
+{
+	if (q->count==0) return NULL;
+	/* skip the slots of the lost packets */
+	while(rtp_jitter_queue_slot(q,q->head)==NULL) q->head++;
+	return rtp_jitter_queue_slot(q,q->head);
+}
+
+/**
+ * Removes and returns the oldest packet of the queue, or NULL if it is empty.
+**/
+mblk_t *rtp_jitter_queue_pop(RtpJitterQueue *q)
+{
+	mblk_t *mp=rtp_jitter_queue_peek(q);
+	if (mp!=NULL){
+		rtp_jitter_queue_slot(q,q->head)=NULL;
+		q->head++;
+		q->count--;
 	}
-	/* this packet is the oldest, it has to be 
-	placed on top of the queue */
-	insq(q,qfirst(q),mp);
-	
+	return mp;
 }
 
+/**
+ * Returns the packet with the given sequence number if it is in the queue, without removing it.
+**/
+mblk_t *rtp_jitter_queue_find(RtpJitterQueue *q, uint16_t seq)
+{
+	if (q->count==0 || (uint16_t)(seq-q->head)>=(uint16_t)(q->tail-q->head)) return NULL;
+	return rtp_jitter_queue_slot(q,seq);
+}
 
+/**
+ * Puts an rtp packet in the queue. It is called by rtp_parse().
+ * Duplicated packets are dropped. When there are more than max_packets in the queue the
+ * oldest packets are dropped. The ring has room for 2*max_packets consecutive sequence
+ * numbers: the queued packets that are too old for a new packet are dropped, all of them
+ * if it jumps ahead of the whole ring, which is a resync; a packet older than the ring
+ * is dropped.
+ *
+ * @return the number of discarded packets.
+**/
+int rtp_jitter_queue_put(RtpJitterQueue *q, mblk_t *mp, int max_packets)
+{
+	rtp_header_t *rtp=(rtp_header_t*)mp->b_rptr;
+	uint16_t seq=rtp->seq_number;
+	int size=rtp_jitter_queue_size_for(max_packets);
+	int discarded=0;
+
+	ortp_debug("rtp_jitter_queue_put(): Enqueuing packet with ts=%i and seq=%i",rtp->timestamp,rtp->seq_number);
+	/* a smaller max_packets only shrinks the ring at the next flush */
+	if (q->size<size)
+		rtp_jitter_queue_resize(q,size);
+	if (q->count==0){
+		q->head=seq;
+		q->tail=seq+1;
+	}else if (RTP_SEQ_IS_GREATER(seq,q->tail)){
+		if ((uint16_t)(seq-q->tail)>=(uint16_t)q->size){
+			/* the sequence numbers jumped ahead of the whole ring */
+			ortp_debug("rtp_jitter_queue_put: Packet too far. Discarding all queued messages.");
+			discarded+=q->count;
+			rtp_jitter_queue_drop_all(q);
+		}
+		/* the distance is measured from the oldest packet, rtp_jitter_queue_peek()
+		moves the head to it. Drop the oldest ones that are out of the ring */
+		while(rtp_jitter_queue_peek(q)!=NULL && (uint16_t)(seq-q->head)>=(uint16_t)q->size){
+			ortp_debug("rtp_jitter_queue_put: Packet too far. Discarding oldest message.");
+			freemsg(rtp_jitter_queue_pop(q));
+			discarded++;
+		}
+		if (q->count==0) q->head=seq;
+		q->tail=seq+1;
+	}else if (!RTP_SEQ_IS_GREATER(seq,q->head)){
+		/* this packet is the oldest */
+		if ((uint16_t)(q->tail-seq)>(uint16_t)q->size){
+			ortp_debug("rtp_jitter_queue_put: Packet too old. Discarding message with seq=%i",seq);
+			freemsg(mp);
+			return discarded+1;
+		}
+		q->head=seq;
+	}else if (rtp_jitter_queue_slot(q,seq)!=NULL){
+		/* this is a duplicated packet. Don't queue it */
+		ortp_debug("rtp_jitter_queue_put: duplicated message.");
+		freemsg(mp);
+		return discarded;
+	}
+	rtp_jitter_queue_slot(q,seq)=mp;
+	q->count++;
+	/* make some checks: q size must not exceed max_packets */
+	while(q->count>max_packets){
+		ortp_debug("rtp_jitter_queue_put: Queue is full. Discarding oldest message.");
+		freemsg(rtp_jitter_queue_pop(q));
+		discarded++;
+	}
+	return discarded;
+}
 
-mblk_t *rtp_getq(queue_t *q,uint32_t timestamp, int *rejected)
+/**
+ * Returns the newest packet whose timestamp is older or equal than the asked timestamp.
+ * Packets that are even older are discarded, and counted in rejected.
+**/
+mblk_t *rtp_jitter_queue_get(RtpJitterQueue *q,uint32_t timestamp, int *rejected)
 {
 	mblk_t *tmp,*ret=NULL,*old=NULL;
 	rtp_header_t *tmprtp;
 	uint32_t ts_found=0;
 	
 	*rejected=0;
-	ortp_debug("rtp_getq(): Timestamp %i wanted.",timestamp);
+	ortp_debug("rtp_jitter_queue_get(): Timestamp %i wanted.",timestamp);
 
-	if (qempty(q))
-	{
-		/*ortp_debug("rtp_getq: q is empty.");*/
-		return NULL;
-	}
 	/* return the packet with ts just equal or older than the asked timestamp */
 	/* packets with older timestamps are discarded */
-	while ((tmp=qfirst(q))!=NULL)
+	while ((tmp=rtp_jitter_queue_peek(q))!=NULL)
 	{
 		tmprtp=(rtp_header_t*)tmp->b_rptr;
-		ortp_debug("rtp_getq: Seeing packet with ts=%i",tmprtp->timestamp);
+		ortp_debug("rtp_jitter_queue_get: Seeing packet with ts=%i",tmprtp->timestamp);
 		if ( RTP_TIMESTAMP_IS_NEWER_THAN(timestamp,tmprtp->timestamp) )
 		{
 			if (ret!=NULL && tmprtp->timestamp==ts_found) {
@@ -172,13 +283,13 @@ mblk_t *rtp_getq(queue_t *q,uint32_t timestamp, int *rejected)
 				break;
 			}
 			if (old!=NULL) {
-				ortp_debug("rtp_getq: discarding too old packet with ts=%i",ts_found);
+				ortp_debug("rtp_jitter_queue_get: discarding too old packet with ts=%i",ts_found);
 				(*rejected)++;
 				freemsg(old);
 			}
-			ret=getq(q); /* dequeue the packet, since it has an interesting timestamp*/
+			ret=rtp_jitter_queue_pop(q); /* dequeue the packet, since it has an interesting timestamp*/
 			ts_found=tmprtp->timestamp;
-			ortp_debug("rtp_getq: Found packet with ts=%i",tmprtp->timestamp);
+			ortp_debug("rtp_jitter_queue_get: Found packet with ts=%i",tmprtp->timestamp);
 			old=ret;
 		}
 		else
@@ -189,28 +300,29 @@ mblk_t *rtp_getq(queue_t *q,uint32_t timestamp, int *rejected)
 	return ret;
 }
 
-mblk_t *rtp_getq_permissive(queue_t *q,uint32_t timestamp, int *rejected)
+/**
+ * Returns the oldest packet, provided that its timestamp is older or equal than the asked timestamp.
+**/
+mblk_t *rtp_jitter_queue_get_permissive(RtpJitterQueue *q,uint32_t timestamp, int *rejected)
 {
 	mblk_t *tmp,*ret=NULL;
 	rtp_header_t *tmprtp;
 	
 	*rejected=0;
-	ortp_debug("rtp_getq_permissive(): Timestamp %i wanted.",timestamp);
+	ortp_debug("rtp_jitter_queue_get_permissive(): Timestamp %i wanted.",timestamp);
 
-	if (qempty(q))
+	if ((tmp=rtp_jitter_queue_peek(q))==NULL)
 	{
-		/*ortp_debug("rtp_getq: q is empty.");*/
 		return NULL;
 	}
 	/* return the packet with the older timestamp (provided that it is older than
 	the asked timestamp) */
-	tmp=qfirst(q);
 	tmprtp=(rtp_header_t*)tmp->b_rptr;
-	ortp_debug("rtp_getq_permissive: Seeing packet with ts=%i",tmprtp->timestamp);
+	ortp_debug("rtp_jitter_queue_get_permissive: Seeing packet with ts=%i",tmprtp->timestamp);
 	if ( RTP_TIMESTAMP_IS_NEWER_THAN(timestamp,tmprtp->timestamp) )
 	{
-		ret=getq(q); /* dequeue the packet, since it has an interesting timestamp*/
-		ortp_debug("rtp_getq_permissive: Found packet with ts=%i",tmprtp->timestamp);
+		ret=rtp_jitter_queue_pop(q); /* dequeue the packet, since it has an interesting timestamp*/
+		ortp_debug("rtp_jitter_queue_get_permissive: Found packet with ts=%i",tmprtp->timestamp);
 	}
 	return ret;
 }
@@ -246,6 +358,8 @@ rtp_session_init (RtpSession * session, int mode)
 	rtp_session_set_profile (session, &av_profile); /*the default profile to work with */
 	session->rtp.socket=-1;
 	session->rtcp.socket=-1;
+	session->sched_fd=-1;
+	session->sched_wakeup=-1;
 #ifndef WIN32
 	session->rtp.snd_socket_size=0;	/*use OS default value unless on windows where they are definitely too short*/
 	session->rtp.rcv_socket_size=0;
@@ -256,8 +370,8 @@ rtp_session_init (RtpSession * session, int mode)
 	session->dscp=RTP_DEFAULT_DSCP;
 	session->multicast_ttl=RTP_DEFAULT_MULTICAST_TTL;
 	session->multicast_loopback=RTP_DEFAULT_MULTICAST_LOOPBACK;
-	qinit(&session->rtp.rq);
-	qinit(&session->rtp.tev_rq);
+	rtp_jitter_queue_init(&session->rtp.rq);
+	rtp_jitter_queue_init(&session->rtp.tev_rq);
 	qinit(&session->contributing_sources);
 	session->eventqs=NULL;
 	/* init signal tables */
@@ -280,12 +394,14 @@ rtp_session_init (RtpSession * session, int mode)
 	jbp.max_size=-1;
 	jbp.max_packets= 100;/* maximum number of packet allowed to be queued */
 	jbp.adaptive=TRUE;
+	jbp.late_loss_rate=0.0f;
 	rtp_session_enable_jitter_buffer(session,TRUE);
 	rtp_session_set_jitter_buffer_params(session,&jbp);
 	rtp_session_set_time_jump_limit(session,5000);
 	rtp_session_enable_rtcp(session,TRUE);
 	rtp_session_set_rtcp_report_interval(session,RTCP_DEFAULT_REPORT_INTERVAL);
 	session->recv_buf_size = UDP_MAX_SIZE;
+	session->rtp.io_batch_size = 1;
 	session->symmetric_rtp = FALSE;
 	session->permissive=FALSE;
 	msgb_allocator_init(&session->allocator);
@@ -333,13 +449,17 @@ rtp_session_set_scheduling_mode (RtpSession * session, int yesno)
 {
 	if (yesno)
 	{
-		RtpScheduler *sched;
-		sched = ortp_get_scheduler ();
-		if (sched != NULL)
+		RtpSchedulerGroup *group;
+		group = ortp_get_scheduler_group ();
+		if (group != NULL)
 		{
+			/* the session goes to the least loaded scheduler thread */
+			RtpScheduler *sched = (session->flags & RTP_SESSION_IN_SCHEDULER) ?
+				session->sched : rtp_scheduler_group_pick (group);
 			rtp_session_set_flag (session, RTP_SESSION_SCHEDULED);
 			session->sched = sched;
-			rtp_scheduler_add_session (sched, session);
+			if (rtp_scheduler_add_session (sched, session) != 0)
+				rtp_session_unset_flag (session, RTP_SESSION_SCHEDULED);
 		}
 		else
 			ortp_warning
@@ -351,6 +471,27 @@ rtp_session_set_scheduling_mode (RtpSession * session, int yesno)
 }
 
 
+/**
+ *	When enabled on a scheduled session, the arrival of data on the rtp socket makes
+ *	the session ready for receiving in session_set_select(), without waiting for the
+ *	time of the last timestamp queried by rtp_session_recvm_with_ts().
+ *	This is useful for applications that process incoming packets as soon as they
+ *	arrive, like relays. It requires epoll support from the system.
+ *
+ *  @param session a rtp session
+ *  @param yesno a boolean
+**/
+void rtp_session_enable_wakeup_on_data(RtpSession *session, bool_t yesno){
+	if (yesno){
+		rtp_session_set_flag(session,RTP_SESSION_WAKEUP_ON_DATA);
+		if (session->flags & RTP_SESSION_IN_SCHEDULER){
+			rtp_scheduler_lock(session->sched);
+			rtp_scheduler_watch_socket(session->sched,session);
+			rtp_scheduler_unlock(session->sched);
+		}
+	}else rtp_session_unset_flag(session,RTP_SESSION_WAKEUP_ON_DATA);
+}
+
 /**
  *	This function implicitely enables the scheduling mode if yesno is TRUE.
  *	rtp_session_set_blocking_mode() defines the behaviour of the rtp_session_recv_with_ts() and 
@@ -748,7 +889,8 @@ mblk_t * rtp_session_create_packet(RtpSession *session,int header_size, const ui
 	int msglen=header_size+payload_size;
 	rtp_header_t *rtp;
 	
-	mp=allocb(msglen,BPRI_MED);
+	/*leave room for srtp to append its authentication tag in place*/
+	mp=allocb(msglen+RTP_PACKET_TAILROOM,BPRI_MED);
 	rtp=(rtp_header_t*)mp->b_rptr;
 	rtp_header_init_from_session(rtp,session);
 	/*copy the payload, if any */
@@ -795,6 +937,33 @@ mblk_t * rtp_session_create_packet_with_data(RtpSession *session, uint8_t *paylo
 }
 
 
+/**
+ * Makes a rtp packet of a payload, writing the rtp header in the room left before the payload data
+ * when it has been allocated with rtp_payload_allocb(), so that the packet is sent from a single buffer.
+ * Otherwise the header is allocated separately and the payload is linked to it (no copy either).
+ * In the header, ssrc and payload_type are set according to the session's context.
+ * Timestamp and seq number are set when the packet is sent with rtp_session_sendm_with_ts().
+ *
+ * @param session a rtp session.
+ * @param payload the payload, owned by the returned packet.
+ * @return a rtp packet in a mblk_t (message block) structure.
+**/
+mblk_t * rtp_session_prepend_header(RtpSession *session, mblk_t *payload)
+{
+	mblk_t *mp;
+	/* only in place if the header stays aligned */
+	if (((intptr_t)(payload->b_rptr-RTP_FIXED_HEADER_SIZE) & 0x3)==0
+		&& msgb_prepend(payload,RTP_FIXED_HEADER_SIZE)!=NULL){
+		rtp_header_init_from_session((rtp_header_t*)payload->b_rptr,session);
+		return payload;
+	}
+	mp=allocb(RTP_FIXED_HEADER_SIZE,BPRI_MED);
+	rtp_header_init_from_session((rtp_header_t*)mp->b_rptr,session);
+	mp->b_wptr+=RTP_FIXED_HEADER_SIZE;
+	mp->b_cont=payload;
+	return mp;
+}
+
 /**
  * Creates a new rtp packet using the buffer given in arguments (no copy). 
  * In the header, ssrc and payload_type according to the session's
@@ -820,16 +989,35 @@ mblk_t * rtp_session_create_packet_in_place(RtpSession *session,uint8_t *buffer,
 	return mp;
 }
 
+static void rtp_session_update_sent_packet(RtpSession *session, mblk_t *mp, uint32_t packet_ts){
+	rtp_header_t *rtp=(rtp_header_t*)mp->b_rptr;
+	RtpStream *stream=&session->rtp;
+	int packsize = msgdsize(mp) ;
+	
+	rtp->timestamp=packet_ts;
+	if (session->snd.telephone_events_pt==rtp->paytype)
+	{
+		rtp->seq_number = session->rtp.snd_seq;
+		session->rtp.snd_seq++;
+	}
+	else
+		session->rtp.snd_seq=rtp->seq_number+1;
+	session->rtp.snd_last_ts = packet_ts;
+
+
+	ortp_global_stats.sent += packsize;
+	stream->sent_payload_bytes+=packsize-RTP_FIXED_HEADER_SIZE;
+	stream->stats.sent += packsize;
+	ortp_global_stats.packet_sent++;
+	stream->stats.packet_sent++;
+}
 
 int
 __rtp_session_sendm_with_ts (RtpSession * session, mblk_t *mp, uint32_t packet_ts, uint32_t send_ts)
 {
-	rtp_header_t *rtp;
 	uint32_t packet_time;
 	int error = 0;
-	int packsize;
 	RtpScheduler *sched=session->sched;
-	RtpStream *stream=&session->rtp;
 
 	if (session->flags & RTP_SESSION_SEND_NOT_STARTED)
 	{
@@ -861,6 +1049,7 @@ __rtp_session_sendm_with_ts (RtpSession * session, mblk_t *mp, uint32_t packet_t
 		/*ortp_message("rtp_session_send_with_ts: packet_time=%i time=%i",packet_time,sched->time_);*/
 		if (TIME_IS_STRICTLY_NEWER_THAN (packet_time, sched->time_))
 		{
+			rtp_scheduler_wakeup_at(sched,session,packet_time);
 			wait_point_wakeup_at(&session->snd.wp,packet_time,(session->flags & RTP_SESSION_BLOCKING_MODE)!=0);	
 			session_set_clr(&sched->w_sessions,session);	/* the session has written */
 		}
@@ -874,26 +1063,7 @@ __rtp_session_sendm_with_ts (RtpSession * session, mblk_t *mp, uint32_t packet_t
 		return 0;
 	}
 
-	rtp=(rtp_header_t*)mp->b_rptr;
-	
-	packsize = msgdsize(mp) ;
-	
-	rtp->timestamp=packet_ts;
-	if (session->snd.telephone_events_pt==rtp->paytype)
-	{
-		rtp->seq_number = session->rtp.snd_seq;
-		session->rtp.snd_seq++;
-	}
-	else
-		session->rtp.snd_seq=rtp->seq_number+1;
-	session->rtp.snd_last_ts = packet_ts;
-
-
-	ortp_global_stats.sent += packsize;
-	stream->sent_payload_bytes+=packsize-RTP_FIXED_HEADER_SIZE;
-	stream->stats.sent += packsize;
-	ortp_global_stats.packet_sent++;
-	stream->stats.packet_sent++;
+	rtp_session_update_sent_packet(session,mp,packet_ts);
 
 	error = rtp_session_rtp_send (session, mp);
 	/*send RTCP packet if needed */
@@ -920,6 +1090,39 @@ int rtp_session_sendm_with_ts(RtpSession *session, mblk_t *packet, uint32_t time
 	return __rtp_session_sendm_with_ts(session,packet,timestamp,timestamp);
 }
 
+/**
+ *	Send several rtp datagrams sharing the same timestamp, typically the fragments
+ *	of a video frame. It behaves like calling rtp_session_sendm_with_ts() for each packet,
+ *	except that the packets are handed to the network with as few system calls as
+ *	allowed by rtp_session_set_io_batch_size(). The packets get consecutive sequence
+ *	numbers, starting from the one of the first packet.
+ *  The packets are freed once they are sent.
+ *
+ *@param session a rtp session.
+ *@param packets an array of rtp packets presented as mblk_t.
+ *@param count the number of packets.
+ *@param timestamp the timestamp of the data to be sent.
+ * @return the number of bytes sent over the network.
+**/
+int rtp_session_sendm_batch_with_ts(RtpSession *session, mblk_t **packets, int count, uint32_t timestamp){
+	int i;
+	int error;
+
+	/*takes care of the scheduling, as for a single packet*/
+	__rtp_session_sendm_with_ts(session,NULL,timestamp,timestamp);
+	for(i=0;i<count;i++){
+		/*the packets were created before any of them was sent, so they all carry the same sequence number*/
+		if (i>0) ((rtp_header_t*)packets[i]->b_rptr)->seq_number=session->rtp.snd_seq;
+		rtp_session_update_sent_packet(session,packets[i],timestamp);
+	}
+	error=rtp_session_rtp_send_batch(session,packets,count);
+	/*send RTCP packet if needed */
+	rtp_session_rtcp_process_send(session);
+	/* receives rtcp packet if session is send-only*/
+	if (session->mode==RTP_SESSION_SENDONLY) rtp_session_rtcp_recv(session);
+	return error;
+}
+
 
 
 
@@ -978,14 +1181,7 @@ static void payload_type_changed_notify(RtpSession *session, int paytype){
 
 mblk_t *
 rtp_session_pick_with_cseq (RtpSession * session, const uint16_t sequence_number) {
-	queue_t* q= &session->rtp.rq;
-	mblk_t* mb;
-	for (mb=qbegin(q); !qend(q,mb); mb=qnext(q,mb)){
-		if (rtp_get_seqnumber(mb)==sequence_number) {
-			return mb;
-		}
-	}
-	return NULL;
+	return rtp_jitter_queue_find(&session->rtp.rq,sequence_number);
 }
 
 /**
@@ -1060,7 +1256,7 @@ rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts)
 		rtp_session_rtcp_recv(session);
 	}
 	/* check for telephone event first */
-	mp=getq(&session->rtp.tev_rq);
+	mp=rtp_jitter_queue_pop(&session->rtp.tev_rq);
 	if (mp!=NULL){
 		int msgsize=msgdsize(mp);
 		ortp_global_stats.recv += msgsize;
@@ -1077,13 +1273,13 @@ rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts)
 	
 	if (session->flags & RTP_SESSION_RECV_SYNC)
 	{
-		queue_t *q = &session->rtp.rq;
-		if (qempty(q))
+		mblk_t *first = rtp_jitter_queue_peek(&session->rtp.rq);
+		if (first == NULL)
 		{
 			ortp_debug ("Queue is empty.");
 			goto end;
 		}
-		rtp = (rtp_header_t *) qfirst(q)->b_rptr;
+		rtp = (rtp_header_t *) first->b_rptr;
 		session->rtp.rcv_ts_offset = rtp->timestamp;
 		session->rtp.rcv_last_ret_ts = user_ts;	/* just to have an init value */
 		session->rcv.ssrc = rtp->ssrc;
@@ -1095,11 +1291,11 @@ rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts)
 	ts = jitter_control_get_compensated_timestamp(&session->rtp.jittctl,user_ts);
 	if (session->rtp.jittctl.enabled==TRUE){
 		if (session->permissive)
-			mp = rtp_getq_permissive(&session->rtp.rq, ts,&rejected);
+			mp = rtp_jitter_queue_get_permissive(&session->rtp.rq, ts,&rejected);
 		else{
-			mp = rtp_getq(&session->rtp.rq, ts,&rejected);
+			mp = rtp_jitter_queue_get(&session->rtp.rq, ts,&rejected);
 		}
-	}else mp=getq(&session->rtp.rq);/*no jitter buffer at all*/
+	}else mp=rtp_jitter_queue_pop(&session->rtp.rq);/*no jitter buffer at all*/
 	
 	stream->stats.outoftime+=rejected;
 	ortp_global_stats.outoftime+=rejected;
@@ -1150,6 +1346,15 @@ rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts)
 		 * wanted expires */
 		/* but we must not block the process if the timestamp wanted by the application is older
 		 * than current time */
+#ifdef HAVE_SYS_EPOLL_H
+		if ((session->flags & RTP_SESSION_WAKEUP_ON_DATA) && session->sched_fd!=session->rtp.socket){
+			/* the rtp socket was (re)created: watch it. The scheduler lock must be taken
+			before the wait point one, as the scheduler thread does.*/
+			rtp_scheduler_lock(sched);
+			rtp_scheduler_watch_socket(sched,session);
+			rtp_scheduler_unlock(sched);
+		}
+#endif
 		wait_point_lock(&session->rcv.wp);
 		packet_time =
 			rtp_session_ts_to_time (session,
@@ -1160,6 +1365,7 @@ rtp_session_recvm_with_ts (RtpSession * session, uint32_t user_ts)
 		
 		if (TIME_IS_STRICTLY_NEWER_THAN (packet_time, sched->time_))
 		{
+			rtp_scheduler_wakeup_at(sched,session,packet_time);
 			wait_point_wakeup_at(&session->rcv.wp,packet_time, (session->flags & RTP_SESSION_BLOCKING_MODE)!=0);
 			session_set_clr(&sched->r_sessions,session);
 		}
@@ -1286,7 +1492,6 @@ uint32_t rtp_session_get_current_send_ts(RtpSession *session)
 uint32_t rtp_session_get_current_recv_ts(RtpSession *session){
 	uint32_t userts;
 	uint32_t session_time;
-	RtpScheduler *sched=ortp_get_scheduler();
 	PayloadType *payload;
 	payload=rtp_profile_get_payload(session->rcv.profile,session->rcv.pt);
 	return_val_if_fail(payload!=NULL, 0);
@@ -1294,7 +1499,7 @@ uint32_t rtp_session_get_current_recv_ts(RtpSession *session){
 		ortp_warning("can't guess current timestamp because session is not scheduled.");
 		return 0;
 	}
-	session_time=sched->time_-session->rtp.rcv_time_offset;
+	session_time=session->sched->time_-session->rtp.rcv_time_offset;
 	userts=  (uint32_t)( ( (double)(session_time) * (double) payload->clock_rate )/ 1000.0)
 				+ session->rtp.rcv_ts_offset;
 	return userts;
@@ -1322,7 +1527,11 @@ void rtp_session_set_time_jump_limit(RtpSession *session, int milisecs){
  * Closes the rtp and rtcp sockets.
 **/
 void rtp_session_release_sockets(RtpSession *session){
-	if (session->rtp.socket!=(ortp_socket_t)-1) close_socket (session->rtp.socket);
+	if (session->rtp.socket!=(ortp_socket_t)-1){
+		close_socket (session->rtp.socket);
+		/*closing the socket removes it from the scheduler's epoll set*/
+		session->sched_fd=-1;
+	}
 	if (session->rtcp.socket!=(ortp_socket_t)-1) close_socket (session->rtcp.socket);
 	session->rtp.socket=-1;
 	session->rtcp.socket=-1;
@@ -1373,14 +1582,15 @@ void rtp_session_dispatch_event(RtpSession *session, OrtpEvent *ev){
 
 void rtp_session_uninit (RtpSession * session)
 {
+	int i;
 	/* first of all remove the session from the scheduler */
 	if (session->flags & RTP_SESSION_SCHEDULED)
 	{
 		rtp_scheduler_remove_session (session->sched,session);
 	}
 	/*flush all queues */
-	flushq(&session->rtp.rq, FLUSHALL);
-	flushq(&session->rtp.tev_rq, FLUSHALL);
+	rtp_jitter_queue_uninit(&session->rtp.rq);
+	rtp_jitter_queue_uninit(&session->rtp.tev_rq);
 
 	if (session->eventqs!=NULL) o_list_free(session->eventqs);
 	/* close sockets */
@@ -1390,6 +1600,9 @@ void rtp_session_uninit (RtpSession * session)
 	wait_point_uninit(&session->rcv.wp);
 	if (session->current_tev!=NULL) freemsg(session->current_tev);
 	if (session->rtp.cached_mp!=NULL) freemsg(session->rtp.cached_mp);
+	for (i=0;i<RTP_IO_BATCH_MAX;i++){
+		if (session->rtp.batch_mp[i]!=NULL) freemsg(session->rtp.batch_mp[i]);
+	}
 	if (session->rtcp.cached_mp!=NULL) freemsg(session->rtcp.cached_mp);
 	if (session->sd!=NULL) freemsg(session->sd);
 
@@ -1454,7 +1667,7 @@ void rtp_session_set_ssrc_changed_threshold(RtpSession *session, int numpackets)
  * @param session the rtp session
 **/
 void rtp_session_resync(RtpSession *session){
-	flushq (&session->rtp.rq, FLUSHALL);
+	rtp_jitter_queue_flush(&session->rtp.rq);
 	rtp_session_set_flag(session, RTP_SESSION_RECV_SYNC);
 	rtp_session_unset_flag(session,RTP_SESSION_FIRST_PACKET_DELIVERED);
 	jitter_control_init(&session->rtp.jittctl,-1,NULL);
@@ -1817,6 +2030,9 @@ void rtp_session_process (RtpSession * session, uint32_t time, RtpScheduler *sch
 	if (wait_point_check(&session->snd.wp,time)){
 		session_set_set(&sched->w_sessions,session);
 		wait_point_wakeup(&session->snd.wp);
+	}else if (session->snd.wp.wakeup){
+		/*the scheduler keeps one wake up per session: arm the one of the wait point still pending*/
+		rtp_scheduler_wakeup_at(sched,session,session->snd.wp.time);
 	}
 	wait_point_unlock(&session->snd.wp);
 	
@@ -1824,6 +2040,8 @@ void rtp_session_process (RtpSession * session, uint32_t time, RtpScheduler *sch
 	if (wait_point_check(&session->rcv.wp,time)){
 		session_set_set(&sched->r_sessions,session);
 		wait_point_wakeup(&session->rcv.wp);
+	}else if (session->rcv.wp.wakeup){
+		rtp_scheduler_wakeup_at(sched,session,session->rcv.wp.time);
 	}
 	wait_point_unlock(&session->rcv.wp);
 }
@@ -17,6 +17,10 @@
   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#if defined(__linux) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /*for recvmmsg() and sendmmsg()*/
+#endif
+
 #include "ortp/ortp.h"
 #include "utils.h"
 #include "ortp/rtpsession.h"
@@ -39,6 +43,10 @@
 #define USE_SENDMSG 1
 #endif
 
+#if defined(USE_SENDMSG) && defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+#define USE_MMSG 1
+#endif
+
 #define can_connect(s)	( (s)->use_connect && !(s)->symmetric_rtp)
 
 static bool_t try_connect(int fd, const struct sockaddr *dest, socklen_t addrlen){
@@ -863,23 +871,37 @@ static void update_recv_bytes(RtpSession*s, int nbytes){
 	s->rtp.recv_bytes+=nbytes+overhead;
 }
 
+static void rtp_header_hton(mblk_t *m){
+	int i;
+	rtp_header_t *hdr = (rtp_header_t *) m->b_rptr;
+	/* perform host to network conversions */
+	hdr->ssrc = htonl (hdr->ssrc);
+	hdr->timestamp = htonl (hdr->timestamp);
+	hdr->seq_number = htons (hdr->seq_number);
+	for (i = 0; i < hdr->cc; i++)
+		hdr->csrc[i] = htonl (hdr->csrc[i]);
+}
+
+static void rtp_session_rtp_send_done(RtpSession *session, int error){
+	if (error < 0){
+		if (session->on_network_error.count>0){
+			rtp_signal_table_emit3(&session->on_network_error,(long)"Error sending RTP packet",INT_TO_POINTER(getSocketErrorCode()));
+		}else ortp_warning ("Error sending rtp packet: %s ; socket=%i", getSocketError(), session->rtp.socket);
+		session->rtp.send_errno=getSocketErrorCode();
+	}else{
+		update_sent_bytes(session,error);
+	}
+}
+
 int
 rtp_session_rtp_send (RtpSession * session, mblk_t * m)
 {
 	int error;
-	int i;
-	rtp_header_t *hdr;
 	struct sockaddr *destaddr=(struct sockaddr*)&session->rtp.rem_addr;
 	socklen_t destlen=session->rtp.rem_addrlen;
 	ortp_socket_t sockfd=session->rtp.socket;
 
-	hdr = (rtp_header_t *) m->b_rptr;
-	/* perform host to network conversions */
-	hdr->ssrc = htonl (hdr->ssrc);
-	hdr->timestamp = htonl (hdr->timestamp);
-	hdr->seq_number = htons (hdr->seq_number);
-	for (i = 0; i < hdr->cc; i++)
-		hdr->csrc[i] = htonl (hdr->csrc[i]);
+	rtp_header_hton(m);
 
 	if (session->flags & RTP_SOCKET_CONNECTED) {
 		destaddr=NULL;
@@ -898,18 +920,111 @@ rtp_session_rtp_send (RtpSession * session, mblk_t * m)
 			 0,destaddr,destlen);
 #endif
 	}
-	if (error < 0){
-		if (session->on_network_error.count>0){
-			rtp_signal_table_emit3(&session->on_network_error,(long)"Error sending RTP packet",INT_TO_POINTER(getSocketErrorCode()));
-		}else ortp_warning ("Error sending rtp packet: %s ; socket=%i", getSocketError(), sockfd);
-		session->rtp.send_errno=getSocketErrorCode();
-	}else{
-		update_sent_bytes(session,error);
-	}
+	rtp_session_rtp_send_done(session,error);
 	freemsg (m);
 	return error;
 }
 
+#ifdef USE_MMSG
+/*sends up to RTP_IO_BATCH_MAX packets with a single sendmmsg() call, returns the number of packets sent*/
+static int rtp_session_rtp_sendmmsg(RtpSession *session, mblk_t **packets, int count, struct sockaddr *destaddr, socklen_t destlen){
+	struct mmsghdr msgs[RTP_IO_BATCH_MAX];
+	struct iovec iov[RTP_IO_BATCH_MAX][MAX_IOV];
+	int i,sent;
+
+	for(i=0;i<count;++i){
+		mblk_t *m=packets[i];
+		int iovlen;
+		for(iovlen=0; iovlen<MAX_IOV && m!=NULL; m=m->b_cont,iovlen++){
+			iov[i][iovlen].iov_base=m->b_rptr;
+			iov[i][iovlen].iov_len=m->b_wptr-m->b_rptr;
+		}
+		memset(&msgs[i],0,sizeof(msgs[i]));
+		msgs[i].msg_hdr.msg_name=(void*)destaddr;
+		msgs[i].msg_hdr.msg_namelen=destlen;
+		msgs[i].msg_hdr.msg_iov=iov[i];
+		msgs[i].msg_hdr.msg_iovlen=iovlen;
+	}
+	sent=sendmmsg(session->rtp.socket,msgs,count,0);
+	for(i=0;i<sent;++i){
+		rtp_session_rtp_send_done(session,msgs[i].msg_len);
+	}
+	return sent;
+}
+#endif
+
+/*sends several rtp packets, using as few system calls as possible. The packets are freed.*/
+int rtp_session_rtp_send_batch(RtpSession *session, mblk_t **packets, int count){
+	int i;
+	int total=0;
+
+#ifdef USE_MMSG
+	if (session->rtp.io_batch_size>1 && rtp_session_using_transport(session, rtp) && session->rtp.tr->t_sendto_batch!=NULL){
+		/*the transport processes and sends the packets by groups, srtp protecting each group in one go*/
+		struct sockaddr *destaddr=(struct sockaddr*)&session->rtp.rem_addr;
+		socklen_t destlen=session->rtp.rem_addrlen;
+		int results[RTP_IO_BATCH_MAX];
+		int done=0;
+
+		if (session->flags & RTP_SOCKET_CONNECTED) {
+			destaddr=NULL;
+			destlen=0;
+		}
+		for(i=0;i<count;++i) rtp_header_hton(packets[i]);
+		while(done<count){
+			int n=MIN(count-done,session->rtp.io_batch_size);
+			session->rtp.tr->t_sendto_batch(session->rtp.tr,packets+done,results,n,0,destaddr,destlen);
+			for(i=0;i<n;++i){
+				rtp_session_rtp_send_done(session,results[i]);
+				if (results[i]>0) total+=results[i];
+				freemsg(packets[done+i]);
+			}
+			done+=n;
+		}
+		return total;
+	}
+	if (session->rtp.io_batch_size>1 && !rtp_session_using_transport(session, rtp)){
+		struct sockaddr *destaddr=(struct sockaddr*)&session->rtp.rem_addr;
+		socklen_t destlen=session->rtp.rem_addrlen;
+		int done=0;
+
+		if (session->flags & RTP_SOCKET_CONNECTED) {
+			destaddr=NULL;
+			destlen=0;
+		}
+		for(i=0;i<count;++i) rtp_header_hton(packets[i]);
+		while(done<count){
+			int n=MIN(count-done,session->rtp.io_batch_size);
+			int sent=rtp_session_rtp_sendmmsg(session,packets+done,n,destaddr,destlen);
+			if (sent<=0){
+				if (sent<0 && getSocketErrorCode()==ENOSYS){
+					ortp_warning("sendmmsg() is not supported by this system, batched io disabled.");
+					session->rtp.io_batch_size=1;
+				}
+				break;
+			}
+			for(i=done;i<done+sent;++i) total+=msgdsize(packets[i]);
+			done+=sent;
+		}
+		for(i=0;i<done;++i) freemsg(packets[i]);
+		if (done==count) return total;
+		/*send the remaining ones one by one: headers are already in network order*/
+		for(i=done;i<count;++i){
+			int error=rtp_sendmsg(session->rtp.socket,packets[i],destaddr,destlen);
+			rtp_session_rtp_send_done(session,error);
+			if (error>0) total+=error;
+			freemsg(packets[i]);
+		}
+		return total;
+	}
+#endif
+	for(i=0;i<count;++i){
+		int error=rtp_session_rtp_send(session,packets[i]);
+		if (error>0) total+=error;
+	}
+	return total;
+}
+
 int
 rtp_session_rtcp_send (RtpSession * session, mblk_t * m)
 {
@@ -954,6 +1069,135 @@ rtp_session_rtcp_send (RtpSession * session, mblk_t * m)
 	return error;
 }
 
+static void rtp_session_rtp_recv_packet(RtpSession *session, mblk_t *mp, uint32_t user_ts, struct sockaddr *remaddr, socklen_t addrlen){
+	bool_t sock_connected=!!(session->flags & RTP_SOCKET_CONNECTED);
+
+	if (session->symmetric_rtp && !sock_connected){
+		if (session->use_connect){
+			/* store the sender rtp address to do symmetric RTP */
+			memcpy(&session->rtp.rem_addr,remaddr,addrlen);
+			session->rtp.rem_addrlen=addrlen;
+			if (try_connect(session->rtp.socket,remaddr,addrlen))
+				session->flags|=RTP_SOCKET_CONNECTED;
+		}
+	}
+	if (session->net_sim_ctx){
+		/*the simulator gives back every packet whose delay has expired, which may not include this one*/
+		queue_t q;
+		qinit(&q);
+		rtp_session_network_simulate(session,mp,&q);
+		while((mp=getq(&q))!=NULL){
+			int msgsize=msgdsize(mp);
+			rtp_session_rtp_parse(session, mp, user_ts, remaddr,addrlen);
+			update_recv_bytes(session,msgsize);
+		}
+		return;
+	}
+	/* then parse the message and put on jitter buffer queue */
+	if (mp){
+		/*the packet may be freed by the parser*/
+		int msgsize=mp->b_wptr-mp->b_rptr;
+		rtp_session_rtp_parse(session, mp, user_ts, remaddr,addrlen);
+		update_recv_bytes(session,msgsize);
+	}
+}
+
+static void rtp_session_rtp_recv_error(RtpSession *session, int error, uint32_t user_ts){
+	int errnum;
+	mblk_t *mp;
+	if (error==-1 && !is_would_block_error((errnum=getSocketErrorCode())) )
+	{
+		if (session->on_network_error.count>0){
+			rtp_signal_table_emit3(&session->on_network_error,(long)"Error receiving RTP packet",INT_TO_POINTER(getSocketErrorCode()));
+		}else ortp_warning("Error receiving RTP packet: %s, err num  [%i],error [%i]",getSocketError(),errnum,error);
+	}else{
+		/*EWOULDBLOCK errors or transports returning 0 are ignored.*/
+		if (session->net_sim_ctx){
+			/*drain possible packets queued in the network simulator*/
+			queue_t q;
+			qinit(&q);
+			rtp_session_network_simulate(session,NULL,&q);
+			while((mp=getq(&q))!=NULL){
+				/*the packet may be freed by the parser*/
+				int msgsize=msgdsize(mp);
+				/* then parse the message and put on jitter buffer queue */
+				rtp_session_rtp_parse(session, mp, user_ts, (struct sockaddr*)&session->rtp.rem_addr,session->rtp.rem_addrlen);
+				update_recv_bytes(session,msgsize);
+			}
+		}
+	}
+}
+
+#ifdef USE_MMSG
+/*reads up to io_batch_size datagrams per recvmmsg() call, or per call to the transport,
+into buffers kept from one call to the next*/
+static int rtp_session_rtp_recv_batch(RtpSession *session, uint32_t user_ts){
+	struct mmsghdr msgs[RTP_IO_BATCH_MAX];
+	struct iovec iov[RTP_IO_BATCH_MAX];
+	struct sockaddr_storage remaddr[RTP_IO_BATCH_MAX];
+	struct sockaddr *from[RTP_IO_BATCH_MAX];
+	socklen_t fromlen[RTP_IO_BATCH_MAX];
+	int lens[RTP_IO_BATCH_MAX];
+	mblk_t **mps=session->rtp.batch_mp;
+	int batch=session->rtp.io_batch_size;
+	bool_t use_transport=rtp_session_using_transport(session, rtp);
+	int i,n;
+
+	while (1)
+	{
+		for(i=0;i<batch;++i){
+			if (mps[i]==NULL)
+				mps[i]=msgb_allocator_alloc(&session->allocator,session->recv_buf_size);
+			from[i]=(struct sockaddr*)&remaddr[i];
+			fromlen[i]=sizeof(remaddr[i]);
+			if (use_transport) continue;
+			iov[i].iov_base=mps[i]->b_wptr;
+			iov[i].iov_len=mps[i]->b_datap->db_lim - mps[i]->b_wptr;
+			memset(&msgs[i],0,sizeof(msgs[i]));
+			msgs[i].msg_hdr.msg_name=&remaddr[i];
+			msgs[i].msg_hdr.msg_namelen=sizeof(remaddr[i]);
+			msgs[i].msg_hdr.msg_iov=&iov[i];
+			msgs[i].msg_hdr.msg_iovlen=1;
+		}
+		if (use_transport){
+			n=session->rtp.tr->t_recvfrom_batch(session->rtp.tr,mps,lens,batch,0,from,fromlen);
+		}else{
+			n=recvmmsg(session->rtp.socket,msgs,batch,0,NULL);
+			for(i=0;i<n;++i){
+				lens[i]=msgs[i].msg_len;
+				fromlen[i]=msgs[i].msg_hdr.msg_namelen;
+			}
+		}
+		if (n<=0){
+			if (n<0 && getSocketErrorCode()==ENOSYS){
+				ortp_warning("recvmmsg() is not supported by this system, batched io disabled.");
+				session->rtp.io_batch_size=1;
+				return rtp_session_rtp_recv(session,user_ts);
+			}
+			rtp_session_rtp_recv_error(session,n,user_ts);
+			return -1;
+		}
+		for(i=0;i<n;++i){
+			mblk_t *mp=mps[i];
+			mps[i]=NULL;
+			/*empty datagrams, and the ones the transport rejected, are dropped*/
+			if (lens[i]<=0){
+				freemsg(mp);
+				continue;
+			}
+			mp->b_wptr+=lens[i];
+			rtp_session_rtp_recv_packet(session,mp,user_ts,from[i],fromlen[i]);
+		}
+		/*move the unused buffers to the front*/
+		for(i=n;i<batch;++i){
+			mps[i-n]=mps[i];
+			mps[i]=NULL;
+		}
+	}
+	return -1;
+}
+#endif
+
 int
 rtp_session_rtp_recv (RtpSession * session, uint32_t user_ts)
 {
@@ -969,6 +1213,11 @@ rtp_session_rtp_recv (RtpSession * session, uint32_t user_ts)
 	
 	if ((sockfd==(ortp_socket_t)-1) && !rtp_session_using_transport(session, rtp)) return -1;  /*session has no sockets for the moment*/
 
+#ifdef USE_MMSG
+	if (session->rtp.io_batch_size>1 && (!rtp_session_using_transport(session, rtp) || session->rtp.tr->t_recvfrom_batch!=NULL))
+		return rtp_session_rtp_recv_batch(session,user_ts);
+#endif
+
 	while (1)
 	{
 		int bufsz;
@@ -989,46 +1238,14 @@ rtp_session_rtp_recv (RtpSession * session, uint32_t user_ts)
 				  (struct sockaddr *) &remaddr,
 				  &addrlen);
 		if (error > 0){
-			if (session->symmetric_rtp && !sock_connected){
-				if (session->use_connect){
-					/* store the sender rtp address to do symmetric RTP */
-					memcpy(&session->rtp.rem_addr,&remaddr,addrlen);
-					session->rtp.rem_addrlen=addrlen;
-					if (try_connect(sockfd,(struct sockaddr*)&remaddr,addrlen))
-						session->flags|=RTP_SOCKET_CONNECTED;
-				}
-			}
 			mp->b_wptr+=error;
-			if (session->net_sim_ctx)
-				mp=rtp_session_network_simulate(session,mp);
-			/* then parse the message and put on jitter buffer queue */
-			if (mp){
-				rtp_session_rtp_parse(session, mp, user_ts, (struct sockaddr*)&remaddr,addrlen);
-				update_recv_bytes(session,mp->b_wptr-mp->b_rptr);
-			}
+			rtp_session_rtp_recv_packet(session,mp,user_ts,(struct sockaddr*)&remaddr,addrlen);
 			session->rtp.cached_mp=NULL;
 			/*for bandwidth measurements:*/
 		}
 		else
 		{
-			int errnum;
-			if (error==-1 && !is_would_block_error((errnum=getSocketErrorCode())) )
-			{
-				if (session->on_network_error.count>0){
-					rtp_signal_table_emit3(&session->on_network_error,(long)"Error receiving RTP packet",INT_TO_POINTER(getSocketErrorCode()));
-				}else ortp_warning("Error receiving RTP packet: %s, err num  [%i],error [%i]",getSocketError(),errnum,error);
-			}else{
-				/*EWOULDBLOCK errors or transports returning 0 are ignored.*/
-				if (session->net_sim_ctx){
-					/*drain possible packets queued in the network simulator*/
-					mp=rtp_session_network_simulate(session,NULL);
-					if (mp){
-						/* then parse the message and put on jitter buffer queue */
-						rtp_session_rtp_parse(session, mp, user_ts, (struct sockaddr*)&session->rtp.rem_addr,session->rtp.rem_addrlen);
-						update_recv_bytes(session,msgdsize(mp));
-					}
-				}
-			}
+			rtp_session_rtp_recv_error(session,error,user_ts);
 			/* don't free the cached_mp, it will be reused next time */
 			return -1;
 		}
@@ -1206,3 +1423,27 @@ rtp_session_rtcp_recv (RtpSession * session)
 	return error;
 }
 
+
+/**
+ * Sets the maximum number of datagrams read or written by a single system call
+ * on the rtp socket. Values greater than one are only effective on systems
+ * providing recvmmsg() and sendmmsg(), and when either no RtpTransport is used
+ * or the RtpTransport supports batches, as the srtp one does.
+ * Batching only saves the cost of the system calls, not the per datagram work
+ * of the network stack: the gain depends on the system, src/tests/rtpbatchbench
+ * measures it.
+ *
+ * @param session a rtp session
+ * @param count number of datagrams per system call, between 1 and RTP_IO_BATCH_MAX
+**/
+void rtp_session_set_io_batch_size(RtpSession *session, int count){
+	if (count<1) count=1;
+	if (count>RTP_IO_BATCH_MAX) count=RTP_IO_BATCH_MAX;
+#ifndef USE_MMSG
+	if (count>1){
+		ortp_message("Batched io is not supported on this platform, using one datagram per system call.");
+		count=1;
+	}
+#endif
+	session->rtp.io_batch_size=count;
+}
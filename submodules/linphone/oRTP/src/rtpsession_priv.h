@@ -36,17 +36,17 @@ typedef enum {
 	RTP_SESSION_USING_TRANSPORT=1<<10,
 	RTCP_OVERRIDE_LOST_PACKETS=1<11,
 	RTCP_OVERRIDE_JITTER=1<<12,
-	RTCP_OVERRIDE_DELAY=1<<13
+	RTCP_OVERRIDE_DELAY=1<<13,
+	RTP_SESSION_WAKEUP_ON_DATA=1<<14 /* the scheduler watches the rtp socket of the session */
 }RtpSessionFlags;
 
 #define rtp_session_using_transport(s, stream) (((s)->flags & RTP_SESSION_USING_TRANSPORT) && (s->stream.tr != 0))
 
 void rtp_session_update_payload_type(RtpSession * session, int pt);
-void rtp_putq(queue_t *q, mblk_t *mp);
-mblk_t * rtp_getq(queue_t *q, uint32_t ts, int *rejected);
 int rtp_session_rtp_recv(RtpSession * session, uint32_t ts);
 int rtp_session_rtcp_recv(RtpSession * session);
 int rtp_session_rtp_send (RtpSession * session, mblk_t * m);
+int rtp_session_rtp_send_batch(RtpSession *session, mblk_t **packets, int count);
 int rtp_session_rtcp_send (RtpSession * session, mblk_t * m);
 
 void rtp_session_rtp_parse(RtpSession *session, mblk_t *mp, uint32_t local_str_ts, struct sockaddr *addr, socklen_t addrlen);
@@ -54,7 +54,7 @@ void rtp_session_rtcp_parse(RtpSession *session, mblk_t *mp);
 
 void rtp_session_dispatch_event(RtpSession *session, OrtpEvent *ev);
 
-mblk_t * rtp_session_network_simulate(RtpSession *session, mblk_t *input);
+void rtp_session_network_simulate(RtpSession *session, mblk_t *input, queue_t *output);
 void ortp_network_simulator_destroy(OrtpNetworkSimulatorCtx *sim);
 
 #endif
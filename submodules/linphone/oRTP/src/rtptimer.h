@@ -49,4 +49,15 @@ void rtp_timer_set_interval(RtpTimer *timer, struct timeval *interval);
 
 extern RtpTimer posix_timer;
 
+#if	!defined(_WIN32) && !defined(_WIN32_WCE)
+/* the state of the posix timer, so that several schedulers can each run their own */
+typedef struct _PosixTimerClock{
+	struct timeval orig;
+	uint32_t time;	/*in milisecond */
+}PosixTimerClock;
+
+void posix_timer_clock_init(PosixTimerClock *clock, const struct timeval *orig);
+void posix_timer_clock_wait(PosixTimerClock *clock, uint32_t interval_ms);
+#endif
+
 #endif
@@ -17,11 +17,29 @@
   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#if defined(__linux) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /*for pthread_setaffinity_np()*/
+#endif
+
+#if defined(WIN32) || defined(_WIN32_WCE)
+#include "ortp-config-win32.h"
+#elif HAVE_CONFIG_H
+#include "ortp-config.h"
+#endif
 #include <ortp/ortp.h>
 #include "utils.h"
 #include "scheduler.h"
 #include "rtpsession_priv.h"
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#define RTP_SCHEDULER_MAX_EVENTS 64
+#endif
+
+#ifdef __linux
+#include <sched.h>
+#endif
+
 // To avoid warning during compile
 extern void rtp_session_process (RtpSession * session, uint32_t time, RtpScheduler *sched);
 
@@ -29,11 +47,19 @@ extern void rtp_session_process (RtpSession * session, uint32_t time, RtpSchedul
 void rtp_scheduler_init(RtpScheduler *sched)
 {
 	sched->list=0;
+	sched->nsessions=0;
+	sched->group=NULL;
+	sched->index=0;
+	sched->cpu=-1;
 	sched->time_=0;
 	/* default to the posix timer */
 	rtp_scheduler_set_timer(sched,&posix_timer);
 	ortp_mutex_init(&sched->lock,NULL);
 	ortp_cond_init(&sched->unblock_select_cond,NULL);
+	ortp_mutex_init(&sched->waiters_lock,NULL);
+	sched->waiters=NULL;
+	sched->nwaiters=0;
+	sched->waiters_size=0;
 	sched->max_sessions=sizeof(SessionSet)*8;
 	session_set_init(&sched->all_sessions);
 	sched->all_max=0;
@@ -43,6 +69,16 @@ void rtp_scheduler_init(RtpScheduler *sched)
 	sched->w_max=0;
 	session_set_init(&sched->e_sessions);
 	sched->e_max=0;
+	ortp_mutex_init(&sched->wakeups_lock,NULL);
+	sched->wakeups=NULL;
+	sched->wakeups_count=0;
+	sched->wakeups_size=0;
+#ifdef HAVE_SYS_EPOLL_H
+	sched->epfd=epoll_create(RTP_SCHEDULER_MAX_EVENTS);
+	if (sched->epfd==-1) ortp_warning("epoll_create() failed: %s, sessions won't wake up on data.",strerror(errno));
+#else
+	sched->epfd=-1;
+#endif
 }
 
 RtpScheduler * rtp_scheduler_new()
@@ -67,6 +103,13 @@ void rtp_scheduler_set_timer(RtpScheduler *sched,RtpTimer *timer)
 void rtp_scheduler_start(RtpScheduler *sched)
 {
 	if (sched->thread_running==0){
+#if	!defined(_WIN32) && !defined(_WIN32_WCE)
+		if (sched->group==NULL){
+			struct timeval orig;
+			gettimeofday(&orig,NULL);
+			posix_timer_clock_init(&sched->clock,&orig);
+		}
+#endif
 		sched->thread_running=1;
 		ortp_mutex_lock(&sched->lock);
 		ortp_thread_create(&sched->thread, NULL, rtp_scheduler_schedule,(void*)sched);
@@ -92,9 +135,199 @@ void rtp_scheduler_destroy(RtpScheduler *sched)
 	ortp_mutex_destroy(&sched->lock);
 	//g_mutex_free(sched->unblock_select_mutex);
 	ortp_cond_destroy(&sched->unblock_select_cond);
+	ortp_mutex_destroy(&sched->waiters_lock);
+	if (sched->waiters!=NULL) ortp_free(sched->waiters);
+	ortp_mutex_destroy(&sched->wakeups_lock);
+	if (sched->wakeups!=NULL) ortp_free(sched->wakeups);
+#ifdef HAVE_SYS_EPOLL_H
+	if (sched->epfd!=-1) close(sched->epfd);
+#endif
 	ortp_free(sched);
 }
 
+#define wakeup_before(a,b)	((int32_t)((a).time-(b).time)<0)
+
+/*must be called with wakeups_lock held: stores w at position i and records it in the session*/
+static inline void rtp_scheduler_heap_set(RtpScheduler *sched, int i, RtpSchedulerWakeup w){
+	sched->wakeups[i]=w;
+	w.session->sched_wakeup=i;
+}
+
+/*must be called with wakeups_lock held*/
+static void rtp_scheduler_heap_sift_up(RtpScheduler *sched, int i, RtpSchedulerWakeup w){
+	while(i>0 && wakeup_before(w,sched->wakeups[(i-1)/2])){
+		rtp_scheduler_heap_set(sched,i,sched->wakeups[(i-1)/2]);
+		i=(i-1)/2;
+	}
+	rtp_scheduler_heap_set(sched,i,w);
+}
+
+/*
+ * Arms a wake up of the session at the given scheduler time. The scheduler thread
+ * only processes the sessions whose wake up time has come, instead of all of them.
+ * A session has at most one entry in the heap: a wake up later than the pending one
+ * is not recorded, rtp_session_process() arms it again when the earlier one expires.
+ * Can be called with a wait point of the session locked.
+ */
+void rtp_scheduler_wakeup_at(RtpScheduler *sched, RtpSession *session, uint32_t time){
+	RtpSchedulerWakeup w;
+
+	w.time=time;
+	w.session=session;
+	ortp_mutex_lock(&sched->wakeups_lock);
+	if (session->sched_wakeup!=-1){
+		int i=session->sched_wakeup;
+		if (wakeup_before(w,sched->wakeups[i]))
+			rtp_scheduler_heap_sift_up(sched,i,w);
+		ortp_mutex_unlock(&sched->wakeups_lock);
+		return;
+	}
+	if (sched->wakeups_count==sched->wakeups_size){
+		sched->wakeups_size=(sched->wakeups_size==0) ? 64 : sched->wakeups_size*2;
+		sched->wakeups=(RtpSchedulerWakeup*)ortp_realloc(sched->wakeups,sched->wakeups_size*sizeof(RtpSchedulerWakeup));
+	}
+	rtp_scheduler_heap_sift_up(sched,sched->wakeups_count++,w);
+	ortp_mutex_unlock(&sched->wakeups_lock);
+}
+
+/*must be called with wakeups_lock held*/
+static void rtp_scheduler_heap_remove(RtpScheduler *sched, int i){
+	RtpSchedulerWakeup last=sched->wakeups[--sched->wakeups_count];
+	sched->wakeups[i].session->sched_wakeup=-1;
+	if (i==sched->wakeups_count) return;
+	if (i>0 && wakeup_before(last,sched->wakeups[(i-1)/2])){
+		/*last is older than the parent of the removed entry*/
+		rtp_scheduler_heap_sift_up(sched,i,last);
+		return;
+	}
+	/*sift down*/
+	while(1){
+		int child=2*i+1;
+		if (child>=sched->wakeups_count) break;
+		if (child+1<sched->wakeups_count && wakeup_before(sched->wakeups[child+1],sched->wakeups[child]))
+			child++;
+		if (!wakeup_before(sched->wakeups[child],last)) break;
+		rtp_scheduler_heap_set(sched,i,sched->wakeups[child]);
+		i=child;
+	}
+	rtp_scheduler_heap_set(sched,i,last);
+}
+
+static RtpSession *rtp_scheduler_pop_expired(RtpScheduler *sched, uint32_t time){
+	RtpSession *session=NULL;
+	ortp_mutex_lock(&sched->wakeups_lock);
+	if (sched->wakeups_count>0 && TIME_IS_NEWER_THAN(time,sched->wakeups[0].time)){
+		session=sched->wakeups[0].session;
+		rtp_scheduler_heap_remove(sched,0);
+	}
+	ortp_mutex_unlock(&sched->wakeups_lock);
+	return session;
+}
+
+static void rtp_scheduler_purge_wakeups(RtpScheduler *sched, RtpSession *session){
+	ortp_mutex_lock(&sched->wakeups_lock);
+	if (session->sched_wakeup!=-1)
+		rtp_scheduler_heap_remove(sched,session->sched_wakeup);
+	ortp_mutex_unlock(&sched->wakeups_lock);
+}
+
+/*
+ * Registers the rtp socket of a session that wakes up on data into the epoll set,
+ * when not done yet for this socket.
+ */
+void rtp_scheduler_watch_socket(RtpScheduler *sched, RtpSession *session){
+#ifdef HAVE_SYS_EPOLL_H
+	struct epoll_event ev;
+	ortp_socket_t fd=session->rtp.socket;
+
+	if (sched->epfd==-1 || fd==session->sched_fd || !(session->flags & RTP_SESSION_WAKEUP_ON_DATA)) return;
+	if (session->sched_fd!=-1)
+		epoll_ctl(sched->epfd,EPOLL_CTL_DEL,session->sched_fd,NULL);
+	session->sched_fd=-1;
+	if (fd==(ortp_socket_t)-1) return;
+	memset(&ev,0,sizeof(ev));
+	ev.events=EPOLLIN|EPOLLET;
+	ev.data.ptr=session;
+	if (epoll_ctl(sched->epfd,EPOLL_CTL_ADD,fd,&ev)==0)
+		session->sched_fd=fd;
+	else ortp_warning("Cannot watch rtp socket %i: %s",fd,strerror(errno));
+#endif
+}
+
+static void rtp_scheduler_unwatch_socket(RtpScheduler *sched, RtpSession *session){
+#ifdef HAVE_SYS_EPOLL_H
+	if (session->sched_fd!=-1){
+		epoll_ctl(sched->epfd,EPOLL_CTL_DEL,session->sched_fd,NULL);
+		session->sched_fd=-1;
+	}
+#endif
+}
+
+/*marks the sessions that received data as ready for receiving, must be called with the scheduler locked*/
+static void rtp_scheduler_poll_sockets(RtpScheduler *sched){
+#ifdef HAVE_SYS_EPOLL_H
+	struct epoll_event events[RTP_SCHEDULER_MAX_EVENTS];
+	int i,n;
+
+	if (sched->epfd==-1) return;
+	do{
+		n=epoll_wait(sched->epfd,events,RTP_SCHEDULER_MAX_EVENTS,0);
+		for(i=0;i<n;i++){
+			RtpSession *session=(RtpSession*)events[i].data.ptr;
+			session_set_set(&sched->r_sessions,session);
+		}
+	}while(n==RTP_SCHEDULER_MAX_EVENTS);
+#endif
+}
+
+static void rtp_scheduler_pin_thread(RtpScheduler *sched){
+#if defined(__linux) && defined(CPU_SET)
+	cpu_set_t set;
+	if (sched->cpu<0) return;
+	CPU_ZERO(&set);
+	CPU_SET(sched->cpu,&set);
+	if (pthread_setaffinity_np(pthread_self(),sizeof(set),&set)!=0)
+		ortp_warning("Could not pin scheduler thread to cpu %i.",sched->cpu);
+#endif
+}
+
+/*registers a thread of session_set_select() to be woken up after each tick*/
+void rtp_scheduler_add_waiter(RtpScheduler *sched, RtpSchedulerWaiter *waiter){
+	ortp_mutex_lock(&sched->waiters_lock);
+	if (sched->nwaiters==sched->waiters_size){
+		sched->waiters_size=(sched->waiters_size==0) ? 8 : sched->waiters_size*2;
+		sched->waiters=(RtpSchedulerWaiter**)ortp_realloc(sched->waiters,sched->waiters_size*sizeof(RtpSchedulerWaiter*));
+	}
+	sched->waiters[sched->nwaiters++]=waiter;
+	ortp_mutex_unlock(&sched->waiters_lock);
+}
+
+void rtp_scheduler_remove_waiter(RtpScheduler *sched, RtpSchedulerWaiter *waiter){
+	int i;
+	ortp_mutex_lock(&sched->waiters_lock);
+	for(i=0;i<sched->nwaiters;i++){
+		if (sched->waiters[i]==waiter){
+			sched->waiters[i]=sched->waiters[--sched->nwaiters];
+			break;
+		}
+	}
+	ortp_mutex_unlock(&sched->waiters_lock);
+}
+
+/*wakes up the threads sleeping in session_set_select() on sessions of this scheduler*/
+static void rtp_scheduler_wake_waiters(RtpScheduler *sched){
+	int i;
+	ortp_mutex_lock(&sched->waiters_lock);
+	for(i=0;i<sched->nwaiters;i++){
+		RtpSchedulerWaiter *waiter=sched->waiters[i];
+		ortp_mutex_lock(&waiter->lock);
+		waiter->ticked=TRUE;
+		ortp_cond_signal(&waiter->cond);
+		ortp_mutex_unlock(&waiter->lock);
+	}
+	ortp_mutex_unlock(&sched->waiters_lock);
+}
+
 void * rtp_scheduler_schedule(void * psched)
 {
 	RtpScheduler *sched=(RtpScheduler*) psched;
@@ -106,27 +339,32 @@ void * rtp_scheduler_schedule(void * psched)
 	ortp_mutex_lock(&sched->lock);
 	ortp_cond_signal(&sched->unblock_select_cond);	/* unblock the starting thread */
 	ortp_mutex_unlock(&sched->lock);
+	rtp_scheduler_pin_thread(sched);
 	timer->timer_init();
 	while(sched->thread_running)
 	{
 		/* do the processing here: */
 		ortp_mutex_lock(&sched->lock);
 		
-		current=sched->list;
-		/* processing all scheduled rtp sessions */
-		while (current!=NULL)
+		rtp_scheduler_poll_sockets(sched);
+		/* processing the rtp sessions whose wake up time has come */
+		while ((current=rtp_scheduler_pop_expired(sched,sched->time_))!=NULL)
 		{
 			ortp_debug("scheduler: processing session=0x%x.\n",current);
 			rtp_session_process(current,sched->time_,sched);
-			current=current->next;
 		}
-		/* wake up all the threads that are sleeping in _select()  */
-		ortp_cond_broadcast(&sched->unblock_select_cond);
 		ortp_mutex_unlock(&sched->lock);
+		/* wake up the threads that are sleeping in _select() on our sessions */
+		rtp_scheduler_wake_waiters(sched);
 		
 		/* now while the scheduler is going to sleep, the other threads can compute their
 		result mask and see if they have to leave, or to wait for next tick*/
 		//ortp_message("scheduler: sleeping.");
+#if	!defined(_WIN32) && !defined(_WIN32_WCE)
+		if (timer==&posix_timer)
+			posix_timer_clock_wait(&sched->clock,sched->timer_inc);
+		else
+#endif
 		timer->timer_do();
 		sched->time_+=sched->timer_inc;
 	}
@@ -135,41 +373,78 @@ void * rtp_scheduler_schedule(void * psched)
 	return NULL;
 }
 
-void rtp_scheduler_add_session(RtpScheduler *sched, RtpSession *session)
+/* takes a free position in the session masks, from the pool shared by all the shards of
+a group so that SessionSets can mix sessions of different shards. Returns -1 if they are
+full. Must be called with the scheduler locked.*/
+static int rtp_scheduler_take_pos(RtpScheduler *sched){
+	RtpSchedulerGroup *group=sched->group;
+	SessionSet *used=(group!=NULL) ? &group->positions : &sched->all_sessions;
+	int i,pos=-1;
+	if (group!=NULL) ortp_mutex_lock(&group->lock);
+	for (i=0;i<sched->max_sessions;i++){
+		if (!ORTP_FD_ISSET(i,&used->rtpset)){
+			pos=i;
+			break;
+		}
+	}
+	if (group!=NULL){
+		if (pos!=-1){
+			ORTP_FD_SET(pos,&group->positions.rtpset);
+			group->owners[pos]=(unsigned char)sched->index;
+		}
+		ortp_mutex_unlock(&group->lock);
+	}
+	return pos;
+}
+
+static void rtp_scheduler_release_pos(RtpScheduler *sched, int pos){
+	RtpSchedulerGroup *group=sched->group;
+	if (group!=NULL){
+		ortp_mutex_lock(&group->lock);
+		ORTP_FD_CLR(pos,&group->positions.rtpset);
+		ortp_mutex_unlock(&group->lock);
+	}
+}
+
+/**
+ * Schedules the session. Returns -1 if the session masks are full: there can be at most
+ * max_sessions scheduled sessions, for all the shards of a group together.
+**/
+int rtp_scheduler_add_session(RtpScheduler *sched, RtpSession *session)
 {
 	RtpSession *oldfirst;
 	int i;
 	if (session->flags & RTP_SESSION_IN_SCHEDULER){
 		/* the rtp session is already scheduled, so return silently */
-		return;
+		return 0;
 	}
 	rtp_scheduler_lock(sched);
+	/* find a free pos in the session mask*/
+	i=rtp_scheduler_take_pos(sched);
+	if (i==-1){
+		rtp_scheduler_unlock(sched);
+		ortp_error("rtp_scheduler_add_session: no free position, %i sessions are already scheduled.",sched->nsessions);
+		return -1;
+	}
+	session->mask_pos=i;
+	session_set_set(&sched->all_sessions,session);
+	/* make a new session scheduled not blockable if it has not started*/
+	if (session->flags & RTP_SESSION_RECV_NOT_STARTED) 
+		session_set_set(&sched->r_sessions,session);
+	if (session->flags & RTP_SESSION_SEND_NOT_STARTED) 
+		session_set_set(&sched->w_sessions,session);
+	if (i>sched->all_max){
+		sched->all_max=i;
+	}
 	/* enqueue the session to the list of scheduled sessions */
 	oldfirst=sched->list;
 	sched->list=session;
 	session->next=oldfirst;
-	if (sched->max_sessions==0){
-		ortp_error("rtp_scheduler_add_session: max_session=0 !");
-	}
-	/* find a free pos in the session mask*/
-	for (i=0;i<sched->max_sessions;i++){
-		if (!ORTP_FD_ISSET(i,&sched->all_sessions.rtpset)){
-			session->mask_pos=i;
-			session_set_set(&sched->all_sessions,session);
-			/* make a new session scheduled not blockable if it has not started*/
-			if (session->flags & RTP_SESSION_RECV_NOT_STARTED) 
-				session_set_set(&sched->r_sessions,session);
-			if (session->flags & RTP_SESSION_SEND_NOT_STARTED) 
-				session_set_set(&sched->w_sessions,session);
-			if (i>sched->all_max){
-				sched->all_max=i;
-			}
-			break;
-		}
-	}
-	
+	sched->nsessions++;
 	rtp_session_set_flag(session,RTP_SESSION_IN_SCHEDULER);
+	rtp_scheduler_watch_socket(sched,session);
 	rtp_scheduler_unlock(sched);
+	return 0;
 }
 
 void rtp_scheduler_remove_session(RtpScheduler *sched, RtpSession *session)
@@ -183,11 +458,15 @@ void rtp_scheduler_remove_session(RtpScheduler *sched, RtpSession *session)
 	}
 
 	rtp_scheduler_lock(sched);
+	rtp_scheduler_purge_wakeups(sched,session);
+	rtp_scheduler_unwatch_socket(sched,session);
+	sched->nsessions--;
 	tmp=sched->list;
 	if (tmp==session){
 		sched->list=tmp->next;
 		rtp_session_unset_flag(session,RTP_SESSION_IN_SCHEDULER);
 		session_set_clr(&sched->all_sessions,session);
+		rtp_scheduler_release_pos(sched,session->mask_pos);
 		rtp_scheduler_unlock(sched);
 		return;
 	}
@@ -208,5 +487,84 @@ void rtp_scheduler_remove_session(RtpScheduler *sched, RtpSession *session)
 	rtp_session_unset_flag(session,RTP_SESSION_IN_SCHEDULER);
 	/* delete the bit in the mask */
 	session_set_clr(&sched->all_sessions,session);
+	rtp_scheduler_release_pos(sched,session->mask_pos);
 	rtp_scheduler_unlock(sched);
 }
+
+/**
+ * Creates count schedulers sharing the scheduled sessions, RTP_SCHEDULER_MAX_SHARDS at most.
+ * When there are several of them, each thread is pinned to a cpu. The shards take their
+ * mask positions from a common pool, so any of them can hold up to max_sessions sessions,
+ * all of them together too.
+**/
+RtpSchedulerGroup *rtp_scheduler_group_new(int count){
+	RtpSchedulerGroup *group=ortp_new0(RtpSchedulerGroup,1);
+	int i;
+#if	!defined(_WIN32) && !defined(_WIN32_WCE)
+	long ncpus=sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpus<1) ncpus=1;
+	if (count<=0) count=ncpus;
+	if (count>RTP_SCHEDULER_MAX_SHARDS) count=RTP_SCHEDULER_MAX_SHARDS;
+#else
+	/*the windows timer is a single global object*/
+	count=1;
+#endif
+	group->count=count;
+	group->shards=ortp_new0(RtpScheduler*,count);
+	ortp_mutex_init(&group->lock,NULL);
+	session_set_init(&group->positions);
+	group->owners=ortp_new0(unsigned char,sizeof(SessionSet)*8);
+	for(i=0;i<count;i++){
+		RtpScheduler *sched=rtp_scheduler_new();
+		sched->group=group;
+		sched->index=i;
+#if	!defined(_WIN32) && !defined(_WIN32_WCE)
+		if (count>1) sched->cpu=i%ncpus;
+#endif
+		group->shards[i]=sched;
+	}
+	return group;
+}
+
+void rtp_scheduler_group_start(RtpSchedulerGroup *group){
+	int i;
+#if	!defined(_WIN32) && !defined(_WIN32_WCE)
+	struct timeval orig;
+	/*same time origin for all shards, so that their clocks tick together*/
+	gettimeofday(&orig,NULL);
+	for(i=0;i<group->count;i++)
+		posix_timer_clock_init(&group->shards[i]->clock,&orig);
+#endif
+	for(i=0;i<group->count;i++)
+		rtp_scheduler_start(group->shards[i]);
+}
+
+/**
+ * Returns the shard with the fewest sessions.
+**/
+RtpScheduler *rtp_scheduler_group_pick(RtpSchedulerGroup *group){
+	RtpScheduler *best=NULL;
+	int i,best_count=0;
+	for(i=0;i<group->count;i++){
+		RtpScheduler *sched=group->shards[i];
+		int count;
+		rtp_scheduler_lock(sched);
+		count=sched->nsessions;
+		rtp_scheduler_unlock(sched);
+		if (best==NULL || count<best_count){
+			best=sched;
+			best_count=count;
+		}
+	}
+	return best;
+}
+
+void rtp_scheduler_group_destroy(RtpSchedulerGroup *group){
+	int i;
+	for(i=0;i<group->count;i++)
+		rtp_scheduler_destroy(group->shards[i]);
+	ortp_free(group->shards);
+	ortp_mutex_destroy(&group->lock);
+	ortp_free(group->owners);
+	ortp_free(group);
+}
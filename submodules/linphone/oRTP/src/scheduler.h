@@ -25,9 +25,36 @@
 #include "rtptimer.h"
 
 
+/* a pending wake up of the wait points of a session */
+typedef struct _RtpSchedulerWakeup{
+	uint32_t time;
+	RtpSession *session;
+}RtpSchedulerWakeup;
+
+struct _RtpSchedulerGroup;
+
+/* a thread waiting in session_set_select(), registered in the shards of the sessions it waits for */
+typedef struct _RtpSchedulerWaiter{
+	ortp_mutex_t lock;
+	ortp_cond_t cond;
+	bool_t ticked;	/* set by a shard after its tick, cleared by the waiter before polling */
+}RtpSchedulerWaiter;
+
 struct _RtpScheduler {
  
 	RtpSession *list;	/* list of scheduled sessions*/
+	int nsessions;	/* number of sessions in the list */
+	struct _RtpSchedulerGroup *group;	/* the group this scheduler is a shard of, or NULL */
+	int index;	/* index of the shard in its group */
+	int cpu;	/* the cpu the scheduler thread is pinned to, or -1 */
+#if	!defined(_WIN32) && !defined(_WIN32_WCE)
+	PosixTimerClock clock;	/* state of the posix timer for this scheduler */
+#endif
+	RtpSchedulerWakeup *wakeups;	/* min-heap of the armed wait points, ordered by time */
+	int wakeups_count;
+	int wakeups_size;
+	ortp_mutex_t wakeups_lock;	/* protects the heap, can be taken while holding a wait point lock */
+	int epfd;	/* epoll set of the sockets of sessions that wake up on data, or -1 */
 	SessionSet	all_sessions;  /* mask of scheduled sessions */
 	int		all_max;		/* the highest pos in the all mask */
 	SessionSet  r_sessions;		/* mask of sessions that have a recv event */
@@ -39,6 +66,10 @@ struct _RtpScheduler {
 	int max_sessions;		/* the number of position in the masks */
   /* GMutex  *unblock_select_mutex; */
 	ortp_cond_t   unblock_select_cond;
+	RtpSchedulerWaiter **waiters;	/* the threads to wake up after each tick */
+	int nwaiters;
+	int waiters_size;
+	ortp_mutex_t waiters_lock;
 	ortp_mutex_t	lock;
 	ortp_thread_t thread;
 	int thread_running;
@@ -48,6 +79,35 @@ struct _RtpScheduler {
 };
 
 typedef struct _RtpScheduler RtpScheduler;
+
+/*
+ * A set of schedulers sharing the scheduled sessions, each running its own thread.
+ * The shards take the positions of their sessions in the session masks from a pool
+ * shared by the group, so that SessionSets can mix sessions of different shards, and
+ * they use a common time origin. The group lock is only taken when a session is added
+ * or removed: a SessionSet is polled shard by shard, and a thread in
+ * session_set_select() is woken up by the shards of the sessions it waits for.
+ */
+#define RTP_SCHEDULER_MAX_SHARDS 64
+
+struct _RtpSchedulerGroup{
+	RtpScheduler **shards;
+	int count;
+	ortp_mutex_t lock;	/* protects the positions and their owners */
+	SessionSet positions;	/* the mask positions taken by the sessions of all the shards */
+	unsigned char *owners;	/* index of the shard of each taken position: it does not change
+				while the session is scheduled, so it is read without the lock */
+};
+
+typedef struct _RtpSchedulerGroup RtpSchedulerGroup;
+
+RtpSchedulerGroup *rtp_scheduler_group_new(int count);
+void rtp_scheduler_group_start(RtpSchedulerGroup *group);
+RtpScheduler *rtp_scheduler_group_pick(RtpSchedulerGroup *group);
+void rtp_scheduler_group_destroy(RtpSchedulerGroup *group);
+
+void rtp_scheduler_add_waiter(RtpScheduler *sched, RtpSchedulerWaiter *waiter);
+void rtp_scheduler_remove_waiter(RtpScheduler *sched, RtpSchedulerWaiter *waiter);
 	
 RtpScheduler * rtp_scheduler_new(void);
 void rtp_scheduler_set_timer(RtpScheduler *sched,RtpTimer *timer);
@@ -55,8 +115,10 @@ void rtp_scheduler_start(RtpScheduler *sched);
 void rtp_scheduler_stop(RtpScheduler *sched);
 void rtp_scheduler_destroy(RtpScheduler *sched);
 
-void rtp_scheduler_add_session(RtpScheduler *sched, RtpSession *session);
+int rtp_scheduler_add_session(RtpScheduler *sched, RtpSession *session);
 void rtp_scheduler_remove_session(RtpScheduler *sched, RtpSession *session);
+void rtp_scheduler_wakeup_at(RtpScheduler *sched, RtpSession *session, uint32_t time);
+void rtp_scheduler_watch_socket(RtpScheduler *sched, RtpSession *session);
 
 void * rtp_scheduler_schedule(void * sched);
 
@@ -66,4 +128,5 @@ void * rtp_scheduler_schedule(void * sched);
 /* void rtp_scheduler_add_set(RtpScheduler *sched, SessionSet *set); */
 
 RtpScheduler * ortp_get_scheduler(void);
+RtpSchedulerGroup * ortp_get_scheduler_group(void);
 #endif
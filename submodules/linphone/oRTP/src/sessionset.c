@@ -59,9 +59,10 @@ int count_power_items_simple(int v)
 int count_power_items_fast(int v) 
 {
     int c = 0;
-    while(v) {
-        c += (v & 1);
-	v >>= 1;
+    unsigned int u = (unsigned int)v; /* a signed shift never clears the sign bit */
+    while(u) {
+        c += (u & 1);
+	u >>= 1;
     }
     return c;
 }
@@ -88,6 +89,126 @@ int session_set_and(SessionSet *sched_set, int maxs, SessionSet *user_set, Sessi
 	return ret;
 }
 
+/* returns the mask of the shards owning the sessions of the set */
+static uint64_t session_set_shards(RtpSchedulerGroup *group, SessionSet *set)
+{
+	uint32_t *mask;
+	uint64_t shards=0;
+	int i,j;
+	if (set==NULL) return 0;
+	mask=(uint32_t*)(void*)&set->rtpset;
+	for(i=0;i<(int)(sizeof(ortp_fd_set)/sizeof(uint32_t));i++){
+		if (mask[i]==0) continue;
+		for(j=0;j<32;j++){
+			if (mask[i] & (1U<<j))
+				shards|=((uint64_t)1)<<group->owners[i*32+j];
+		}
+	}
+	return shards;
+}
+
+/* computes the intersection between the user set and the given scheduler set of the
+ shards in the mask, and accumulates it in result. The shards use disjoint mask positions. */
+static int session_set_collect(RtpSchedulerGroup *group, uint64_t shards, int which, SessionSet *user_set, SessionSet *result)
+{
+	SessionSet temp;
+	uint32_t *src,*dst;
+	int i,k,ret=0;
+	session_set_init(result);
+	for(k=0;k<group->count;k++){
+		RtpScheduler *sched=group->shards[k];
+		SessionSet *sched_set;
+		int bits;
+		if (!(shards & (((uint64_t)1)<<k))) continue;
+		/*lock the scheduler to not read the masks while they are being modified by the scheduler*/
+		rtp_scheduler_lock(sched);
+		if (which==0) sched_set=&sched->r_sessions;
+		else if (which==1) sched_set=&sched->w_sessions;
+		else sched_set=&sched->e_sessions;
+		session_set_init(&temp);
+		bits=session_set_and(sched_set,sched->all_max,user_set,&temp);
+		rtp_scheduler_unlock(sched);
+		if (bits==0) continue;
+		ret+=bits;
+		src=(uint32_t*)(void*)&temp.rtpset;
+		dst=(uint32_t*)(void*)&result->rtpset;
+		for(i=0;i<(int)(sizeof(ortp_fd_set)/sizeof(uint32_t));i++)
+			dst[i]|=src[i];
+	}
+	return ret;
+}
+
+/* computes the events of the three sets, and if any, copies the results in the user sets.*/
+static int session_set_poll(RtpSchedulerGroup *group, uint64_t shards, SessionSet *recvs, SessionSet *sends, SessionSet *errors)
+{
+	SessionSet rres,wres,eres;
+	int ret=0;
+	if (recvs!=NULL) ret+=session_set_collect(group,shards,0,recvs,&rres);
+	if (sends!=NULL) ret+=session_set_collect(group,shards,1,sends,&wres);
+	if (errors!=NULL) ret+=session_set_collect(group,shards,2,errors,&eres);
+	if (ret>0){
+		/* copy the result sets in the given user sets (might be empty) */
+		if (recvs!=NULL) session_set_copy(recvs,&rres);
+		if (sends!=NULL) session_set_copy(sends,&wres);
+		if (errors!=NULL) session_set_copy(errors,&eres);
+	}
+	return ret;
+}
+
+/* waits for events on the sets, for at most timeout_ms milliseconds of scheduler time if it is not negative.
+ The calling thread is only woken up by the ticks of the shards of its sessions.*/
+static int session_set_wait(SessionSet *recvs, SessionSet *sends, SessionSet *errors, int timeout_ms)
+{
+	RtpSchedulerGroup *group=ortp_get_scheduler_group();
+	RtpSchedulerWaiter waiter;
+	RtpScheduler *clock_shard=NULL;
+	uint64_t shards;
+	uint32_t last,now;
+	int k,ret=-1;
+
+	shards=session_set_shards(group,recvs)|session_set_shards(group,sends)|session_set_shards(group,errors);
+	/* with no session in the sets, only the time can elapse */
+	if (shards==0) shards=1;
+	ortp_mutex_init(&waiter.lock,NULL);
+	ortp_cond_init(&waiter.cond,NULL);
+	waiter.ticked=FALSE;
+	for(k=0;k<group->count;k++){
+		if (!(shards & (((uint64_t)1)<<k))) continue;
+		if (clock_shard==NULL) clock_shard=group->shards[k];
+		rtp_scheduler_add_waiter(group->shards[k],&waiter);
+	}
+	/* the time is counted on one shard, the others tick at the same pace */
+	last=clock_shard->time_;
+	while(1){
+		ortp_mutex_lock(&waiter.lock);
+		waiter.ticked=FALSE;
+		ortp_mutex_unlock(&waiter.lock);
+		ret=session_set_poll(group,shards,recvs,sends,errors);
+		if (ret>0) break;
+		if (timeout_ms>=0){
+			now=clock_shard->time_;
+			timeout_ms-=(int)(now-last);
+			last=now;
+			if (timeout_ms<=0){
+				ret=-1;
+				break;
+			}
+		}
+		/* else we wait until the next tick of one of the schedulers */
+		ortp_mutex_lock(&waiter.lock);
+		while(!waiter.ticked)
+			ortp_cond_wait(&waiter.cond,&waiter.lock);
+		ortp_mutex_unlock(&waiter.lock);
+	}
+	for(k=0;k<group->count;k++){
+		if (shards & (((uint64_t)1)<<k))
+			rtp_scheduler_remove_waiter(group->shards[k],&waiter);
+	}
+	ortp_cond_destroy(&waiter.cond);
+	ortp_mutex_destroy(&waiter.lock);
+	return ret;
+}
+
 /**
  *	This function performs similarly as libc select() function, but performs on #RtpSession 
  *	instead of file descriptors.
@@ -112,109 +233,12 @@ int session_set_and(SessionSet *sched_set, int maxs, SessionSet *user_set, Sessi
 **/
 int session_set_select(SessionSet *recvs, SessionSet *sends, SessionSet *errors)
 {
-	int ret=0,bits;
-	SessionSet temp;
-	RtpScheduler *sched=ortp_get_scheduler();
-	
-	/*lock the scheduler to not read the masks while they are being modified by the scheduler*/
-	rtp_scheduler_lock(sched);
-	
-	while(1){
-		/* computes the SessionSet intersection (in the other words mask intersection) between
-		the mask given by the user and scheduler masks */
-		if (recvs!=NULL){
-			session_set_init(&temp);
-			bits=session_set_and(&sched->r_sessions,sched->all_max,recvs,&temp);
-			ret+=bits;
-			/* copy the result set in the given user set (might be empty) */
-			if (ret>0) session_set_copy(recvs,&temp);
-		}
-		if (sends!=NULL){
-			session_set_init(&temp);
-			bits=session_set_and(&sched->w_sessions,sched->all_max,sends,&temp);
-			ret+=bits;
-			if (ret>0){
-				/* copy the result set in the given user set (might be empty)*/
-				session_set_copy(sends,&temp);
-			}
-		}
-		if (errors!=NULL){
-			session_set_init(&temp);
-			bits=session_set_and(&sched->e_sessions,sched->all_max,errors,&temp);
-			ret+=bits;
-			if (ret>0){
-				/* copy the result set in the given user set */
-				session_set_copy(errors,&temp);
-			}
-		}
-		if (ret>0){
-			/* there are set file descriptors, return immediately */
-			//printf("There are %i sessions set, returning.\n",ret);
-			rtp_scheduler_unlock(sched);
-			return ret;
-		}
-		//printf("There are %i sessions set.\n",ret);
-		/* else we wait until the next loop of the scheduler*/
-		ortp_cond_wait(&sched->unblock_select_cond,&sched->lock);
-	}
-
-	return -1;
+	return session_set_wait(recvs,sends,errors,-1);
 }
 
 int session_set_timedselect(SessionSet *recvs, SessionSet *sends, SessionSet *errors,  struct timeval *timeout)
 {
-	int ret=0,bits;
-	int remainingTime; // duration in ms
-	SessionSet temp;
-	RtpScheduler *sched;
 	if (timeout==NULL)
 		return session_set_select(recvs, sends, errors);
-	sched=ortp_get_scheduler();
-	remainingTime = timeout->tv_usec/1000 + timeout->tv_sec*1000;
-
-	/*lock the scheduler to not read the masks while they are being modified by the scheduler*/
-	rtp_scheduler_lock(sched);
-
-	do {
-		/* computes the SessionSet intersection (in the other words mask intersection) between
-		the mask given by the user and scheduler masks */
-		if (recvs!=NULL){
-			session_set_init(&temp);
-			bits=session_set_and(&sched->r_sessions,sched->all_max,recvs,&temp);
-			ret+=bits;
-			/* copy the result set in the given user set (might be empty) */
-			if (ret>0) session_set_copy(recvs,&temp);
-		}
-		if (sends!=NULL){
-			session_set_init(&temp);
-			bits=session_set_and(&sched->w_sessions,sched->all_max,sends,&temp);
-			ret+=bits;
-			if (ret>0){
-				/* copy the result set in the given user set (might be empty)*/
-				session_set_copy(sends,&temp);
-			}
-		}
-		if (errors!=NULL){
-			session_set_init(&temp);
-			bits=session_set_and(&sched->e_sessions,sched->all_max,errors,&temp);
-			ret+=bits;
-			if (ret>0){
-				/* copy the result set in the given user set */
-				session_set_copy(errors,&temp);
-			}
-		}
-		if (ret>0){
-			/* there are set file descriptors, return immediately */
-			//printf("There are %i sessions set, returning.\n",ret);
-			rtp_scheduler_unlock(sched);
-			return ret;
-		}
-		//printf("There are %i sessions set.\n",ret);
-		/* else we wait until the next loop of the scheduler*/
-		ortp_cond_wait(&sched->unblock_select_cond,&sched->lock);
-		remainingTime -= sched->timer_inc;
-	} while (remainingTime>0);
-	rtp_scheduler_unlock(sched);
-
-	return -1;
+	return session_set_wait(recvs,sends,errors,timeout->tv_usec/1000 + timeout->tv_sec*1000);
 }
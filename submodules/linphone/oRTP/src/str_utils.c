@@ -37,10 +37,300 @@ void mblk_init(mblk_t *mp)
 	mp->reserved2=0;
 }
 
+/*
+ * Message block pool.
+ * Every packet costs one mblk_t and one dblk_t (with its inline buffer), so
+ * instead of going back to ortp_malloc()/ortp_free() for each of them, released
+ * blocks are kept in size-classed free lists. Each thread owns a small cache
+ * that is served without locking; caches exchange batches of blocks with a
+ * global depot, which is bounded by msgb_pool_set_max_retained().
+ */
+
+enum{
+	MSGB_CLASS_MBLK,	/* mblk_t */
+	MSGB_CLASS_DBLK,	/* bare dblk_t, for esballoc() */
+	MSGB_CLASS_SMALL,	/* dblk_t + MSGB_POOL_SMALL_SIZE bytes */
+	MSGB_CLASS_MTU,	/* dblk_t + MSGB_POOL_MTU_SIZE bytes */
+	MSGB_CLASS_COUNT
+};
+
+#define MSGB_POOL_SMALL_SIZE 256
+#define MSGB_POOL_MTU_SIZE 1536
+#define MSGB_POOL_DEFAULT_MAX_RETAINED (1024*1024)
+#define MSGB_CACHE_MAX 64	/*max number of blocks per class in a thread cache*/
+#define MSGB_CACHE_BATCH 16	/*number of blocks exchanged at once with the depot*/
+
+typedef struct _msgb_node{
+	struct _msgb_node *next;
+}msgb_node_t;
+
+static const size_t msgb_class_size[MSGB_CLASS_COUNT]={
+	sizeof(mblk_t),
+	sizeof(dblk_t),
+	sizeof(dblk_t)+MSGB_POOL_SMALL_SIZE,
+	sizeof(dblk_t)+MSGB_POOL_MTU_SIZE
+};
+
+#if !defined(WIN32) && !defined(_WIN32_WCE)
+#define MSGB_POOL_ENABLED
+#endif
+
+#ifdef MSGB_POOL_ENABLED
+
+typedef struct _msgb_cache{
+	struct _msgb_cache *next;
+	msgb_node_t *free[MSGB_CLASS_COUNT];
+	int count[MSGB_CLASS_COUNT];
+	msgb_pool_stats_t stats;
+}msgb_cache_t;
+
+static struct{
+	ortp_mutex_t lock;
+	msgb_node_t *free[MSGB_CLASS_COUNT];
+	size_t retained;
+	size_t max_retained;
+	msgb_cache_t *caches;	/*caches of the living threads*/
+	msgb_pool_stats_t retired;	/*counters of the caches of the threads that have exited*/
+}msgb_depot={PTHREAD_MUTEX_INITIALIZER,{NULL},0,MSGB_POOL_DEFAULT_MAX_RETAINED,NULL,{0}};
+
+static pthread_key_t msgb_cache_key;
+static pthread_once_t msgb_cache_once=PTHREAD_ONCE_INIT;
+
+static void msgb_stats_add(msgb_pool_stats_t *dst, const msgb_pool_stats_t *src){
+	dst->hits+=src->hits;
+	dst->misses+=src->misses;
+	dst->releases+=src->releases;
+	dst->drops+=src->drops;
+}
+
+/*must be called with the depot locked*/
+static void msgb_depot_put(int cls, msgb_node_t *n, msgb_pool_stats_t *stats){
+	size_t sz=msgb_class_size[cls];
+	if (msgb_depot.retained+sz>msgb_depot.max_retained){
+		stats->drops++;
+		ortp_free(n);
+		return;
+	}
+	n->next=msgb_depot.free[cls];
+	msgb_depot.free[cls]=n;
+	msgb_depot.retained+=sz;
+}
+
+static void msgb_cache_destroy(void *data){
+	msgb_cache_t *c=(msgb_cache_t*)data;
+	msgb_cache_t **it;
+	int cls;
+
+	ortp_mutex_lock(&msgb_depot.lock);
+	for(it=&msgb_depot.caches;*it!=NULL;it=&(*it)->next){
+		if (*it==c){
+			*it=c->next;
+			break;
+		}
+	}
+	for(cls=0;cls<MSGB_CLASS_COUNT;++cls){
+		while(c->free[cls]!=NULL){
+			msgb_node_t *n=c->free[cls];
+			c->free[cls]=n->next;
+			msgb_depot_put(cls,n,&c->stats);
+		}
+	}
+	msgb_stats_add(&msgb_depot.retired,&c->stats);
+	ortp_mutex_unlock(&msgb_depot.lock);
+	free(c);
+}
+
+static void msgb_cache_key_init(void){
+	pthread_key_create(&msgb_cache_key,msgb_cache_destroy);
+}
+
+static msgb_cache_t *msgb_cache_get(void){
+	msgb_cache_t *c;
+	pthread_once(&msgb_cache_once,msgb_cache_key_init);
+	c=(msgb_cache_t*)pthread_getspecific(msgb_cache_key);
+	if (c==NULL){
+		/*not accounted as an ortp allocation: it is released by the thread key destructor*/
+		c=(msgb_cache_t*)calloc(1,sizeof(msgb_cache_t));
+		if (c==NULL) return NULL;
+		ortp_mutex_lock(&msgb_depot.lock);
+		c->next=msgb_depot.caches;
+		msgb_depot.caches=c;
+		ortp_mutex_unlock(&msgb_depot.lock);
+		pthread_setspecific(msgb_cache_key,c);
+	}
+	return c;
+}
+
+static void *msgb_pool_get(int cls){
+	msgb_cache_t *c=msgb_cache_get();
+	msgb_node_t *n;
+
+	if (c==NULL) return ortp_malloc(msgb_class_size[cls]);
+	if (c->free[cls]==NULL){
+		int i;
+		ortp_mutex_lock(&msgb_depot.lock);
+		for(i=0;i<MSGB_CACHE_BATCH && msgb_depot.max_retained>0 && msgb_depot.free[cls]!=NULL;++i){
+			n=msgb_depot.free[cls];
+			msgb_depot.free[cls]=n->next;
+			msgb_depot.retained-=msgb_class_size[cls];
+			n->next=c->free[cls];
+			c->free[cls]=n;
+			c->count[cls]++;
+		}
+		ortp_mutex_unlock(&msgb_depot.lock);
+	}
+	n=c->free[cls];
+	if (n==NULL){
+		c->stats.misses++;
+		return ortp_malloc(msgb_class_size[cls]);
+	}
+	c->free[cls]=n->next;
+	c->count[cls]--;
+	c->stats.hits++;
+	return n;
+}
+
+static void msgb_pool_put(int cls, void *ptr){
+	msgb_cache_t *c=msgb_cache_get();
+	msgb_node_t *n=(msgb_node_t*)ptr;
+
+	if (c==NULL){
+		ortp_free(ptr);
+		return;
+	}
+	if (c->count[cls]>=MSGB_CACHE_MAX){
+		int i;
+		bool_t disabled;
+		ortp_mutex_lock(&msgb_depot.lock);
+		disabled=(msgb_depot.max_retained==0);
+		/*when pooling has been disabled, the whole cache of this class is given back*/
+		for(i=0;c->free[cls]!=NULL && (disabled || i<MSGB_CACHE_BATCH);++i){
+			msgb_node_t *m=c->free[cls];
+			c->free[cls]=m->next;
+			c->count[cls]--;
+			msgb_depot_put(cls,m,&c->stats);
+		}
+		ortp_mutex_unlock(&msgb_depot.lock);
+		if (disabled){
+			c->stats.drops++;
+			ortp_free(ptr);
+			return;
+		}
+	}
+	c->stats.releases++;
+	n->next=c->free[cls];
+	c->free[cls]=n;
+	c->count[cls]++;
+}
+
+static void msgb_depot_flush(void){
+	int cls;
+	for(cls=0;cls<MSGB_CLASS_COUNT;++cls){
+		while(msgb_depot.free[cls]!=NULL){
+			msgb_node_t *n=msgb_depot.free[cls];
+			msgb_depot.free[cls]=n->next;
+			ortp_free(n);
+		}
+	}
+	msgb_depot.retained=0;
+}
+
+/**
+ * Sets the maximum amount of memory, in bytes, that the message block pool may keep
+ * in its global free lists. Each thread additionally caches at most a few dozens of
+ * blocks per size class.
+ * A value of 0 disables pooling: blocks are then allocated and freed individually,
+ * once each thread has drained the few blocks left in its cache.
+ * The limit is only read with the depot locked, when a thread cache runs empty or full.
+**/
+void msgb_pool_set_max_retained(size_t bytes){
+	ortp_mutex_lock(&msgb_depot.lock);
+	msgb_depot.max_retained=bytes;
+	if (msgb_depot.retained>bytes) msgb_depot_flush();
+	ortp_mutex_unlock(&msgb_depot.lock);
+}
+
+/**
+ * Retrieves the counters of the message block pool, summed over all threads.
+**/
+void msgb_pool_get_stats(msgb_pool_stats_t *stats){
+	msgb_cache_t *c;
+	int cls;
+
+	ortp_mutex_lock(&msgb_depot.lock);
+	*stats=msgb_depot.retired;
+	stats->retained=msgb_depot.retained;
+	for(c=msgb_depot.caches;c!=NULL;c=c->next){
+		msgb_stats_add(stats,&c->stats);
+		for(cls=0;cls<MSGB_CLASS_COUNT;++cls)
+			stats->retained+=c->count[cls]*msgb_class_size[cls];
+	}
+	ortp_mutex_unlock(&msgb_depot.lock);
+}
+
+/**
+ * Frees the blocks kept by the global free lists of the message block pool, and
+ * the ones kept by the cache of the calling thread.
+**/
+void msgb_pool_flush(void){
+	msgb_cache_t *c=msgb_cache_get();
+	int cls;
+
+	ortp_mutex_lock(&msgb_depot.lock);
+	msgb_depot_flush();
+	ortp_mutex_unlock(&msgb_depot.lock);
+	if (c==NULL) return;
+	for(cls=0;cls<MSGB_CLASS_COUNT;++cls){
+		while(c->free[cls]!=NULL){
+			msgb_node_t *n=c->free[cls];
+			c->free[cls]=n->next;
+			ortp_free(n);
+		}
+		c->count[cls]=0;
+	}
+}
+
+#else /*MSGB_POOL_ENABLED*/
+
+#define msgb_pool_get(cls)	ortp_malloc(msgb_class_size[cls])
+#define msgb_pool_put(cls,ptr)	ortp_free(ptr)
+
+void msgb_pool_set_max_retained(size_t bytes){
+}
+
+void msgb_pool_get_stats(msgb_pool_stats_t *stats){
+	memset(stats,0,sizeof(*stats));
+}
+
+void msgb_pool_flush(void){
+}
+
+#endif /*MSGB_POOL_ENABLED*/
+
+/*returns the pool class of a datab, or -1 if it was not allocated from the pool*/
+static inline int datab_class(const dblk_t *d){
+	if (d->db_freefn!=NULL) return MSGB_CLASS_DBLK;
+	if (d->db_base==(uint8_t*)d+sizeof(dblk_t)){
+		int capacity=(int)(d->db_lim-d->db_base);
+		if (capacity==MSGB_POOL_SMALL_SIZE) return MSGB_CLASS_SMALL;
+		if (capacity==MSGB_POOL_MTU_SIZE) return MSGB_CLASS_MTU;
+	}
+	return -1;
+}
+
 dblk_t *datab_alloc(int size){
 	dblk_t *db;
-	int total_size=sizeof(dblk_t)+size;
-	db=(dblk_t *) ortp_malloc(total_size);
+	int total_size;
+	if (size<=MSGB_POOL_SMALL_SIZE){
+		size=MSGB_POOL_SMALL_SIZE;
+		db=(dblk_t *) msgb_pool_get(MSGB_CLASS_SMALL);
+	}else if (size<=MSGB_POOL_MTU_SIZE){
+		size=MSGB_POOL_MTU_SIZE;
+		db=(dblk_t *) msgb_pool_get(MSGB_CLASS_MTU);
+	}else{
+		total_size=sizeof(dblk_t)+size;
+		db=(dblk_t *) ortp_malloc(total_size);
+	}
 	db->db_base=(uint8_t*)db+sizeof(dblk_t);
 	db->db_lim=db->db_base+size;
 	db->db_ref=1;
@@ -55,9 +345,11 @@ static inline void datab_ref(dblk_t *d){
 static inline void datab_unref(dblk_t *d){
 	d->db_ref--;
 	if (d->db_ref==0){
+		int cls=datab_class(d);
 		if (d->db_freefn!=NULL)
 			d->db_freefn(d->db_base);
-		ortp_free(d);
+		if (cls!=-1) msgb_pool_put(cls,d);
+		else ortp_free(d);
 	}
 }
 
@@ -67,7 +359,7 @@ mblk_t *allocb(int size, int pri)
 	mblk_t *mp;
 	dblk_t *datab;
 	
-	mp=(mblk_t *) ortp_malloc(sizeof(mblk_t));
+	mp=(mblk_t *) msgb_pool_get(MSGB_CLASS_MBLK);
 	mblk_init(mp);
 	datab=datab_alloc(size);
 	
@@ -77,14 +369,30 @@ mblk_t *allocb(int size, int pri)
 	return mp;
 }
 
+mblk_t *allocb_with_headroom(int size, int headroom, int pri)
+{
+	mblk_t *mp=allocb(size+headroom,pri);
+	mp->b_rptr+=headroom;
+	mp->b_wptr=mp->b_rptr;
+	return mp;
+}
+
+uint8_t *msgb_prepend(mblk_t *mp, int len)
+{
+	/* the space before b_rptr may be data of another mblk_t sharing the buffer */
+	if (mp->b_datap->db_ref!=1 || msgb_headroom(mp)<len) return NULL;
+	mp->b_rptr-=len;
+	return mp->b_rptr;
+}
+
 mblk_t *esballoc(uint8_t *buf, int size, int pri, void (*freefn)(void*) )
 {
 	mblk_t *mp;
 	dblk_t *datab;
 	
-	mp=(mblk_t *) ortp_malloc(sizeof(mblk_t));
+	mp=(mblk_t *) msgb_pool_get(MSGB_CLASS_MBLK);
 	mblk_init(mp);
-	datab=(dblk_t *) ortp_malloc(sizeof(dblk_t));
+	datab=(dblk_t *) msgb_pool_get(MSGB_CLASS_DBLK);
 	
 
 	datab->db_base=buf;
@@ -105,7 +413,7 @@ void freeb(mblk_t *mp)
 	return_if_fail(mp->b_datap->db_base!=NULL);
 	
 	datab_unref(mp->b_datap);
-	ortp_free(mp);
+	msgb_pool_put(MSGB_CLASS_MBLK,mp);
 }
 
 void freemsg(mblk_t *mp)
@@ -127,7 +435,7 @@ mblk_t *dupb(mblk_t *mp)
 	return_val_if_fail(mp->b_datap->db_base!=NULL,NULL);
 	
 	datab_ref(mp->b_datap);
-	newm=(mblk_t *) ortp_malloc(sizeof(mblk_t));
+	newm=(mblk_t *) msgb_pool_get(MSGB_CLASS_MBLK);
 	mblk_init(newm);
 	newm->reserved1=mp->reserved1;
 	newm->reserved2=mp->reserved2;
@@ -230,7 +538,12 @@ void msgpullup(mblk_t *mp,int len)
 	dblk_t *db;
 	int wlen=0;
 
-	if (mp->b_cont==NULL && len==-1) return;	/*nothing to do, message is not fragmented */
+	if (mp->b_cont==NULL){
+		if (len==-1) return;	/*nothing to do, message is not fragmented */
+		/*nothing to do either if the requested size fits in the buffer, and the buffer is not shared*/
+		if (len>=(int)(mp->b_wptr-mp->b_rptr) && mp->b_datap->db_ref==1 && mp->b_rptr+len<=mp->b_datap->db_lim)
+			return;
+	}
 
 	if (len==-1) len=msgdsize(mp);
 	db=datab_alloc(len);
@@ -312,28 +625,118 @@ mblk_t *concatb(mblk_t *mp, mblk_t *newm){
 	return newm;
 }
 
+/*
+ * msgb_allocator: buffers are kept in free lists indexed by size class, and a
+ * buffer goes back to its list as soon as the last message referencing it is
+ * freed. The free lists live in a separately allocated state which stays alive,
+ * after msgb_allocator_uninit(), until all the buffers still in use are released.
+ */
+
+#define MSGB_ALLOCATOR_MIN_SIZE 256
+
+typedef struct _msgb_allocator_buf{
+	struct _msgb_allocator_pool *pool;
+	struct _msgb_allocator_buf *next;
+	int cls;
+	int pad;	/*keeps the data that follows 8 bytes aligned on 32 bit platforms*/
+}msgb_allocator_buf_t;
+
+struct _msgb_allocator_pool{
+	ortp_mutex_t lock;
+	msgb_allocator_buf_t *free[MSGB_ALLOCATOR_CLASSES];
+	msgb_allocator_stats_t stats;
+	bool_t dead;
+};
+
+static void msgb_allocator_pool_destroy(msgb_allocator_pool_t *pool){
+	int cls;
+	for(cls=0;cls<MSGB_ALLOCATOR_CLASSES;++cls){
+		while(pool->free[cls]!=NULL){
+			msgb_allocator_buf_t *b=pool->free[cls];
+			pool->free[cls]=b->next;
+			ortp_free(b);
+		}
+	}
+	ortp_mutex_destroy(&pool->lock);
+	ortp_free(pool);
+}
+
+static void msgb_allocator_release(void *data){
+	msgb_allocator_buf_t *b=(msgb_allocator_buf_t*)data-1;
+	msgb_allocator_pool_t *pool=b->pool;
+	bool_t destroy=FALSE;
+
+	ortp_mutex_lock(&pool->lock);
+	pool->stats.in_use--;
+	if (pool->dead){
+		ortp_free(b);
+		destroy=(pool->stats.in_use==0);
+	}else{
+		b->next=pool->free[b->cls];
+		pool->free[b->cls]=b;
+		pool->stats.free_count++;
+	}
+	ortp_mutex_unlock(&pool->lock);
+	if (destroy) msgb_allocator_pool_destroy(pool);
+}
+
 void msgb_allocator_init(msgb_allocator_t *a){
-	qinit(&a->q);
+	a->pool=ortp_new0(msgb_allocator_pool_t,1);
+	ortp_mutex_init(&a->pool->lock,NULL);
 }
 
 mblk_t *msgb_allocator_alloc(msgb_allocator_t *a, int size){
-	queue_t *q=&a->q;
-	mblk_t *m,*found=NULL;
-
-	/*lookup for an unused msgb (data block with ref count ==1)*/
-	for(m=qbegin(q);!qend(q,m);m=qnext(q,m)){
-		if (m->b_datap->db_ref==1 && m->b_datap->db_lim-m->b_datap->db_base>=size){
-			found=m;
-			break;
-		}
+	msgb_allocator_pool_t *pool=a->pool;
+	msgb_allocator_buf_t *b;
+	int cls=0;
+	int capacity=MSGB_ALLOCATOR_MIN_SIZE;
+
+	while(capacity<size){
+		capacity<<=1;
+		cls++;
+	}
+	if (cls>=MSGB_ALLOCATOR_CLASSES){
+		/*too large to be worth keeping*/
+		ortp_mutex_lock(&pool->lock);
+		pool->stats.misses++;
+		ortp_mutex_unlock(&pool->lock);
+		return allocb(size,0);
 	}
-	if (found==NULL){
-		found=allocb(size,0);
-		putq(q,found);
+	ortp_mutex_lock(&pool->lock);
+	b=pool->free[cls];
+	if (b!=NULL){
+		pool->free[cls]=b->next;
+		pool->stats.free_count--;
+		pool->stats.hits++;
+	}else{
+		b=(msgb_allocator_buf_t*)ortp_malloc(sizeof(msgb_allocator_buf_t)+capacity);
+		b->pool=pool;
+		b->cls=cls;
+		pool->stats.misses++;
+		pool->stats.retained+=capacity;
 	}
-	return dupb(found);
+	pool->stats.in_use++;
+	ortp_mutex_unlock(&pool->lock);
+	return esballoc((uint8_t*)(b+1),capacity,0,msgb_allocator_release);
+}
+
+/**
+ * Retrieves the usage counters of a msgb_allocator_t.
+**/
+void msgb_allocator_get_stats(msgb_allocator_t *a, msgb_allocator_stats_t *stats){
+	ortp_mutex_lock(&a->pool->lock);
+	*stats=a->pool->stats;
+	ortp_mutex_unlock(&a->pool->lock);
 }
 
 void msgb_allocator_uninit(msgb_allocator_t *a){
-	flushq(&a->q,-1);
+	msgb_allocator_pool_t *pool=a->pool;
+	bool_t destroy;
+
+	a->pool=NULL;
+	ortp_mutex_lock(&pool->lock);
+	pool->dead=TRUE;
+	destroy=(pool->stats.in_use==0);
+	ortp_mutex_unlock(&pool->lock);
+	if (destroy) msgb_allocator_pool_destroy(pool);
 }
@@ -0,0 +1,299 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* this program compares the jitter queue of the RtpSession with the sorted list
+	it replaced, on a stream with reordering and losses, and checks that both return
+	the same packets. */
+
+#include <ortp/ortp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+static char *help="usage: jitterqueuebench [number_of_packets] [packets_per_frame] [reorder_percent] [reorder_distance] [loss_percent]\n"
+		"Puts number_of_packets in a jitter queue and reads them back a few frames later,\n"
+		"with the former sorted list and with the sequence number indexed ring.\n";
+
+#define SEQ_IS_GREATER(seq1,seq2)\
+	((uint16_t)((uint16_t)(seq1) - (uint16_t)(seq2))< (uint16_t)(1<<15))
+
+/* the former implementation: a queue_t sorted by sequence number */
+static void list_put(queue_t *q, mblk_t *mp, int max_packets){
+	mblk_t *tmp;
+	rtp_header_t *rtp=(rtp_header_t*)mp->b_rptr,*tmprtp;
+	if (qempty(q)) {
+		putq(q,mp);
+		return;
+	}
+	tmp=qlast(q);
+	while (!qend(q,tmp)){
+		tmprtp=(rtp_header_t*)tmp->b_rptr;
+		if (rtp->seq_number == tmprtp->seq_number){
+			freemsg(mp);
+			return;
+		}else if (SEQ_IS_GREATER(rtp->seq_number,tmprtp->seq_number)){
+			insq(q,tmp->b_next,mp);
+			goto trim;
+		}
+		tmp=tmp->b_prev;
+	}
+	insq(q,qfirst(q),mp);
+trim:
+	while (q->q_mcount > max_packets)
+		freemsg(getq(q));
+}
+
+static mblk_t *list_get(queue_t *q, uint32_t timestamp, int *rejected){
+	mblk_t *tmp,*ret=NULL,*old=NULL;
+	rtp_header_t *tmprtp;
+	uint32_t ts_found=0;
+	*rejected=0;
+	while ((tmp=qfirst(q))!=NULL){
+		tmprtp=(rtp_header_t*)tmp->b_rptr;
+		if ( RTP_TIMESTAMP_IS_NEWER_THAN(timestamp,tmprtp->timestamp) ){
+			if (ret!=NULL && tmprtp->timestamp==ts_found) break;
+			if (old!=NULL) {
+				(*rejected)++;
+				freemsg(old);
+			}
+			ret=getq(q);
+			ts_found=tmprtp->timestamp;
+			old=ret;
+		}else break;
+	}
+	return ret;
+}
+
+static double cpu_time(void){
+#ifndef _WIN32
+	struct rusage ru;
+	getrusage(RUSAGE_SELF,&ru);
+	return ru.ru_utime.tv_sec+ru.ru_stime.tv_sec+(ru.ru_utime.tv_usec+ru.ru_stime.tv_usec)*1e-6;
+#else
+	return (double)clock()/CLOCKS_PER_SEC;
+#endif
+}
+
+typedef struct _Arrival{
+	uint16_t seq;
+	uint32_t ts;
+	int pos; /*position in the arrival order*/
+}Arrival;
+
+static int compare_arrivals(const void *a, const void *b){
+	const Arrival *a1=(const Arrival*)a,*a2=(const Arrival*)b;
+	return a1->pos-a2->pos;
+}
+
+static mblk_t *make_packet(const Arrival *a){
+	mblk_t *mp=allocb(RTP_FIXED_HEADER_SIZE+1,0);
+	rtp_header_t *rtp=(rtp_header_t*)mp->b_wptr;
+	memset(rtp,0,RTP_FIXED_HEADER_SIZE);
+	rtp->version=2;
+	rtp->seq_number=a->seq;
+	rtp->timestamp=a->ts;
+	mp->b_wptr+=RTP_FIXED_HEADER_SIZE+1;
+	return mp;
+}
+
+/* a scripted sequence of puts and pops (-1) that both queues must agree on: the packet
+ put after a pop jumps ahead, while the oldest slots of the ring are empty */
+static const int pop_then_jump[]={0,5,-1,17,-1,-1,-1};
+
+static int run_script(int use_ring, const int *script, int nops, int max_packets, uint16_t *out){
+	queue_t list;
+	RtpJitterQueue ring;
+	int i,nout=0;
+
+	qinit(&list);
+	rtp_jitter_queue_init(&ring);
+	for(i=0;i<nops;i++){
+		if (script[i]>=0){
+			Arrival a;
+			a.seq=(uint16_t)script[i];
+			a.ts=script[i]*3000;
+			a.pos=i;
+			if (use_ring) rtp_jitter_queue_put(&ring,make_packet(&a),max_packets);
+			else list_put(&list,make_packet(&a),max_packets);
+		}else{
+			mblk_t *mp=use_ring ? rtp_jitter_queue_pop(&ring) : getq(&list);
+			if (mp!=NULL){
+				out[nout++]=((rtp_header_t*)mp->b_rptr)->seq_number;
+				freemsg(mp);
+			}
+		}
+	}
+	flushq(&list,0);
+	rtp_jitter_queue_uninit(&ring);
+	return nout;
+}
+
+/* returns 0 if both queues return the same packets for the script */
+static int check_script(const char *name, const int *script, int nops, int max_packets){
+	uint16_t outlist[16],outring[16];
+	int nlist=run_script(0,script,nops,max_packets,outlist);
+	int nring=run_script(1,script,nops,max_packets,outring);
+	if (nlist!=nring || memcmp(outlist,outring,nlist*sizeof(uint16_t))!=0){
+		printf("%s: the two queues returned different packets !\n",name);
+		return -1;
+	}
+	return 0;
+}
+
+/* a packet that jumps ahead of the whole ring is a resync: the queued ones are dropped,
+ and flushing the queue releases the ring. Returns 0 if the ring does so. */
+static int check_resync(void){
+	RtpJitterQueue ring;
+	Arrival a;
+	int i,discarded=0,ok;
+	rtp_jitter_queue_init(&ring);
+	for(i=0;i<4;i++){
+		a.seq=i;
+		a.ts=i*3000;
+		a.pos=i;
+		discarded+=rtp_jitter_queue_put(&ring,make_packet(&a),8);
+	}
+	a.seq=1000;
+	a.ts=1000*3000;
+	discarded+=rtp_jitter_queue_put(&ring,make_packet(&a),8);
+	ok=(discarded==4 && ring.count==1 && ring.size==16
+		&& ((rtp_header_t*)rtp_jitter_queue_peek(&ring)->b_rptr)->seq_number==1000);
+	rtp_jitter_queue_flush(&ring);
+	ok=ok && ring.slots==NULL && ring.size==0;
+	rtp_jitter_queue_uninit(&ring);
+	if (!ok){
+		printf("resync: the ring did not drop the queued packets !\n");
+		return -1;
+	}
+	return 0;
+}
+
+/* runs the stream through one of the queues, the reader being depth frames late.
+ The sequence numbers of the returned packets are written in out.*/
+static double run(int use_ring, const Arrival *arrivals, int narrivals, int depth, int max_packets,
+	uint16_t *out, int *nout, int *rejected){
+	queue_t list;
+	RtpJitterQueue ring;
+	mblk_t **packets=ortp_malloc(narrivals*sizeof(mblk_t*));
+	int i,rej;
+	uint32_t frame_ts=0,newest_ts=0;
+	double begin,elapsed;
+
+	for(i=0;i<narrivals;i++) packets[i]=make_packet(&arrivals[i]);
+	qinit(&list);
+	rtp_jitter_queue_init(&ring);
+	*nout=0;
+	*rejected=0;
+	begin=cpu_time();
+	for(i=0;i<narrivals;i++){
+		if (use_ring) rtp_jitter_queue_put(&ring,packets[i],max_packets);
+		else list_put(&list,packets[i],max_packets);
+		if (arrivals[i].ts>newest_ts) newest_ts=arrivals[i].ts;
+		/* read the frames that are depth frames older than the newest one */
+		while(frame_ts+depth*3000<=newest_ts){
+			mblk_t *mp;
+			do{
+				mp=use_ring ? rtp_jitter_queue_get(&ring,frame_ts,&rej) : list_get(&list,frame_ts,&rej);
+				*rejected+=rej;
+				if (mp!=NULL){
+					out[(*nout)++]=((rtp_header_t*)mp->b_rptr)->seq_number;
+					freemsg(mp);
+				}
+			}while(mp!=NULL);
+			frame_ts+=3000;
+		}
+	}
+	elapsed=cpu_time()-begin;
+	flushq(&list,0);
+	rtp_jitter_queue_uninit(&ring);
+	ortp_free(packets);
+	return elapsed;
+}
+
+int main(int argc, char *argv[]){
+	int npackets=200000;
+	int ppf=20;
+	int reorder=10;
+	int distance=100;
+	int loss=2;
+	int depth=50;
+	int i,n=0,nlist,nring,rejlist,rejring,max_packets;
+	Arrival *arrivals;
+	uint16_t *outlist,*outring;
+	double tlist,tring;
+
+	if (argc>1 && (npackets=atoi(argv[1]))<=0){
+		printf("%s",help);
+		return -1;
+	}
+	if (argc>2) ppf=atoi(argv[2]);
+	if (argc>3) reorder=atoi(argv[3]);
+	if (argc>4) distance=atoi(argv[4]);
+	if (argc>5) loss=atoi(argv[5]);
+	if (ppf<=0) ppf=1;
+	if (distance<=0) distance=1;
+
+	ortp_init();
+	ortp_set_log_level_mask(ORTP_WARNING|ORTP_ERROR);
+	/* 8 packets at most: the ring has 16 slots */
+	if (check_script("pop then jump",pop_then_jump,sizeof(pop_then_jump)/sizeof(int),8)!=0
+		|| check_resync()!=0){
+		ortp_exit();
+		return -1;
+	}
+	srandom(1);
+	arrivals=ortp_malloc(npackets*sizeof(Arrival));
+	for(i=0;i<npackets;i++){
+		if (random()%100<loss) continue;
+		arrivals[n].seq=(uint16_t)i;
+		arrivals[n].ts=(i/ppf)*3000;
+		/* delay some packets by up to distance positions */
+		arrivals[n].pos=2*i;
+		if (random()%100<reorder) arrivals[n].pos+=1+2*(random()%distance);
+		n++;
+	}
+	qsort(arrivals,n,sizeof(Arrival),compare_arrivals);
+	outlist=ortp_malloc(n*sizeof(uint16_t));
+	outring=ortp_malloc(n*sizeof(uint16_t));
+	max_packets=depth*ppf*2;
+	tlist=run(0,arrivals,n,depth,max_packets,outlist,&nlist,&rejlist);
+	tring=run(1,arrivals,n,depth,max_packets,outring,&nring,&rejring);
+	printf("%i packets, %i per frame, %i%% reordered up to %i positions, %i%% lost, reader %i frames late\n",
+		n,ppf,reorder,distance,loss,depth);
+	printf("sorted list: %.3f s of cpu, returned %i packets, %i rejected\n",tlist,nlist,rejlist);
+	printf("ring:        %.3f s of cpu, returned %i packets, %i rejected\n",tring,nring,rejring);
+	if (distance>=2*max_packets){
+		/* the ring only has room for 2*max_packets sequence numbers: it drops the packets
+		delayed further on arrival, where the list returns them late */
+		printf("packets delayed beyond the ring are dropped by it, the results are not compared\n");
+	}else if (nlist!=nring || rejlist!=rejring || memcmp(outlist,outring,nlist*sizeof(uint16_t))!=0){
+		printf("the two queues returned different packets !\n");
+		n=-1;
+	}
+	ortp_free(arrivals);
+	ortp_free(outlist);
+	ortp_free(outring);
+	ortp_exit();
+	return n<0 ? -1 : 0;
+}
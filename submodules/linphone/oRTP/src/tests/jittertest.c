@@ -0,0 +1,137 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* this program feeds synthetic jitter traces to the adaptive jitter control, and checks
+	the compensation chosen from the histogram of the lateness of the packets, and that
+	a silence is told apart from a network stall. */
+
+#include <ortp/ortp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../jitterctl.h"
+
+#define CLOCK_RATE 8000
+#define PACKET_TS 160	/* 20 ms */
+#define LATE_TS 480	/* 60 ms */
+
+static int failures=0;
+
+static void check(int cond, const char *what){
+	if (!cond){
+		printf("FAILED: %s\n",what);
+		failures++;
+	}
+}
+
+static void init_control(JitterControl *ctl, PayloadType *pt, int min_size, int max_size, float late_loss_rate){
+	memset(ctl,0,sizeof(*ctl));
+	jitter_control_set_histogram_params(ctl,min_size,max_size,late_loss_rate);
+	jitter_control_init(ctl,20,pt);
+	jitter_control_enable_adaptive(ctl,TRUE);
+}
+
+/* one packet out of ten arrives 60ms late, the others on time. Returns the next timestamp */
+static uint32_t feed_trace(JitterControl *ctl, uint32_t ts, uint32_t arrival_offset, int npackets){
+	int i;
+	for(i=0;i<npackets;i++){
+		uint32_t arrival=ts+arrival_offset;
+		if (i%10==9) arrival+=LATE_TS;
+		jitter_control_new_packet(ctl,ts,arrival,FALSE);
+		ts+=PACKET_TS;
+	}
+	return ts;
+}
+
+static int target_ms(JitterControl *ctl){
+	jitter_stats_t stats;
+	memset(&stats,0,sizeof(stats));
+	jitter_control_update_stats(ctl,&stats);
+	return stats.target_jitter_buffer_size_ms;
+}
+
+static int size_ms(JitterControl *ctl){
+	jitter_stats_t stats;
+	memset(&stats,0,sizeof(stats));
+	jitter_control_update_stats(ctl,&stats);
+	return stats.jitter_buffer_size_ms;
+}
+
+static void test_percentile(PayloadType *pt){
+	JitterControl ctl;
+	int target;
+
+	/* 10% of the packets are late by 60ms, minus the average slide of 6ms: keeping
+	late packets under 5% needs a compensation covering their lateness */
+	init_control(&ctl,pt,20,-1,5.0f);
+	feed_trace(&ctl,1000,0,1000);
+	target=target_ms(&ctl);
+	check(target>=50 && target<=60,"the target covers the 95th percentile of the lateness");
+	check(size_ms(&ctl)==target,"the compensation converges to the target");
+
+	/* with 20% allowed, the late packets are left out and the target is the minimum */
+	init_control(&ctl,pt,20,-1,20.0f);
+	feed_trace(&ctl,1000,0,1000);
+	check(target_ms(&ctl)==20,"the target does not go below min_size");
+
+	init_control(&ctl,pt,20,40,5.0f);
+	feed_trace(&ctl,1000,0,1000);
+	check(target_ms(&ctl)==40,"the target does not go beyond max_size");
+}
+
+static void test_silence(PayloadType *pt){
+	JitterControl ctl;
+	uint32_t ts;
+
+	/* after 100 packets the compensation moved by two steps of 10ms toward a target of ~55ms */
+	init_control(&ctl,pt,20,-1,5.0f);
+	ts=feed_trace(&ctl,1000,0,100);
+	check(size_ms(&ctl)==40 && target_ms(&ctl)>40,"the compensation moves by small steps");
+	/* the sender stops for one second: the timestamp jumps over the gap in arrivals */
+	ts+=CLOCK_RATE;
+	jitter_control_new_packet(&ctl,ts,ts,FALSE);
+	check(size_ms(&ctl)==target_ms(&ctl),"the target is applied at once after a silence");
+
+	init_control(&ctl,pt,20,-1,5.0f);
+	ts=feed_trace(&ctl,1000,0,100);
+	/* a new talkspurt, without timestamp jump */
+	jitter_control_new_packet(&ctl,ts,ts+CLOCK_RATE,TRUE);
+	check(size_ms(&ctl)==target_ms(&ctl),"the target is applied at once on a new talkspurt");
+
+	/* the network stalls for one second: the timestamps are contiguous, the packets
+	are still to be played, the compensation must not jump */
+	init_control(&ctl,pt,20,-1,5.0f);
+	ts=feed_trace(&ctl,1000,0,100);
+	jitter_control_new_packet(&ctl,ts,ts+CLOCK_RATE,FALSE);
+	check(size_ms(&ctl)==40,"a network stall is not taken for a silence");
+}
+
+int main(int argc, char *argv[]){
+	PayloadType *pt;
+	ortp_init();
+	ortp_set_log_level_mask(ORTP_WARNING|ORTP_ERROR);
+	pt=payload_type_clone(&payload_type_pcmu8000);
+	test_percentile(pt);
+	test_silence(pt);
+	payload_type_destroy(pt);
+	ortp_exit();
+	if (failures==0) printf("all tests passed\n");
+	return failures==0 ? 0 : -1;
+}
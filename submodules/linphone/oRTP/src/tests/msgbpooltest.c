@@ -0,0 +1,148 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* this program checks that the message block pool recycles the blocks that are
+	freed, and that it does not keep more memory than it is allowed to, and that a
+	msgb_allocator_t reuses its buffers. */
+
+#include <ortp/ortp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NBLOCKS 1000
+
+static int failures=0;
+
+static void check(int cond, const char *what){
+	if (!cond){
+		printf("FAILED: %s\n",what);
+		failures++;
+	}
+}
+
+static void test_pool_reuse(void){
+	msgb_pool_stats_t before,after;
+	mblk_t *mp;
+	uint8_t *base;
+	int i;
+
+	msgb_pool_set_max_retained(1024*1024);
+	mp=allocb(100,0);
+	base=mp->b_datap->db_base;
+	freeb(mp);
+	msgb_pool_get_stats(&before);
+	check(before.retained>0,"a freed block is retained by the pool");
+	for(i=0;i<10;i++){
+		mp=allocb(100,0);
+		check(mp->b_datap->db_base==base,"a freed block is handed out again");
+		freeb(mp);
+	}
+	msgb_pool_get_stats(&after);
+	/* one mblk_t and one dblk_t per allocation */
+	check(after.hits-before.hits==20,"allocations are served from the free lists");
+	check(after.misses==before.misses,"no allocation goes to ortp_malloc()");
+}
+
+static void test_pool_trim(void){
+	msgb_pool_stats_t before,after;
+	mblk_t **blocks=ortp_malloc(NBLOCKS*sizeof(mblk_t*));
+	size_t limit=16*1024;
+	int i;
+
+	msgb_pool_flush();
+	msgb_pool_set_max_retained(limit);
+	msgb_pool_get_stats(&before);
+	for(i=0;i<NBLOCKS;i++) blocks[i]=allocb(1000,0);
+	for(i=0;i<NBLOCKS;i++) freeb(blocks[i]);
+	msgb_pool_get_stats(&after);
+	check(after.drops>before.drops,"blocks beyond the limit are freed");
+	/* the thread cache may keep a few dozens blocks of each class on top of the depot */
+	check(after.retained<=limit+64*(sizeof(mblk_t)+sizeof(dblk_t)+1536),"the retained memory stays bounded");
+
+	msgb_pool_flush();
+	msgb_pool_get_stats(&after);
+	check(after.retained==0,"msgb_pool_flush() releases everything");
+
+	/* with pooling disabled, every block eventually goes back to ortp_free() */
+	msgb_pool_set_max_retained(0);
+	for(i=0;i<NBLOCKS;i++) blocks[i]=allocb(1000,0);
+	for(i=0;i<NBLOCKS;i++) freeb(blocks[i]);
+	msgb_pool_get_stats(&after);
+	check(after.retained<=64*(sizeof(mblk_t)+sizeof(dblk_t)+1536),"a disabled pool keeps nothing but the thread cache");
+	msgb_pool_set_max_retained(1024*1024);
+	ortp_free(blocks);
+}
+
+static void test_allocator(void){
+	msgb_allocator_t allocator;
+	msgb_allocator_stats_t stats;
+	mblk_t *blocks[4];
+	mblk_t *mp;
+	uint8_t *base;
+	int i;
+
+	msgb_allocator_init(&allocator);
+	mp=msgb_allocator_alloc(&allocator,300);
+	check(mp->b_datap->db_lim-mp->b_datap->db_base>=300,"the buffer is large enough");
+	base=mp->b_datap->db_base;
+	freemsg(mp);
+	mp=msgb_allocator_alloc(&allocator,400);
+	check(mp->b_datap->db_base==base,"a released buffer of the same size class is reused");
+	/* a duplicate keeps the buffer in use */
+	blocks[0]=dupb(mp);
+	freemsg(mp);
+	mp=msgb_allocator_alloc(&allocator,400);
+	check(mp->b_datap->db_base!=base,"a buffer still referenced is not reused");
+	freemsg(mp);
+	freemsg(blocks[0]);
+	msgb_allocator_get_stats(&allocator,&stats);
+	check(stats.hits==1 && stats.misses==2,"hits and misses are counted");
+	check(stats.in_use==0 && stats.free_count==2,"released buffers go back to the free lists");
+
+	/* once the free list is exhausted, new buffers are allocated */
+	for(i=0;i<4;i++) blocks[i]=msgb_allocator_alloc(&allocator,400);
+	msgb_allocator_get_stats(&allocator,&stats);
+	check(stats.hits==3 && stats.misses==4 && stats.in_use==4,"an exhausted free list falls back to a new buffer");
+
+	/* sizes beyond the largest class are not kept */
+	mp=msgb_allocator_alloc(&allocator,100000);
+	check(mp!=NULL && mp->b_datap->db_lim-mp->b_datap->db_base>=100000,"a large buffer is allocated");
+	freemsg(mp);
+	msgb_allocator_get_stats(&allocator,&stats);
+	check(stats.misses==5 && stats.in_use==4,"a large buffer is not owned by the allocator");
+
+	/* buffers still in use stay valid after msgb_allocator_uninit() */
+	msgb_allocator_uninit(&allocator);
+	for(i=0;i<4;i++){
+		memset(blocks[i]->b_datap->db_base,i,400);
+		freemsg(blocks[i]);
+	}
+}
+
+int main(int argc, char *argv[]){
+	ortp_init();
+	ortp_set_log_level_mask(ORTP_WARNING|ORTP_ERROR);
+	test_pool_reuse();
+	test_pool_trim();
+	test_allocator();
+	ortp_exit();
+	if (failures==0) printf("all tests passed\n");
+	return failures==0 ? 0 : -1;
+}
@@ -0,0 +1,235 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* this program checks the loss and reordering models of the network simulator, the
+	replay of a trace, and that it delivers at once all the packets whose delay has expired. */
+
+#include <ortp/ortp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "../rtpsession_priv.h"
+
+static int failures=0;
+
+static void check(int cond, const char *what){
+	if (!cond){
+		printf("FAILED: %s\n",what);
+		failures++;
+	}
+}
+
+static void sleep_ms(int ms){
+#ifndef _WIN32
+	usleep(ms*1000);
+#else
+	Sleep(ms);
+#endif
+}
+
+static mblk_t *make_packet(uint32_t num){
+	mblk_t *mp=allocb(sizeof(num),0);
+	memcpy(mp->b_wptr,&num,sizeof(num));
+	mp->b_wptr+=sizeof(num);
+	return mp;
+}
+
+static uint32_t packet_num(mblk_t *mp){
+	uint32_t num;
+	memcpy(&num,mp->b_rptr,sizeof(num));
+	return num;
+}
+
+static RtpSession *new_session(const OrtpNetworkSimulatorParams *params){
+	RtpSession *session=rtp_session_new(RTP_SESSION_RECVONLY);
+	rtp_session_enable_network_simulation(session,params);
+	return session;
+}
+
+/* sends npackets through the simulator without delay, and returns the number of losses
+ and the average length of the bursts of losses */
+static int run_losses(const OrtpNetworkSimulatorParams *params, int npackets, float *avg_burst){
+	RtpSession *session=new_session(params);
+	queue_t q;
+	mblk_t *mp;
+	uint32_t expected=0;
+	int lost=0,bursts=0;
+	int i;
+
+	qinit(&q);
+	for(i=0;i<npackets;i++){
+		rtp_session_network_simulate(session,make_packet(i),&q);
+		while((mp=getq(&q))!=NULL){
+			uint32_t num=packet_num(mp);
+			if (num!=expected){
+				lost+=num-expected;
+				bursts++;
+			}
+			expected=num+1;
+			freemsg(mp);
+		}
+	}
+	if (expected!=(uint32_t)npackets){
+		lost+=npackets-expected;
+		bursts++;
+	}
+	*avg_burst=bursts ? (float)lost/bursts : 0;
+	rtp_session_destroy(session);
+	return lost;
+}
+
+static void test_loss(void){
+	OrtpNetworkSimulatorParams params;
+	float avg_burst;
+	int lost;
+
+	memset(&params,0,sizeof(params));
+	params.enabled=TRUE;
+	params.seed=1;
+	params.loss_rate=10;
+	lost=run_losses(&params,10000,&avg_burst);
+	check(lost>800 && lost<1200,"loss_rate is a percentage");
+	check(avg_burst<1.3f,"random losses are isolated");
+
+	/* a bad state entered 5% of the time and left half of the time, losing all packets:
+	9% of losses, by bursts of 2 packets on average */
+	memset(&params,0,sizeof(params));
+	params.enabled=TRUE;
+	params.seed=1;
+	params.ge_good_to_bad=5;
+	params.ge_bad_to_good=50;
+	params.ge_good_loss=0;
+	params.ge_bad_loss=100;
+	lost=run_losses(&params,10000,&avg_burst);
+	check(lost>700 && lost<1100,"the Gilbert-Elliott probabilities are percentages");
+	check(avg_burst>1.6f && avg_burst<2.4f,"Gilbert-Elliott losses come by bursts");
+}
+
+static void test_reorder(void){
+	OrtpNetworkSimulatorParams params;
+	RtpSession *session;
+	queue_t q;
+	mblk_t *mp;
+	uint32_t highest=0;
+	int received=0,reordered=0;
+	int i;
+
+	memset(&params,0,sizeof(params));
+	params.enabled=TRUE;
+	params.seed=1;
+	params.reorder_rate=10;
+	params.reorder_delay=20;
+	session=new_session(&params);
+	qinit(&q);
+	/* a packet every 5ms: a reordered packet arrives after the 4 next ones */
+	for(i=1;i<=200;i++){
+		rtp_session_network_simulate(session,make_packet(i),&q);
+		sleep_ms(5);
+	}
+	sleep_ms(30);
+	rtp_session_network_simulate(session,NULL,&q);
+	while((mp=getq(&q))!=NULL){
+		uint32_t num=packet_num(mp);
+		if (num<highest) reordered++;
+		else highest=num;
+		received++;
+		freemsg(mp);
+	}
+	check(received==200,"reordered packets are not lost");
+	check(reordered>=10 && reordered<=30,"reorder_rate is a percentage");
+	rtp_session_destroy(session);
+}
+
+static void test_drain(void){
+	OrtpNetworkSimulatorParams params;
+	RtpSession *session;
+	queue_t q;
+	int i;
+
+	memset(&params,0,sizeof(params));
+	params.enabled=TRUE;
+	params.latency=50;
+	session=new_session(&params);
+	qinit(&q);
+	for(i=0;i<10;i++) rtp_session_network_simulate(session,make_packet(i),&q);
+	check(q.q_mcount==0,"packets are delayed");
+	sleep_ms(60);
+	/* all the expired packets come out with the next one, which is held */
+	rtp_session_network_simulate(session,make_packet(10),&q);
+	check(q.q_mcount==10,"all the packets whose delay expired are delivered at once");
+	flushq(&q,0);
+	rtp_session_destroy(session);
+}
+
+/* a trace losing every other packet, replayed for 8 packets sent at once */
+static int run_trace(int by_time, uint32_t *received_mask){
+	static const char *trace_path="netsimtest-trace.txt";
+	OrtpNetworkSimulatorParams params;
+	RtpSession *session;
+	queue_t q;
+	mblk_t *mp;
+	FILE *f;
+	int received=0;
+	uint32_t i;
+
+	f=fopen(trace_path,"w");
+	if (f==NULL) return -1;
+	fputs("# time delay\n0 0\n10 -1\n20 0\n30 -1\n",f);
+	fclose(f);
+	memset(&params,0,sizeof(params));
+	params.enabled=TRUE;
+	params.trace_file=trace_path;
+	params.trace_by_time=by_time;
+	session=new_session(&params);
+	unlink(trace_path);
+	qinit(&q);
+	*received_mask=0;
+	for(i=0;i<8;i++) rtp_session_network_simulate(session,make_packet(i),&q);
+	while((mp=getq(&q))!=NULL){
+		*received_mask|=1<<packet_num(mp);
+		received++;
+		freemsg(mp);
+	}
+	rtp_session_destroy(session);
+	return received;
+}
+
+static void test_trace(void){
+	uint32_t mask;
+	check(run_trace(FALSE,&mask)==4 && mask==0x55,"the trace is replayed an entry per packet");
+	/* all the packets arrive within the first entry */
+	check(run_trace(TRUE,&mask)==8,"the trace is replayed by the time of the packets with trace_by_time");
+}
+
+int main(int argc, char *argv[]){
+	ortp_init();
+	ortp_set_log_level_mask(ORTP_WARNING|ORTP_ERROR);
+	test_loss();
+	test_reorder();
+	test_trace();
+	test_drain();
+	ortp_exit();
+	if (failures==0) printf("all tests passed\n");
+	return failures==0 ? 0 : -1;
+}
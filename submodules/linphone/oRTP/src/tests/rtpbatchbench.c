@@ -0,0 +1,170 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* this program measures how many rtp packets per second of cpu time can be sent
+	and received over the loopback interface, with and without batched socket io,
+	and optionally with srtp.
+	Over loopback the kernel delivers the datagrams to the receiving socket while the
+	sender is in sendto(), so part of the receive cost is accounted to the send side:
+	only the total is meaningful to compare the two modes.
+	It exits with an error if a packet is lost or received corrupted, so that it also
+	checks the batched srtp transport. */
+
+#include <ortp/ortp.h>
+#include <ortp/ortp_srtp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+static char *help="usage: rtpbatchbench [number_of_packets] [payload_size] [burst] [srtp]\n"
+		"Sends and receives number_of_packets over loopback, by bursts of burst packets,\n"
+		"once with one datagram per system call and once with batched system calls.\n"
+		"With the srtp argument, the packets are protected with AES_CM_128_HMAC_SHA1_80.\n";
+
+static const char *srtp_key="d0RmdmcmVCspeEc3QGZiNWpVLFJhQX1cfHAwJSoj";
+
+static RtpTransport *enable_srtp(RtpSession *session){
+	RtpTransport *rtpt=NULL;
+	srtp_t srtp=ortp_srtp_create_configure_session(AES_128_SHA1_80,rtp_session_get_send_ssrc(session),srtp_key,srtp_key);
+	if (srtp==NULL){
+		printf("Could not create the srtp session.\n");
+		exit(-1);
+	}
+	srtp_transport_new(srtp,&rtpt,NULL);
+	rtp_session_set_transports(session,rtpt,NULL);
+	return rtpt;
+}
+
+static void free_srtp(RtpTransport *rtpt){
+	if (rtpt==NULL) return;
+	ortp_srtp_dealloc((srtp_t)rtpt->data);
+	ortp_free(rtpt);
+}
+
+/* the bursts last a few microseconds: getrusage() is only precise to the scheduler tick */
+static double cpu_time(void){
+#if defined(CLOCK_PROCESS_CPUTIME_ID)
+	struct timespec tp;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&tp);
+	return tp.tv_sec+tp.tv_nsec*1e-9;
+#elif !defined(_WIN32)
+	struct rusage ru;
+	getrusage(RUSAGE_SELF,&ru);
+	return ru.ru_utime.tv_sec+ru.ru_stime.tv_sec+(ru.ru_utime.tv_usec+ru.ru_stime.tv_usec)*1e-6;
+#else
+	return (double)clock()/CLOCKS_PER_SEC;
+#endif
+}
+
+static RtpSession *create_session(int mode, int batch){
+	RtpSession *session=rtp_session_new(mode);
+	rtp_session_set_scheduling_mode(session,0);
+	rtp_session_set_blocking_mode(session,0);
+	rtp_session_enable_jitter_buffer(session,FALSE);
+	rtp_session_enable_rtcp(session,FALSE);
+	rtp_session_set_payload_type(session,0);
+	rtp_session_set_rtp_socket_recv_buffer_size(session,1024*1024);
+	rtp_session_set_io_batch_size(session,batch);
+	return session;
+}
+
+/* returns the number of packets lost or corrupted */
+static int run(int batch, int npackets, int payload_size, int burst, bool_t use_srtp){
+	RtpSession *sender=create_session(RTP_SESSION_SENDONLY,batch);
+	RtpSession *receiver=create_session(RTP_SESSION_RECVONLY,batch);
+	mblk_t *packets[RTP_IO_BATCH_MAX];
+	uint8_t *payload=ortp_malloc0(payload_size);
+	double send_time=0,recv_time=0,begin;
+	int sent=0,received=0,corrupted=0,i;
+	RtpTransport *sender_tr=NULL,*receiver_tr=NULL;
+	uint32_t ts=0,user_ts=0;
+
+	for(i=0;i<payload_size;i++) payload[i]=(uint8_t)i;
+
+	rtp_session_set_local_addr(receiver,"127.0.0.1",0);
+	rtp_session_set_remote_addr(sender,"127.0.0.1",rtp_session_get_local_port(receiver));
+	if (use_srtp){
+		sender_tr=enable_srtp(sender);
+		receiver_tr=enable_srtp(receiver);
+	}
+	while(sent<npackets){
+		int n=(npackets-sent<burst) ? npackets-sent : burst;
+		begin=cpu_time();
+		for(i=0;i<n;i++)
+			packets[i]=rtp_session_create_packet(sender,RTP_FIXED_HEADER_SIZE,payload,payload_size);
+		rtp_session_sendm_batch_with_ts(sender,packets,n,ts);
+		send_time+=cpu_time()-begin;
+		sent+=n;
+		ts+=160;
+		begin=cpu_time();
+		while(1){
+			mblk_t *m=rtp_session_recvm_with_ts(receiver,user_ts++);
+			unsigned char *data;
+			if (m==NULL) break;
+			received++;
+			if (rtp_get_payload(m,&data)!=payload_size || memcmp(data,payload,payload_size)!=0)
+				corrupted++;
+			freemsg(m);
+		}
+		recv_time+=cpu_time()-begin;
+	}
+	printf("%sbatch=%-2i sent %i packets: %.0f packets/s of cpu, received %i packets: %.0f packets/s of cpu, total %.2f us per packet\n",
+		use_srtp ? "srtp " : "",batch,sent,sent/send_time,received,received/recv_time,(send_time+recv_time)*1e6/sent);
+	ortp_free(payload);
+	rtp_session_destroy(sender);
+	rtp_session_destroy(receiver);
+	free_srtp(sender_tr);
+	free_srtp(receiver_tr);
+	if (corrupted>0) printf("%i packets were received corrupted.\n",corrupted);
+	return sent-received+corrupted;
+}
+
+int main(int argc, char *argv[]){
+	int npackets=200000;
+	int payload_size=160;
+	int burst=RTP_IO_BATCH_MAX;
+	bool_t use_srtp=FALSE;
+	int errors;
+
+	if (argc>1 && (npackets=atoi(argv[1]))<=0){
+		printf("%s",help);
+		return -1;
+	}
+	if (argc>2) payload_size=atoi(argv[2]);
+	if (argc>3) burst=atoi(argv[3]);
+	if (burst<=0 || burst>RTP_IO_BATCH_MAX) burst=RTP_IO_BATCH_MAX;
+	if (argc>4 && strcmp(argv[4],"srtp")==0) use_srtp=TRUE;
+
+	ortp_init();
+	ortp_set_log_level_mask(ORTP_WARNING|ORTP_ERROR);
+	if (use_srtp && !ortp_srtp_supported()){
+		printf("oRTP was built without srtp support.\n");
+		return -1;
+	}
+	errors=run(1,npackets,payload_size,burst,use_srtp);
+	errors+=run(RTP_IO_BATCH_MAX,npackets,payload_size,burst,use_srtp);
+	ortp_exit();
+	return errors==0 ? 0 : -1;
+}
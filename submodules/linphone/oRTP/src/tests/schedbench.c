@@ -0,0 +1,162 @@
+/*
+  The oRTP library is an RTP (Realtime Transport Protocol - rfc3550) stack.
+  Copyright (C) 2001  Simon MORLAT simon.morlat@linphone.org
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* this program measures how the scheduler scales with the number of scheduler threads:
+	number_of_sessions scheduled sessions send a 20ms audio packet each to the discard port,
+	driven by application threads that each wait on their own SessionSet.
+	Run it with several shard counts to compare, e.g. 'schedbench 800 1 4' and
+	'schedbench 800 4 4': the packet rate should stay at 50 packets per second per session,
+	and the cpu time per packet should not grow with the number of shards. */
+
+#include <ortp/ortp.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+static char *help="usage: schedbench [number_of_sessions] [number_of_shards] [number_of_threads] [seconds]\n"
+		"Sends 50 packets per second on each session during seconds, with number_of_shards\n"
+		"scheduler threads (0 for one per cpu) and number_of_threads application threads.\n";
+
+#define PAYLOAD_SIZE 160
+
+typedef struct _Worker{
+	ortp_thread_t thread;
+	RtpSession **sessions;
+	int nsessions;
+	int seconds;
+	long sent;
+	long selects;
+}Worker;
+
+static double cpu_time(void){
+#if defined(CLOCK_PROCESS_CPUTIME_ID)
+	struct timespec tp;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&tp);
+	return tp.tv_sec+tp.tv_nsec*1e-9;
+#elif !defined(_WIN32)
+	struct rusage ru;
+	getrusage(RUSAGE_SELF,&ru);
+	return ru.ru_utime.tv_sec+ru.ru_stime.tv_sec+(ru.ru_utime.tv_usec+ru.ru_stime.tv_usec)*1e-6;
+#else
+	return (double)clock()/CLOCKS_PER_SEC;
+#endif
+}
+
+static double wall_time(void){
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return tv.tv_sec+tv.tv_usec*1e-6;
+}
+
+static void *worker_run(void *data){
+	Worker *w=(Worker*)data;
+	SessionSet *set=session_set_new();
+	uint32_t *ts=ortp_new0(uint32_t,w->nsessions);
+	unsigned char payload[PAYLOAD_SIZE];
+	uint32_t end_ts=w->seconds*8000;
+	int done=0;
+	int k;
+
+	memset(payload,0,sizeof(payload));
+	while(done<w->nsessions){
+		session_set_init(set);
+		for(k=0;k<w->nsessions;k++){
+			if (ts[k]<end_ts) session_set_set(set,w->sessions[k]);
+		}
+		session_set_select(NULL,set,NULL);
+		w->selects++;
+		for(k=0;k<w->nsessions;k++){
+			if (ts[k]<end_ts && session_set_is_set(set,w->sessions[k])){
+				rtp_session_send_with_ts(w->sessions[k],payload,PAYLOAD_SIZE,ts[k]);
+				w->sent++;
+				ts[k]+=160;
+				if (ts[k]>=end_ts) done++;
+			}
+		}
+	}
+	ortp_free(ts);
+	session_set_destroy(set);
+	return NULL;
+}
+
+int main(int argc, char *argv[]){
+	int nsessions=400;
+	int nshards=1;
+	int nthreads=4;
+	int seconds=5;
+	RtpSession **sessions;
+	Worker *workers;
+	double begin_cpu,begin_wall,cpu,wall;
+	long sent=0,selects=0;
+	int i;
+
+	if (argc>1 && (nsessions=atoi(argv[1]))<=0){
+		printf("%s",help);
+		return -1;
+	}
+	if (argc>2) nshards=atoi(argv[2]);
+	if (argc>3) nthreads=atoi(argv[3]);
+	if (argc>4) seconds=atoi(argv[4]);
+	if (nthreads<=0 || nthreads>nsessions) nthreads=1;
+	if (seconds<=0) seconds=1;
+
+	ortp_init();
+	ortp_set_log_level_mask(ORTP_WARNING|ORTP_ERROR);
+	ortp_scheduler_init_shards(nshards);
+	sessions=ortp_new0(RtpSession*,nsessions);
+	for(i=0;i<nsessions;i++){
+		sessions[i]=rtp_session_new(RTP_SESSION_SENDONLY);
+		rtp_session_set_scheduling_mode(sessions[i],1);
+		rtp_session_set_blocking_mode(sessions[i],0);
+		rtp_session_set_remote_addr(sessions[i],"127.0.0.1",9);
+		rtp_session_set_payload_type(sessions[i],0);
+	}
+	workers=ortp_new0(Worker,nthreads);
+	begin_cpu=cpu_time();
+	begin_wall=wall_time();
+	for(i=0;i<nthreads;i++){
+		/* each thread drives a contiguous slice of the sessions */
+		workers[i].sessions=sessions+(i*nsessions)/nthreads;
+		workers[i].nsessions=((i+1)*nsessions)/nthreads-(i*nsessions)/nthreads;
+		workers[i].seconds=seconds;
+		ortp_thread_create(&workers[i].thread,NULL,worker_run,&workers[i]);
+	}
+	for(i=0;i<nthreads;i++){
+		ortp_thread_join(workers[i].thread,NULL);
+		sent+=workers[i].sent;
+		selects+=workers[i].selects;
+	}
+	cpu=cpu_time()-begin_cpu;
+	wall=wall_time()-begin_wall;
+	printf("%i sessions, %i application threads, %i seconds of media\n",nsessions,nthreads,seconds);
+	printf("sent %li packets in %.2f s: %.1f packets/s per session (50 expected), %li selects\n",
+		sent,wall,sent/wall/nsessions,selects);
+	printf("%.2f s of cpu, %.2f us per packet\n",cpu,cpu*1e6/sent);
+	for(i=0;i<nsessions;i++) rtp_session_destroy(sessions[i]);
+	ortp_free(sessions);
+	ortp_free(workers);
+	ortp_exit();
+	return 0;
+}